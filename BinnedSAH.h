@@ -0,0 +1,165 @@
+#ifndef BINNEDSAH_H
+#define BINNEDSAH_H
+
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include "Cartesian3.h"
+#include "SimdMath.h"
+
+//the boxes & the binned surface area heuristic that MeshBVH & Scene build their hierarchies with.
+//the boxes are aligned float4s, so that growing one is a single min & max rather than six of each,
+//and a build keeps them in the order of its primitive ids,
+//partitioning both together, so that every pass over a node's boxes reads them in sequence
+
+//an axis aligned box, empty until it is grown. the fourth lanes are padding.
+//growing keeps the box's own bound where the two are equal, so a +0 & a -0 resolve as std::min() would
+struct alignas(16) SAHBox
+{
+    float lower[4] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), 0.f };
+    float upper[4] = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), 0.f };
+
+    SAHBox() = default;
+    SAHBox(const Cartesian3 & boundsMin, const Cartesian3 & boundsMax)
+        : lower{ boundsMin.x, boundsMin.y, boundsMin.z, 0.f }, upper{ boundsMax.x, boundsMax.y, boundsMax.z, 0.f } {}
+
+    inline auto grow(const SAHBox & other) -> void
+    {
+        SimdMath::store(lower, SimdMath::min(SimdMath::load(other.lower), SimdMath::load(lower)));
+        SimdMath::store(upper, SimdMath::max(SimdMath::load(other.upper), SimdMath::load(upper)));
+    }
+
+    inline auto grow(const Cartesian3 & point) -> void
+    {
+        SimdMath::float4 p = SimdMath::set(point.x, point.y, point.z, 0.f);
+        SimdMath::store(lower, SimdMath::min(p, SimdMath::load(lower)));
+        SimdMath::store(upper, SimdMath::max(p, SimdMath::load(upper)));
+    }
+
+    inline auto centre(int axis) const -> float { return (lower[axis] + upper[axis]) * 0.5f; }
+
+    inline auto surfaceArea() const -> float
+    {
+        float x = upper[0] - lower[0], y = upper[1] - lower[1], z = upper[2] - lower[2];
+        return 2.f * (x * y + y * z + z * x);
+    }
+
+    inline auto getMin() const -> Cartesian3 { return Cartesian3(lower[0], lower[1], lower[2]); }
+    inline auto getMax() const -> Cartesian3 { return Cartesian3(upper[0], upper[1], upper[2]); }
+};
+
+//where to split a set of boxes: those whose centres fall in bins [0, bin] along axis go left
+struct SAHSplit
+{
+    int axis = 0;
+    uint32_t bin = 0;
+    uint32_t binCount = 1;
+    float origin = 0.f;
+    float binScale = 0.f;
+    //surface area times box count, summed over both sides; max() when no split leaves both sides with boxes
+    float cost = std::numeric_limits<float>::max();
+
+    inline auto binOf(const SAHBox & box) const -> uint32_t
+    {
+        return std::min(binCount - 1, (uint32_t)((box.centre(axis) - origin) * binScale));
+    }
+    inline auto goesLeft(const SAHBox & box) const -> bool { return binOf(box) <= bin; }
+};
+
+//the box around boxes[0, count), & the box around their centres
+inline auto boundSAHBoxes(const SAHBox * boxes, uint32_t count, SAHBox & bounds, SAHBox & centres) -> void
+{
+    SimdMath::float4 boundsLower = SimdMath::load(bounds.lower), boundsUpper = SimdMath::load(bounds.upper);
+    SimdMath::float4 centresLower = SimdMath::load(centres.lower), centresUpper = SimdMath::load(centres.upper);
+    const SimdMath::float4 half = SimdMath::splat(0.5f);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        SimdMath::float4 lower = SimdMath::load(boxes[i].lower), upper = SimdMath::load(boxes[i].upper);
+        SimdMath::float4 centre = SimdMath::mul(SimdMath::add(lower, upper), half);
+        boundsLower = SimdMath::min(lower, boundsLower);
+        boundsUpper = SimdMath::max(upper, boundsUpper);
+        centresLower = SimdMath::min(centre, centresLower);
+        centresUpper = SimdMath::max(centre, centresUpper);
+    }
+    SimdMath::store(bounds.lower, boundsLower);
+    SimdMath::store(bounds.upper, boundsUpper);
+    SimdMath::store(centres.lower, centresLower);
+    SimdMath::store(centres.upper, centresUpper);
+}
+
+//bins boxes[0, count) by their centres into BINS along the axis the centres spread furthest, then
+//sweeps in from the right & from the left for the cheapest split. no split is found if the centres coincide
+template <uint32_t BINS>
+inline auto findSAHSplit(const SAHBox * boxes, uint32_t count, const SAHBox & centres) -> SAHSplit
+{
+    SAHSplit split;
+    split.binCount = BINS;
+    for(int other = 1; other < 3; other++)
+        if(centres.upper[other] - centres.lower[other] > centres.upper[split.axis] - centres.lower[split.axis])
+            split.axis = other;
+    float extent = centres.upper[split.axis] - centres.lower[split.axis];
+    if(count < 2 || !(extent > 0.f))
+        return split;
+    split.origin = centres.lower[split.axis];
+    split.binScale = BINS / extent;
+
+    SAHBox bins[BINS];
+    uint32_t binCounts[BINS] = {};
+    for(uint32_t i = 0; i < count; i++)
+    {
+        const SAHBox & box = boxes[i];
+        uint32_t bin = split.binOf(box);
+        bins[bin].grow(box);
+        binCounts[bin]++;
+    }
+
+    float rightCost[BINS];
+    SAHBox sweep;
+    uint32_t sweepCount = 0;
+    for(uint32_t bin = BINS - 1; bin > 0; bin--)
+    {
+        sweep.grow(bins[bin]);
+        sweepCount += binCounts[bin];
+        rightCost[bin] = sweepCount > 0 ? sweep.surfaceArea() * sweepCount : 0.f;
+    }
+    sweep = SAHBox();
+    sweepCount = 0;
+    for(uint32_t bin = 0; bin + 1 < BINS; bin++)
+    {
+        sweep.grow(bins[bin]);
+        sweepCount += binCounts[bin];
+        if(sweepCount == 0 || sweepCount == count)
+            continue;
+        float cost = sweep.surfaceArea() * sweepCount + rightCost[bin + 1];
+        if(cost < split.cost)
+        {
+            split.cost = cost;
+            split.bin = bin;
+        }
+    }
+    return split;
+}
+
+//moves the boxes that go left, & their ids with them, to the front of boxes[0, count) & ids[0, count),
+//returning how many there are. the order comes out as std::partition() would leave it
+inline auto partitionSAH(SAHBox * boxes, uint32_t * ids, uint32_t count, const SAHSplit & split) -> uint32_t
+{
+    uint32_t first = 0, last = count;
+    while(true)
+    {
+        while(first != last && split.goesLeft(boxes[first]))
+            first++;
+        if(first == last)
+            return first;
+        last--;
+        while(first != last && !split.goesLeft(boxes[last]))
+            last--;
+        if(first == last)
+            return first;
+        std::swap(boxes[first], boxes[last]);
+        std::swap(ids[first], ids[last]);
+        first++;
+    }
+}
+
+#endif // BINNEDSAH_H
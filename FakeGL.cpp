@@ -19,8 +19,12 @@
 #include <cassert>
 #include <memory.h>
 #include <limits>
+#include <algorithm>
 #include "MathUtils.h"
 #include "Shader.h"
+#include "FrameCapture.h"
+#include "Meshlet.h"
+#include "ShadowSource.h"
 
 //-------------------------------------------------//
 //                                                 //
@@ -31,6 +35,7 @@
 // constructor
 FakeGL::FakeGL()
 { // constructor
+    ownStatisticsContext = statisticsContext = PipelineStatistics::newContext();
     stateMechine.matrixMode = FAKEGL_MODELVIEW;
     stateMechine.envMode = FAKEGL_REPLACE;
     stateMechine.modelViewMatrixStack.push({});
@@ -43,6 +48,7 @@ FakeGL::FakeGL()
 // destructor
 FakeGL::~FakeGL()
 { // destructor
+    PipelineStatistics::releaseContext(ownStatisticsContext);
 } // destructor
 
 //-------------------------------------------------//
@@ -63,55 +69,16 @@ void FakeGL::Begin(unsigned int primitiveType)
 // ends a sequence of geometric primitives
 void FakeGL::End()
 { // End()
-
-    if(stateMechine.enables[FAKEGL_TEXTURE_2D])
+    if(ConditionalRenderDiscards())
     {
-        stateMechine.currentShader->bindTexture(&stateMechine.texture);
-    }
-    else
-    {
-        stateMechine.currentShader->bindTexture(nullptr);
+        vertexQueue.clear();
+        stateMechine.drawType = -1;
+        return;
     }
 
+    PrepareShader();
     TransformVertex();
-    if(RasterisePrimitive()){
-        switch ( stateMechine.drawType)
-        {
-        case FAKEGL_POINTS:{
-            while(rasterQueue.size() > 0){
-                auto & a = rasterQueue.front();
-                RasterisePoint(a);
-                rasterQueue.pop_front();
-            }
-        }
-            break;
-        case FAKEGL_LINES:
-            while(rasterQueue.size() > 1){
-                auto a = rasterQueue.front();
-                rasterQueue.pop_front();
-                auto b = rasterQueue.front();
-                rasterQueue.pop_front();
-                RasteriseLineSegment(a,b);
-            }
-        break;
-
-        case FAKEGL_TRIANGLES:
-            while(rasterQueue.size() > 2){
-                auto a = rasterQueue.front();
-                rasterQueue.pop_front();
-                auto b = rasterQueue.front();
-                rasterQueue.pop_front();
-                auto c = rasterQueue.front();
-                rasterQueue.pop_front();
-                RasteriseTriangle(a,b,c);
-            }
-        break;
-        default:
-            break;
-        }
-        ProcessFragment();
-    }
-    stateMechine.drawType = -1;
+    ProcessRasterQueue();
 } // End()
 
 // sets the size of a point for drawing
@@ -146,9 +113,11 @@ void FakeGL::PushMatrix()
     switch (stateMechine.matrixMode) {
     case  FAKEGL_MODELVIEW:
         stateMechine.modelViewMatrixStack.push(identity);
+        stateMechine.markDirty(DIRTY_MODELVIEW);
     break;
     case FAKEGL_PROJECTION:
         stateMechine.projectionMatrixStack.push(identity);
+        stateMechine.markDirty(DIRTY_PROJECTION);
     break;
     }
 } // PushMatrix()
@@ -159,9 +128,11 @@ void FakeGL::PopMatrix()
     switch (stateMechine.matrixMode) {
     case  FAKEGL_MODELVIEW:
         stateMechine.modelViewMatrixStack.pop();
+        stateMechine.markDirty(DIRTY_MODELVIEW);
     break;
     case FAKEGL_PROJECTION:
         stateMechine.projectionMatrixStack.pop();
+        stateMechine.markDirty(DIRTY_PROJECTION);
     break;
     }
 } // PopMatrix()
@@ -315,6 +286,7 @@ void FakeGL::Color3f(float red, float green, float blue)
 // sets material properties
 void FakeGL::Materialf(unsigned int parameterName, const float parameterValue)
 { // Materialf()
+    stateMechine.markDirty(DIRTY_MATERIAL);
     if(parameterName & FAKEGL_SHININESS)
     {
         stateMechine.material.setShininess(parameterValue);
@@ -323,7 +295,7 @@ void FakeGL::Materialf(unsigned int parameterName, const float parameterValue)
 
 void FakeGL::Materialfv(unsigned int parameterName, const float *parameterValues)
 { // Materialfv()
-
+    stateMechine.markDirty(DIRTY_MATERIAL);
     if(parameterName & FAKEGL_AMBIENT)
     {
         stateMechine.material.setAmbient({parameterValues});
@@ -364,8 +336,212 @@ void FakeGL::Vertex3f(float x, float y, float z)
     v.texCoord = stateMechine.currentSurface.textCoord;
     v.divZ = 1.f;
     vertexQueue.emplace_back(v);
+    PipelineStatistics::add(statisticsContext, PipelineStatistics::VerticesSubmitted);
 } // Vertex3f()
 
+//-------------------------------------------------//
+//                                                 //
+// VERTEX ARRAY ROUTINES                           //
+//                                                 //
+//-------------------------------------------------//
+
+// set the arrays that DrawElements() fetches from
+void FakeGL::VertexPointer(const Cartesian3 *positions)
+{ // VertexPointer()
+    stateMechine.vertexArrays.positions = positions;
+} // VertexPointer()
+
+void FakeGL::NormalPointer(const Cartesian3 *normals)
+{ // NormalPointer()
+    stateMechine.vertexArrays.normals = normals;
+} // NormalPointer()
+
+void FakeGL::TexCoordPointer(const Cartesian3 *texCoords)
+{ // TexCoordPointer()
+    stateMechine.vertexArrays.texCoords = texCoords;
+} // TexCoordPointer()
+
+void FakeGL::QuantisedVertexPointer(const QuantisedVertex *vertices, const Cartesian3 &offset, const Cartesian3 &step)
+{ // QuantisedVertexPointer()
+    stateMechine.vertexArrays.quantised = vertices;
+    stateMechine.vertexArrays.quantisedOffset = offset;
+    stateMechine.vertexArrays.quantisedStep = step;
+} // QuantisedVertexPointer()
+
+// draws count indices worth of primitives from the arrays
+void FakeGL::DrawElements(unsigned int primitiveType, unsigned int count, const unsigned int *indices)
+{ // DrawElements()
+    const VertexArrays &arrays = stateMechine.vertexArrays;
+    if (arrays.positions == nullptr && arrays.quantised == nullptr)
+        return;
+    if (ConditionalRenderDiscards())
+        return;
+
+    Begin(primitiveType);
+    PrepareShader();
+
+    // the cache only lives for one draw, since the matrices may change in between
+    const unsigned int emptySlot = std::numeric_limits<unsigned int>::max();
+    vertexCacheTags.assign(FAKEGL_VERTEX_CACHE_SIZE, emptySlot);
+    vertexCache.resize(FAKEGL_VERTEX_CACHE_SIZE);
+    unsigned int nextSlot = 0;
+
+    vertexWithAttributes vertex;
+
+    PipelineStatistics::add(statisticsContext, PipelineStatistics::VerticesSubmitted, count);
+    uint64_t misses = 0;
+    for (unsigned int element = 0; element < count; element++)
+        { // per index
+        unsigned int index = indices[element];
+        unsigned int slot = 0;
+        while (slot < FAKEGL_VERTEX_CACHE_SIZE && vertexCacheTags[slot] != index)
+            slot++;
+
+        if (slot == FAKEGL_VERTEX_CACHE_SIZE)
+            { // cache miss
+            FetchVertex(index, vertex);
+            vertex.normal = vertex.normal * stateMechine.getDerivedState().normalScale;
+
+            // shade into the oldest slot
+            slot = nextSlot;
+            nextSlot = (nextSlot + 1) % FAKEGL_VERTEX_CACHE_SIZE;
+            vertexCache[slot] = stateMechine.currentShader->vertexShader(vertex, *this);
+            normalizeToWindow(vertexCache[slot]);
+            vertexCacheTags[slot] = index;
+            misses++;
+            } // cache miss
+
+        rasterQueue.emplace_back(vertexCache[slot]);
+        } // per index
+    PipelineStatistics::add(statisticsContext, PipelineStatistics::VertexShaderInvocations, misses);
+
+    ProcessRasterQueue();
+} // DrawElements()
+
+// sets the per-instance arrays that DrawElementsInstanced() reads
+void FakeGL::InstancePointer(const Matrix4 *transforms, const RGBAValue *colours)
+{ // InstancePointer()
+    stateMechine.vertexArrays.instanceTransforms = transforms;
+    stateMechine.vertexArrays.instanceColours = colours;
+} // InstancePointer()
+
+// draws the same indices once per instance
+void FakeGL::DrawElementsInstanced(unsigned int primitiveType, unsigned int count, const unsigned int *indices, unsigned int instanceCount)
+{ // DrawElementsInstanced()
+    const VertexArrays &arrays = stateMechine.vertexArrays;
+    if ((arrays.positions == nullptr && arrays.quantised == nullptr) || arrays.instanceTransforms == nullptr || count == 0)
+        return;
+    if (ConditionalRenderDiscards())
+        return;
+    PipelineStatistics::add(statisticsContext, PipelineStatistics::VerticesSubmitted, uint64_t(count) * instanceCount);
+
+    // fetch each distinct vertex once, renumbering the indices to match
+    const unsigned int unfetched = std::numeric_limits<unsigned int>::max();
+    std::vector<unsigned int> fetched(*std::max_element(indices, indices + count) + 1, unfetched);
+    instanceVertices.clear();
+    instanceIndices.resize(count);
+    for (unsigned int element = 0; element < count; element++)
+        { // per index
+        unsigned int index = indices[element];
+        if (fetched[index] == unfetched)
+            { // first use
+            fetched[index] = instanceVertices.size();
+            instanceVertices.emplace_back();
+            FetchVertex(index, instanceVertices.back());
+            } // first use
+        instanceIndices[element] = fetched[index];
+        } // per index
+    instanceShaded.resize(instanceVertices.size());
+
+    // the bounding sphere of the fetched vertices, centred on their box
+    Cartesian3 low = instanceVertices[0].position.Point(), high = low;
+    for (const vertexWithAttributes &vertex : instanceVertices)
+        for (int axis = 0; axis < 3; axis++)
+            { // per axis
+            low[axis] = std::min(low[axis], vertex.position[axis]);
+            high[axis] = std::max(high[axis], vertex.position[axis]);
+            } // per axis
+    Cartesian3 centre = (low + high) * 0.5f;
+    float radius = 0.f;
+    for (const vertexWithAttributes &vertex : instanceVertices)
+        radius = std::max(radius, (vertex.position.Point() - centre).length());
+
+    // each instance's modelview is the current one times its own transform
+    const Matrix4 modelView = stateMechine.modelViewMatrixStack.top();
+    MeshletCuller culler(modelView, stateMechine.projectionMatrixStack.top(), false);
+
+    for (unsigned int instance = 0; instance < instanceCount; instance++)
+        { // per instance
+        const Matrix4 &transform = arrays.instanceTransforms[instance];
+
+        // the sphere grows with the transform's largest scale
+        float scale = 0.f;
+        for (int column = 0; column < 3; column++)
+            scale = std::max(scale, transform[0][column] * transform[0][column] + transform[1][column] * transform[1][column]
+                                  + transform[2][column] * transform[2][column]);
+        if (!culler.isVisible(transform * centre, radius * std::sqrt(scale)))
+            continue;
+
+        stateMechine.modelViewMatrixStack.top() = modelView * transform;
+        stateMechine.markDirty(DIRTY_MODELVIEW);
+        Begin(primitiveType);
+        PrepareShader();
+
+        // with back faces culled, the positions alone say which triangles survive, so only
+        // the vertices those use need the full shader
+        bool cullTriangles = primitiveType == FAKEGL_TRIANGLES && stateMechine.enables[FAKEGL_CULL_FACE];
+        const DerivedState &derived = stateMechine.getDerivedState();
+        instanceNeeded.assign(instanceVertices.size(), !cullTriangles);
+        if (cullTriangles)
+            { // cull by position
+            for (size_t shaded = 0; shaded < instanceVertices.size(); shaded++)
+                { // per vertex
+                // the same arithmetic as the shaders, so the triangles face the same way later
+                instanceShaded[shaded].position = (derived.modelViewProjection * instanceVertices[shaded].position).Point();
+                normalizeToWindow(instanceShaded[shaded]);
+                } // per vertex
+            instanceFront.resize(instanceIndices.size());
+            size_t kept = 0;
+            for (size_t element = 0; element + 2 < instanceIndices.size(); element += 3)
+                { // per triangle
+                const unsigned int *triangle = &instanceIndices[element];
+                if (IsBackFacing(instanceShaded[triangle[0]], instanceShaded[triangle[1]], instanceShaded[triangle[2]]))
+                    continue;
+                for (int corner = 0; corner < 3; corner++)
+                    { // per corner
+                    instanceNeeded[triangle[corner]] = true;
+                    instanceFront[kept++] = triangle[corner];
+                    } // per corner
+                } // per triangle
+            PipelineStatistics::add(statisticsContext, PipelineStatistics::PrimitivesCulled, (instanceIndices.size() - kept) / 3);
+            instanceFront.resize(kept);
+            } // cull by position
+
+        // only the transform & colour change between instances, so every vertex is shaded at most once
+        uint64_t invocations = 0;
+        for (size_t shaded = 0; shaded < instanceVertices.size(); shaded++)
+            { // per vertex
+            if (!instanceNeeded[shaded])
+                continue;
+            vertexWithAttributes vertex = instanceVertices[shaded];
+            vertex.normal = vertex.normal * derived.normalScale;
+            if (arrays.instanceColours != nullptr)
+                vertex.colour = arrays.instanceColours[instance];
+            instanceShaded[shaded] = stateMechine.currentShader->vertexShader(vertex, *this);
+            normalizeToWindow(instanceShaded[shaded]);
+            invocations++;
+            } // per vertex
+        PipelineStatistics::add(statisticsContext, PipelineStatistics::VertexShaderInvocations, invocations);
+
+        for (unsigned int index : cullTriangles ? instanceFront : instanceIndices)
+            rasterQueue.emplace_back(instanceShaded[index]);
+        ProcessRasterQueue();
+        } // per instance
+
+    stateMechine.modelViewMatrixStack.top() = modelView;
+    stateMechine.markDirty(DIRTY_MODELVIEW);
+} // DrawElementsInstanced()
+
 //-------------------------------------------------//
 //                                                 //
 // STATE VARIABLE ROUTINES                         //
@@ -376,6 +552,7 @@ void FakeGL::Vertex3f(float x, float y, float z)
 void FakeGL::Disable(unsigned int property)
 { // Disable()
    stateMechine.enables[property] = false;
+   stateMechine.markDirty(DIRTY_ENABLES);
    if(property == FAKEGL_LIGHTING){
        stateMechine.currentShader->setLight(nullptr);
    }
@@ -392,8 +569,9 @@ void FakeGL::Enable(unsigned int property)
 
     //use a array indicate all flags;
     stateMechine.enables[property] = true;
+    stateMechine.markDirty(DIRTY_ENABLES);
     if(property == FAKEGL_DEPTH_TEST){
-        if(depthBuffer.width != frameBuffer.width && depthBuffer.height != frameBuffer.height)
+        if(depthBuffer.width != frameBuffer.width || depthBuffer.height != frameBuffer.height)
             depthBuffer.Resize(frameBuffer.width,frameBuffer.height);
     }
 
@@ -417,7 +595,7 @@ void FakeGL::Enable(unsigned int property)
 // sets properties for the one and only light
 void FakeGL::Light(int parameterName, const float *parameterValues)
 { // Light()
-
+    stateMechine.markDirty(DIRTY_LIGHT);
     if(parameterName & FAKEGL_AMBIENT)
     {
         stateMechine.light.setAmbient(parameterValues);
@@ -439,6 +617,18 @@ void FakeGL::Light(int parameterName, const float *parameterValues)
 
 } // Light()
 
+// sets where the shadow term comes from while FAKEGL_SHADOWS is enabled
+void FakeGL::Shadows(const ShadowSource *source)
+{ // Shadows()
+    stateMechine.shadowSource = source;
+} // Shadows()
+
+// whether the shadow term is found per vertex or per pixel
+void FakeGL::ShadowMode(unsigned int mode)
+{ // ShadowMode()
+    stateMechine.shadowMode = mode;
+} // ShadowMode()
+
 //-------------------------------------------------//
 //                                                 //
 // TEXTURE PROCESSING ROUTINES                     //
@@ -458,8 +648,126 @@ void FakeGL::TexEnvMode(unsigned int textureMode)
 void FakeGL::TexImage2D(const RGBAImage &textureImage)
 { // TexImage2D()
     stateMechine.texture = textureImage;
+    textureFramebuffer = 0;
 } // TexImage2D()
 
+// sets how far the texels of a depth sprite reach in front of & behind the primitive
+void FakeGL::SpriteDepthRange(float range)
+{ // SpriteDepthRange()
+    stateMechine.spriteDepthRange = range;
+} // SpriteDepthRange()
+
+//-------------------------------------------------//
+//                                                 //
+// FRAMEBUFFER OBJECT ROUTINES                     //
+//                                                 //
+//-------------------------------------------------//
+
+// creates n framebuffer objects, without attachments, & writes their names (never 0) to ids
+void FakeGL::GenFramebuffers(int n, unsigned int *ids)
+{ // GenFramebuffers()
+    for(int framebuffer = 0; framebuffer < n; framebuffer++)
+    {
+        ids[framebuffer] = nextFramebufferName++;
+        framebuffers[ids[framebuffer]];
+    }
+} // GenFramebuffers()
+
+// deletes framebuffer objects, unbinding any that are bound as the target or the texture
+void FakeGL::DeleteFramebuffers(int n, const unsigned int *ids)
+{ // DeleteFramebuffers()
+    for(int framebuffer = 0; framebuffer < n; framebuffer++)
+    {
+        auto found = framebuffers.find(ids[framebuffer]);
+        if(found == framebuffers.end())
+            continue;
+        if(boundFramebuffer == ids[framebuffer])
+            BindFramebuffer(0);
+        if(textureFramebuffer == ids[framebuffer])
+            textureFramebuffer = 0;
+        framebuffers.erase(found);
+    }
+} // DeleteFramebuffers()
+
+// (re)creates a framebuffer object's colour & depth attachments at the given size
+bool FakeGL::FramebufferStorage(unsigned int id, int width, int height)
+{ // FramebufferStorage()
+    auto found = framebuffers.find(id);
+    if(found == framebuffers.end())
+        return false;
+
+    // a bound object's attachments are in the frame & depth buffers
+    bool bound = boundFramebuffer == id;
+    RGBAImage &colour = bound ? frameBuffer : found->second.colour;
+    RGBAImage &depth = bound ? depthBuffer : found->second.depth;
+    if(!colour.Resize(width, height) || !depth.Resize(width, height))
+        return false;
+
+    // Resize() zeroes the colour, & the far plane is 255
+    for(long pixel = 0; pixel < depth.width * depth.height; pixel++)
+        depth.block[pixel].alpha = 255;
+    return true;
+} // FramebufferStorage()
+
+// makes a framebuffer object what is drawn, cleared & captured in place of the frame & depth buffers
+void FakeGL::BindFramebuffer(unsigned int id)
+{ // BindFramebuffer()
+    if(id == boundFramebuffer || (id != 0 && framebuffers.find(id) == framebuffers.end()))
+        return;
+
+    // put back what is bound, then swap in the new one
+    if(boundFramebuffer != 0)
+    {
+        FramebufferObject &previous = framebuffers[boundFramebuffer];
+        frameBuffer.Swap(previous.colour);
+        depthBuffer.Swap(previous.depth);
+    }
+    if(id != 0)
+    {
+        FramebufferObject &next = framebuffers[id];
+        frameBuffer.Swap(next.colour);
+        depthBuffer.Swap(next.depth);
+    }
+
+    // a recording for tiles stands aside until the default buffers are back
+    if(boundFramebuffer == 0)
+    {
+        suspendedRecordTarget = recordTarget;
+        recordTarget = nullptr;
+    }
+    else if(id == 0)
+    {
+        recordTarget = suspendedRecordTarget;
+        suspendedRecordTarget = nullptr;
+    }
+    boundFramebuffer = id;
+} // BindFramebuffer()
+
+// makes the colour attachment of a framebuffer object the texture
+void FakeGL::BindFramebufferTexture(unsigned int id)
+{ // BindFramebufferTexture()
+    if(id == 0 || framebuffers.find(id) != framebuffers.end())
+        textureFramebuffer = id;
+} // BindFramebufferTexture()
+
+// the colour attachment of a framebuffer object, wherever it is
+const RGBAImage *FakeGL::FramebufferColour(unsigned int id) const
+{ // FramebufferColour()
+    auto found = framebuffers.find(id);
+    if(found == framebuffers.end())
+        return NULL;
+    return id == boundFramebuffer ? &frameBuffer : &found->second.colour;
+} // FramebufferColour()
+
+// the depth attachment of a framebuffer object, wherever it is
+const RGBAImage *FakeGL::FramebufferDepth(unsigned int id) const
+{ // FramebufferDepth()
+    auto found = framebuffers.find(id);
+    if(found == framebuffers.end())
+        return NULL;
+    return id == boundFramebuffer ? &depthBuffer : &found->second.depth;
+} // FramebufferDepth()
+
 //-------------------------------------------------//
 //                                                 //
 // FRAME BUFFER ROUTINES                           //
@@ -512,6 +820,9 @@ void FakeGL::normalizeToWindow(screenVertexWithAttributes & v) const
 // clears the frame buffer
 void FakeGL::Clear(unsigned int mask)
 { // Clear()
+    // a recording has no frame buffer of its own, the replay clears instead
+    if(recordTarget != nullptr || ConditionalRenderDiscards())
+        return;
 
     if(mask & FAKEGL_COLOR_BUFFER_BIT){
         clearFramebuffer();
@@ -529,26 +840,426 @@ void FakeGL::ClearColor(float red, float green, float blue, float alpha)
     stateMechine.clearColor = {red*255,green*255,blue*255,alpha*255};
 } // ClearColor()
 
+// sets which channels of the frame buffer fragments write
+void FakeGL::ColorMask(bool red, bool green, bool blue, bool alpha)
+{ // ColorMask()
+    stateMechine.colorMask[0] = red;
+    stateMechine.colorMask[1] = green;
+    stateMechine.colorMask[2] = blue;
+    stateMechine.colorMask[3] = alpha;
+} // ColorMask()
+
+// sets whether fragments that pass the depth test write the depth buffer
+void FakeGL::DepthMask(bool flag)
+{ // DepthMask()
+    stateMechine.depthMask = flag;
+} // DepthMask()
+
+//-------------------------------------------------//
+//                                                 //
+// FRAME CAPTURE ROUTINES                          //
+//                                                 //
+//-------------------------------------------------//
+
+// starts handing frames to a background writer thread
+bool FakeGL::BeginCapture(const char *fileName, unsigned int format, unsigned int queueLength)
+{ // BeginCapture()
+    // finish off any capture that is still running
+    EndCapture();
+
+    if(format > FAKEGL_CAPTURE_Y4M)
+        return false;
+
+    frameCapture.reset(new FrameCapture(fileName, static_cast<FrameCapture::Format>(format), queueLength));
+    if(!frameCapture->good())
+    {
+        frameCapture.reset();
+        return false;
+    }
+    return true;
+} // BeginCapture()
+
+// queues the current frame buffer for writing
+void FakeGL::CaptureFrame()
+{ // CaptureFrame()
+    if(frameCapture)
+        frameCapture->submit(frameBuffer);
+} // CaptureFrame()
+
+// waits for the queued frames to be written & stops capturing
+void FakeGL::EndCapture()
+{ // EndCapture()
+    // the destructor drains the queue
+    frameCapture.reset();
+} // EndCapture()
+
+//-------------------------------------------------//
+//                                                 //
+// QUERY ROUTINES                                  //
+//                                                 //
+//-------------------------------------------------//
+
+// creates n query objects & writes their names (never 0) to ids
+void FakeGL::GenQueries(int n, unsigned int *ids)
+{ // GenQueries()
+    for(int query = 0; query < n; query++)
+    {
+        ids[query] = nextQueryName++;
+        queries[ids[query]] = QueryObject();
+    }
+} // GenQueries()
+
+// deletes query objects, ending any that are active
+void FakeGL::DeleteQueries(int n, const unsigned int *ids)
+{ // DeleteQueries()
+    for(int query = 0; query < n; query++)
+    {
+        auto found = queries.find(ids[query]);
+        if(found == queries.end())
+            continue;
+        if(found->second.active)
+            activeQueries[found->second.target] = 0;
+        queries.erase(found);
+    }
+} // DeleteQueries()
+
+// starts counting a target into a query; each target has at most one active query
+void FakeGL::BeginQuery(unsigned int target, unsigned int id)
+{ // BeginQuery()
+    auto found = queries.find(id);
+    if(target >= FAKEGL_QUERY_TARGETS || found == queries.end() || found->second.active || activeQueries[target] != 0)
+        return;
+
+    QueryObject &query = found->second;
+    query.target = target;
+    query.active = true;
+    // recorded primitives pass or fail the depth test later, in another context
+    query.available = !(target == FAKEGL_SAMPLES_PASSED && recordTarget != nullptr);
+    query.start = QueryCount(target);
+    query.result = 0;
+    activeQueries[target] = id;
+} // BeginQuery()
+
+// stops the active query of a target
+void FakeGL::EndQuery(unsigned int target)
+{ // EndQuery()
+    if(target >= FAKEGL_QUERY_TARGETS || activeQueries[target] == 0)
+        return;
+
+    QueryObject &query = queries[activeQueries[target]];
+    query.result = QueryCount(target) - query.start;
+    if(target == FAKEGL_SAMPLES_PASSED && recordTarget != nullptr)
+        query.available = false;
+    query.active = false;
+    activeQueries[target] = 0;
+} // EndQuery()
+
+// reads the result, or whether it is available, of an ended query
+void FakeGL::GetQueryObjectui64v(unsigned int id, unsigned int parameterName, unsigned long long *result)
+{ // GetQueryObjectui64v()
+    auto found = queries.find(id);
+    if(found == queries.end() || found->second.active)
+        return;
+    if(parameterName == FAKEGL_QUERY_RESULT_AVAILABLE)
+        *result = found->second.available;
+    else if(parameterName == FAKEGL_QUERY_RESULT && found->second.available)
+        *result = found->second.result;
+} // GetQueryObjectui64v()
+
+// the current count of a target
+unsigned long long FakeGL::QueryCount(unsigned int target)
+{ // QueryCount()
+    // samples passed are kept by this context, the statistics by whichever threads did its work
+    if(target == FAKEGL_SAMPLES_PASSED)
+        return samplesPassed;
+    return PipelineStatistics::read(statisticsContext, static_cast<PipelineStatistics::Statistic>(target));
+} // QueryCount()
+
+// starts discarding drawing & clearing if the query counted nothing
+void FakeGL::BeginConditionalRender(unsigned int id)
+{ // BeginConditionalRender()
+    if(queries.find(id) != queries.end())
+        conditionalQuery = id;
+} // BeginConditionalRender()
+
+// stops discarding
+void FakeGL::EndConditionalRender()
+{ // EndConditionalRender()
+    conditionalQuery = 0;
+} // EndConditionalRender()
+
+// true while a conditional render is discarding
+bool FakeGL::ConditionalRenderDiscards()
+{ // ConditionalRenderDiscards()
+    if(conditionalQuery == 0)
+        return false;
+    auto found = queries.find(conditionalQuery);
+    // a query that has gone, is still counting or has no result doesn't hold anything back
+    if(found == queries.end() || found->second.active || !found->second.available)
+        return false;
+    return found->second.result == 0;
+} // ConditionalRenderDiscards()
+
+//-------------------------------------------------//
+//                                                 //
+// RECORD / REPLAY ROUTINES                        //
+//                                                 //
+//-------------------------------------------------//
+
+// number of primitives in the batch
+size_t RecordedBatch::PrimitiveCount() const
+{ // PrimitiveCount()
+    return vertices.size() / (drawType + 1);
+} // PrimitiveCount()
+
+// rows covered by a primitive, including point size & line width
+void RecordedBatch::PrimitiveRows(size_t primitive, float &minY, float &maxY) const
+{ // PrimitiveRows()
+    auto perPrimitive = drawType + 1;
+    auto first = vertices.begin() + primitive * perPrimitive;
+    minY = maxY = first->position.y;
+    for (auto vertex = first + 1; vertex < first + perPrimitive; vertex++)
+        {
+        minY = std::min(minY, vertex->position.y);
+        maxY = std::max(maxY, vertex->position.y);
+        }
+    // points grow both ways, wide lines are thickened down & right
+    float grow = drawType == FAKEGL_POINTS ? pointSize : (drawType == FAKEGL_LINES ? lineWidth : 0);
+    minY -= grow + 1;
+    maxY += grow + 1;
+} // PrimitiveRows()
+
+// columns covered by a primitive, including point size & line width
+void RecordedBatch::PrimitiveColumns(size_t primitive, float &minX, float &maxX) const
+{ // PrimitiveColumns()
+    auto perPrimitive = drawType + 1;
+    auto first = vertices.begin() + primitive * perPrimitive;
+    minX = maxX = first->position.x;
+    for (auto vertex = first + 1; vertex < first + perPrimitive; vertex++)
+        {
+        minX = std::min(minX, vertex->position.x);
+        maxX = std::max(maxX, vertex->position.x);
+        }
+    float grow = drawType == FAKEGL_POINTS ? pointSize : (drawType == FAKEGL_LINES ? lineWidth : 0);
+    minX -= grow + 1;
+    maxX += grow + 1;
+} // PrimitiveColumns()
+
+// rasterises & shades the listed primitives of a recorded batch
+void FakeGL::ReplayBatch(const RecordedBatch &batch, const std::vector<uint32_t> &primitives, int originX, int originY)
+{ // ReplayBatch()
+    // restore the state the batch was recorded with
+    stateMechine.currentShader = batch.phong ? phongShader : gouraudShader;
+    stateMechine.light = batch.light;
+    stateMechine.material = batch.material;
+    stateMechine.currentShader->setLight(batch.lit ? &stateMechine.light : nullptr);
+    stateMechine.currentShader->bindTexture(batch.texture);
+    stateMechine.envMode = batch.envMode;
+    stateMechine.enables[FAKEGL_DEPTH_TEST] = batch.depthTest;
+    stateMechine.enables[FAKEGL_SHADOWS] = batch.shadows;
+    stateMechine.shadowMode = batch.shadowMode;
+    stateMechine.shadowSource = batch.shadowSource;
+    stateMechine.enables[FAKEGL_DEPTH_SPRITE] = batch.depthSprite;
+    stateMechine.spriteDepthRange = batch.spriteDepthRange;
+    stateMechine.markDirty(DIRTY_LIGHT | DIRTY_MATERIAL | DIRTY_ENABLES);
+    stateMechine.updateDerivedState();
+    stateMechine.lineWidth = batch.lineWidth;
+    stateMechine.pointSize = batch.pointSize;
+    std::copy(batch.colorMask, batch.colorMask + 4, stateMechine.colorMask);
+    stateMechine.depthMask = batch.depthMask;
+
+    // the vertices stay in window coordinates, the rasterisers sample the pixels
+    // at the same positions as a single pass would, then shift them into the tile
+    stateMechine.rasterOriginX = originX;
+    stateMechine.rasterOriginY = originY;
+
+    screenVertexWithAttributes corners[3];
+    auto perPrimitive = batch.drawType + 1;
+    for (auto primitive : primitives)
+        { // per primitive
+        for (int corner = 0; corner < perPrimitive; corner++)
+            corners[corner] = batch.vertices[primitive * perPrimitive + corner];
+        switch (batch.drawType)
+            {
+        case FAKEGL_POINTS:
+            RasterisePoint(corners[0]);
+            break;
+        case FAKEGL_LINES:
+            RasteriseLineSegment(corners[0], corners[1]);
+            break;
+        case FAKEGL_TRIANGLES:
+            RasteriseTriangle(corners[0], corners[1], corners[2]);
+            break;
+            }
+        } // per primitive
+    ProcessFragment();
+
+    stateMechine.rasterOriginX = 0;
+    stateMechine.rasterOriginY = 0;
+} // ReplayBatch()
+
 //-------------------------------------------------//
 //                                                 //
 // MAJOR PROCESSING ROUTINES                       //
 //                                                 //
 //-------------------------------------------------//
 
+// binds the texture to the current shader & brings the derived state up to date
+void FakeGL::PrepareShader()
+{ // PrepareShader()
+    if(stateMechine.enables[FAKEGL_TEXTURE_2D])
+    {
+        // a framebuffer object's colour is sampled where it is, rather than copied in
+        const RGBAImage *texture = textureFramebuffer != 0 ? FramebufferColour(textureFramebuffer) : &stateMechine.texture;
+        stateMechine.currentShader->bindTexture(texture);
+    }
+    else
+    {
+        stateMechine.currentShader->bindTexture(nullptr);
+    }
+
+    // the shaders read the matrices & lighting products from here,
+    // which are only recomputed if something they depend on has changed
+    stateMechine.updateDerivedState();
+} // PrepareShader()
+
+// fetches one vertex from the arrays, decoding the compact format if that is what we have
+void FakeGL::FetchVertex(unsigned int index, vertexWithAttributes &vertex) const
+{ // FetchVertex()
+    const VertexArrays &arrays = stateMechine.vertexArrays;
+    // attributes without an array come from the current state, like Vertex3f()
+    vertex.colour = stateMechine.currentSurface.color;
+    vertex.divZ = 1.f;
+    if (arrays.quantised != nullptr)
+        { // quantised
+        const QuantisedVertex &quantised = arrays.quantised[index];
+        Cartesian3 position = VertexQuantiser::decodePosition(quantised, arrays.quantisedOffset, arrays.quantisedStep);
+        vertex.position = {position.x, position.y, position.z, 1.f};
+        vertex.normal = VertexQuantiser::decodeOctahedral(quantised.normal);
+        vertex.texCoord = VertexQuantiser::decodeTexCoord(quantised);
+        } // quantised
+    else
+        { // float arrays
+        const Cartesian3 &position = arrays.positions[index];
+        vertex.position = {position.x, position.y, position.z, 1.f};
+        vertex.normal = arrays.normals != nullptr ? arrays.normals[index] : stateMechine.currentSurface.normal;
+        vertex.texCoord = arrays.texCoords != nullptr ? arrays.texCoords[index] : stateMechine.currentSurface.textCoord;
+        } // float arrays
+} // FetchVertex()
+
 // transform one vertex & shift to the raster queue
 void FakeGL::TransformVertex()
 { // TransformVertex()
-    stateMechine.currentShader->setModelViewMatrix(stateMechine.modelViewMatrixStack.top());
-    stateMechine.currentShader->setProjectMatrix(stateMechine.projectionMatrixStack.top());
-
     //Transform in vertex shader;
+    PipelineStatistics::add(statisticsContext, PipelineStatistics::VertexShaderInvocations, vertexQueue.size());
     while(!vertexQueue.empty()){
-        rasterQueue.emplace_back(stateMechine.currentShader->vertexShader(vertexQueue.front(),*this));
+        auto & vertex = vertexQueue.front();
+        if(stateMechine.enables[FAKEGL_RESCALE_NORMAL])
+            vertex.normal = vertex.normal * stateMechine.getDerivedState().normalScale;
+        rasterQueue.emplace_back(stateMechine.currentShader->vertexShader(vertex,*this));
+        //convert this vertex into screen coord system.
+        normalizeToWindow(rasterQueue.back());
         vertexQueue.pop_front();
     }
 
 } // TransformVertex()
 
+// rasterises (or records) everything on the raster queue
+void FakeGL::ProcessRasterQueue()
+{ // ProcessRasterQueue()
+    if(recordTarget != nullptr && RasterisePrimitive())
+    {
+        RecordedBatch batch;
+        batch.drawType = stateMechine.drawType;
+        batch.vertices.assign(rasterQueue.begin(), rasterQueue.end());
+        batch.vertices.resize(batch.vertices.size() - batch.vertices.size() % (batch.drawType + 1));
+        if(batch.drawType == FAKEGL_TRIANGLES && stateMechine.enables[FAKEGL_CULL_FACE])
+        {
+            //culled triangles never need to reach the tiles
+            size_t kept = 0;
+            for(size_t i = 0; i < batch.vertices.size(); i += 3)
+                if(!IsBackFacing(batch.vertices[i], batch.vertices[i + 1], batch.vertices[i + 2]))
+                    for(size_t j = 0; j < 3; j++)
+                        batch.vertices[kept++] = batch.vertices[i + j];
+            PipelineStatistics::add(statisticsContext, PipelineStatistics::PrimitivesCulled, (batch.vertices.size() - kept) / 3);
+            batch.vertices.resize(kept);
+        }
+        batch.phong = stateMechine.currentShader == phongShader;
+        batch.lit = stateMechine.currentShader->getLight() != nullptr;
+        batch.depthTest = stateMechine.enables[FAKEGL_DEPTH_TEST];
+        batch.texture = stateMechine.currentShader->getTexture();
+        batch.envMode = stateMechine.envMode;
+        batch.lineWidth = stateMechine.lineWidth;
+        batch.pointSize = stateMechine.pointSize;
+        std::copy(stateMechine.colorMask, stateMechine.colorMask + 4, batch.colorMask);
+        batch.depthMask = stateMechine.depthMask;
+        batch.material = stateMechine.material;
+        if(batch.lit)
+            batch.light = *stateMechine.currentShader->getLight();
+        batch.shadows = stateMechine.enables[FAKEGL_SHADOWS];
+        batch.shadowMode = stateMechine.shadowMode;
+        batch.shadowSource = stateMechine.shadowSource;
+        batch.depthSprite = stateMechine.enables[FAKEGL_DEPTH_SPRITE];
+        batch.spriteDepthRange = stateMechine.spriteDepthRange;
+        //a batch that writes nothing, such as an occlusion test, has no effect on the tiles
+        bool writes = batch.depthMask || std::find(batch.colorMask, batch.colorMask + 4, true) != batch.colorMask + 4;
+        if(!batch.vertices.empty() && writes)
+            recordTarget->emplace_back(std::move(batch));
+        rasterQueue.clear();
+    }
+    else if(RasterisePrimitive()){
+        switch ( stateMechine.drawType)
+        {
+        case FAKEGL_POINTS:{
+            while(rasterQueue.size() > 0){
+                auto & a = rasterQueue.front();
+                RasterisePoint(a);
+                rasterQueue.pop_front();
+            }
+        }
+            break;
+        case FAKEGL_LINES:
+            while(rasterQueue.size() > 1){
+                auto a = rasterQueue.front();
+                rasterQueue.pop_front();
+                auto b = rasterQueue.front();
+                rasterQueue.pop_front();
+                RasteriseLineSegment(a,b);
+            }
+        break;
+
+        case FAKEGL_TRIANGLES:
+            while(rasterQueue.size() > 2){
+                auto a = rasterQueue.front();
+                rasterQueue.pop_front();
+                auto b = rasterQueue.front();
+                rasterQueue.pop_front();
+                auto c = rasterQueue.front();
+                rasterQueue.pop_front();
+                if(stateMechine.enables[FAKEGL_CULL_FACE] && IsBackFacing(a,b,c))
+                {
+                    PipelineStatistics::add(statisticsContext, PipelineStatistics::PrimitivesCulled);
+                    continue;
+                }
+                RasteriseTriangle(a,b,c);
+            }
+        break;
+        default:
+            break;
+        }
+        ProcessFragment();
+    }
+    stateMechine.drawType = -1;
+} // ProcessRasterQueue()
+
+// a triangle is back facing when it winds clockwise in window coordinates
+bool FakeGL::IsBackFacing(const screenVertexWithAttributes &vertex0, const screenVertexWithAttributes &vertex1, const screenVertexWithAttributes &vertex2) const
+{ // IsBackFacing()
+    float area = (vertex1.position.x - vertex0.position.x) * (vertex2.position.y - vertex0.position.y)
+               - (vertex2.position.x - vertex0.position.x) * (vertex1.position.y - vertex0.position.y);
+    return area < 0.f;
+} // IsBackFacing()
+
 // rasterise a single primitive if there are enough vertices on the queue
 bool FakeGL::RasterisePrimitive()
 { // RasterisePrimitive()
@@ -559,9 +1270,6 @@ bool FakeGL::RasterisePrimitive()
 void FakeGL::RasterisePoint(screenVertexWithAttributes &vertex0)
 { // RasterisePoint()
 
-    //convert this vertex into screen coord system.
-    normalizeToWindow(vertex0);
-
     fragmentWithAttributes tmp;
 
     tmp.colour = vertex0.colour;
@@ -569,22 +1277,24 @@ void FakeGL::RasterisePoint(screenVertexWithAttributes &vertex0)
     tmp.texCoord = vertex0.texCoord;
     tmp.divZ = vertex0.divZ;
     tmp.modelViewCoord  = vertex0.modelViewCoord;
-    int32_t startX = vertex0.position.x - stateMechine.pointSize / 2;
-    int32_t startY = vertex0.position.y - stateMechine.pointSize / 2;
+    //floor rather than truncate, so that a point just off the bottom/left edge stays off it
+    int32_t startX = std::floor(vertex0.position.x - stateMechine.pointSize / 2) - stateMechine.rasterOriginX;
+    int32_t startY = std::floor(vertex0.position.y - stateMechine.pointSize / 2) - stateMechine.rasterOriginY;
 
     if(stateMechine.pointSize > 0)
     {
+       //a square of pointSize x pointSize pixels
        for(auto i = 0;i<stateMechine.pointSize;i++){
           for(auto j = 0;j<stateMechine.pointSize;j++){
-              if(isDepthPassed(startX,startY,vertex0.position.z * 255.f)){
-                  if(stateMechine.enables[FAKEGL_DEPTH_TEST]){
-                      depthBuffer[startY][startX].alpha = vertex0.position.z * 255.f;
+              auto col = startX + j;
+              if(isDepthPassed(col,startY,vertex0.position.z * 255.f)){
+                  if(stateMechine.enables[FAKEGL_DEPTH_TEST] && stateMechine.depthMask){
+                      depthBuffer[startY][col].alpha = vertex0.position.z * 255.f;
                   }
                   tmp.row = startY;
-                  tmp.col = startX;
+                  tmp.col = col;
                   fragmentQueue.emplace_back(tmp);//a fragment ......
               }
-              startX++;
           }
           startY++;
        }
@@ -592,7 +1302,7 @@ void FakeGL::RasterisePoint(screenVertexWithAttributes &vertex0)
     else
     {
         if(isDepthPassed(startX,startY,vertex0.position.z* 255.f)){
-            if(stateMechine.enables[FAKEGL_DEPTH_TEST]){
+            if(stateMechine.enables[FAKEGL_DEPTH_TEST] && stateMechine.depthMask){
                 depthBuffer[startY][startX].alpha = vertex0.position.z * 255.f;
             }
             tmp.row = startY;
@@ -606,12 +1316,18 @@ void FakeGL::RasterisePoint(screenVertexWithAttributes &vertex0)
 
 bool FakeGL::isDepthPassed(float x,float y, float z)
 {
+    //wide points & lines can reach past the edge of the frame buffer
+    if(x < 0 || y < 0 || x >= frameBuffer.width || y >= frameBuffer.height)
+        return false;
+    PipelineStatistics::add(statisticsContext, PipelineStatistics::FragmentsGenerated);
     if(stateMechine.enables[FAKEGL_DEPTH_TEST]){
         if(z > depthBuffer[(int32_t)y][(int32_t)x].alpha)
         {
+           PipelineStatistics::add(statisticsContext, PipelineStatistics::FragmentsDepthRejected);
            return false;
         }
     }
+    samplesPassed++;
     return true;//default as true
 }
 
@@ -619,10 +1335,6 @@ bool FakeGL::isDepthPassed(float x,float y, float z)
 void FakeGL::RasteriseLineSegment(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1)
 { // RasteriseLineSegment()
 
-//convert this vertex into screen coord system.
-    normalizeToWindow(vertex0);
-    normalizeToWindow(vertex1);
-
 
 //RasteriseLine with bresenham
     auto dx = vertex1.position.x - vertex0.position.x;
@@ -654,18 +1366,18 @@ void FakeGL::RasteriseLineSegment(screenVertexWithAttributes &vertex0, screenVer
         for(auto i = 0;i <= dx;++i)
         {
             auto lerped = MathUtils::lerp(vertex0,vertex1,static_cast<double>(i)/dx);
-            tmp.row = sy;
-            tmp.col = sx;
+            tmp.row = std::floor(sy) - stateMechine.rasterOriginY;
+            tmp.col = std::floor(sx) - stateMechine.rasterOriginX;
             tmp.colour = lerped.colour;
             tmp.normal = lerped.normal;
             tmp.texCoord = lerped.texCoord;
             tmp.divZ = lerped.divZ;
             tmp.modelViewCoord  = lerped.modelViewCoord;
             for(auto j = 0;j<stateMechine.lineWidth;j++){
-                tmp.col = sx+j;
-                tmp.row = sy+j;
+                tmp.col = std::floor(sx)+j - stateMechine.rasterOriginX;
+                tmp.row = std::floor(sy)+j - stateMechine.rasterOriginY;
                 if(isDepthPassed(tmp.col,tmp.row,lerped.position.z * 255.f)){
-                    if(stateMechine.enables[FAKEGL_DEPTH_TEST]){
+                    if(stateMechine.enables[FAKEGL_DEPTH_TEST] && stateMechine.depthMask){
                         depthBuffer[tmp.row][tmp.col].alpha = lerped.position.z * 255.f;
                     }
                     fragmentQueue.emplace_back(tmp);//a fragment ......
@@ -689,8 +1401,8 @@ void FakeGL::RasteriseLineSegment(screenVertexWithAttributes &vertex0, screenVer
         {
 
             auto lerped = MathUtils::lerp(vertex0,vertex1,static_cast<double>(i)/dy);
-            tmp.row = sy;
-            tmp.col = sx;
+            tmp.row = std::floor(sy) - stateMechine.rasterOriginY;
+            tmp.col = std::floor(sx) - stateMechine.rasterOriginX;
             tmp.colour = lerped.colour;
             tmp.normal = lerped.normal;
             tmp.texCoord = lerped.texCoord;
@@ -698,10 +1410,10 @@ void FakeGL::RasteriseLineSegment(screenVertexWithAttributes &vertex0, screenVer
             tmp.modelViewCoord  = lerped.modelViewCoord;
 
             for(auto j = 0;j<stateMechine.lineWidth;j++){
-                tmp.col = sx+j;
-                tmp.row = sy+j;
+                tmp.col = std::floor(sx)+j - stateMechine.rasterOriginX;
+                tmp.row = std::floor(sy)+j - stateMechine.rasterOriginY;
                 if(isDepthPassed(tmp.col,tmp.row,lerped.position.z * 255.f)){
-                    if(stateMechine.enables[FAKEGL_DEPTH_TEST]){
+                    if(stateMechine.enables[FAKEGL_DEPTH_TEST] && stateMechine.depthMask){
                         depthBuffer[tmp.row][tmp.col].alpha = lerped.position.z * 255.f;
                     }
                     fragmentQueue.emplace_back(tmp);//a fragment ......
@@ -723,25 +1435,15 @@ void FakeGL::RasteriseLineSegment(screenVertexWithAttributes &vertex0, screenVer
 // rasterises a single triangle
 void FakeGL::RasteriseTriangle(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, screenVertexWithAttributes &vertex2)
     { // RasteriseTriangle()
-    // compute a bounding box that starts inverted to frame size
-    // clipping will happen in the raster loop proper
-
+    // compute the bounding box of the vertices
+    // clipping to the frame buffer happens below
 
-//convert this vertex into screen coord system.
-    normalizeToWindow(vertex0);
-    normalizeToWindow(vertex1);
-    normalizeToWindow(vertex2);
+    auto originX = stateMechine.rasterOriginX;
+    auto originY = stateMechine.rasterOriginY;
+    float minX = vertex0.position.x, maxX = vertex0.position.x;
+    float minY = vertex0.position.y, maxY = vertex0.position.y;
 
-    float minX = frameBuffer.width, maxX = 0.0;
-    float minY = frameBuffer.height, maxY = 0.0;
-
-
-    // test against all vertices
-    if (vertex0.position.x < minX) minX = vertex0.position.x;
-    if (vertex0.position.x > maxX) maxX = vertex0.position.x;
-    if (vertex0.position.y < minY) minY = vertex0.position.y;
-    if (vertex0.position.y > maxY) maxY = vertex0.position.y;
-    
+    // test against the other vertices
     if (vertex1.position.x < minX) minX = vertex1.position.x;
     if (vertex1.position.x > maxX) maxX = vertex1.position.x;
     if (vertex1.position.y < minY) minY = vertex1.position.y;
@@ -752,7 +1454,31 @@ void FakeGL::RasteriseTriangle(screenVertexWithAttributes &vertex0, screenVertex
     if (vertex2.position.y < minY) minY = vertex2.position.y;
     if (vertex2.position.y > maxY) maxY = vertex2.position.y;
 
-
+    // move the box into the frame buffer & clip it, so that a triangle much larger than
+    // the frame buffer (e.g. when rendering one tile of a poster) costs nothing extra
+    minX -= originX;
+    maxX -= originX;
+    minY -= originY;
+    maxY -= originY;
+    if (minX < 0) minX = 0;
+    if (minY < 0) minY = 0;
+    if (maxX > frameBuffer.width - 1) maxX = frameBuffer.width - 1;
+    if (maxY > frameBuffer.height - 1) maxY = frameBuffer.height - 1;
+
+    // a box that is empty after clipping is a triangle entirely outside the frame buffer
+    if ((minX > maxX) || (minY > maxY))
+        { // clipped
+        PipelineStatistics::add(statisticsContext, PipelineStatistics::PrimitivesClipped);
+        return;
+        } // clipped
+
+    // snap the box inwards to the pixels it actually contains: pixels are sampled at integer
+    // positions, and a triangle whose box falls between them (most sub-pixel triangles of a
+    // dense mesh) can't cover any, so it is rejected before any more setup
+    int firstCol = (int) std::ceil(minX), lastCol = (int) std::floor(maxX);
+    int firstRow = (int) std::ceil(minY), lastRow = (int) std::floor(maxY);
+    if ((firstCol > lastCol) || (firstRow > lastRow))
+        return;
 
     // now for each side of the triangle, compute the line vectors
     Cartesian3 vector01 = vertex1.position - vertex0.position;
@@ -786,70 +1512,190 @@ void FakeGL::RasteriseTriangle(screenVertexWithAttributes &vertex0, screenVertex
     // create a fragment for reuse
     fragmentWithAttributes rasterFragment;
 
+    // the shadow attributes are only needed when there are shadows
+    bool shadowing = stateMechine.enables[FAKEGL_SHADOWS];
+
+    // a depth sprite's texture decides which fragments there are, & their depths
+    Texture2D sprite;
+    if (stateMechine.enables[FAKEGL_DEPTH_SPRITE])
+        sprite.setImage(stateMechine.currentShader->getTexture());
+
+    // interpolates a fragment for a pixel inside the frame buffer & the triangle, at its barycentric coordinates
+    auto emitFragment = [&](int col, int row, float alpha, float beta, float gamma)
+        { // emitFragment()
+        rasterFragment.row = row;
+        rasterFragment.col = col;
+
+        // compute colour
+        rasterFragment.colour = alpha * vertex0.colour + beta * vertex1.colour + gamma * vertex2.colour; 
+        rasterFragment.texCoord =  (alpha * vertex0.texCoord + beta * vertex1.texCoord + gamma * vertex2.texCoord);
+        rasterFragment.modelViewCoord = alpha * vertex0.modelViewCoord + beta * vertex1.modelViewCoord + gamma * vertex2.modelViewCoord;
+        rasterFragment.normal =alpha * vertex0.normal + beta * vertex1.normal + gamma * vertex2.normal;
+        if (shadowing)
+            { // shadow attributes
+            rasterFragment.lightVisibility = alpha * vertex0.lightVisibility + beta * vertex1.lightVisibility + gamma * vertex2.lightVisibility;
+            rasterFragment.shadowColour = alpha * vertex0.shadowColour + beta * vertex1.shadowColour + gamma * vertex2.shadowColour;
+            } // shadow attributes
+
+        auto vertex = alpha * vertex0.position + beta * vertex1.position + gamma * vertex2.position;
+
+        if (sprite.getImage() != nullptr)
+            { // depth sprite
+            // the same texel the fragment shader will sample
+            unsigned char spriteDepth = sprite.sample({rasterFragment.texCoord.x, rasterFragment.texCoord.y}).alpha;
+            if (spriteDepth == 0)
+                return;
+            vertex.z += (spriteDepth * (2.f / 255.f) - 1.f) * stateMechine.spriteDepthRange;
+            } // depth sprite
+
+        if(isDepthPassed(col,row,vertex.z * 255.f)){
+            if(stateMechine.enables[FAKEGL_DEPTH_TEST] && stateMechine.depthMask){
+                depthBuffer[row][col].alpha = vertex.z * 255.f;
+            }
+            // now we add it to the queue for fragment processing
+            fragmentQueue.push_back(rasterFragment);
+        }
+        }; // emitFragment()
+
+    // tests a single pixel, which is known to be inside the frame buffer
+    auto rasterisePixel = [&](int col, int row)
+        { // rasterisePixel()
+        // the pixel in cartesian format
+        Cartesian3 pixel(col + originX, row + originY, 0.0);
+
+        // note we *COULD* compute gamma = 1.0 - alpha - beta instead
+        float alpha = (normal12.dot(pixel) - lineConstant12) / distance0;           
+        float beta = (normal20.dot(pixel) - lineConstant20) / distance1;            
+        float gamma = (normal01.dot(pixel) - lineConstant01) / distance2;           
+
+        // now perform the half-plane test
+        if ((alpha < 0.0) || (beta < 0.0) || (gamma < 0.0))
+            return;
+
+        emitFragment(col, row, alpha, beta, gamma);
+        }; // rasterisePixel()
+
+    // a triangle that spans at most 2 x 2 pixels (most of those in a dense mesh) has less set up per pixel:
+    // each edge function is a column term plus a row term, which are multiplied out once for the two
+    // columns & the two rows, & a pixel is only divided through to barycentric coordinates once it is
+    // known to be inside every edge, i.e. no edge function has the opposite sign to its distance.
+    // these are the same sums as normal.dot(pixel), so exactly the same pixels & values come out
+    if ((lastCol - firstCol <= 1) && (lastRow - firstRow <= 1))
+        { // small triangle
+        const Cartesian3 *edgeNormals[3] = { &normal12, &normal20, &normal01 };
+        const float edgeConstants[3] = { lineConstant12, lineConstant20, lineConstant01 };
+        const float edgeDistances[3] = { distance0, distance1, distance2 };
+        const int cols[2] = { firstCol, lastCol }, rows[2] = { firstRow, lastRow };
+        float colTerms[3][2], rowTerms[3][2];
+        for (int edge = 0; edge < 3; edge++)
+            for (int i = 0; i < 2; i++)
+                { // per column & row
+                colTerms[edge][i] = float(cols[i] + originX) * edgeNormals[edge]->x;
+                rowTerms[edge][i] = float(rows[i] + originY) * edgeNormals[edge]->y;
+                } // per column & row
+
+        // in the same order as the loop below
+        int nCols = (lastCol != firstCol) ? 2 : 1, nRows = (lastRow != firstRow) ? 2 : 1;
+        for (int r = 0; r < nRows; r++)
+            for (int c = 0; c < nCols; c++)
+                { // per pixel
+                float edges[3];
+                bool inside = true;
+                for (int edge = 0; edge < 3; edge++)
+                    { // per edge
+                    edges[edge] = colTerms[edge][c] + rowTerms[edge][r] - edgeConstants[edge];
+                    if ((edges[edge] < 0.0f) ? (edgeDistances[edge] > 0.0f) : ((edges[edge] > 0.0f) && (edgeDistances[edge] < 0.0f)))
+                        inside = false;
+                    } // per edge
+                if (inside)
+                    emitFragment(cols[c], rows[r], edges[0] / distance0, edges[1] / distance1, edges[2] / distance2);
+                } // per pixel
+        return;
+        } // small triangle
+
     // loop through the pixels in the bounding box
-    for (rasterFragment.row = minY; rasterFragment.row <= maxY; rasterFragment.row++)
+    for (int row = firstRow; row <= lastRow; row++)
         { // per row
-        // this is here so that clipping works correctly
-        if (rasterFragment.row < 0) continue;
-        if (rasterFragment.row >= frameBuffer.height) continue;
-        for (rasterFragment.col = minX; rasterFragment.col <= maxX; rasterFragment.col++)
+        for (int col = firstCol; col <= lastCol; col++)
             { // per pixel
-            // this is also for correct clipping
-            if (rasterFragment.col < 0) continue;
-            if (rasterFragment.col >= frameBuffer.width) continue;
-            
-            // the pixel in cartesian format
-            Cartesian3 pixel(rasterFragment.col, rasterFragment.row, 0.0);
-            
-            // right - we have a pixel inside the frame buffer AND the bounding box
-            // note we *COULD* compute gamma = 1.0 - alpha - beta instead
-            float alpha = (normal12.dot(pixel) - lineConstant12) / distance0;           
-            float beta = (normal20.dot(pixel) - lineConstant20) / distance1;            
-            float gamma = (normal01.dot(pixel) - lineConstant01) / distance2;           
-
-            // now perform the half-plane test
-            if ((alpha < 0.0) || (beta < 0.0) || (gamma < 0.0))
-                continue;
-
-
-            // compute colour
-
-            rasterFragment.colour = alpha * vertex0.colour + beta * vertex1.colour + gamma * vertex2.colour; 
-            rasterFragment.texCoord =  (alpha * vertex0.texCoord + beta * vertex1.texCoord + gamma * vertex2.texCoord);
-            rasterFragment.modelViewCoord = alpha * vertex0.modelViewCoord + beta * vertex1.modelViewCoord + gamma * vertex2.modelViewCoord;
-            rasterFragment.normal =alpha * vertex0.normal + beta * vertex1.normal + gamma * vertex2.normal;
-
-            auto vertex = alpha * vertex0.position + beta * vertex1.position + gamma * vertex2.position;
-
-
-            if(isDepthPassed(rasterFragment.col,rasterFragment.row,vertex.z * 255.f)){
-                if(stateMechine.enables[FAKEGL_DEPTH_TEST]){
-                    depthBuffer[rasterFragment.row][rasterFragment.col].alpha = vertex.z * 255.f;
-                }
-                // now we add it to the queue for fragment processing
-                fragmentQueue.push_back(rasterFragment);
-            }
-        } // per pixel
-    } // per row
+            rasterisePixel(col, row);
+            } // per pixel
+        } // per row
 } // RasteriseTriangle()
 
+// finds the shadow term of every fragment on the queue
+void FakeGL::FindShadows()
+{ // FindShadows()
+    //the rasteriser queues a primitive's fragments in scan order, so four in a row are almost
+    //always neighbours, whose shadow rays or shadow map lookups land close together
+    const Cartesian3 & light = stateMechine.currentShader->getLight()->getPosition();
+    bool gouraud = stateMechine.currentShader == gouraudShader;
+    Cartesian3 points[4], normals[4];
+    float visibilities[4];
+    for(size_t first = 0; first < fragmentQueue.size(); first += 4)
+    {
+        uint32_t count = static_cast<uint32_t>(std::min<size_t>(4, fragmentQueue.size() - first));
+        for(uint32_t lane = 0; lane < count; lane++)
+        {
+            points[lane] = fragmentQueue[first + lane].modelViewCoord.Vector();
+            normals[lane] = fragmentQueue[first + lane].normal;
+        }
+        stateMechine.shadowSource->visibility(points, normals, count, light, visibilities);
+        for(uint32_t lane = 0; lane < count; lane++)
+        {
+            auto & fragment = fragmentQueue[first + lane];
+            fragment.lightVisibility = visibilities[lane];
+            //Gouraud shading baked the light into the colour, so it falls back on the colour without it
+            if(gouraud)
+                fragment.colour = visibilities[lane] * fragment.colour + (1.0f - visibilities[lane]) * fragment.shadowColour;
+        }
+    }
+} // FindShadows()
+
 // process a single fragment
 void FakeGL::ProcessFragment()
 { // ProcessFragment()
 
+    //with every channel masked there is nothing to shade, e.g. an occlusion query's bounding box
+    const bool * mask = stateMechine.colorMask;
+    if(!mask[0] && !mask[1] && !mask[2] && !mask[3])
+    {
+        fragmentQueue.clear();
+        return;
+    }
+    bool fullMask = mask[0] && mask[1] && mask[2] && mask[3];
+
+    //per pixel shadows are found for the whole queue before any of it is shaded
+    if(stateMechine.enables[FAKEGL_SHADOWS] && stateMechine.shadowMode == FAKEGL_PER_PIXEL
+       && stateMechine.shadowSource != nullptr && stateMechine.currentShader->getLight() != nullptr)
+        FindShadows();
+
     //process every fragment in fragment shader.
     while (!fragmentQueue.empty())
     {   
         auto & top = fragmentQueue.front();
-        if(top.row <= frameBuffer.height && top.col <= frameBuffer.width && top.row >= 0 && top.col >= 0)
+        if(top.row < frameBuffer.height && top.col < frameBuffer.width && top.row >= 0 && top.col >= 0)
         {
+            PipelineStatistics::add(statisticsContext, PipelineStatistics::FragmentShaderInvocations);
+            RGBAValue colour;
             if(stateMechine.envMode == FAKEGL_REPLACE)
             {
-                frameBuffer[top.row][top.col] = stateMechine.currentShader->fragmentShader(top,*this);
+                colour = stateMechine.currentShader->fragmentShader(top,*this);
+            }
+            else
+            {
+                colour = stateMechine.currentShader->fragmentShader(top,*this) * top.colour;
             }
+
+            RGBAValue & pixel = frameBuffer[top.row][top.col];
+            if(fullMask)
+                pixel = colour;
             else
             {
-               frameBuffer[top.row][top.col] = stateMechine.currentShader->fragmentShader(top,*this) * top.colour;
+                if(mask[0]) pixel.red = colour.red;
+                if(mask[1]) pixel.green = colour.green;
+                if(mask[2]) pixel.blue = colour.blue;
+                if(mask[3]) pixel.alpha = colour.alpha;
             }
         }
         fragmentQueue.pop_front();
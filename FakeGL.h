@@ -23,9 +23,11 @@
 #include "Matrix4.h"
 #include "RGBAImage.h"
 #include "StateMechine.h"
+#include "PipelineStatistics.h"
 #include <vector>
 #include <deque>
 #include <stack>
+#include <map>
 #include <memory>
 
 // we will store all of the FakeGL context in a class object
@@ -49,12 +51,19 @@ const unsigned int FAKEGL_LIGHTING = 1;
 const unsigned int FAKEGL_TEXTURE_2D = 2;
 const unsigned int FAKEGL_DEPTH_TEST = 3;
 const unsigned int FAKEGL_PHONG_SHADING = 4;
+const unsigned int FAKEGL_RESCALE_NORMAL = 5;
+const unsigned int FAKEGL_CULL_FACE = 6;
+const unsigned int FAKEGL_SHADOWS = 7;
+const unsigned int FAKEGL_DEPTH_SPRITE = 8;
 // constants for Light() - actually bit flags
 const unsigned int FAKEGL_POSITION = 1;
 const unsigned int FAKEGL_AMBIENT = 2;
 const unsigned int FAKEGL_DIFFUSE = 4;
 const unsigned int FAKEGL_AMBIENT_AND_DIFFUSE = 6;
 const unsigned int FAKEGL_SPECULAR = 8;
+// constants for ShadowMode()
+const unsigned int FAKEGL_PER_VERTEX = 0;
+const unsigned int FAKEGL_PER_PIXEL = 1;
 // additional constants for Material()
 const unsigned int FAKEGL_EMISSION = 16;
 const unsigned int FAKEGL_SHININESS = 32;
@@ -64,6 +73,27 @@ const unsigned int FAKEGL_PROJECTION = 2;
 // constants for texture operations
 const unsigned int FAKEGL_MODULATE = 1;
 const unsigned int FAKEGL_REPLACE = 2;
+// size of the post-transform vertex cache used by DrawElements()
+const unsigned int FAKEGL_VERTEX_CACHE_SIZE = 24;
+// constants for BeginCapture()
+const unsigned int FAKEGL_CAPTURE_PPM = 0;
+const unsigned int FAKEGL_CAPTURE_QOI = 1;
+const unsigned int FAKEGL_CAPTURE_Y4M = 2;
+// constants for BeginQuery(): the pipeline statistics, see PipelineStatistics.h
+const unsigned int FAKEGL_VERTICES_SUBMITTED = 0;
+const unsigned int FAKEGL_VERTEX_SHADER_INVOCATIONS = 1;
+const unsigned int FAKEGL_PRIMITIVES_CLIPPED = 2;
+const unsigned int FAKEGL_PRIMITIVES_CULLED = 3;
+const unsigned int FAKEGL_FRAGMENTS_GENERATED = 4;
+const unsigned int FAKEGL_FRAGMENTS_DEPTH_REJECTED = 5;
+const unsigned int FAKEGL_FRAGMENT_SHADER_INVOCATIONS = 6;
+// fragments of this context that passed the depth test, for occlusion queries
+const unsigned int FAKEGL_SAMPLES_PASSED = 7;
+// number of query targets
+const unsigned int FAKEGL_QUERY_TARGETS = 8;
+// constants for GetQueryObjectui64v()
+const unsigned int FAKEGL_QUERY_RESULT = 0;
+const unsigned int FAKEGL_QUERY_RESULT_AVAILABLE = 1;
 
 
 
@@ -111,7 +141,10 @@ class screenVertexWithAttributes
 
     double divZ;
 
-
+    //with FAKEGL_SHADOWS, the fraction of the light that reaches the vertex, found per vertex
+    float lightVisibility = 1.0f;
+    //& for Gouraud shading with per pixel shadows, the colour lit without the light
+    RGBAValue shadowColour;
 
     //in order to support lerp template function
     auto operator*(float scale) const -> screenVertexWithAttributes{
@@ -121,6 +154,8 @@ class screenVertexWithAttributes
        newSVW.normal = normal * scale;
        newSVW.divZ = divZ * scale;
        newSVW.texCoord = texCoord * scale;
+       newSVW.lightVisibility = lightVisibility * scale;
+       newSVW.shadowColour = shadowColour * scale;
        return newSVW;
     }
 
@@ -132,6 +167,8 @@ class screenVertexWithAttributes
         newSVW.normal = normal+ other.normal;
         newSVW.divZ = divZ+ other.divZ;
         newSVW.texCoord = texCoord + other.texCoord;
+        newSVW.lightVisibility = lightVisibility + other.lightVisibility;
+        newSVW.shadowColour = shadowColour + other.shadowColour;
         return newSVW;
     }
 
@@ -164,11 +201,81 @@ class fragmentWithAttributes
     Homogeneous4 modelViewCoord;
 
     double divZ;
+
+    //with FAKEGL_SHADOWS, the fraction of the light that reaches the fragment
+    float lightVisibility = 1.0f;
+    //& the colour lit without the light, for Gouraud shading with per pixel shadows
+    RGBAValue shadowColour;
 }; // class fragmentWithAttributes
 
 
 
 class Shader;
+class FrameCapture;
+class ShadowSource;
+
+// a query object, which counts one statistic between BeginQuery() & EndQuery()
+class QueryObject
+{ // class QueryObject
+    public:
+    // the target it was last begun with
+    unsigned int target = 0;
+    // true between BeginQuery() & EndQuery()
+    bool active = false;
+    // false if the result can't be known, i.e. samples were counted while recording for tiles
+    bool available = true;
+    // the count when the query began
+    unsigned long long start = 0;
+    // the count between BeginQuery() & EndQuery(), once it has ended
+    unsigned long long result = 0;
+}; // class QueryObject
+
+// a framebuffer object: an off-screen colour target & its depth target, in the same
+// layout as FakeGL's frame & depth buffers (rows from the bottom, depth in the alpha)
+class FramebufferObject
+{ // class FramebufferObject
+    public:
+    RGBAImage colour;
+    RGBAImage depth;
+}; // class FramebufferObject
+
+// a batch of primitives captured after the vertex shader, in window coordinates,
+// together with the state needed to rasterise & shade them again later
+class RecordedBatch
+{ // class RecordedBatch
+    public:
+    // FAKEGL_POINTS, FAKEGL_LINES or FAKEGL_TRIANGLES
+    int32_t drawType = -1;
+    // 1, 2 or 3 vertices per primitive
+    std::vector<screenVertexWithAttributes> vertices;
+
+    // the shading state in effect at End()
+    bool phong = false;
+    bool lit = false;
+    bool depthTest = false;
+    const RGBAImage *texture = nullptr;
+    int32_t envMode = -1;
+    int32_t lineWidth = 1;
+    int32_t pointSize = 1;
+    bool colorMask[4] = {true, true, true, true};
+    bool depthMask = true;
+    Material material;
+    Light light;
+    // the shadows, whose source must outlive the replay
+    bool shadows = false;
+    uint32_t shadowMode = 0;
+    const ShadowSource *shadowSource = nullptr;
+    // the depth sprite
+    bool depthSprite = false;
+    float spriteDepthRange = 0.0f;
+
+    // number of primitives in the batch
+    size_t PrimitiveCount() const;
+    // rows covered by a primitive, including point size & line width
+    void PrimitiveRows(size_t primitive, float &minY, float &maxY) const;
+    // columns covered by a primitive, including point size & line width
+    void PrimitiveColumns(size_t primitive, float &minX, float &maxX) const;
+}; // class RecordedBatch
 
 // the class storing the FakeGL context
 class FakeGL
@@ -321,6 +428,48 @@ class FakeGL
     // sets the vertex & launches it down the pipeline
     void Vertex3f(float x, float y, float z);
 
+    //-------------------------------------------------//
+    //                                                 //
+    // VERTEX ARRAY ROUTINES                           //
+    //                                                 //
+    //-------------------------------------------------//
+
+    // set the arrays that DrawElements() fetches from
+    // a NULL normal or texture coordinate array means the current Normal3f() / TexCoord2f() value is used
+    void VertexPointer(const Cartesian3 *positions);
+    void NormalPointer(const Cartesian3 *normals);
+    void TexCoordPointer(const Cartesian3 *texCoords);
+
+    // sets a compact array holding all three attributes, which replaces the arrays above until it is set to NULL
+    // positions decode as offset + quantised * step, see VertexQuantiser.h
+    void QuantisedVertexPointer(const QuantisedVertex *vertices, const Cartesian3 &offset, const Cartesian3 &step);
+
+    // draws count indices worth of primitives from the arrays
+    // each vertex is fetched & shaded once while it stays in a FIFO cache of FAKEGL_VERTEX_CACHE_SIZE entries,
+    // so meshes ordered for the cache shade far fewer vertices than immediate mode
+    void DrawElements(unsigned int primitiveType, unsigned int count, const unsigned int *indices);
+
+    // the post-transform cache: which array index each slot holds, and the shaded vertex
+    std::vector<unsigned int> vertexCacheTags;
+    std::vector<screenVertexWithAttributes> vertexCache;
+
+    // sets the per-instance arrays that DrawElementsInstanced() reads: a model matrix applied after
+    // the modelview, and a colour in place of the current Color3f() value unless colours is NULL
+    void InstancePointer(const Matrix4 *transforms, const RGBAValue *colours);
+
+    // draws the same indices once per instance, fetching each vertex from the arrays only once
+    // instances whose bounding sphere is outside the view volume are skipped before any shading,
+    // and every other instance shades each distinct vertex exactly once
+    void DrawElementsInstanced(unsigned int primitiveType, unsigned int count, const unsigned int *indices, unsigned int instanceCount);
+
+    // the vertices an instanced draw fetched, its indices into them, and one instance's shaded vertices,
+    // which of them its front-facing triangles use, and those triangles' indices
+    std::vector<vertexWithAttributes> instanceVertices;
+    std::vector<unsigned int> instanceIndices;
+    std::vector<screenVertexWithAttributes> instanceShaded;
+    std::vector<bool> instanceNeeded;
+    std::vector<unsigned int> instanceFront;
+
     //-------------------------------------------------//
     //                                                 //
     // STATE VARIABLE ROUTINES                         //
@@ -342,6 +491,14 @@ class FakeGL
     // sets properties for the one and only light
     void Light(int parameterName, const float *parameterValues);
 
+    // sets where the shadow term comes from while FAKEGL_SHADOWS is enabled: rays traced from the surfaces
+    // to the light (ShadowTracer) or a shadow map (ShadowMap). it is kept (not copied) & must outlive the frame
+    void Shadows(const ShadowSource *source);
+
+    // whether the shadow term is found at the vertices & interpolated (FAKEGL_PER_VERTEX), or found
+    // for every fragment (FAKEGL_PER_PIXEL), four neighbouring fragments at a time
+    void ShadowMode(unsigned int mode);
+
     //-------------------------------------------------//
     //                                                 //
     // TEXTURE PROCESSING ROUTINES                     //
@@ -357,6 +514,50 @@ class FakeGL
     // sets the texture image that corresponds to a given ID
     void TexImage2D(const RGBAImage &textureImage);
 
+    // while FAKEGL_DEPTH_SPRITE is enabled, textured fragments whose texel has an alpha of 0 are
+    // discarded before the depth test, & the others are moved in depth by the texel's alpha: 1 is
+    // range nearer than the primitive, 255 range further, in window depth (zNear to zFar)
+    void SpriteDepthRange(float range);
+
+    //-------------------------------------------------//
+    //                                                 //
+    // FRAMEBUFFER OBJECT ROUTINES                     //
+    //                                                 //
+    //-------------------------------------------------//
+
+    // creates n framebuffer objects, without attachments, & writes their names (never 0) to ids
+    void GenFramebuffers(int n, unsigned int *ids);
+
+    // deletes framebuffer objects, unbinding any that are bound as the target or the texture
+    void DeleteFramebuffers(int n, const unsigned int *ids);
+
+    // (re)creates a framebuffer object's colour & depth attachments at the given size, with the
+    // colour cleared to transparent black & the depth to the far plane. false if the size is too large
+    bool FramebufferStorage(unsigned int id, int width, int height);
+
+    // makes a framebuffer object what is drawn, cleared & captured in place of the frame & depth
+    // buffers, or 0 for them again. nothing is copied: the attachments trade places with them, so
+    // frameBuffer & depthBuffer hold whatever is bound. the viewport is left as it is.
+    // the drawing happens straight away even while recording for tiles, so that the tiles can
+    // then sample what was drawn
+    void BindFramebuffer(unsigned int id);
+
+    // makes the colour attachment of a framebuffer object the texture, without copying it, or 0 for
+    // the TexImage2D() texture again. sampling the one that is being drawn into is undefined
+    void BindFramebufferTexture(unsigned int id);
+
+    // the attachments of a framebuffer object, wherever they are, or NULL if there is no such object
+    const RGBAImage *FramebufferColour(unsigned int id) const;
+    const RGBAImage *FramebufferDepth(unsigned int id) const;
+
+    // the framebuffer objects by name, the next name to hand out, the one bound as the target & the one bound
+    // as the texture (0 for none), & the recording set aside while a framebuffer object is drawn into
+    std::map<unsigned int, FramebufferObject> framebuffers;
+    unsigned int nextFramebufferName = 1;
+    unsigned int boundFramebuffer = 0;
+    unsigned int textureFramebuffer = 0;
+    std::vector<RecordedBatch> *suspendedRecordTarget = nullptr;
+
     //-------------------------------------------------//
     //                                                 //
     // FRAME BUFFER ROUTINES                           //
@@ -368,7 +569,101 @@ class FakeGL
     
     // sets the clear colour for the frame buffer
     void ClearColor(float red, float green, float blue, float alpha);
+
+    // sets which channels of the frame buffer fragments write; with none, fragments are not shaded
+    void ColorMask(bool red, bool green, bool blue, bool alpha);
+
+    // sets whether fragments that pass the depth test write the depth buffer
+    void DepthMask(bool flag);
     
+    //-------------------------------------------------//
+    //                                                 //
+    // FRAME CAPTURE ROUTINES                          //
+    //                                                 //
+    //-------------------------------------------------//
+
+    // starts handing frames to a background writer thread
+    // for PPM & QOI the file name is a printf pattern such as "frame%04d.ppm"
+    // for Y4M it names the single output stream
+    bool BeginCapture(const char *fileName, unsigned int format, unsigned int queueLength = 4);
+
+    // queues the current frame buffer for writing
+    // only blocks if all queueLength buffers are still waiting for the disk
+    void CaptureFrame();
+
+    // waits for the queued frames to be written & stops capturing
+    void EndCapture();
+
+    // the capture in progress, if any
+    std::unique_ptr<FrameCapture> frameCapture;
+
+    //-------------------------------------------------//
+    //                                                 //
+    // QUERY ROUTINES                                  //
+    //                                                 //
+    //-------------------------------------------------//
+
+    // creates n query objects & writes their names (never 0) to ids
+    void GenQueries(int n, unsigned int *ids);
+
+    // deletes query objects, ending any that are active
+    void DeleteQueries(int n, const unsigned int *ids);
+
+    // starts counting a target into a query; each target has at most one active query
+    // the statistics count only this context's work, including work done for it on other
+    // threads by contexts that share its statisticsContext (as TiledRenderer's tiles do)
+    void BeginQuery(unsigned int target, unsigned int id);
+
+    // stops the active query of a target
+    void EndQuery(unsigned int target);
+
+    // reads FAKEGL_QUERY_RESULT or FAKEGL_QUERY_RESULT_AVAILABLE (0 or 1) of an ended query
+    // FakeGL has finished all its work by then, so results are never pending, but samples
+    // passed while recording (see recordTarget) are only counted by the replay & never available
+    void GetQueryObjectui64v(unsigned int id, unsigned int parameterName, unsigned long long *result);
+
+    // the current count of a target
+    unsigned long long QueryCount(unsigned int target);
+
+    // the id the pipeline statistics of this context are counted under, see PipelineStatistics.h
+    // a context rendering on behalf of another takes on the other's id, so that its work shows up there
+    uint32_t statisticsContext;
+    // the id handed out to this context, given back when it is destroyed
+    uint32_t ownStatisticsContext;
+
+    // the query objects by name, the active query of each target (0 for none) & the next name to hand out
+    std::map<unsigned int, QueryObject> queries;
+    unsigned int activeQueries[FAKEGL_QUERY_TARGETS] = {};
+    unsigned int nextQueryName = 1;
+
+    // fragments of this context that have passed the depth test, for FAKEGL_SAMPLES_PASSED
+    unsigned long long samplesPassed = 0;
+
+    // until EndConditionalRender(), drawing & clearing are discarded if the query counted nothing
+    // a result that isn't available never discards
+    void BeginConditionalRender(unsigned int id);
+    void EndConditionalRender();
+
+    // true while a conditional render is discarding, so that callers can skip submitting geometry at all
+    bool ConditionalRenderDiscards();
+
+    // the query of the conditional render in progress (0 for none)
+    unsigned int conditionalQuery = 0;
+
+    //-------------------------------------------------//
+    //                                                 //
+    // RECORD / REPLAY ROUTINES                        //
+    //                                                 //
+    //-------------------------------------------------//
+
+    // while set, End() runs the vertex shader and appends the primitives here
+    // instead of rasterising them, and Clear() does nothing
+    std::vector<RecordedBatch> *recordTarget = nullptr;
+
+    // rasterises & shades the listed primitives of a recorded batch into this context's
+    // frame buffer, whose bottom left pixel is at (originX, originY) in the recorded window
+    void ReplayBatch(const RecordedBatch &batch, const std::vector<uint32_t> &primitives, int originX, int originY);
+
     //-------------------------------------------------//
     //                                                 //
     // ROUTINE TO FLUSH THE PIPELINE                   //
@@ -395,9 +690,22 @@ class FakeGL
     //                                                 //
     //-------------------------------------------------//
 
+    // binds the texture & updates the matrices & lighting products before vertices are shaded
+    void PrepareShader();
+
+    // fetches one vertex from the arrays, with the current state standing in for missing arrays
+    // the normal is not yet rescaled
+    void FetchVertex(unsigned int index, vertexWithAttributes &vertex) const;
+
     // transform one vertex & shift to the transformed queue
     void TransformVertex();
 
+    // rasterises (or records) everything on the raster queue & processes the fragments
+    void ProcessRasterQueue();
+
+    // true if the triangle winds clockwise on screen, i.e. is culled with FAKEGL_CULL_FACE
+    bool IsBackFacing(const screenVertexWithAttributes &vertex0, const screenVertexWithAttributes &vertex1, const screenVertexWithAttributes &vertex2) const;
+
     // rasterise a single primitive if there are enough vertices on the queue
     bool RasterisePrimitive();
 
@@ -410,6 +718,9 @@ class FakeGL
     // rasterises a single triangle
     void RasteriseTriangle(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, screenVertexWithAttributes &vertex2);
     
+    // finds the shadow term of every fragment on the queue
+    void FindShadows();
+
     // process a single fragment
     void ProcessFragment();
     
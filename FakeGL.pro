@@ -17,15 +17,29 @@ INCLUDEPATH += .
 # Input
 HEADERS += ArcBall.h \
            ArcBallWidget.h \
+           BinnedSAH.h \
            Cartesian3.h \
            Color.h \
            FakeGL.h \
            FakeGLRenderWidget.h \
+           FakeGLScene.h \
+           FrameCapture.h \
            Homogeneous4.h \
+           ImpostorCache.h \
+           IndexedMesh.h \
            Light.h \
+           MappedFile.h \
            Material.h \
            MathUtils.h \
+           MeshBVH.h \
+           MeshFile.h \
+           Meshlet.h \
+           MeshOptimiser.h \
+           MeshSimplifier.h \
            Matrix4.h \
+           ObjParser.h \
+           OcclusionCuller.h \
+           PipelineStatistics.h \
            Quaternion.h \
            RenderController.h \
            RenderParameters.h \
@@ -33,29 +47,54 @@ HEADERS += ArcBall.h \
            RenderWindow.h \
            RGBAImage.h \
            RGBAValue.h \
+           Scene.h \
            Shader.h \
+           ShadowMap.h \
+           ShadowSource.h \
+           ShadowTracer.h \
+           SimdMath.h \
            StateMechine.h \
            Texture2D.h \
-           TexturedObject.h
+           TexturedObject.h \
+           TiledRenderer.h \
+           VertexQuantiser.h
 SOURCES += ArcBall.cpp \
            ArcBallWidget.cpp \
            Cartesian3.cpp \
            Color.cpp \
            FakeGL.cpp \
            FakeGLRenderWidget.cpp \
+           FakeGLScene.cpp \
+           FrameCapture.cpp \
            Homogeneous4.cpp \
+           ImpostorCache.cpp \
+           IndexedMesh.cpp \
            Light.cpp \
            main.cpp \
+           MappedFile.cpp \
            Material.cpp \
            MathUtils.cpp \
+           MeshBVH.cpp \
+           MeshFile.cpp \
+           Meshlet.cpp \
+           MeshOptimiser.cpp \
+           MeshSimplifier.cpp \
            Matrix4.cpp \
+           ObjParser.cpp \
+           OcclusionCuller.cpp \
+           PipelineStatistics.cpp \
            Quaternion.cpp \
            RenderController.cpp \
            RenderWidget.cpp \
            RenderWindow.cpp \
            RGBAImage.cpp \
            RGBAValue.cpp \
+           Scene.cpp \
            Shader.cpp \
+           ShadowMap.cpp \
+           ShadowTracer.cpp \
            StateMechine.cpp \
            Texture2D.cpp \
-           TexturedObject.cpp
+           TexturedObject.cpp \
+           TiledRenderer.cpp \
+           VertexQuantiser.cpp
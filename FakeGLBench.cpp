@@ -0,0 +1,680 @@
+////////////////////////////////////////////////////////////////////////
+//
+//  -----------------------------
+//  FakeGLBench.cpp
+//  -----------------------------
+//
+//  Benchmark suite: renders every object of the corpus under a matrix
+//  of configurations (lighting, Phong, texture, depth test, image size
+//  & thread count) and reports frame time percentiles, triangle & fill
+//  rates, memory growth & the process peak, then times the hot routines in isolation.
+//  Built by fakegl_bench.pro without Qt or OpenGL, like fakegl_cli.
+//
+////////////////////////////////////////////////////////////////////////
+
+// system libraries
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <math.h>
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+// local includes
+#include "FakeGL.h"
+#include "FakeGLScene.h"
+#include "Shader.h"
+#include "Texture2D.h"
+#include "TexturedObject.h"
+#include "RenderParameters.h"
+#include "TiledRenderer.h"
+
+// defaults for the corpus runs
+#define BENCH_DEFAULT_SIZES "320x240,800x600,1920x1080"
+#define BENCH_DEFAULT_FRAMES 10
+#define BENCH_DEFAULT_WARMUP 2
+// tile size for the multi-threaded runs
+#define BENCH_TILE_SIZE 128
+// each microbenchmark sample runs for at least this many seconds
+#define BENCH_MICRO_SECONDS 0.05
+
+// one cell of the configuration matrix
+struct BenchConfig
+    { // struct BenchConfig
+    bool lighting, phong, texture, depth;
+    long width, height;
+    unsigned int threads;
+    }; // struct BenchConfig
+
+// the measurements for one object under one configuration
+struct BenchResult
+    { // struct BenchResult
+    std::string object;
+    BenchConfig config;
+    size_t triangles;
+    unsigned long long fragments;
+    long frames;
+    double meanTime, minTime, p50Time, p90Time, p99Time, maxTime;
+    double trianglesPerSecond, fragmentsPerSecond;
+    // how much the resident set grew while the configuration ran, and the process
+    // high water mark by the end of it, which earlier objects & configurations count towards
+    long memoryGrowthKB;
+    long processPeakMemoryKB;
+    }; // struct BenchResult
+
+// the measurement for one microbenchmark
+struct MicroResult
+    { // struct MicroResult
+    std::string name;
+    // what is counted, e.g. "vertex" or "pixel"
+    std::string unit;
+    double nanosecondsPerItem;
+    }; // struct MicroResult
+
+// a stream buffer that throws everything away, for the tiled runs
+class NullBuffer : public std::streambuf
+    { // class NullBuffer
+    protected:
+    int overflow(int character) { return character; }
+    std::streamsize xsputn(const char *, std::streamsize count) { return count; }
+    }; // class NullBuffer
+
+// results are consumed through this so that the compiler can't drop the work
+static volatile float benchSink;
+
+// prints the options
+static void PrintUsage(const char *programName)
+    { // PrintUsage()
+    std::cout << "Usage: " << programName << " [options] [geometry.obj ...]" << std::endl
+              << "Renders every .obj in the objects directory (or the files given) under every" << std::endl
+              << "combination of lighting, Phong shading, texture & depth test at each size & thread count." << std::endl
+              << "  -objects DIR        corpus directory (default objects)" << std::endl
+              << "  -texture FILE       texture for the textured runs (default textures/earth.ppm)" << std::endl
+              << "  -sizes LIST         image sizes, e.g. 640x480,1920x1080 (default " << BENCH_DEFAULT_SIZES << ")" << std::endl
+              << "  -threads LIST       thread counts, e.g. 1,8 (default 1 & all hardware threads)" << std::endl
+              << "                      1 renders straight into the frame buffer, more render in tiles" << std::endl
+              << "  -frames N           timed frames per configuration (default " << BENCH_DEFAULT_FRAMES << ")" << std::endl
+              << "  -warmup N           untimed frames per configuration (default " << BENCH_DEFAULT_WARMUP << ")" << std::endl
+              << "  -json FILE          write all results as JSON" << std::endl
+              << "  -csv FILE           write the configuration results as CSV" << std::endl
+              << "  -microcsv FILE      write the microbenchmark results as CSV" << std::endl
+              << "  -nocorpus           only run the microbenchmarks" << std::endl
+              << "  -nomicro            only run the corpus" << std::endl
+              << "  -nocache            don't read or write the binary mesh cache" << std::endl;
+    } // PrintUsage()
+
+// splits a comma separated list
+static std::vector<std::string> SplitList(const std::string &list)
+    { // SplitList()
+    std::vector<std::string> items;
+    std::stringstream listStream(list);
+    std::string item;
+    while (std::getline(listStream, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+    } // SplitList()
+
+// the .obj files in a directory, sorted by name
+static std::vector<std::string> ListObjects(const std::string &directoryName)
+    { // ListObjects()
+    std::vector<std::string> fileNames;
+#ifndef _WIN32
+    DIR *directory = opendir(directoryName.c_str());
+    if (directory == NULL)
+        return fileNames;
+    for (dirent *entry = readdir(directory); entry != NULL; entry = readdir(directory))
+        { // per entry
+        std::string name(entry->d_name);
+        if ((name.size() > 4) && (name.compare(name.size() - 4, 4, ".obj") == 0))
+            fileNames.push_back(directoryName + "/" + name);
+        } // per entry
+    closedir(directory);
+    std::sort(fileNames.begin(), fileNames.end());
+#else
+    // no directory listing here: the files have to be named on the command line
+    (void) directoryName;
+#endif
+    return fileNames;
+    } // ListObjects()
+
+// resident set of the process now, in kilobytes (0 where unsupported)
+static long ResidentMemoryKB()
+    { // ResidentMemoryKB()
+#ifdef __linux__
+    // the second field of statm is the resident set in pages
+    long totalPages = 0, residentPages = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL)
+        return 0;
+    if (fscanf(statm, "%ld %ld", &totalPages, &residentPages) != 2)
+        residentPages = 0;
+    fclose(statm);
+    return residentPages * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+    return 0;
+#endif
+    } // ResidentMemoryKB()
+
+// largest resident set of the process so far, in kilobytes (0 where unsupported)
+static long PeakMemoryKB()
+    { // PeakMemoryKB()
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    // macOS reports bytes rather than kilobytes
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+    } // PeakMemoryKB()
+
+// nearest rank percentile of sorted times
+static double Percentile(const std::vector<double> &sortedTimes, double percent)
+    { // Percentile()
+    size_t rank = (size_t) ceil(percent / 100.0 * sortedTimes.size());
+    if (rank < 1)
+        rank = 1;
+    return sortedTimes[std::min(rank, sortedTimes.size()) - 1];
+    } // Percentile()
+
+// milliseconds since a start time
+static double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    { // MillisecondsSince()
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    } // MillisecondsSince()
+
+// renders one object under one configuration
+static BenchResult RunConfig(FakeGL &fakeGL, TexturedObject &texturedObject, const std::string &objectName,
+                             const BenchConfig &config, long nFrames, long nWarmup)
+    { // RunConfig()
+    long startMemoryKB = ResidentMemoryKB();
+
+    // a fixed view of the full detail mesh, so that every run draws the same triangles
+    RenderParameters renderParameters;
+    renderParameters.showObject = true;
+    renderParameters.centreObject = true;
+    renderParameters.scaleObject = true;
+    renderParameters.lodPixelError = 0.0;
+    renderParameters.useLighting = config.lighting;
+    renderParameters.phongShadingOn = config.phong;
+    renderParameters.texturedRendering = config.texture;
+    renderParameters.depthTestOn = config.depth;
+    renderParameters.rotationMatrix.SetRotation(Cartesian3(1.0, 1.0, 0.0), 0.7);
+
+    // the fill rate comes from a single threaded frame, which also warms the caches
+    fakeGL.Viewport(0, 0, config.width, config.height);
+    fakeGL.frameBuffer.Resize(config.width, config.height);
+    FakeGLScene::SetProjection(&fakeGL, config.width, config.height);
+    unsigned int fragmentQuery;
+    fakeGL.GenQueries(1, &fragmentQuery);
+    fakeGL.BeginQuery(FAKEGL_FRAGMENT_SHADER_INVOCATIONS, fragmentQuery);
+    FakeGLScene::Paint(&fakeGL, &texturedObject, &renderParameters);
+    fakeGL.EndQuery(FAKEGL_FRAGMENT_SHADER_INVOCATIONS);
+
+    BenchResult result;
+    result.object = objectName;
+    result.config = config;
+    result.triangles = texturedObject.meshLevels[0].triangleCount();
+    fakeGL.GetQueryObjectui64v(fragmentQuery, FAKEGL_QUERY_RESULT, &result.fragments);
+    fakeGL.DeleteQueries(1, &fragmentQuery);
+    result.frames = nFrames;
+
+    // more than one thread renders tiles, which go nowhere
+    NullBuffer nullBuffer;
+    std::ostream nullStream(&nullBuffer);
+    TiledRenderer tiledRenderer(config.width, config.height, BENCH_TILE_SIZE, config.threads);
+    auto renderFrame = [&]()
+        { // renderFrame()
+        if (config.threads <= 1)
+            FakeGLScene::Paint(&fakeGL, &texturedObject, &renderParameters);
+        else
+            tiledRenderer.render(fakeGL, [&](FakeGL &tileGL)
+                { // scene
+                FakeGLScene::SetProjection(&tileGL, config.width, config.height);
+                FakeGLScene::Paint(&tileGL, &texturedObject, &renderParameters);
+                }, nullStream); // scene
+        }; // renderFrame()
+
+    for (long frame = 0; frame < nWarmup; frame++)
+        renderFrame();
+
+    std::vector<double> frameTimes(nFrames);
+    for (long frame = 0; frame < nFrames; frame++)
+        { // per frame
+        auto frameStart = std::chrono::steady_clock::now();
+        renderFrame();
+        frameTimes[frame] = MillisecondsSince(frameStart);
+        } // per frame
+
+    std::sort(frameTimes.begin(), frameTimes.end());
+    double totalTime = 0.0;
+    for (double frameTime : frameTimes)
+        totalTime += frameTime;
+    result.meanTime = totalTime / nFrames;
+    result.minTime = frameTimes.front();
+    result.p50Time = Percentile(frameTimes, 50.0);
+    result.p90Time = Percentile(frameTimes, 90.0);
+    result.p99Time = Percentile(frameTimes, 99.0);
+    result.maxTime = frameTimes.back();
+    result.trianglesPerSecond = result.triangles * 1000.0 / result.meanTime;
+    result.fragmentsPerSecond = result.fragments * 1000.0 / result.meanTime;
+    result.memoryGrowthKB = ResidentMemoryKB() - startMemoryKB;
+    result.processPeakMemoryKB = PeakMemoryKB();
+    return result;
+    } // RunConfig()
+
+// times a routine that handles itemsPerCall items per call: the call count is doubled until a
+// run takes BENCH_MICRO_SECONDS, and the fastest of five runs is kept
+template <typename Routine> static double NanosecondsPerItem(Routine routine, double itemsPerCall)
+    { // NanosecondsPerItem()
+    routine();
+    long nCalls = 1;
+    double runTime = 0.0;
+    while (true)
+        { // find the call count
+        auto runStart = std::chrono::steady_clock::now();
+        for (long call = 0; call < nCalls; call++)
+            routine();
+        runTime = MillisecondsSince(runStart);
+        if (runTime >= BENCH_MICRO_SECONDS * 1000.0)
+            break;
+        nCalls *= 2;
+        } // find the call count
+
+    double bestTime = runTime;
+    for (int run = 0; run < 4; run++)
+        { // per run
+        auto runStart = std::chrono::steady_clock::now();
+        for (long call = 0; call < nCalls; call++)
+            routine();
+        bestTime = std::min(bestTime, MillisecondsSince(runStart));
+        } // per run
+    return bestTime * 1.0e6 / (nCalls * itemsPerCall);
+    } // NanosecondsPerItem()
+
+// times the vertex shaders, the triangle rasteriser, texture sampling & the clears on their own
+static std::vector<MicroResult> RunMicrobenchmarks()
+    { // RunMicrobenchmarks()
+    std::vector<MicroResult> results;
+    std::mt19937 random(5812);
+    std::uniform_real_distribution<float> unit(0.0, 1.0);
+
+    // a context with the widget's usual state
+    FakeGL fakeGL;
+    fakeGL.ClearColor(0.8, 0.8, 0.6, 1.0);
+    fakeGL.Viewport(0, 0, 800, 600);
+    fakeGL.frameBuffer.Resize(800, 600);
+    FakeGLScene::SetProjection(&fakeGL, 800, 600);
+    fakeGL.MatrixMode(FAKEGL_MODELVIEW);
+    fakeGL.LoadIdentity();
+    fakeGL.Rotatef(40.0, 1.0, 1.0, 0.0);
+
+    // vertex shader: random vertices on the unit sphere
+    std::vector<vertexWithAttributes> vertices(1024);
+    for (vertexWithAttributes &vertex : vertices)
+        { // per vertex
+        Cartesian3 normal(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f);
+        normal = normal.unit();
+        vertex.position = Homogeneous4(normal.x, normal.y, normal.z, 1.0);
+        vertex.normal = normal;
+        vertex.colour = RGBAValue(200.0f, 160.0f, 120.0f, 255.0f);
+        vertex.texCoord = Cartesian3(unit(random), unit(random), 0.0);
+        } // per vertex
+
+    const char *shaderNames[3] = { "vertex shader (unlit)", "vertex shader (Gouraud)", "vertex shader (Phong)" };
+    for (int shader = 0; shader < 3; shader++)
+        { // per shader
+        if (shader == 2)
+            fakeGL.Enable(FAKEGL_PHONG_SHADING);
+        else
+            fakeGL.Disable(FAKEGL_PHONG_SHADING);
+        // enabling lighting picks the shader, so it comes after the Phong switch
+        if (shader == 0)
+            fakeGL.Disable(FAKEGL_LIGHTING);
+        else
+            fakeGL.Enable(FAKEGL_LIGHTING);
+        fakeGL.PrepareShader();
+
+        double nanoseconds = NanosecondsPerItem([&]()
+            { // shade
+            float sum = 0.0;
+            for (const vertexWithAttributes &vertex : vertices)
+                sum += fakeGL.stateMechine.currentShader->vertexShader(vertex, fakeGL).position.x;
+            benchSink = sum;
+            }, vertices.size()); // shade
+        results.push_back({shaderNames[shader], "vertex", nanoseconds});
+        } // per shader
+    fakeGL.Disable(FAKEGL_LIGHTING);
+    fakeGL.Disable(FAKEGL_PHONG_SHADING);
+
+    // RasteriseTriangle: random triangles in window coordinates of roughly the given edge length
+    const char *triangleNames[3] = { "RasteriseTriangle (2 pixel)", "RasteriseTriangle (16 pixel)", "RasteriseTriangle (256 pixel)" };
+    float triangleSizes[3] = { 2.0, 16.0, 256.0 };
+    for (int size = 0; size < 3; size++)
+        { // per size
+        std::vector<screenVertexWithAttributes> triangles(3 * 256);
+        for (size_t vertex = 0; vertex < triangles.size(); vertex++)
+            { // per vertex
+            screenVertexWithAttributes &screenVertex = triangles[vertex];
+            if (vertex % 3 == 0)
+                screenVertex.position = Cartesian3(unit(random) * (800 - triangleSizes[size]), unit(random) * (600 - triangleSizes[size]), 0.5);
+            else
+                screenVertex.position = triangles[vertex - vertex % 3].position
+                                      + Cartesian3(unit(random) * triangleSizes[size], unit(random) * triangleSizes[size], 0.0);
+            screenVertex.colour = RGBAValue(200.0f, 160.0f, 120.0f, 255.0f);
+            screenVertex.divZ = 1.0;
+            } // per vertex
+
+        unsigned long long fragments = 0;
+        double nanoseconds = NanosecondsPerItem([&]()
+            { // rasterise
+            for (size_t vertex = 0; vertex < triangles.size(); vertex += 3)
+                fakeGL.RasteriseTriangle(triangles[vertex], triangles[vertex + 1], triangles[vertex + 2]);
+            fragments = fakeGL.fragmentQueue.size();
+            fakeGL.fragmentQueue.clear();
+            }, triangles.size() / 3); // rasterise
+        results.push_back({triangleNames[size], "triangle", nanoseconds});
+        if (fragments > 0)
+            results.push_back({std::string(triangleNames[size]) + " per fragment", "fragment", nanoseconds * (triangles.size() / 3) / fragments});
+        } // per size
+
+    // Texture2D::sample at random coordinates of a 1024 x 1024 texture
+    RGBAImage textureImage;
+    textureImage.Resize(1024, 1024);
+    for (long row = 0; row < textureImage.height; row++)
+        for (long col = 0; col < textureImage.width; col++)
+            textureImage[row][col] = RGBAValue((unsigned char) row, (unsigned char) col, (unsigned char) (row ^ col));
+    Texture2D texture;
+    texture.setImage(&textureImage);
+    std::vector<std::pair<float, float>> texCoords(4096);
+    for (std::pair<float, float> &texCoord : texCoords)
+        texCoord = std::make_pair(unit(random), unit(random));
+    double sampleNanoseconds = NanosecondsPerItem([&]()
+        { // sample
+        unsigned int sum = 0;
+        for (const std::pair<float, float> &texCoord : texCoords)
+            sum += texture.sample(texCoord).red;
+        benchSink = sum;
+        }, texCoords.size()); // sample
+    results.push_back({"Texture2D::sample", "sample", sampleNanoseconds});
+
+    // the clears, at 1920 x 1080
+    fakeGL.Viewport(0, 0, 1920, 1080);
+    fakeGL.frameBuffer.Resize(1920, 1080);
+    fakeGL.Enable(FAKEGL_DEPTH_TEST);
+    const char *clearNames[3] = { "Clear (colour)", "Clear (depth)", "Clear (colour & depth)" };
+    unsigned int clearMasks[3] = { FAKEGL_COLOR_BUFFER_BIT, FAKEGL_DEPTH_BUFFER_BIT, FAKEGL_COLOR_BUFFER_BIT | FAKEGL_DEPTH_BUFFER_BIT };
+    for (int clear = 0; clear < 3; clear++)
+        { // per clear
+        double nanoseconds = NanosecondsPerItem([&]()
+            { // clear
+            fakeGL.Clear(clearMasks[clear]);
+            }, 1920.0 * 1080.0); // clear
+        results.push_back({clearNames[clear], "pixel", nanoseconds});
+        } // per clear
+
+    return results;
+    } // RunMicrobenchmarks()
+
+// JSON string with the characters that need it escaped
+static std::string JSONString(const std::string &string)
+    { // JSONString()
+    std::string quoted = "\"";
+    for (char character : string)
+        { // per character
+        if ((character == '"') || (character == '\\'))
+            quoted += '\\';
+        quoted += character;
+        } // per character
+    return quoted + "\"";
+    } // JSONString()
+
+// writes everything as a single JSON object
+static bool WriteJSON(const std::string &fileName, const std::vector<BenchResult> &results, const std::vector<MicroResult> &microResults)
+    { // WriteJSON()
+    std::ofstream outFile(fileName);
+    outFile << "{" << std::endl << "  \"configurations\": [";
+    for (size_t result = 0; result < results.size(); result++)
+        { // per result
+        const BenchResult &r = results[result];
+        outFile << (result ? "," : "") << std::endl
+                << "    {\"object\": " << JSONString(r.object) << ", \"triangles\": " << r.triangles
+                << ", \"lighting\": " << (r.config.lighting ? "true" : "false")
+                << ", \"phong\": " << (r.config.phong ? "true" : "false")
+                << ", \"texture\": " << (r.config.texture ? "true" : "false")
+                << ", \"depth\": " << (r.config.depth ? "true" : "false")
+                << ", \"width\": " << r.config.width << ", \"height\": " << r.config.height
+                << ", \"threads\": " << r.config.threads << ", \"frames\": " << r.frames
+                << ", \"mean_ms\": " << r.meanTime << ", \"min_ms\": " << r.minTime
+                << ", \"p50_ms\": " << r.p50Time << ", \"p90_ms\": " << r.p90Time
+                << ", \"p99_ms\": " << r.p99Time << ", \"max_ms\": " << r.maxTime
+                << ", \"triangles_per_s\": " << r.trianglesPerSecond
+                << ", \"fragments_per_frame\": " << r.fragments
+                << ", \"fragments_per_s\": " << r.fragmentsPerSecond
+                << ", \"memory_growth_kb\": " << r.memoryGrowthKB
+                << ", \"process_peak_memory_kb\": " << r.processPeakMemoryKB << "}";
+        } // per result
+    outFile << std::endl << "  ]," << std::endl << "  \"microbenchmarks\": [";
+    for (size_t result = 0; result < microResults.size(); result++)
+        { // per microbenchmark
+        const MicroResult &r = microResults[result];
+        outFile << (result ? "," : "") << std::endl
+                << "    {\"name\": " << JSONString(r.name) << ", \"unit\": " << JSONString(r.unit)
+                << ", \"ns_per_item\": " << r.nanosecondsPerItem
+                << ", \"items_per_s\": " << 1.0e9 / r.nanosecondsPerItem << "}";
+        } // per microbenchmark
+    outFile << std::endl << "  ]" << std::endl << "}" << std::endl;
+    return outFile.good();
+    } // WriteJSON()
+
+// writes the configuration results as CSV
+static bool WriteCSV(const std::string &fileName, const std::vector<BenchResult> &results)
+    { // WriteCSV()
+    std::ofstream outFile(fileName);
+    outFile << "object,triangles,lighting,phong,texture,depth,width,height,threads,frames,"
+            << "mean_ms,min_ms,p50_ms,p90_ms,p99_ms,max_ms,triangles_per_s,fragments_per_frame,fragments_per_s,memory_growth_kb,process_peak_memory_kb" << std::endl;
+    for (const BenchResult &r : results)
+        outFile << r.object << "," << r.triangles << "," << r.config.lighting << "," << r.config.phong << ","
+                << r.config.texture << "," << r.config.depth << "," << r.config.width << "," << r.config.height << ","
+                << r.config.threads << "," << r.frames << "," << r.meanTime << "," << r.minTime << ","
+                << r.p50Time << "," << r.p90Time << "," << r.p99Time << "," << r.maxTime << ","
+                << r.trianglesPerSecond << "," << r.fragments << "," << r.fragmentsPerSecond << ","
+                << r.memoryGrowthKB << "," << r.processPeakMemoryKB << std::endl;
+    return outFile.good();
+    } // WriteCSV()
+
+// writes the microbenchmark results as CSV
+static bool WriteMicroCSV(const std::string &fileName, const std::vector<MicroResult> &microResults)
+    { // WriteMicroCSV()
+    std::ofstream outFile(fileName);
+    outFile << "name,unit,ns_per_item,items_per_s" << std::endl;
+    for (const MicroResult &r : microResults)
+        outFile << r.name << "," << r.unit << "," << r.nanosecondsPerItem << "," << 1.0e9 / r.nanosecondsPerItem << std::endl;
+    return outFile.good();
+    } // WriteMicroCSV()
+
+// main routine
+int main(int argc, char **argv)
+    { // main()
+    std::string objectsDirectory = "objects";
+    std::string textureName = "textures/earth.ppm";
+    std::string sizeList = BENCH_DEFAULT_SIZES;
+    std::string threadList;
+    std::string jsonName, csvName, microCSVName;
+    long nFrames = BENCH_DEFAULT_FRAMES, nWarmup = BENCH_DEFAULT_WARMUP;
+    bool runCorpus = true, runMicro = true, useCache = true;
+    std::vector<std::string> objectNames;
+
+    // walk through the arguments
+    for (int arg = 1; arg < argc; arg++)
+        { // per argument
+        std::string option(argv[arg]);
+        // the number of values the option still has available
+        int nValues = argc - arg - 1;
+
+        if ((option == "-objects") && (nValues >= 1))
+            objectsDirectory = argv[++arg];
+        else if ((option == "-texture") && (nValues >= 1))
+            textureName = argv[++arg];
+        else if ((option == "-sizes") && (nValues >= 1))
+            sizeList = argv[++arg];
+        else if ((option == "-threads") && (nValues >= 1))
+            threadList = argv[++arg];
+        else if ((option == "-frames") && (nValues >= 1))
+            nFrames = atol(argv[++arg]);
+        else if ((option == "-warmup") && (nValues >= 1))
+            nWarmup = atol(argv[++arg]);
+        else if ((option == "-json") && (nValues >= 1))
+            jsonName = argv[++arg];
+        else if ((option == "-csv") && (nValues >= 1))
+            csvName = argv[++arg];
+        else if ((option == "-microcsv") && (nValues >= 1))
+            microCSVName = argv[++arg];
+        else if (option == "-nocorpus")
+            runCorpus = false;
+        else if (option == "-nomicro")
+            runMicro = false;
+        else if (option == "-nocache")
+            useCache = false;
+        else if ((option.size() > 1) && (option[0] == '-'))
+            { // bad option
+            std::cout << "Unknown option or missing value: " << option << std::endl;
+            PrintUsage(argv[0]);
+            return 1;
+            } // bad option
+        else
+            objectNames.push_back(option);
+        } // per argument
+
+    // image sizes
+    std::vector<std::pair<long, long>> sizes;
+    for (const std::string &size : SplitList(sizeList))
+        { // per size
+        long width = 0, height = 0;
+        if ((sscanf(size.c_str(), "%ldx%ld", &width, &height) != 2) || (width < 1) || (height < 1)
+            || (width > MAX_IMAGE_DIMENSION) || (height > MAX_IMAGE_DIMENSION))
+            { // bad size
+            std::cout << "Bad size " << size << ": sizes are WxH, up to " << MAX_IMAGE_DIMENSION << " each way" << std::endl;
+            return 1;
+            } // bad size
+        sizes.push_back(std::make_pair(width, height));
+        } // per size
+
+    // thread counts
+    std::vector<unsigned int> threadCounts;
+    if (threadList.empty())
+        { // default threads
+        threadCounts.push_back(1);
+        if (std::thread::hardware_concurrency() > 1)
+            threadCounts.push_back(std::thread::hardware_concurrency());
+        } // default threads
+    else
+        for (const std::string &threads : SplitList(threadList))
+            threadCounts.push_back(std::max(1, atoi(threads.c_str())));
+
+    if (objectNames.empty() && runCorpus)
+        objectNames = ListObjects(objectsDirectory);
+
+    if ((runCorpus && objectNames.empty()) || sizes.empty() || threadCounts.empty() || (nFrames < 1) || (nWarmup < 0))
+        { // nothing to do
+        if (runCorpus && objectNames.empty())
+            std::cout << "No objects found in " << objectsDirectory << std::endl;
+        PrintUsage(argv[0]);
+        return 1;
+        } // nothing to do
+
+    // the corpus
+    std::vector<BenchResult> results;
+    if (runCorpus)
+        { // run corpus
+        // the texture is read for every object, so check it once up front
+        if (!std::ifstream(textureName).good())
+            { // no texture
+            std::cout << "Read failed for texture " << textureName << " (use -texture)" << std::endl;
+            return 1;
+            } // no texture
+
+        printf("%-32s %9s %-14s %9s %3s %9s %9s %9s %9s %11s %11s %9s %12s\n", "object", "triangles", "config", "size", "thr",
+               "mean ms", "p50 ms", "p90 ms", "p99 ms", "tri/s", "frag/s", "grew MB", "process peak");
+        for (const std::string &objectName : objectNames)
+            { // per object
+            std::ifstream textureFile(textureName, std::ios::binary);
+            TexturedObject texturedObject;
+            if (!texturedObject.ReadObjectFile(objectName.c_str(), textureFile, useCache))
+                { // object read failed
+                std::cout << "Read failed for object " << objectName << ", skipped" << std::endl;
+                continue;
+                } // object read failed
+
+            FakeGL fakeGL;
+            fakeGL.Enable(FAKEGL_LIGHTING);
+            fakeGL.ClearColor(0.8, 0.8, 0.6, 1.0);
+            texturedObject.TransferAssetsToFakeGL(&fakeGL);
+
+            // unlit, Gouraud & Phong, each with & without texture & depth test
+            for (const std::pair<long, long> &size : sizes)
+                for (int shading = 0; shading < 3; shading++)
+                    for (int texture = 0; texture < 2; texture++)
+                        for (int depth = 0; depth < 2; depth++)
+                            for (unsigned int threads : threadCounts)
+                                { // per configuration
+                                BenchConfig config = { shading > 0, shading == 2, texture == 1, depth == 1, size.first, size.second, threads };
+                                BenchResult r = RunConfig(fakeGL, texturedObject, objectName, config, nFrames, nWarmup);
+                                results.push_back(r);
+
+                                std::string configName = std::string(shading == 0 ? "unlit" : shading == 1 ? "gouraud" : "phong")
+                                                       + (texture ? "+tex" : "") + (depth ? "+z" : "");
+                                std::string sizeName = std::to_string(size.first) + "x" + std::to_string(size.second);
+                                printf("%-32s %9zu %-14s %9s %3u %9.2f %9.2f %9.2f %9.2f %11.3g %11.3g %9.1f %9.1f MB\n",
+                                       objectName.c_str(), r.triangles, configName.c_str(), sizeName.c_str(), threads,
+                                       r.meanTime, r.p50Time, r.p90Time, r.p99Time, r.trianglesPerSecond, r.fragmentsPerSecond,
+                                       r.memoryGrowthKB / 1024.0, r.processPeakMemoryKB / 1024.0);
+                                fflush(stdout);
+                                } // per configuration
+            } // per object
+        } // run corpus
+
+    // the microbenchmarks
+    std::vector<MicroResult> microResults;
+    if (runMicro)
+        { // run micro
+        microResults = RunMicrobenchmarks();
+        printf("%-40s %10s %14s\n", "microbenchmark", "ns/item", "items/s");
+        for (const MicroResult &r : microResults)
+            printf("%-40s %10.3f %14.4g %s\n", r.name.c_str(), r.nanosecondsPerItem, 1.0e9 / r.nanosecondsPerItem, r.unit.c_str());
+        } // run micro
+
+    // and the files
+    bool written = true;
+    if (!jsonName.empty())
+        written = WriteJSON(jsonName, results, microResults) && written;
+    if (!csvName.empty())
+        written = WriteCSV(csvName, results) && written;
+    if (!microCSVName.empty())
+        written = WriteMicroCSV(microCSVName, microResults) && written;
+    if (!written)
+        { // write failed
+        std::cout << "Writing the results failed" << std::endl;
+        return 1;
+        } // write failed
+
+    return 0;
+    } // main()
@@ -0,0 +1,388 @@
+////////////////////////////////////////////////////////////////////////
+//
+//  -----------------------------
+//  FakeGLCli.cpp
+//  -----------------------------
+//
+//  Headless renderer: loads an object, sets up the render parameters
+//  from the command line & renders frames with FakeGL alone, writing
+//  images & timings.  Built by fakegl_cli.pro without Qt or OpenGL,
+//  so that it runs on machines without a display or a GPU.
+//
+////////////////////////////////////////////////////////////////////////
+
+// system libraries
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <math.h>
+
+// local includes
+#include "FakeGL.h"
+#include "FakeGLScene.h"
+#include "TexturedObject.h"
+#include "RenderParameters.h"
+#include "TiledRenderer.h"
+
+// default image size
+#define CLI_DEFAULT_WIDTH 800
+#define CLI_DEFAULT_HEIGHT 600
+
+// prints the options
+static void PrintUsage(const char *programName)
+    { // PrintUsage()
+    std::cout << "Usage: " << programName << " [options] geometry.obj [texture.ppm]" << std::endl
+              << "Image:" << std::endl
+              << "  -size W H           image size (default " << CLI_DEFAULT_WIDTH << " " << CLI_DEFAULT_HEIGHT << ")" << std::endl
+              << "  -frames N           number of frames to render (default 1)" << std::endl
+              << "  -output NAME        frames to write: a printf pattern ending in .ppm or .qoi" << std::endl
+              << "                      (e.g. frame%04d.ppm), or a single .y4m stream" << std::endl
+              << "  -timings FILE       per-frame render times as CSV" << std::endl
+              << "  -tile SIZE          render one frame in tiles of SIZE pixels to -output (a .ppm);" << std::endl
+              << "                      used anyway when the image is larger than " << MAX_IMAGE_DIMENSION << std::endl
+              << "  -threads N          threads for tiled rendering (default: all)" << std::endl
+              << "View:" << std::endl
+              << "  -rotate X Y Z DEG   rotate the object about the axis (X, Y, Z)" << std::endl
+              << "  -spin DEG           further rotation about the vertical axis per frame" << std::endl
+              << "  -translate X Y      visual translation" << std::endl
+              << "  -zoom S             zoom scale (default 1)" << std::endl
+              << "  -light X Y Z        light direction (default 0 0 1)" << std::endl
+              << "  -grid N             draw an N x N grid of copies of the object as a scene," << std::endl
+              << "                      culled through its bounding volume hierarchy" << std::endl
+              << "  -pick X Y           after the last frame, report what is drawn at pixel (X, Y)," << std::endl
+              << "                      counted from the bottom left" << std::endl
+              << "Rendering:" << std::endl
+              << "  -lighting -phong -depth -texture -modulate -uvw -axes -cull" << std::endl
+              << "                      switch on the corresponding render parameter" << std::endl
+              << "  -shadows            ray-traced shadows from the light, traced at the vertices" << std::endl
+              << "  -pixelshadows       ray-traced shadows, traced at every pixel" << std::endl
+              << "  -shadowmap          shadows from a cached shadow map, at the vertices or with" << std::endl
+              << "                      -pixelshadows at every pixel" << std::endl
+              << "  -impostors          draw the copies of a -grid that are small on screen as cached" << std::endl
+              << "                      impostors, captured once per view direction" << std::endl
+              << "  -occlusion          with -depth, skip the copies of a -grid & the parts of them" << std::endl
+              << "                      hidden behind the nearest copies" << std::endl
+              << "  -emissive V -ambient V -diffuse V -specular V -shininess E" << std::endl
+              << "                      lighting parameters" << std::endl
+              << "  -lod PIXELS         largest level of detail error on screen (0 for the full mesh)" << std::endl
+              << "  -quantise           use the compact vertex format" << std::endl
+              << "  -nocache            don't read or write the binary mesh cache" << std::endl;
+    } // PrintUsage()
+
+// true if the string ends with the suffix
+static bool EndsWith(const std::string &string, const std::string &suffix)
+    { // EndsWith()
+    return (string.size() >= suffix.size()) && (string.compare(string.size() - suffix.size(), suffix.size(), suffix) == 0);
+    } // EndsWith()
+
+// main routine
+int main(int argc, char **argv)
+    { // main()
+    // everything the command line can set
+    RenderParameters renderParameters;
+    long width = CLI_DEFAULT_WIDTH, height = CLI_DEFAULT_HEIGHT;
+    long nFrames = 1;
+    long tileSize = 0;
+    long nThreads = 0;
+    long gridSize = 0;
+    bool picking = false;
+    float pickX = 0.0, pickY = 0.0;
+    float spinDegrees = 0.0;
+    bool quantise = false;
+    bool useCache = true;
+    std::string outputName, timingsName;
+    std::vector<const char *> fileNames;
+
+    // headless renders are of the object, centred & scaled to fit
+    renderParameters.showObject = true;
+    renderParameters.centreObject = true;
+    renderParameters.scaleObject = true;
+
+    // walk through the arguments
+    for (int arg = 1; arg < argc; arg++)
+        { // per argument
+        std::string option(argv[arg]);
+        // the number of values the option still has available
+        int nValues = argc - arg - 1;
+
+        if ((option == "-size") && (nValues >= 2))
+            { // size
+            width = atol(argv[++arg]);
+            height = atol(argv[++arg]);
+            } // size
+        else if ((option == "-frames") && (nValues >= 1))
+            nFrames = atol(argv[++arg]);
+        else if ((option == "-output") && (nValues >= 1))
+            outputName = argv[++arg];
+        else if ((option == "-timings") && (nValues >= 1))
+            timingsName = argv[++arg];
+        else if ((option == "-tile") && (nValues >= 1))
+            tileSize = atol(argv[++arg]);
+        else if ((option == "-threads") && (nValues >= 1))
+            nThreads = atol(argv[++arg]);
+        else if ((option == "-rotate") && (nValues >= 4))
+            { // rotate
+            Cartesian3 axis(atof(argv[arg + 1]), atof(argv[arg + 2]), atof(argv[arg + 3]));
+            renderParameters.rotationMatrix.SetRotation(axis, atof(argv[arg + 4]) * M_PI / 180.0);
+            arg += 4;
+            } // rotate
+        else if ((option == "-spin") && (nValues >= 1))
+            spinDegrees = atof(argv[++arg]);
+        else if ((option == "-translate") && (nValues >= 2))
+            { // translate
+            renderParameters.xTranslate = atof(argv[++arg]);
+            renderParameters.yTranslate = atof(argv[++arg]);
+            } // translate
+        else if ((option == "-zoom") && (nValues >= 1))
+            renderParameters.zoomScale = atof(argv[++arg]);
+        else if ((option == "-grid") && (nValues >= 1))
+            gridSize = atol(argv[++arg]);
+        else if ((option == "-pick") && (nValues >= 2))
+            { // pick
+            picking = true;
+            pickX = atof(argv[++arg]);
+            pickY = atof(argv[++arg]);
+            } // pick
+        else if ((option == "-light") && (nValues >= 3))
+            { // light
+            for (int coord = 0; coord < 3; coord++)
+                renderParameters.lightPosition[coord] = atof(argv[++arg]);
+            } // light
+        else if (option == "-lighting")
+            renderParameters.useLighting = true;
+        else if (option == "-phong")
+            renderParameters.phongShadingOn = true;
+        else if (option == "-depth")
+            renderParameters.depthTestOn = true;
+        else if (option == "-texture")
+            renderParameters.texturedRendering = true;
+        else if (option == "-modulate")
+            renderParameters.textureModulation = true;
+        else if (option == "-uvw")
+            renderParameters.mapUVWToRGB = true;
+        else if (option == "-axes")
+            renderParameters.showAxes = true;
+        else if (option == "-cull")
+            renderParameters.cullBackFaces = true;
+        else if (option == "-shadows")
+            renderParameters.shadowsOn = true;
+        else if (option == "-pixelshadows")
+            renderParameters.shadowsOn = renderParameters.perPixelShadows = true;
+        else if (option == "-shadowmap")
+            renderParameters.shadowsOn = renderParameters.shadowMapOn = true;
+        else if (option == "-impostors")
+            renderParameters.impostorsOn = true;
+        else if (option == "-occlusion")
+            renderParameters.occlusionCullingOn = true;
+        else if ((option == "-emissive") && (nValues >= 1))
+            renderParameters.emissiveLight = atof(argv[++arg]);
+        else if ((option == "-ambient") && (nValues >= 1))
+            renderParameters.ambientLight = atof(argv[++arg]);
+        else if ((option == "-diffuse") && (nValues >= 1))
+            renderParameters.diffuseLight = atof(argv[++arg]);
+        else if ((option == "-specular") && (nValues >= 1))
+            renderParameters.specularLight = atof(argv[++arg]);
+        else if ((option == "-shininess") && (nValues >= 1))
+            renderParameters.specularExponent = atof(argv[++arg]);
+        else if ((option == "-lod") && (nValues >= 1))
+            renderParameters.lodPixelError = atof(argv[++arg]);
+        else if (option == "-quantise")
+            quantise = true;
+        else if (option == "-nocache")
+            useCache = false;
+        else if ((option.size() > 1) && (option[0] == '-'))
+            { // bad option
+            std::cout << "Unknown option or missing value: " << option << std::endl;
+            PrintUsage(argv[0]);
+            return 1;
+            } // bad option
+        else
+            fileNames.push_back(argv[arg]);
+        } // per argument
+
+    // check that we have something sensible to do
+    if ((fileNames.size() < 1) || (fileNames.size() > 2) || (width < 1) || (height < 1) || (nFrames < 1))
+        { // bad arguments
+        PrintUsage(argv[0]);
+        return 1;
+        } // bad arguments
+
+    // images beyond the frame buffer limit can only be rendered in tiles
+    bool tiled = (tileSize > 0) || (width > MAX_IMAGE_DIMENSION) || (height > MAX_IMAGE_DIMENSION);
+    if (tiled && (outputName.empty() || (nFrames != 1) || !EndsWith(outputName, ".ppm")))
+        { // bad tiled arguments
+        std::cout << "Tiled rendering writes a single frame, and needs a .ppm -output" << std::endl;
+        return 1;
+        } // bad tiled arguments
+
+    // the texture is optional
+    std::ifstream textureFile;
+    if (fileNames.size() > 1)
+        { // texture given
+        textureFile.open(fileNames[1], std::ios::binary);
+        if (!textureFile.good())
+            { // texture open failed
+            std::cout << "Read failed for texture " << fileNames[1] << std::endl;
+            return 1;
+            } // texture open failed
+        } // texture given
+
+    // read the object, timing it since load time matters on the farm too
+    TexturedObject texturedObject;
+    auto loadStart = std::chrono::steady_clock::now();
+    if (!texturedObject.ReadObjectFile(fileNames[0], textureFile, useCache))
+        { // object read failed
+        std::cout << "Read failed for object " << fileNames[0] << std::endl;
+        return 1;
+        } // object read failed
+    if (quantise)
+        texturedObject.QuantiseMesh();
+    double loadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+    std::cout << "Loaded " << fileNames[0] << " in " << loadTime << " ms: "
+              << texturedObject.meshLevels[0].triangleCount() << " triangles, "
+              << texturedObject.meshLevels.size() << " levels of detail" << std::endl;
+
+    // a grid of copies fills the same unit sphere the single object would, one copy per cell
+    Scene scene;
+    for (long row = 0; row < gridSize; row++)
+        for (long column = 0; column < gridSize; column++)
+            { // per copy
+            Matrix4 cell, shrink, centre;
+            cell.SetTranslation(Cartesian3(2.0 * (column + 0.5) / gridSize - 1.0, 2.0 * (row + 0.5) / gridSize - 1.0, 0.0));
+            shrink.SetScale(1.0 / (gridSize * texturedObject.objectSize), 1.0 / (gridSize * texturedObject.objectSize), 1.0 / (gridSize * texturedObject.objectSize));
+            centre.SetTranslation(-1.0 * texturedObject.centreOfGravity);
+            scene.add(&texturedObject, cell * shrink * centre);
+            } // per copy
+    Scene *paintScene = gridSize > 0 ? &scene : NULL;
+
+    // shared by every tile's thread, so they live as long as the rendering
+    ShadowTracer shadowTracer;
+    ShadowMap shadowMap;
+    ImpostorCache impostorCache;
+
+    // set up the context as the render widget does
+    FakeGL fakeGL;
+    fakeGL.Enable(FAKEGL_LIGHTING);
+    fakeGL.ClearColor(0.8, 0.8, 0.6, 1.0);
+    texturedObject.TransferAssetsToFakeGL(&fakeGL);
+
+    // a poster is a single frame streamed to disk in strips
+    if (tiled)
+        { // tiled
+        std::ofstream outFile(outputName, std::ios::binary);
+        TiledRenderer tiledRenderer(width, height, tileSize > 0 ? tileSize : 1024, nThreads);
+        auto frameStart = std::chrono::steady_clock::now();
+        bool rendered = outFile.good() && tiledRenderer.render(fakeGL, [&](FakeGL &tileGL)
+            { // scene
+            FakeGLScene::SetProjection(&tileGL, width, height);
+            FakeGLScene::Paint(&tileGL, &texturedObject, &renderParameters, paintScene, &shadowTracer, &shadowMap, &impostorCache);
+            }, outFile); // scene
+        double frameTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+        if (!rendered)
+            { // render failed
+            std::cout << "Tiled render to " << outputName << " failed" << std::endl;
+            return 1;
+            } // render failed
+        std::cout << "Rendered " << width << "x" << height << " in tiles to " << outputName << " in " << frameTime << " ms" << std::endl;
+        return 0;
+        } // tiled
+
+    fakeGL.Viewport(0, 0, width, height);
+    fakeGL.frameBuffer.Resize(width, height);
+    FakeGLScene::SetProjection(&fakeGL, width, height);
+
+    // the format follows from the name of the output
+    if (!outputName.empty())
+        { // capturing
+        unsigned int format = FAKEGL_CAPTURE_PPM;
+        if (EndsWith(outputName, ".qoi"))
+            format = FAKEGL_CAPTURE_QOI;
+        else if (EndsWith(outputName, ".y4m"))
+            format = FAKEGL_CAPTURE_Y4M;
+        else if (!EndsWith(outputName, ".ppm"))
+            { // unknown format
+            std::cout << "Output must end in .ppm, .qoi or .y4m: " << outputName << std::endl;
+            return 1;
+            } // unknown format
+        if (!fakeGL.BeginCapture(outputName.c_str(), format))
+            { // capture failed
+            std::cout << "Can't write frames to " << outputName << std::endl;
+            return 1;
+            } // capture failed
+        } // capturing
+
+    // render the frames, spinning the object about the vertical axis
+    Matrix4 startRotation = renderParameters.rotationMatrix;
+    std::vector<double> frameTimes(nFrames);
+    auto runStart = std::chrono::steady_clock::now();
+    for (long frame = 0; frame < nFrames; frame++)
+        { // per frame
+        Matrix4 spin;
+        spin.SetRotation(Cartesian3(0.0, 1.0, 0.0), frame * spinDegrees * M_PI / 180.0);
+        renderParameters.rotationMatrix = spin * startRotation;
+
+        auto frameStart = std::chrono::steady_clock::now();
+        FakeGLScene::Paint(&fakeGL, &texturedObject, &renderParameters, paintScene, &shadowTracer, &shadowMap, &impostorCache);
+        frameTimes[frame] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+
+        // the writing happens on another thread, so it is not part of the frame time
+        fakeGL.CaptureFrame();
+        } // per frame
+    fakeGL.EndCapture();
+    double runTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - runStart).count();
+
+    // per frame timings for whoever is collecting them
+    if (!timingsName.empty())
+        { // write timings
+        std::ofstream timingsFile(timingsName);
+        timingsFile << "frame,milliseconds" << std::endl;
+        for (long frame = 0; frame < nFrames; frame++)
+            timingsFile << frame << "," << frameTimes[frame] << std::endl;
+        if (!timingsFile.good())
+            { // write failed
+            std::cout << "Write failed for timings " << timingsName << std::endl;
+            return 1;
+            } // write failed
+        } // write timings
+
+    // and a summary
+    double totalTime = 0.0;
+    for (double frameTime : frameTimes)
+        totalTime += frameTime;
+    std::cout << "Rendered " << nFrames << " frames of " << width << "x" << height << ": mean "
+              << totalTime / nFrames << " ms, min " << *std::min_element(frameTimes.begin(), frameTimes.end())
+              << " ms, max " << *std::max_element(frameTimes.begin(), frameTimes.end()) << " ms ("
+              << 1000.0 * nFrames / runTime << " frames per second including output)" << std::endl;
+    if (renderParameters.shadowsOn && renderParameters.shadowMapOn)
+        std::cout << "Shadow map drawn " << shadowMap.getRenderCount() << " times" << std::endl;
+    if (renderParameters.impostorsOn)
+        std::cout << "Impostors: " << impostorCache.getCaptures() << " captured, " << impostorCache.getHits() << " reused, "
+                  << impostorCache.getEvictions() << " evicted, " << impostorCache.size() << " cached in "
+                  << impostorCache.getBytes() / 1024 << " KB" << std::endl;
+    if (renderParameters.occlusionCullingOn && (paintScene != NULL))
+        std::cout << "Occlusion culling hid " << scene.getOccludedCount() << " of " << scene.size()
+                  << " objects in the last frame" << std::endl;
+
+    // and what is under the requested pixel
+    if (picking)
+        { // pick
+        FakeGLScene::PickResult pick;
+        auto pickStart = std::chrono::steady_clock::now();
+        bool hit = FakeGLScene::Pick(&fakeGL, &texturedObject, &renderParameters, pickX, pickY, pick, paintScene);
+        double pickTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pickStart).count();
+        if (hit)
+            std::cout << "Picked object " << pick.sceneID << " triangle " << pick.triangle << " at (" << pick.u << ", " << pick.v
+                      << "), position " << pick.position << ", depth " << pick.depth << " in " << pickTime << " ms" << std::endl;
+        else
+            std::cout << "Picked nothing in " << pickTime << " ms" << std::endl;
+        } // pick
+
+    return 0;
+    } // main()
@@ -89,22 +89,8 @@ void FakeGLRenderWidget::resizeGL(int w, int h)
     // resize the render image
     fakeGL.frameBuffer.Resize(w, h);
 
-    // set projection matrix to be fakeGL.Ortho based on zoom & window size
-    fakeGL.MatrixMode(FAKEGL_PROJECTION);
-    fakeGL.LoadIdentity();
-    
-    // compute the aspect ratio of the widget
-    float aspectRatio = (float) w / (float) h;
-    
-    // we want to capture a sphere of radius 1.0 without distortion
-    // so we set the ortho projection based on whether the window is portrait (> 1.0) or landscape
-    // portrait ratio is wider, so make bottom & top -1.0 & 1.0
-    if (aspectRatio > 1.0)
-        fakeGL.Ortho(-aspectRatio, aspectRatio, -1.0, 1.0, -1.0, 1.0);
-    // otherwise, make left & right -1.0 & 1.0
-    else
-        fakeGL.Ortho(-1.0, 1.0, -1.0/aspectRatio, 1.0/aspectRatio, -1.0, 1.0);
-
+    // and the projection to match
+    FakeGLScene::SetProjection(&fakeGL, w, h);
     } // FakeGLRenderWidget::resizeGL()
     
 // called every time the widget needs painting
@@ -125,113 +111,18 @@ void FakeGLRenderWidget::paintGL()
 // routine that runs the fake GL library
 void FakeGLRenderWidget::paintFakeGL()
 { // FakeGLRenderWidget::paintFakeGL()
-// enable depth-buffering
-
-    if (renderParameters->depthTestOn)
-        fakeGL.Enable(FAKEGL_DEPTH_TEST);
-    else
-        fakeGL.Disable(FAKEGL_DEPTH_TEST);
-
-    // clear the buffer
-    fakeGL.Clear(FAKEGL_COLOR_BUFFER_BIT | (renderParameters->depthTestOn ? FAKEGL_DEPTH_BUFFER_BIT: 0));
-
-    // set model view matrix based on stored translation, rotation &c.
-    fakeGL.MatrixMode(FAKEGL_MODELVIEW);
-    fakeGL.LoadIdentity();
-
-    // start with lighting turned off
-    fakeGL.Disable(FAKEGL_LIGHTING);
-
-    // if lighting is turned on
-    if (renderParameters->useLighting)
-        { // use lighting
-        // make sure lighting is on
-        fakeGL.Enable(FAKEGL_LIGHTING);
-
-        // set light position first, pushing/popping matrix so that it the transformation does
-        // not affect the position of the geometric object
-        fakeGL.PushMatrix();
-        fakeGL.MultMatrixf(renderParameters->lightMatrix.columnMajor().coordinates);
-        fakeGL.Light(FAKEGL_POSITION, renderParameters->lightPosition);
-        fakeGL.PopMatrix();
-
-        // now set the lighting parameters (assuming all light is white)
-        float ambientColour[4];
-        float diffuseColour[4];
-        float specularColour[4];
-
-        // now copy the parameters
-        ambientColour[0]    = ambientColour[1]  = ambientColour[2]  = renderParameters->ambientLight;
-        diffuseColour[0]    = diffuseColour[1]  = diffuseColour[2]  = renderParameters->diffuseLight;
-        specularColour[0]   = specularColour[1] = specularColour[2] = renderParameters->specularLight;
-        ambientColour[3]    = diffuseColour[3]  = specularColour[3] = 1.0; // don't forget alpha
-
-        // and set them in OpenGL
-        fakeGL.Light(FAKEGL_AMBIENT,    ambientColour);
-        fakeGL.Light(FAKEGL_DIFFUSE,    diffuseColour);
-        fakeGL.Light(FAKEGL_SPECULAR,   specularColour);
-
-        // notice that emission and the specular exponent belong to the material
-        // not to the light. So, even though we are treating them as global,
-        // they belong in the TexturedObject render code
-
-        // test for Phong shading
-        if (renderParameters->phongShadingOn)
-            fakeGL.Enable(FAKEGL_PHONG_SHADING);
-        else
-            fakeGL.Disable(FAKEGL_PHONG_SHADING);
-        } // use lighting
-
-    // translate by the visual translation
-    fakeGL.Translatef(renderParameters->xTranslate, renderParameters->yTranslate, 0.0f);
-
-    // apply rotation matrix from arcball
-    fakeGL.MultMatrixf(renderParameters->rotationMatrix.columnMajor().coordinates);
-
-    // now we start using the render parameters
-    if (renderParameters->showAxes)
-        { // show axes
-        // start with lighting turned off
-        fakeGL.Disable(FAKEGL_LIGHTING);
-
-        // set the lines to be obvious in width
-        fakeGL.LineWidth(4.0);
-
-        // now draw one line for each axis in different colours
-        fakeGL.Begin(FAKEGL_LINES);
-
-        // X axis is red
-        fakeGL.Color3f(1.0, 0.0, 0.0);
-        fakeGL.Vertex3f(0.0, 0.0, 0.0);
-        fakeGL.Vertex3f(1.0, 0.0, 0.0);
-
-        // Y axis is green
-        fakeGL.Color3f(0.0, 1.0, 0.0);
-        fakeGL.Vertex3f(0.0, 0.0, 0.0);
-        fakeGL.Vertex3f(0.0, 1.0, 0.0);
-
-        // Z axis is red
-        fakeGL.Color3f(0.0, 0.0, 1.0);
-        fakeGL.Vertex3f(0.0, 0.0, 0.0);
-        fakeGL.Vertex3f(0.0, 0.0, 1.0);
-
-        // now reset the color, just in case
-        fakeGL.Color3f(1.0, 1.0, 1.0);
-        fakeGL.End();
-
-        // reset lighting on if needed
-        if (renderParameters->useLighting)
-            fakeGL.Enable(FAKEGL_LIGHTING);
-        } // show axes
-
-    // tell the object to draw itself,
-    // passing in the render parameters for reference
-    if (renderParameters->showObject)
-        texturedObject->FakeGLRender(renderParameters, &fakeGL);
-
-
+    // the scene itself doesn't need Qt, so that it can also be rendered headless
+    FakeGLScene::Paint(&fakeGL, texturedObject, renderParameters, NULL, &shadowTracer, &shadowMap);
 } // FakeGLRenderWidget::paintFakeGL()
 
+// picks what is drawn at a widget position, given as mouse events give it
+bool FakeGLRenderWidget::PickAt(int x, int y, FakeGLScene::PickResult &result)
+    { // FakeGLRenderWidget::PickAt()
+    // the frame buffer is drawn with its first row at the bottom of the widget, while
+    // mouse events count rows from the top. FakeGL samples pixels at their integer positions
+    return FakeGLScene::Pick(&fakeGL, texturedObject, renderParameters, x, fakeGL.frameBuffer.height - 1 - y, result);
+    } // FakeGLRenderWidget::PickAt()
+
 // mouse-handling
 void FakeGLRenderWidget::mousePressEvent(QMouseEvent *event)
     { // FakeGLRenderWidget::mousePressEvent()
@@ -49,6 +49,8 @@
 
 // and most particularly our fake GL library
 #include "FakeGL.h"
+// with the scene it renders
+#include "FakeGLScene.h"
 
 // class for a render widget with arcball linked to an external arcball widget
 class FakeGLRenderWidget : public QOpenGLWidget										
@@ -64,6 +66,10 @@ class FakeGLRenderWidget : public QOpenGLWidget
 	// the fakeGL context to use when rendering
 	FakeGL fakeGL;
 
+	// and what casts its shadows
+	ShadowTracer shadowTracer;
+	ShadowMap shadowMap;
+
 	public:
 	// constructor
 	FakeGLRenderWidget
@@ -78,6 +84,10 @@ class FakeGLRenderWidget : public QOpenGLWidget
 	
 	// destructor
 	~FakeGLRenderWidget();
+
+	// picks what is drawn at a widget position, given as mouse events give it
+	// returns false if nothing is there
+	bool PickAt(int x, int y, FakeGLScene::PickResult &result);
 			
 	protected:
 	// called when OpenGL context is set up
@@ -0,0 +1,251 @@
+#include "FakeGLScene.h"
+
+// sets an orthographic projection that fits the unit sphere into a width x height image
+void FakeGLScene::SetProjection(FakeGL *fakeGL, int width, int height)
+    { // SetProjection()
+    // set projection matrix to be an Ortho based on the image size
+    fakeGL->MatrixMode(FAKEGL_PROJECTION);
+    fakeGL->LoadIdentity();
+    
+    // compute the aspect ratio of the image
+    float aspectRatio = (float) width / (float) height;
+    
+    // we want to capture a sphere of radius 1.0 without distortion
+    // so we set the ortho projection based on whether the window is portrait (> 1.0) or landscape
+    // portrait ratio is wider, so make bottom & top -1.0 & 1.0
+    if (aspectRatio > 1.0)
+        fakeGL->Ortho(-aspectRatio, aspectRatio, -1.0, 1.0, -1.0, 1.0);
+    // otherwise, make left & right -1.0 & 1.0
+    else
+        fakeGL->Ortho(-1.0, 1.0, -1.0/aspectRatio, 1.0/aspectRatio, -1.0, 1.0);
+    } // SetProjection()
+
+// clears & renders one frame: lights, axes & the object (or scene), as set in the render parameters
+void FakeGLScene::Paint(FakeGL *fakeGL, TexturedObject *texturedObject, RenderParameters *renderParameters, Scene *scene,
+                        ShadowTracer *shadowTracer, ShadowMap *shadowMap, ImpostorCache *impostorCache)
+    { // Paint()
+    // enable depth-buffering
+    if (renderParameters->depthTestOn)
+        fakeGL->Enable(FAKEGL_DEPTH_TEST);
+    else
+        fakeGL->Disable(FAKEGL_DEPTH_TEST);
+
+    // and back face culling, which also lets whole meshlets be skipped
+    if (renderParameters->cullBackFaces)
+        fakeGL->Enable(FAKEGL_CULL_FACE);
+    else
+        fakeGL->Disable(FAKEGL_CULL_FACE);
+
+    // clear the buffer
+    fakeGL->Clear(FAKEGL_COLOR_BUFFER_BIT | (renderParameters->depthTestOn ? FAKEGL_DEPTH_BUFFER_BIT: 0));
+
+    // set model view matrix based on stored translation, rotation &c.
+    fakeGL->MatrixMode(FAKEGL_MODELVIEW);
+    fakeGL->LoadIdentity();
+
+    // start with lighting turned off
+    fakeGL->Disable(FAKEGL_LIGHTING);
+
+    // if lighting is turned on
+    if (renderParameters->useLighting)
+        { // use lighting
+        // make sure lighting is on
+        fakeGL->Enable(FAKEGL_LIGHTING);
+
+        // set light position first, pushing/popping matrix so that it the transformation does
+        // not affect the position of the geometric object
+        fakeGL->PushMatrix();
+        fakeGL->MultMatrixf(renderParameters->lightMatrix.columnMajor().coordinates);
+        fakeGL->Light(FAKEGL_POSITION, renderParameters->lightPosition);
+        fakeGL->PopMatrix();
+
+        // now set the lighting parameters (assuming all light is white)
+        float ambientColour[4];
+        float diffuseColour[4];
+        float specularColour[4];
+
+        // now copy the parameters
+        ambientColour[0]    = ambientColour[1]  = ambientColour[2]  = renderParameters->ambientLight;
+        diffuseColour[0]    = diffuseColour[1]  = diffuseColour[2]  = renderParameters->diffuseLight;
+        specularColour[0]   = specularColour[1] = specularColour[2] = renderParameters->specularLight;
+        ambientColour[3]    = diffuseColour[3]  = specularColour[3] = 1.0; // don't forget alpha
+
+        // and set them in OpenGL
+        fakeGL->Light(FAKEGL_AMBIENT,    ambientColour);
+        fakeGL->Light(FAKEGL_DIFFUSE,    diffuseColour);
+        fakeGL->Light(FAKEGL_SPECULAR,   specularColour);
+
+        // notice that emission and the specular exponent belong to the material
+        // not to the light. So, even though we are treating them as global,
+        // they belong in the TexturedObject render code
+
+        // test for Phong shading
+        if (renderParameters->phongShadingOn)
+            fakeGL->Enable(FAKEGL_PHONG_SHADING);
+        else
+            fakeGL->Disable(FAKEGL_PHONG_SHADING);
+        } // use lighting
+
+    // translate by the visual translation
+    fakeGL->Translatef(renderParameters->xTranslate, renderParameters->yTranslate, 0.0f);
+
+    // apply rotation matrix from arcball
+    fakeGL->MultMatrixf(renderParameters->rotationMatrix.columnMajor().coordinates);
+
+    // shadows are cast by whatever is drawn, placed as it will be drawn
+    ShadowSource *shadowSource = NULL;
+    if (renderParameters->useLighting && renderParameters->shadowsOn && renderParameters->showObject)
+        { // shadows
+        // the view takes the casters' own coordinates, the world for a scene, to the eye
+        Matrix4 view = fakeGL->stateMechine.modelViewMatrixStack.top();
+        if (scene != NULL)
+            { // scene
+            Matrix4 zoom;
+            zoom.SetScale(renderParameters->zoomScale, renderParameters->zoomScale, renderParameters->zoomScale);
+            view = view * zoom;
+            scene->update();
+            } // scene
+        else
+            view = view * texturedObject->FakeGLPlacement(renderParameters);
+
+        if (renderParameters->shadowMapOn && (shadowMap != NULL))
+            { // shadow map
+            // the map is only drawn again if the light has moved relative to the casters, or they have changed
+            Matrix4 identity;
+            identity.SetIdentity();
+            shadowMap->clear();
+            if (scene != NULL)
+                shadowMap->add(*scene);
+            else
+                shadowMap->add(texturedObject->bvh, identity);
+            shadowMap->update(fakeGL->stateMechine.light.getPosition(), view);
+            shadowSource = shadowMap;
+            } // shadow map
+        else if (shadowTracer != NULL)
+            { // ray tracing
+            shadowTracer->clear();
+            if (scene != NULL)
+                shadowTracer->add(*scene, view);
+            else
+                shadowTracer->add(texturedObject->bvh, view);
+            shadowSource = shadowTracer;
+            } // ray tracing
+        } // shadows
+
+    if (shadowSource != NULL)
+        { // shadow term
+        fakeGL->Shadows(shadowSource);
+        fakeGL->ShadowMode(renderParameters->perPixelShadows ? FAKEGL_PER_PIXEL : FAKEGL_PER_VERTEX);
+        fakeGL->Enable(FAKEGL_SHADOWS);
+        } // shadow term
+    else
+        fakeGL->Disable(FAKEGL_SHADOWS);
+
+    // now we start using the render parameters
+    if (renderParameters->showAxes)
+        { // show axes
+        // start with lighting turned off
+        fakeGL->Disable(FAKEGL_LIGHTING);
+
+        // set the lines to be obvious in width
+        fakeGL->LineWidth(4.0);
+
+        // now draw one line for each axis in different colours
+        fakeGL->Begin(FAKEGL_LINES);
+
+        // X axis is red
+        fakeGL->Color3f(1.0, 0.0, 0.0);
+        fakeGL->Vertex3f(0.0, 0.0, 0.0);
+        fakeGL->Vertex3f(1.0, 0.0, 0.0);
+
+        // Y axis is green
+        fakeGL->Color3f(0.0, 1.0, 0.0);
+        fakeGL->Vertex3f(0.0, 0.0, 0.0);
+        fakeGL->Vertex3f(0.0, 1.0, 0.0);
+
+        // Z axis is red
+        fakeGL->Color3f(0.0, 0.0, 1.0);
+        fakeGL->Vertex3f(0.0, 0.0, 0.0);
+        fakeGL->Vertex3f(0.0, 0.0, 1.0);
+
+        // now reset the color, just in case
+        fakeGL->Color3f(1.0, 1.0, 1.0);
+        fakeGL->End();
+
+        // reset lighting on if needed
+        if (renderParameters->useLighting)
+            fakeGL->Enable(FAKEGL_LIGHTING);
+        } // show axes
+
+    // tell the object to draw itself,
+    // passing in the render parameters for reference
+    if (renderParameters->showObject && (scene != NULL))
+        scene->render(*fakeGL, *renderParameters, renderParameters->impostorsOn ? impostorCache : NULL);
+    else if (renderParameters->showObject)
+        texturedObject->FakeGLRender(renderParameters, fakeGL);
+    } // Paint()
+
+// finds the nearest triangle that Paint() would draw at a window position
+bool FakeGLScene::Pick(FakeGL *fakeGL, TexturedObject *texturedObject, RenderParameters *renderParameters,
+                       float x, float y, PickResult &result, Scene *scene)
+    { // Pick()
+    // nothing to hit if the object isn't drawn
+    if (!renderParameters->showObject)
+        return false;
+
+    // the modelview Paint() builds up to the object or scene
+    Matrix4 translation, placement;
+    translation.SetTranslation(Cartesian3(renderParameters->xTranslate, renderParameters->yTranslate, 0.0f));
+    if (scene != NULL)
+        placement.SetScale(renderParameters->zoomScale, renderParameters->zoomScale, renderParameters->zoomScale);
+    else
+        placement = texturedObject->FakeGLPlacement(renderParameters);
+    Matrix4 modelViewProjection = fakeGL->stateMechine.projectionMatrixStack.top() * translation * renderParameters->rotationMatrix * placement;
+    Matrix4 inverseModelViewProjection = modelViewProjection.inverse();
+
+    // undo the viewport transform to get normalised device coordinates, as normalizeToWindow() sets them
+    const GLViewport &viewport = fakeGL->stateMechine.viewport;
+    int halfWidth = viewport.width >> 1;
+    int halfHeight = viewport.height >> 1;
+    if ((halfWidth == 0) || (halfHeight == 0))
+        return false;
+    float deviceX = (x - (viewport.x + halfWidth)) / halfWidth;
+    float deviceY = (y - (viewport.height - (viewport.y + halfHeight))) / halfHeight;
+
+    // the ray runs from the near plane (t = 0) to the far plane (t = 1)
+    Cartesian3 nearPoint = inverseModelViewProjection * Cartesian3(deviceX, deviceY, -1.0f);
+    Cartesian3 farPoint = inverseModelViewProjection * Cartesian3(deviceX, deviceY, 1.0f);
+    Cartesian3 direction = farPoint - nearPoint;
+
+    // find the hit in the object, or in whichever object of the scene is nearest
+    RayHit hit;
+    if (scene != NULL)
+        { // scene
+        scene->update();
+        if (!scene->intersect(nearPoint, direction, result.sceneID, hit, 1.0f))
+            return false;
+        result.object = scene->getObject(result.sceneID);
+        } // scene
+    else
+        { // single object
+        if (!texturedObject->bvh.intersect(nearPoint, direction, hit, 1.0f))
+            return false;
+        result.object = texturedObject;
+        result.sceneID = 0;
+        } // single object
+
+    // the barycentrics give the hit on the object itself
+    result.triangle = hit.triangle;
+    result.u = hit.u;
+    result.v = hit.v;
+    const std::vector<unsigned int> &corners = result.object->triangleVertices;
+    const std::vector<Cartesian3> &vertices = result.object->vertices;
+    result.position = (1.0f - hit.u - hit.v) * vertices[corners[3 * hit.triangle]]
+                    + hit.u * vertices[corners[3 * hit.triangle + 1]]
+                    + hit.v * vertices[corners[3 * hit.triangle + 2]];
+
+    // and the depth comes from projecting the hit along the ray
+    Cartesian3 device = modelViewProjection * (nearPoint + hit.t * direction);
+    result.depth = ((fakeGL->stateMechine.zFar - fakeGL->stateMechine.zNear) * device.z + (fakeGL->stateMechine.zNear + fakeGL->stateMechine.zFar)) * 0.5f;
+    return true;
+    } // Pick()
@@ -0,0 +1,55 @@
+#ifndef FAKEGLSCENE_H
+#define FAKEGLSCENE_H
+
+#include "FakeGL.h"
+#include "TexturedObject.h"
+#include "RenderParameters.h"
+#include "Scene.h"
+#include "ShadowTracer.h"
+#include "ShadowMap.h"
+#include "ImpostorCache.h"
+
+// the scene the FakeGL render widget shows, without any Qt, so that the
+// same image can be rendered headless (see FakeGLCli.cpp) or in tiles
+namespace FakeGLScene
+    { // namespace FakeGLScene
+    // sets an orthographic projection that fits the unit sphere into a width x height image
+    void SetProjection(FakeGL *fakeGL, int width, int height);
+
+    // clears & renders one frame: lights, axes & the object, as set in the render parameters
+    // given a scene, the scene's visible objects are drawn in place of the object
+    // given a shadow tracer or map, it is refilled with whatever is drawn & used for shadows, if they are on:
+    // it has to outlive any tiled replay of the frame. the map is kept from frame to frame where it can be
+    // given an impostor cache, a scene's distant objects are drawn as impostors if they are on
+    void Paint(FakeGL *fakeGL, TexturedObject *texturedObject, RenderParameters *renderParameters, Scene *scene = NULL,
+               ShadowTracer *shadowTracer = NULL, ShadowMap *shadowMap = NULL, ImpostorCache *impostorCache = NULL);
+
+    // what a pick found at a window position
+    struct PickResult
+        { // struct PickResult
+        // the object hit & its id in the scene, if there was one
+        TexturedObject *object;
+        unsigned int sceneID;
+
+        // the triangle, numbered as in the object's triangle lists, and where on it: the hit is
+        // (1 - u - v) of the first corner, u of the second & v of the third
+        unsigned int triangle;
+        float u, v;
+
+        // the hit in the object's own coordinates
+        Cartesian3 position;
+
+        // and its window depth, as the depth buffer would hold it
+        float depth;
+        }; // struct PickResult
+
+    // finds the nearest triangle that Paint() would draw at a window position, given in pixels from the
+    // bottom left as FakeGL's framebuffer has them (pixels are sampled at their integer positions),
+    // using the viewport & projection set in fakeGL. the full detail mesh is hit, between the near & far planes.
+    // casts one ray through each object's hierarchy, so it is cheap enough to run on every mouse move
+    // returns false if nothing is there
+    bool Pick(FakeGL *fakeGL, TexturedObject *texturedObject, RenderParameters *renderParameters,
+              float x, float y, PickResult &result, Scene *scene = NULL);
+    } // namespace FakeGLScene
+
+#endif // FAKEGLSCENE_H
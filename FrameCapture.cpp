@@ -0,0 +1,306 @@
+#include "FrameCapture.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    //accepts exactly one conversion of the form %[0-9]*d
+    auto isFramePattern(const std::string & pattern) -> bool
+    {
+        int32_t conversions = 0;
+        for(size_t i = 0; i < pattern.size(); i++)
+        {
+            if(pattern[i] != '%')
+                continue;
+            size_t j = i + 1;
+            while(j < pattern.size() && pattern[j] >= '0' && pattern[j] <= '9')
+                j++;
+            if(j == pattern.size() || pattern[j] != 'd')
+                return false;
+            conversions++;
+            i = j;
+        }
+        return conversions == 1;
+    }
+
+    inline auto putBigEndian32(std::vector<char> & out, uint32_t value) -> void
+    {
+        out.push_back(static_cast<char>(value >> 24));
+        out.push_back(static_cast<char>(value >> 16));
+        out.push_back(static_cast<char>(value >> 8));
+        out.push_back(static_cast<char>(value));
+    }
+
+    inline auto clampByte(int32_t value) -> char
+    {
+        return static_cast<char>(value < 0 ? 0 : (value > 255 ? 255 : value));
+    }
+};
+
+FrameCapture::FrameCapture(const std::string & fileName, Format format, uint32_t queueLength)
+    : fileName(fileName), format(format)
+{
+    if(format != Y4M && !isFramePattern(fileName))
+    {
+        std::cerr << "Frame capture pattern " << fileName << " needs exactly one integer conversion such as %04d" << std::endl;
+        failed = true;
+        return;
+    }
+
+    for(uint32_t i = 0; i < std::max(1u, queueLength); i++)
+        freeFrames.emplace_back(new Frame());
+
+    writer = std::thread(&FrameCapture::writerLoop, this);
+}
+
+FrameCapture::~FrameCapture()
+{
+    finish();
+}
+
+auto FrameCapture::good() const -> bool
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return !failed;
+}
+
+auto FrameCapture::submit(const RGBAImage & frame) -> void
+{
+    std::unique_ptr<Frame> buffer;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if(failed || stopping)
+            return;
+        //the only place rendering can stall : every buffer is still queued for the disk
+        frameFree.wait(lock, [this]{ return !freeFrames.empty(); });
+        buffer = std::move(freeFrames.back());
+        freeFrames.pop_back();
+    }
+
+    //copy outside the lock, the buffer keeps its capacity from frame to frame
+    buffer->width = frame.width;
+    buffer->height = frame.height;
+    buffer->index = framesSubmitted++;
+    buffer->pixels.resize(frame.width * frame.height);
+    if(!buffer->pixels.empty())
+        memcpy(static_cast<void *>(buffer->pixels.data()), frame.block, buffer->pixels.size() * sizeof(RGBAValue));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pendingFrames.push_back(std::move(buffer));
+    }
+    frameReady.notify_one();
+}
+
+auto FrameCapture::finish() -> void
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    frameReady.notify_one();
+    if(writer.joinable())
+        writer.join();
+    if(stream.is_open())
+        stream.close();
+}
+
+auto FrameCapture::writerLoop() -> void
+{
+    while(true)
+    {
+        std::unique_ptr<Frame> frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frameReady.wait(lock, [this]{ return stopping || !pendingFrames.empty(); });
+            //drain everything that was queued before we were asked to stop
+            if(pendingFrames.empty())
+                return;
+            frame = std::move(pendingFrames.front());
+            pendingFrames.pop_front();
+        }
+
+        bool written = write(*frame);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!written)
+                failed = true;
+            freeFrames.push_back(std::move(frame));
+        }
+        frameFree.notify_one();
+    }
+}
+
+auto FrameCapture::frameFileName(uint64_t index) const -> std::string
+{
+    std::vector<char> name(fileName.size() + 32);
+    snprintf(name.data(), name.size(), fileName.c_str(), static_cast<int>(index));
+    return name.data();
+}
+
+auto FrameCapture::write(const Frame & frame) -> bool
+{
+    encoded.clear();
+    switch(format)
+    {
+    case PPM:
+        encodePPM(frame);
+        break;
+    case QOI:
+        encodeQOI(frame);
+        break;
+    case Y4M:
+        //a stream has one frame size, set by its first frame
+        if(!stream.is_open())
+        {
+            stream.open(fileName, std::ios::binary | std::ios::trunc);
+            streamWidth = frame.width;
+            streamHeight = frame.height;
+            auto header = "YUV4MPEG2 W" + std::to_string(streamWidth) + " H" + std::to_string(streamHeight) + " F30:1 Ip A1:1 C444\n";
+            stream.write(header.data(), header.size());
+        }
+        if(frame.width != streamWidth || frame.height != streamHeight)
+        {
+            std::cerr << "Frame capture cannot change size within a Y4M stream" << std::endl;
+            return false;
+        }
+        encodeY4M(frame);
+        stream.write(encoded.data(), encoded.size());
+        return stream.good();
+    }
+
+    auto name = frameFileName(frame.index);
+    std::ofstream file(name, std::ios::binary | std::ios::trunc);
+    file.write(encoded.data(), encoded.size());
+    if(!file.good())
+    {
+        std::cerr << "Frame capture failed to write " << name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+auto FrameCapture::encodePPM(const Frame & frame) -> void
+{
+    auto header = "P6\n" + std::to_string(frame.width) + " " + std::to_string(frame.height) + "\n255\n";
+    encoded.reserve(header.size() + frame.width * frame.height * 3);
+    encoded.insert(encoded.end(), header.begin(), header.end());
+    for(long row = frame.height - 1; row >= 0; row--)
+    {
+        auto pixel = frame.pixels.data() + row * frame.width;
+        for(long col = 0; col < frame.width; col++, pixel++)
+        {
+            encoded.push_back(pixel->red);
+            encoded.push_back(pixel->green);
+            encoded.push_back(pixel->blue);
+        }
+    }
+}
+
+//QOI as specified at qoiformat.org, three channels since alpha is not meaningful in the frame buffer
+auto FrameCapture::encodeQOI(const Frame & frame) -> void
+{
+    constexpr uint8_t QOI_OP_INDEX = 0x00;
+    constexpr uint8_t QOI_OP_DIFF = 0x40;
+    constexpr uint8_t QOI_OP_LUMA = 0x80;
+    constexpr uint8_t QOI_OP_RUN = 0xc0;
+    constexpr uint8_t QOI_OP_RGB = 0xfe;
+
+    encoded.reserve(14 + frame.width * frame.height * 4 + 8);
+    encoded.insert(encoded.end(), {'q', 'o', 'i', 'f'});
+    putBigEndian32(encoded, static_cast<uint32_t>(frame.width));
+    putBigEndian32(encoded, static_cast<uint32_t>(frame.height));
+    encoded.push_back(3);
+    encoded.push_back(0);
+
+    struct Pixel { uint8_t r, g, b, a; };
+    Pixel seen[64];
+    memset(seen, 0, sizeof(seen));
+    Pixel previous = {0, 0, 0, 255};
+    int32_t run = 0;
+
+    for(long row = frame.height - 1; row >= 0; row--)
+    {
+        auto source = frame.pixels.data() + row * frame.width;
+        for(long col = 0; col < frame.width; col++, source++)
+        {
+            Pixel pixel = {source->red, source->green, source->blue, 255};
+            if(pixel.r == previous.r && pixel.g == previous.g && pixel.b == previous.b)
+            {
+                if(++run == 62)
+                {
+                    encoded.push_back(static_cast<char>(QOI_OP_RUN | (run - 1)));
+                    run = 0;
+                }
+                continue;
+            }
+            if(run > 0)
+            {
+                encoded.push_back(static_cast<char>(QOI_OP_RUN | (run - 1)));
+                run = 0;
+            }
+
+            auto hash = (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11) % 64;
+            if(seen[hash].r == pixel.r && seen[hash].g == pixel.g && seen[hash].b == pixel.b && seen[hash].a == pixel.a)
+            {
+                encoded.push_back(static_cast<char>(QOI_OP_INDEX | hash));
+            }
+            else
+            {
+                seen[hash] = pixel;
+                int8_t dr = static_cast<int8_t>(pixel.r - previous.r);
+                int8_t dg = static_cast<int8_t>(pixel.g - previous.g);
+                int8_t db = static_cast<int8_t>(pixel.b - previous.b);
+                int8_t drdg = static_cast<int8_t>(dr - dg);
+                int8_t dbdg = static_cast<int8_t>(db - dg);
+                if(dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2)
+                {
+                    encoded.push_back(static_cast<char>(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                }
+                else if(drdg > -9 && drdg < 8 && dg > -33 && dg < 32 && dbdg > -9 && dbdg < 8)
+                {
+                    encoded.push_back(static_cast<char>(QOI_OP_LUMA | (dg + 32)));
+                    encoded.push_back(static_cast<char>((drdg + 8) << 4 | (dbdg + 8)));
+                }
+                else
+                {
+                    encoded.push_back(static_cast<char>(QOI_OP_RGB));
+                    encoded.push_back(static_cast<char>(pixel.r));
+                    encoded.push_back(static_cast<char>(pixel.g));
+                    encoded.push_back(static_cast<char>(pixel.b));
+                }
+            }
+            previous = pixel;
+        }
+    }
+    if(run > 0)
+        encoded.push_back(static_cast<char>(QOI_OP_RUN | (run - 1)));
+
+    encoded.insert(encoded.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+}
+
+//BT.601 studio range, full resolution chroma
+auto FrameCapture::encodeY4M(const Frame & frame) -> void
+{
+    const char marker[] = "FRAME\n";
+    auto planeSize = static_cast<size_t>(frame.width * frame.height);
+    encoded.resize(sizeof(marker) - 1 + planeSize * 3);
+    memcpy(encoded.data(), marker, sizeof(marker) - 1);
+    auto y = encoded.data() + sizeof(marker) - 1;
+    auto u = y + planeSize;
+    auto v = u + planeSize;
+
+    for(long row = frame.height - 1; row >= 0; row--)
+    {
+        auto pixel = frame.pixels.data() + row * frame.width;
+        for(long col = 0; col < frame.width; col++, pixel++)
+        {
+            int32_t r = pixel->red, g = pixel->green, b = pixel->blue;
+            *y++ = clampByte(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            *u++ = clampByte(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            *v++ = clampByte(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include "RGBAImage.h"
+
+//hands finished frames to a background writer thread.
+//frames are copied into a fixed pool of recycled buffers, so submit() only blocks
+//when every buffer is still waiting to be written.
+//frames are written top row first, i.e. flipped from the bottom-up frame buffer.
+
+class FrameCapture
+{
+public:
+    enum Format : uint32_t
+    {
+        //one binary PPM (P6) per frame
+        PPM = 0,
+        //one QOI (lossless, 3 channel) per frame
+        QOI = 1,
+        //every frame into a single YUV4MPEG2 (4:4:4) stream
+        Y4M = 2
+    };
+
+    //for PPM and QOI fileName is a printf pattern with one integer conversion, e.g. "frame%04d.ppm".
+    //for Y4M it is the name of the stream
+    FrameCapture(const std::string & fileName, Format format, uint32_t queueLength);
+    //drains the queue before returning
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture &) = delete;
+    auto operator=(const FrameCapture &) -> FrameCapture & = delete;
+
+    //false if the pattern was rejected or a write has failed
+    auto good() const -> bool;
+
+    //copies the frame into a free buffer and queues it
+    auto submit(const RGBAImage & frame) -> void;
+
+    //waits until every queued frame has been written, then stops the writer
+    auto finish() -> void;
+
+    inline auto getFramesSubmitted() const -> uint64_t { return framesSubmitted; }
+
+private:
+    struct Frame
+    {
+        std::vector<RGBAValue> pixels;
+        long width = 0;
+        long height = 0;
+        uint64_t index = 0;
+    };
+
+    auto writerLoop() -> void;
+    auto write(const Frame & frame) -> bool;
+    auto encodePPM(const Frame & frame) -> void;
+    auto encodeQOI(const Frame & frame) -> void;
+    auto encodeY4M(const Frame & frame) -> void;
+    auto frameFileName(uint64_t index) const -> std::string;
+
+    std::string fileName;
+    Format format;
+    uint64_t framesSubmitted = 0;
+
+    mutable std::mutex mutex;
+    std::condition_variable frameFree;
+    std::condition_variable frameReady;
+    std::vector<std::unique_ptr<Frame>> freeFrames;
+    std::deque<std::unique_ptr<Frame>> pendingFrames;
+    bool stopping = false;
+    bool failed = false;
+    std::thread writer;
+
+    //only touched by the writer thread
+    std::vector<char> encoded;
+    std::ofstream stream;
+    long streamWidth = 0;
+    long streamHeight = 0;
+};
+
+#endif // FRAMECAPTURE_H
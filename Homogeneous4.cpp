@@ -18,81 +18,6 @@
 #include "math.h"
 #include <iomanip>
 
-// constructors
-Homogeneous4::Homogeneous4() 
-    : 
-    x(0.0), 
-    y(0.0), 
-    z(0.0), 
-    w(0.0)
-    {}
-
-Homogeneous4::Homogeneous4(float X, float Y, float Z, float W)
-    : 
-    x(X), 
-    y(Y), 
-    z(Z),
-    w(W) 
-    {}
-
-Homogeneous4::Homogeneous4(const Cartesian3 &other)
-    :
-    x(other.x),
-    y(other.y),
-    z(other.z),
-    w(1)
-    {}
-
-Homogeneous4::Homogeneous4(const Homogeneous4 &other)
-    : 
-    x(other.x), 
-    y(other.y), 
-    z(other.z), 
-    w(other.w)
-    {}
-
-// routine to get a point by perspective division
-Cartesian3 Homogeneous4::Point() const
-    { // Homogeneous4::Point()
-    Cartesian3 returnVal(x/w, y/w, z/w);
-    return returnVal;
-    } // Homogeneous4::Point()
-
-// routine to get a vector by dropping w (assumed to be 0)
-Cartesian3 Homogeneous4::Vector() const
-    { // Homogeneous4::Vector()
-    Cartesian3 returnVal(x, y, z);
-    return returnVal;
-    } // Homogeneous4::Vector()
-
-// addition operator
-Homogeneous4 Homogeneous4::operator +(const Homogeneous4 &other) const
-    { // Homogeneous4::operator +()
-    Homogeneous4 returnVal(x + other.x, y + other.y, z + other.z, w + other.w);
-    return returnVal;
-    } // Homogeneous4::operator +()
-
-// subtraction operator
-Homogeneous4 Homogeneous4::operator -(const Homogeneous4 &other) const
-    { // Homogeneous4::operator -()
-    Homogeneous4 returnVal(x - other.x, y - other.y, z - other.z, w - other.w);
-    return returnVal;
-    } // Homogeneous4::operator -()
-
-// multiplication operator
-Homogeneous4 Homogeneous4::operator *(float factor) const
-    { // Homogeneous4::operator *()
-    Homogeneous4 returnVal(x * factor, y * factor, z * factor, 2 * factor);
-    return returnVal;
-    } // Homogeneous4::operator *()
-
-// division operator
-Homogeneous4 Homogeneous4::operator /(float factor) const
-    { // Homogeneous4::operator /()
-    Homogeneous4 returnVal(x / factor, y / factor, z / factor, w / factor);
-    return returnVal;
-    } // Homogeneous4::operator /()
-
 // operator that allows us to use array indexing instead of variable names
 float &Homogeneous4::operator [] (const int index)
     { // operator []
@@ -135,13 +60,6 @@ const float &Homogeneous4::operator [] (const int index) const
         } // switch on index
     } // operator []
 
-// multiplication operator
-Homogeneous4 operator *(float factor, const Homogeneous4 &right)
-    { // operator *
-    // scalar multiplication is commutative, so flip & return
-    return right * factor;
-    } // operator *
-
 // stream input
 std::istream & operator >> (std::istream &inStream, Homogeneous4 &value)
     { // stream output
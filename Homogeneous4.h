@@ -19,9 +19,11 @@
 
 #include <iostream>
 #include "Cartesian3.h"
+#include "SimdMath.h"
 
 // the class - we will rely on POD for sending to GPU
-class Homogeneous4
+// aligned so that the four coordinates load as one SIMD register
+class alignas(16) Homogeneous4
     { // Homogeneous4
     public:
     // the coordinates
@@ -55,10 +57,87 @@ class Homogeneous4
     float &operator [] (const int index);
     const float &operator [] (const int index) const;
 
+    // conversion to & from a SIMD register
+    SimdMath::float4 simd() const;
+    static Homogeneous4 fromSimd(SimdMath::float4 value);
+
     }; // Homogeneous4
 
+// the arithmetic is inline, since it runs per vertex & per fragment
+
+// constructors
+inline Homogeneous4::Homogeneous4()
+    : x(0.0), y(0.0), z(0.0), w(0.0)
+    {}
+
+inline Homogeneous4::Homogeneous4(float X, float Y, float Z, float W)
+    : x(X), y(Y), z(Z), w(W)
+    {}
+
+inline Homogeneous4::Homogeneous4(const Cartesian3 &other)
+    : x(other.x), y(other.y), z(other.z), w(1)
+    {}
+
+inline Homogeneous4::Homogeneous4(const Homogeneous4 &other)
+    { // copy constructor
+    SimdMath::store(&x, other.simd());
+    } // copy constructor
+
+inline SimdMath::float4 Homogeneous4::simd() const
+    { // simd()
+    return SimdMath::load(&x);
+    } // simd()
+
+inline Homogeneous4 Homogeneous4::fromSimd(SimdMath::float4 value)
+    { // fromSimd()
+    Homogeneous4 returnVal;
+    SimdMath::store(&returnVal.x, value);
+    return returnVal;
+    } // fromSimd()
+
+// routine to get a point by perspective division
+inline Cartesian3 Homogeneous4::Point() const
+    { // Homogeneous4::Point()
+    Homogeneous4 divided = fromSimd(SimdMath::div(simd(), SimdMath::broadcast<3>(simd())));
+    return Cartesian3(divided.x, divided.y, divided.z);
+    } // Homogeneous4::Point()
+
+// routine to get a vector by dropping w (assumed to be 0)
+inline Cartesian3 Homogeneous4::Vector() const
+    { // Homogeneous4::Vector()
+    return Cartesian3(x, y, z);
+    } // Homogeneous4::Vector()
+
+// addition operator
+inline Homogeneous4 Homogeneous4::operator +(const Homogeneous4 &other) const
+    { // Homogeneous4::operator +()
+    return fromSimd(SimdMath::add(simd(), other.simd()));
+    } // Homogeneous4::operator +()
+
+// subtraction operator
+inline Homogeneous4 Homogeneous4::operator -(const Homogeneous4 &other) const
+    { // Homogeneous4::operator -()
+    return fromSimd(SimdMath::sub(simd(), other.simd()));
+    } // Homogeneous4::operator -()
+
+// multiplication operator
+inline Homogeneous4 Homogeneous4::operator *(float factor) const
+    { // Homogeneous4::operator *()
+    return fromSimd(SimdMath::mul(simd(), SimdMath::splat(factor)));
+    } // Homogeneous4::operator *()
+
+// division operator
+inline Homogeneous4 Homogeneous4::operator /(float factor) const
+    { // Homogeneous4::operator /()
+    return fromSimd(SimdMath::div(simd(), SimdMath::splat(factor)));
+    } // Homogeneous4::operator /()
+
 // multiplication operator
-Homogeneous4 operator *(float factor, const Homogeneous4 &right);
+inline Homogeneous4 operator *(float factor, const Homogeneous4 &right)
+    { // operator *
+    // scalar multiplication is commutative, so flip & return
+    return right * factor;
+    } // operator *
 
 // stream input
 std::istream & operator >> (std::istream &inStream, Homogeneous4 &value);
@@ -0,0 +1,291 @@
+#include "ImpostorCache.h"
+#include <algorithm>
+#include <cmath>
+#include "TexturedObject.h"
+
+namespace
+{
+    const float COS_MAX_ANGLE = std::cos(IMPOSTOR_MAX_ANGLE_DEGREES * float(M_PI) / 180.f);
+
+    //folds the lower half of the octahedron out over the corners of the map, & back again
+    inline auto fold(float & u, float & v) -> void
+    {
+        float foldedU = (1.f - std::fabs(v)) * (u >= 0.f ? 1.f : -1.f);
+        float foldedV = (1.f - std::fabs(u)) * (v >= 0.f ? 1.f : -1.f);
+        u = foldedU;
+        v = foldedV;
+    }
+
+    //the cell of the octahedral map a unit direction falls in, numbered row by row
+    inline auto encode(const Cartesian3 & direction) -> uint32_t
+    {
+        float sum = std::fabs(direction.x) + std::fabs(direction.y) + std::fabs(direction.z);
+        float u = direction.x / sum, v = direction.y / sum;
+        if(direction.z < 0.f)
+            fold(u, v);
+        uint32_t col = std::min(IMPOSTOR_DIRECTIONS - 1, (uint32_t)std::max(0.f, (u + 1.f) * 0.5f * IMPOSTOR_DIRECTIONS));
+        uint32_t row = std::min(IMPOSTOR_DIRECTIONS - 1, (uint32_t)std::max(0.f, (v + 1.f) * 0.5f * IMPOSTOR_DIRECTIONS));
+        return row * IMPOSTOR_DIRECTIONS + col;
+    }
+
+    //the unit direction through the middle of a cell
+    inline auto decode(uint32_t cell) -> Cartesian3
+    {
+        float u = ((cell % IMPOSTOR_DIRECTIONS) + 0.5f) * 2.f / IMPOSTOR_DIRECTIONS - 1.f;
+        float v = ((cell / IMPOSTOR_DIRECTIONS) + 0.5f) * 2.f / IMPOSTOR_DIRECTIONS - 1.f;
+        float z = 1.f - std::fabs(u) - std::fabs(v);
+        if(z < 0.f)
+            fold(u, v);
+        return Cartesian3(u, v, z).unit();
+    }
+
+    //the axes an impostor is captured & drawn with, such that right x up = direction
+    inline auto axes(const Cartesian3 & direction, Cartesian3 & right, Cartesian3 & up) -> void
+    {
+        Cartesian3 helper = std::fabs(direction.y) < 0.9f ? Cartesian3(0.f, 1.f, 0.f) : Cartesian3(1.f, 0.f, 0.f);
+        right = helper.cross(direction).unit();
+        up = direction.cross(right);
+    }
+}
+
+auto ImpostorCache::Lighting::operator==(const Lighting & other) const -> bool
+{
+    return light == other.light && std::equal(levels, levels + 6, other.levels) && std::equal(flags, flags + 5, other.flags);
+}
+
+ImpostorCache::ImpostorCache(size_t budget, uint32_t resolution)
+    : budget(budget), resolution(std::max(resolution, 2u)),
+      entryBytes((size_t)this->resolution * this->resolution * sizeof(RGBAValue) * 2)
+{
+}
+
+auto ImpostorCache::lighting(const FakeGL & gl, const RenderParameters & renderParameters) const -> Lighting
+{
+    return {gl.stateMechine.light.getPosition(),
+            {renderParameters.emissiveLight, renderParameters.ambientLight, renderParameters.diffuseLight,
+             renderParameters.specularLight, renderParameters.specularExponent, renderParameters.lodPixelError},
+            {renderParameters.useLighting, renderParameters.phongShadingOn, renderParameters.texturedRendering,
+             renderParameters.textureModulation, renderParameters.mapUVWToRGB}};
+}
+
+auto ImpostorCache::beginFrame(FakeGL & gl, const RenderParameters & renderParameters) -> void
+{
+    Lighting current = lighting(gl, renderParameters);
+    if(context != &gl)
+    {
+        entries.clear();
+        uses.clear();
+        context = &gl;
+    }
+    else if(!(current == captured))
+        flush();
+    captured = current;
+    frame++;
+}
+
+auto ImpostorCache::flush() -> void
+{
+    if(context != nullptr)
+        for(const auto & entry : entries)
+            context->DeleteFramebuffers(1, &entry.second.framebuffer);
+    entries.clear();
+    uses.clear();
+}
+
+auto ImpostorCache::allocate(FakeGL & gl) -> unsigned int
+{
+    if((entries.size() + 1) * entryBytes > budget)
+    {
+        //what this frame has drawn may still be sampled by its tiles
+        if(uses.empty())
+            return 0;
+        auto oldest = entries.find(uses.back());
+        if(oldest->second.frame == frame)
+            return 0;
+        unsigned int framebuffer = oldest->second.framebuffer;
+        entries.erase(oldest);
+        uses.pop_back();
+        evictions++;
+        return framebuffer;
+    }
+
+    unsigned int framebuffer;
+    gl.GenFramebuffers(1, &framebuffer);
+    if(!gl.FramebufferStorage(framebuffer, resolution, resolution))
+    {
+        gl.DeleteFramebuffers(1, &framebuffer);
+        return 0;
+    }
+    return framebuffer;
+}
+
+auto ImpostorCache::capture(FakeGL & gl, TexturedObject & object, RenderParameters & renderParameters, const Cartesian3 & centre,
+                            float radius, const Cartesian3 & direction, unsigned int framebuffer) -> void
+{
+    StateMechine & state = gl.stateMechine;
+    GLViewport viewport = state.viewport;
+    RGBAValue clearColor = state.clearColor;
+    uint32_t matrixMode = state.matrixMode;
+    bool depthTest = state.enables[FAKEGL_DEPTH_TEST];
+    bool shadows = state.enables[FAKEGL_SHADOWS];
+    unsigned int target = gl.boundFramebuffer, texture = gl.textureFramebuffer;
+
+    gl.BindFramebuffer(framebuffer);
+    gl.BindFramebufferTexture(0);
+    gl.Viewport(0, 0, resolution, resolution);
+    gl.ClearColor(0.f, 0.f, 0.f, 0.f);
+    gl.Enable(FAKEGL_DEPTH_TEST);
+    gl.Clear(FAKEGL_COLOR_BUFFER_BIT | FAKEGL_DEPTH_BUFFER_BIT);
+    //the shadows are found in the frame's eye coordinates, not the capture's
+    gl.Disable(FAKEGL_SHADOWS);
+
+    //looking along -direction at the sphere, where it is in the frame & at the same size, so that the
+    //eye & the light are where they were relative to it, other than turning about the view axis. the
+    //sphere just fills the view & the depth range
+    Matrix4 frameView = state.modelViewMatrixStack.top();
+    float scale = Cartesian3(frameView[0][0], frameView[1][0], frameView[2][0]).length();
+    Cartesian3 eye = frameView * centre;
+    float extent = 1.f / (scale * radius);
+    gl.MatrixMode(FAKEGL_PROJECTION);
+    gl.PushMatrix();
+    Matrix4 & projection = *state.getCurrentSelectedMatrix();
+    projection.SetIdentity();
+    projection[0][0] = extent;
+    projection[0][3] = -eye.x * extent;
+    projection[1][1] = extent;
+    projection[1][3] = -eye.y * extent;
+    projection[2][2] = -extent;
+    projection[2][3] = eye.z * extent;
+    gl.MatrixMode(FAKEGL_MODELVIEW);
+    gl.PushMatrix();
+    Cartesian3 right, up;
+    axes(direction, right, up);
+    const Cartesian3 * rows[3] = {&right, &up, &direction};
+    Matrix4 & view = *state.getCurrentSelectedMatrix();
+    view.SetIdentity();
+    for(int row = 0; row < 3; row++)
+    {
+        for(int col = 0; col < 3; col++)
+            view[row][col] = scale * (*rows[row])[col];
+        view[row][3] = eye[row] - scale * rows[row]->dot(centre);
+    }
+
+    //the light moves with the object
+    Cartesian3 light = state.light.getPosition();
+    state.light.setPosition(view * (frameView.inverse() * light));
+    state.markDirty(DIRTY_LIGHT);
+    object.FakeGLRender(&renderParameters, &gl);
+    state.light.setPosition(light);
+    state.markDirty(DIRTY_LIGHT);
+
+    gl.PopMatrix();
+    gl.MatrixMode(FAKEGL_PROJECTION);
+    gl.PopMatrix();
+    gl.MatrixMode(matrixMode);
+
+    gl.BindFramebuffer(target);
+    gl.BindFramebufferTexture(texture);
+    gl.Viewport(viewport.x, viewport.y, viewport.width, viewport.height);
+    state.clearColor = clearColor;
+    if(!depthTest)
+        gl.Disable(FAKEGL_DEPTH_TEST);
+    if(shadows)
+        gl.Enable(FAKEGL_SHADOWS);
+
+    //the far plane is where nothing was drawn, & the rest keep at least 1 to tell them from it
+    FramebufferObject & images = gl.framebuffers[framebuffer];
+    for(long pixel = 0; pixel < images.colour.width * images.colour.height; pixel++)
+    {
+        unsigned char depth = images.depth.block[pixel].alpha;
+        images.colour.block[pixel].alpha = depth == 255 ? 0 : std::max<unsigned char>(depth, 1);
+    }
+}
+
+auto ImpostorCache::draw(FakeGL & gl, TexturedObject & object, RenderParameters & renderParameters) -> bool
+{
+    StateMechine & state = gl.stateMechine;
+
+    //the object's bounding sphere, where FakeGLRender() puts it
+    Matrix4 placement = object.FakeGLPlacement(&renderParameters);
+    Cartesian3 centre = placement * object.centreOfGravity;
+    float radius = object.objectSize * Cartesian3(placement[0][0], placement[1][0], placement[2][0]).length();
+
+    //pixels across the sphere, measured as SelectLevelOfDetail() does; any larger & the texels would show
+    const Matrix4 & modelView = state.modelViewMatrixStack.top();
+    const Matrix4 & projection = state.projectionMatrixStack.top();
+    float scale = Cartesian3(modelView[0][0], modelView[1][0], modelView[2][0]).length();
+    float pixels = 2.f * radius * scale * std::fabs(projection[1][1]) * state.viewport.height * 0.5f;
+    if(!(radius > 0.f) || pixels > resolution || context != &gl)
+        return false;
+
+    //the view axis, back towards the eye, in the object's coordinates
+    Matrix4 eyeToObject = modelView.inverse();
+    Cartesian3 toEye = Cartesian3(eyeToObject[0][2], eyeToObject[1][2], eyeToObject[2][2]).unit();
+    uint32_t cell = encode(toEye);
+    Cartesian3 direction = decode(cell);
+    if(toEye.dot(direction) < COS_MAX_ANGLE)
+        return false;
+
+    Key key(&object, cell);
+    auto found = entries.find(key);
+    if(found != entries.end())
+    {
+        uses.splice(uses.begin(), uses, found->second.use);
+        found->second.frame = frame;
+        hits++;
+    }
+    else
+    {
+        unsigned int framebuffer = allocate(gl);
+        if(framebuffer == 0)
+            return false;
+        capture(gl, object, renderParameters, centre, radius, direction, framebuffer);
+        captures++;
+        uses.push_front(key);
+        found = entries.emplace(key, Entry{framebuffer, frame, uses.begin()}).first;
+    }
+
+    //the window depth from the centre to radius further on, which the texels' depths are fractions of
+    Matrix4 modelViewProjection = projection * modelView;
+    float centreDepth = (modelViewProjection * centre).z;
+    float farDepth = (modelViewProjection * (centre - radius * toEye)).z;
+    float range = std::fabs(farDepth - centreDepth) * 0.5f * (state.zFar - state.zNear);
+
+    //the capture is lit already, & its alpha is depth rather than coverage, so it stays out of the frame
+    bool lighting = state.enables[FAKEGL_LIGHTING], textured = state.enables[FAKEGL_TEXTURE_2D];
+    int32_t envMode = state.envMode;
+    bool alphaMask = state.colorMask[3];
+    unsigned int texture = gl.textureFramebuffer;
+    gl.Disable(FAKEGL_LIGHTING);
+    gl.Enable(FAKEGL_TEXTURE_2D);
+    gl.TexEnvMode(FAKEGL_REPLACE);
+    gl.BindFramebufferTexture(found->second.framebuffer);
+    gl.ColorMask(state.colorMask[0], state.colorMask[1], state.colorMask[2], false);
+    gl.Enable(FAKEGL_DEPTH_SPRITE);
+    gl.SpriteDepthRange(range);
+
+    //the quad across the sphere, facing the capture direction. the texels were sampled at whole pixels
+    //of the capture, so the far edges are a texel beyond the last
+    Cartesian3 right, up;
+    axes(direction, right, up);
+    float texEnd = resolution / (resolution - 1.f);
+    const float corners[6][2] = {{-1.f, -1.f}, {1.f, -1.f}, {1.f, 1.f}, {-1.f, -1.f}, {1.f, 1.f}, {-1.f, 1.f}};
+    gl.Begin(FAKEGL_TRIANGLES);
+    for(const auto & corner : corners)
+    {
+        Cartesian3 position = centre + radius * (corner[0] * right + corner[1] * up);
+        gl.TexCoord2f((corner[0] + 1.f) * 0.5f * texEnd, (corner[1] + 1.f) * 0.5f * texEnd);
+        gl.Vertex3f(position.x, position.y, position.z);
+    }
+    gl.End();
+
+    gl.Disable(FAKEGL_DEPTH_SPRITE);
+    gl.ColorMask(state.colorMask[0], state.colorMask[1], state.colorMask[2], alphaMask);
+    gl.BindFramebufferTexture(texture);
+    gl.TexEnvMode(envMode);
+    if(!textured)
+        gl.Disable(FAKEGL_TEXTURE_2D);
+    if(lighting)
+        gl.Enable(FAKEGL_LIGHTING);
+    return true;
+}
@@ -0,0 +1,105 @@
+#ifndef IMPOSTORCACHE_H
+#define IMPOSTORCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <utility>
+#include "Cartesian3.h"
+#include "FakeGL.h"
+#include "RenderParameters.h"
+
+class TexturedObject;
+
+//texels along each side of an impostor, which is also the largest an object may be on screen,
+//in pixels across its bounding sphere, to be drawn as one
+constexpr uint32_t IMPOSTOR_RESOLUTION = 64;
+//view directions along each side of the octahedral map, so an object has up to 32 x 32 impostors,
+//whose directions are at most about 7.5 degrees from any view
+constexpr uint32_t IMPOSTOR_DIRECTIONS = 32;
+//how far the view may be from the direction an impostor was captured from before the mesh is drawn
+constexpr float IMPOSTOR_MAX_ANGLE_DEGREES = 6.f;
+//the colour & depth of every impostor together stay within this many bytes, 512 of them at 64 x 64
+constexpr size_t IMPOSTOR_MEMORY_BUDGET = 16u << 20;
+
+//draws objects that are small on screen as a single textured quad: an image of the object
+//captured once, from the nearest of a fixed set of view directions around it, into a framebuffer
+//object of the context. the texels' alpha holds their depth, and the quad is drawn as a depth
+//sprite (FAKEGL_DEPTH_SPRITE), so that impostors cut into each other & the meshes around them.
+//images are kept from frame to frame & the least recently drawn make way when the budget is used up.
+//the lighting is baked in as it fell on the object that was captured, and shadows are not, so
+//copies of an object share its look, & the images are only kept while the lighting stays as it was
+class ImpostorCache
+{
+public:
+    explicit ImpostorCache(size_t budget = IMPOSTOR_MEMORY_BUDGET, uint32_t resolution = IMPOSTOR_RESOLUTION);
+
+    //starts a frame on gl, after the light has been set: images drawn from now on are not evicted until
+    //the next frame, since a recording for tiles samples them later. starts over if the context or the
+    //lighting has changed, leaving the framebuffer objects of a previous context to that context
+    auto beginFrame(FakeGL & gl, const RenderParameters & renderParameters) -> void;
+
+    //draws the object as FakeGLRender() would place it with gl's current matrices, as an impostor,
+    //capturing one first if need be. false if it is too large on screen, the view is too far from the
+    //nearest capture direction, or the budget is taken up by this frame: the mesh should be drawn instead
+    auto draw(FakeGL & gl, TexturedObject & object, RenderParameters & renderParameters) -> bool;
+
+    //deletes every impostor & its framebuffer object, which the context has to be alive for
+    auto flush() -> void;
+
+    inline auto size() const -> size_t { return entries.size(); }
+    inline auto getBytes() const -> size_t { return entries.size() * entryBytes; }
+    //impostors drawn from an earlier capture, captures, & captures that evicted another impostor
+    inline auto getHits() const -> uint64_t { return hits; }
+    inline auto getCaptures() const -> uint64_t { return captures; }
+    inline auto getEvictions() const -> uint64_t { return evictions; }
+
+private:
+    //an object & the view direction it was captured from, numbered across the octahedral map
+    using Key = std::pair<const TexturedObject *, uint32_t>;
+
+    struct Entry
+    {
+        unsigned int framebuffer;
+        //the frame it was last drawn in, & where it is in the order of use
+        uint64_t frame;
+        std::list<Key>::iterator use;
+    };
+
+    //what the captured images depend on besides the object & the view direction
+    struct Lighting
+    {
+        Cartesian3 light;
+        float levels[6];
+        bool flags[5];
+
+        auto operator==(const Lighting & other) const -> bool;
+    };
+
+    auto lighting(const FakeGL & gl, const RenderParameters & renderParameters) const -> Lighting;
+    //an impostor's framebuffer object, taken from the least recently drawn impostor when the budget
+    //is used up, or 0 if there is none to spare
+    auto allocate(FakeGL & gl) -> unsigned int;
+    //draws the object from direction, its sphere (centre & radius, where FakeGLRender() places it)
+    //filling the framebuffer object, & moves the depths into the colour's alpha
+    auto capture(FakeGL & gl, TexturedObject & object, RenderParameters & renderParameters, const Cartesian3 & centre,
+                 float radius, const Cartesian3 & direction, unsigned int framebuffer) -> void;
+
+    size_t budget;
+    uint32_t resolution;
+    size_t entryBytes;
+
+    FakeGL * context = nullptr;
+    Lighting captured;
+    uint64_t frame = 0;
+    std::map<Key, Entry> entries;
+    //most recently drawn first
+    std::list<Key> uses;
+
+    uint64_t hits = 0;
+    uint64_t captures = 0;
+    uint64_t evictions = 0;
+};
+
+#endif // IMPOSTORCACHE_H
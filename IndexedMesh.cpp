@@ -0,0 +1,63 @@
+#include "IndexedMesh.h"
+#include "MeshOptimiser.h"
+
+auto IndexedMesh::build(const std::vector<uint32_t> & cornerVertices, const std::vector<uint32_t> & cornerNormals,
+                        const std::vector<uint32_t> & cornerTexCoords, const std::vector<Cartesian3> & sourceVertices,
+                        const std::vector<Cartesian3> & sourceNormals, const std::vector<Cartesian3> & sourceTexCoords,
+                        uint32_t cacheSize, float * originalACMR, float * optimisedACMR) -> void
+{
+    std::vector<WeldedVertex> welded;
+    MeshOptimiser::weld(cornerVertices, cornerNormals, cornerTexCoords, indices, welded);
+    auto count = static_cast<uint32_t>(welded.size());
+    auto before = MeshOptimiser::acmr(indices, count, cacheSize);
+
+    //reorder the triangles for the vertex cache, then the clusters that gives for overdraw
+    std::vector<Cartesian3> positions(count);
+    for(uint32_t vertex = 0; vertex < count; vertex++)
+        positions[vertex] = sourceVertices[welded[vertex].vertex];
+    auto original = indices;
+    std::vector<uint32_t> clusters;
+    MeshOptimiser::optimiseVertexCache(indices, count, cacheSize, clusters);
+    MeshOptimiser::optimiseOverdraw(indices, positions, clusters, cacheSize);
+    auto after = MeshOptimiser::acmr(indices, count, cacheSize);
+
+    //meshes of many small disconnected pieces can already be in a better order than we find
+    if(after > before)
+    {
+        indices.swap(original);
+        after = before;
+    }
+    if(originalACMR != nullptr)
+        *originalACMR = before;
+    if(optimisedACMR != nullptr)
+        *optimisedACMR = after;
+
+    //finally lay the vertices out in the order they are first used
+    std::vector<uint32_t> remap;
+    MeshOptimiser::optimiseVertexFetch(indices, count, remap);
+    quantised.clear();
+    vertices.resize(count);
+    normals.resize(count);
+    texCoords.resize(count);
+    for(uint32_t vertex = 0; vertex < count; vertex++)
+    {
+        vertices[remap[vertex]] = positions[vertex];
+        normals[remap[vertex]] = sourceNormals[welded[vertex].normal];
+        texCoords[remap[vertex]] = sourceTexCoords[welded[vertex].texCoord];
+    }
+
+    //clusters are cut from the final order, so drawing them in turn is the same as drawing the mesh
+    MeshletBuilder::build(indices, vertices, meshlets);
+}
+
+auto IndexedMesh::quantise() -> void
+{
+    if(isQuantised() || vertices.empty())
+        return;
+    VertexQuantiser::quantise(vertices, normals, texCoords, quantised, quantisationOffset, quantisationStep);
+
+    //swapping with an empty vector actually frees the memory
+    std::vector<Cartesian3>().swap(vertices);
+    std::vector<Cartesian3>().swap(normals);
+    std::vector<Cartesian3>().swap(texCoords);
+}
@@ -0,0 +1,67 @@
+#ifndef INDEXEDMESH_H
+#define INDEXEDMESH_H
+
+#include <cstdint>
+#include <vector>
+#include "Cartesian3.h"
+#include "VertexQuantiser.h"
+#include "Meshlet.h"
+
+//one level of detail of an object as a single-index mesh : one vertex per distinct
+//(position, normal, texture coordinate) triple, for FakeGL::DrawElements
+class IndexedMesh
+{
+public:
+    //builds the mesh from triangle corner lists indexing the source arrays : welds the corners,
+    //orders the triangles for a FIFO vertex cache of cacheSize entries & for overdraw, and lays
+    //the vertices out in the order they are used. the ACMR before & after ordering is optional
+    auto build(const std::vector<uint32_t> & cornerVertices, const std::vector<uint32_t> & cornerNormals,
+               const std::vector<uint32_t> & cornerTexCoords, const std::vector<Cartesian3> & sourceVertices,
+               const std::vector<Cartesian3> & sourceNormals, const std::vector<Cartesian3> & sourceTexCoords,
+               uint32_t cacheSize, float * originalACMR = nullptr, float * optimisedACMR = nullptr) -> void;
+
+    //switches to the compact vertex format & releases the float arrays
+    auto quantise() -> void;
+
+    inline auto isQuantised() const -> bool { return !quantised.empty(); }
+    inline auto vertexCount() const -> size_t { return isQuantised() ? quantised.size() : vertices.size(); }
+    inline auto triangleCount() const -> size_t { return indices.size() / 3; }
+
+    //fetches one vertex, whichever format it is stored in
+    inline auto getVertex(uint32_t vertex, Cartesian3 & position, Cartesian3 & normal, Cartesian3 & texCoord) const -> void
+    {
+        if(isQuantised())
+        {
+            auto & compact = quantised[vertex];
+            position = VertexQuantiser::decodePosition(compact, quantisationOffset, quantisationStep);
+            normal = VertexQuantiser::decodeOctahedral(compact.normal);
+            texCoord = VertexQuantiser::decodeTexCoord(compact);
+        }
+        else
+        {
+            position = vertices[vertex];
+            normal = normals[vertex];
+            texCoord = texCoords[vertex];
+        }
+    }
+
+    std::vector<Cartesian3> vertices;
+    std::vector<Cartesian3> normals;
+    std::vector<Cartesian3> texCoords;
+
+    //the same vertices in the compact format, once quantised. a position decodes as offset + quantised * step
+    std::vector<QuantisedVertex> quantised;
+    Cartesian3 quantisationOffset;
+    Cartesian3 quantisationStep;
+
+    //three indices per triangle
+    std::vector<uint32_t> indices;
+
+    //contiguous runs of indices with bounds for culling, in index order
+    std::vector<Meshlet> meshlets;
+
+    //RMS distance from the full detail surface, in object space
+    float error = 0.f;
+};
+
+#endif // INDEXEDMESH_H
@@ -0,0 +1,82 @@
+#include "MappedFile.h"
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+auto MappedFile::open(const char * fileName) -> bool
+{
+    close();
+
+#ifndef _WIN32
+    int fd = ::open(fileName, O_RDONLY);
+    if(fd >= 0)
+    {
+        struct stat info;
+        if(fstat(fd, &info) == 0)
+        {
+            length = static_cast<size_t>(info.st_size);
+            //mmap refuses zero-length mappings, an empty file is still a valid file
+            if(length == 0)
+            {
+                ::close(fd);
+                opened = true;
+                return true;
+            }
+            void * address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(address != MAP_FAILED)
+            {
+                //we always walk the file front to back
+                madvise(address, length, MADV_SEQUENTIAL);
+                ::close(fd);
+                begin = static_cast<const char *>(address);
+                mapped = true;
+                opened = true;
+                return true;
+            }
+        }
+        ::close(fd);
+        length = 0;
+    }
+#endif
+
+    //no mapping available, so read the whole file in one go
+    std::ifstream stream(fileName, std::ios::binary | std::ios::ate);
+    if(!stream.good())
+        return false;
+    buffer.resize(static_cast<size_t>(stream.tellg()));
+    stream.seekg(0);
+    stream.read(buffer.data(), buffer.size());
+    if(!stream.good() && !buffer.empty())
+    {
+        buffer.clear();
+        return false;
+    }
+    begin = buffer.data();
+    length = buffer.size();
+    opened = true;
+    return true;
+}
+
+auto MappedFile::close() -> void
+{
+#ifndef _WIN32
+    if(mapped)
+        munmap(const_cast<char *>(begin), length);
+#endif
+    buffer.clear();
+    buffer.shrink_to_fit();
+    begin = nullptr;
+    length = 0;
+    opened = false;
+    mapped = false;
+}
@@ -0,0 +1,35 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <vector>
+
+//read-only view of a whole file.
+//uses mmap where the platform has it, otherwise the file is read into memory once
+
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    auto operator=(const MappedFile &) -> MappedFile & = delete;
+
+    auto open(const char * fileName) -> bool;
+    auto close() -> void;
+
+    inline auto data() const -> const char * { return begin; }
+    inline auto size() const -> size_t { return length; }
+    inline auto isOpen() const -> bool { return opened; }
+
+private:
+    const char * begin = nullptr;
+    size_t length = 0;
+    bool opened = false;
+    bool mapped = false;
+    //fallback storage when the file could not be mapped
+    std::vector<char> buffer;
+};
+
+#endif // MAPPEDFILE_H
@@ -34,13 +34,6 @@ Matrix4::Matrix4()
             coordinates[row][col] = 0.0;
     } // default constructor
 
-Matrix4::Matrix4(const Matrix4 &other)
-    { // copy constructor
-    for (int row = 0; row < 4; row++)
-        for (int col = 0; col < 4; col++)
-            coordinates[row][col] = other.coordinates[row][col];
-    } // copy constructor
-
 // equality operator
 bool Matrix4::operator ==(const Matrix4 &other) const
     { // operator ==()
@@ -77,38 +70,11 @@ Matrix4 Matrix4::operator *(float factor) const
     Matrix4 returnMatrix;
     // multiply by the factor
     for (int row = 0; row < 4; row++)
-        for (int col = 0; col < 4; col++)
-            returnMatrix.coordinates[row][col] = coordinates[row][col] * factor;
+        SimdMath::store(returnMatrix.coordinates[row], SimdMath::mul(this->row(row), SimdMath::splat(factor)));
     // and return it
     return returnMatrix;
     } // operator *()
 
-// vector operations on homogeneous coordinates
-// multiplication is the only operator we use
-Homogeneous4 Matrix4::operator *(const Homogeneous4 &vector) const
-    { // operator *()
-    // get a zero-initialised vector
-    Homogeneous4 productVector;
-    
-    // now loop, adding products
-    for (int row = 0; row < 4; row++)
-        for (int col = 0; col < 4; col++)
-            productVector[row] += coordinates[row][col] * vector[col];
-    
-    // return the result
-    return productVector;
-    } // operator *()
-
-// and on Cartesian coordinates
-Cartesian3 Matrix4::operator *(const Cartesian3 &vector) const
-    { // cartesian multiplication
-    // convert to Homogeneous coords and multiply
-    Homogeneous4 productVector = (*this) * Homogeneous4(vector);
-
-    // then divide back through
-    return productVector.Point();
-    } // cartesian multiplication
-
 // matrix operations
 // addition operator
 Matrix4 Matrix4::operator +(const Matrix4 &other) const
@@ -116,10 +82,9 @@ Matrix4 Matrix4::operator +(const Matrix4 &other) const
     // start with a zero matrix
     Matrix4 sumMatrix;
     
-    // now loop, adding products
+    // now loop, adding rows
     for (int row = 0; row < 4; row++)
-        for (int col = 0; col < 4; col++)
-            sumMatrix.coordinates[row][col] = coordinates[row][col] + other.coordinates[row][col];
+        SimdMath::store(sumMatrix.coordinates[row], SimdMath::add(this->row(row), other.row(row)));
 
     // return the result
     return sumMatrix;
@@ -131,50 +96,82 @@ Matrix4 Matrix4::operator -(const Matrix4 &other) const
     // start with a zero matrix
     Matrix4 differenceMatrix;
     
-    // now loop, adding products
+    // now loop, subtracting rows
     for (int row = 0; row < 4; row++)
-        for (int col = 0; col < 4; col++)
-            differenceMatrix.coordinates[row][col] = coordinates[row][col] + other.coordinates[row][col];
+        SimdMath::store(differenceMatrix.coordinates[row], SimdMath::sub(this->row(row), other.row(row)));
 
     // return the result
     return differenceMatrix;
     } // operator -()
 
-// multiplication operator
-Matrix4 Matrix4::operator *(const Matrix4 &other) const
-{   // operator *()
-    // start with a zero matrix
-    Matrix4 productMatrix;
-
-    // now loop, adding products
-    for (int row = 0; row < 4; row++)
-        for (int col = 0; col < 4; col++)
-            for (int entry = 0; entry < 4; entry++)
-                productMatrix.coordinates[row][col] += coordinates[row][entry] * other.coordinates[entry][col];
-
-    // return the result
-    return productMatrix;
-} // operator *()
-
 // matrix transpose
 Matrix4 Matrix4::transpose() const
     { // transpose()
     // start with a zero matrix
     Matrix4 transposeMatrix;
     
-    // now loop, adding products
-    for (int row = 0; row < 4; row++)
-        for (int col = 0; col < 4; col++)
-            transposeMatrix.coordinates[row][col] = coordinates[col][row];
+    // transpose the rows in registers
+    SimdMath::float4 row0 = row(0), row1 = row(1), row2 = row(2), row3 = row(3);
+    SimdMath::transpose(row0, row1, row2, row3);
+    SimdMath::store(transposeMatrix.coordinates[0], row0);
+    SimdMath::store(transposeMatrix.coordinates[1], row1);
+    SimdMath::store(transposeMatrix.coordinates[2], row2);
+    SimdMath::store(transposeMatrix.coordinates[3], row3);
 
     // return the result
     return transposeMatrix;
     } // transpose()
 
 
-Matrix4 Matrix4::inverse() noexcept
+// true if the bottom row is (0, 0, 0, 1), i.e. no projection
+bool Matrix4::isAffine() const
+    { // isAffine()
+    return coordinates[3][0] == 0.0 && coordinates[3][1] == 0.0 && coordinates[3][2] == 0.0 && coordinates[3][3] == 1.0;
+    } // isAffine()
+
+// inverse of an affine matrix [A t; 0 1], which is [A^-1 -A^-1 t; 0 1]
+Matrix4 Matrix4::affineInverse() const noexcept
+    { // affineInverse()
+    // the rows of A, without the translation
+    SimdMath::float4 row0 = SimdMath::set(coordinates[0][0], coordinates[0][1], coordinates[0][2], 0.0);
+    SimdMath::float4 row1 = SimdMath::set(coordinates[1][0], coordinates[1][1], coordinates[1][2], 0.0);
+    SimdMath::float4 row2 = SimdMath::set(coordinates[2][0], coordinates[2][1], coordinates[2][2], 0.0);
+
+    // the columns of the adjugate of A are cross products of its rows
+    SimdMath::float4 column0 = SimdMath::cross(row1, row2);
+    SimdMath::float4 column1 = SimdMath::cross(row2, row0);
+    SimdMath::float4 column2 = SimdMath::cross(row0, row1);
+
+    // a singular matrix is returned unchanged, as inverse() does
+    float det = SimdMath::dot3(row0, column0);
+    if (std::fabs(det) <= std::numeric_limits<float>::min()) return *this;
+
+    SimdMath::float4 scale = SimdMath::splat(1.f / det);
+    column0 = SimdMath::mul(column0, scale);
+    column1 = SimdMath::mul(column1, scale);
+    column2 = SimdMath::mul(column2, scale);
+
+    // the translation column is -A^-1 t, with 1 in w
+    SimdMath::float4 translation = SimdMath::set(-coordinates[0][3], -coordinates[1][3], -coordinates[2][3], 1.0);
+    SimdMath::float4 column3 = SimdMath::combine(column0, column1, column2, SimdMath::set(0.0, 0.0, 0.0, 1.0), translation);
+
+    // and the columns become the rows
+    SimdMath::transpose(column0, column1, column2, column3);
+    Matrix4 inverse;
+    SimdMath::store(inverse.coordinates[0], column0);
+    SimdMath::store(inverse.coordinates[1], column1);
+    SimdMath::store(inverse.coordinates[2], column2);
+    SimdMath::store(inverse.coordinates[3], column3);
+    return inverse;
+    } // affineInverse()
+
+Matrix4 Matrix4::inverse() const noexcept
 {
-    auto m = reinterpret_cast<float*>(&coordinates[0][0]);
+    // modelview matrices are nearly always affine
+    if (isAffine())
+        return affineInverse();
+
+    auto m = reinterpret_cast<const float*>(&coordinates[0][0]);
     const float a0 = m[0] * m[5] - m[1] * m[4];
     const float a1 = m[0] * m[6] - m[2] * m[4];
     const float a2 = m[0] * m[7] - m[3] * m[4];
@@ -292,33 +289,6 @@ Matrix4 operator *(float factor, const Matrix4 &matrix)
     return matrix * factor;
     } // operator *()
 
-Matrix4& Matrix4::operator*=(const Matrix4 &other) noexcept
-{   
-    multiply(other,*this);
-    return *this;
-}
-
-void Matrix4::multiply(const Matrix4 & other) noexcept
-{
-    multiply(other,*this);
-}
-
-void Matrix4::multiply(const Matrix4 & other,Matrix4 & dst) noexcept
-{
-
-    Matrix4 productMatrix;
-
-    for (int32_t row = 0; row < 4; row++)
-        for (int32_t col = 0; col < 4; col++)
-            for (int32_t entry = 0; entry < 4; entry++)
-                productMatrix.coordinates[row][col] += coordinates[row][entry] * other.coordinates[entry][col];
-
-    memcpy(dst.coordinates,productMatrix.coordinates,sizeof(float) * 16);
-
-    
-}
-     
-
 // stream input
 std::istream & operator >> (std::istream &inStream, Matrix4 &matrix)
     { // operator >>()
@@ -21,6 +21,7 @@
 #include <iostream>
 #include "Cartesian3.h"
 #include "Homogeneous4.h"
+#include "SimdMath.h"
 
 // forward declaration
 class Matrix4;
@@ -36,11 +37,12 @@ class columnMajorMatrix
     }; // class columnMajorMatrix
     
 // the class itself, stored in row-major form
+// each row is aligned so that it loads as one SIMD register
 class Matrix4
     { // Matrix4
     public:
     // the coordinates
-    float coordinates[4][4];
+    alignas(16) float coordinates[4][4];
 
     // constructor - default to the zero matrix
     Matrix4();
@@ -81,13 +83,23 @@ class Matrix4
  //=======Added by Prime Zeng=========
     Matrix4& operator*=(const Matrix4 &other) noexcept;
     void multiply(const Matrix4 & matrix) noexcept;
-    void multiply(const Matrix4 & matrix,Matrix4 & dst) noexcept;
-    Matrix4 inverse() noexcept;
+    void multiply(const Matrix4 & matrix,Matrix4 & dst) const noexcept;
+    Matrix4 inverse() const noexcept;
 
 //====================================
 
+    // true if the bottom row is (0, 0, 0, 1), i.e. no projection
+    bool isAffine() const;
+
+    // inverse of an affine matrix, much cheaper than the general inverse()
+    // which calls it when it can
+    Matrix4 affineInverse() const noexcept;
+
     // matrix transpose
     Matrix4 transpose() const;
+
+    // the rows as SIMD registers
+    SimdMath::float4 row(int rowIndex) const;
     
     // returns a column-major array of 16 values
     // for use with OpenGL
@@ -111,5 +123,65 @@ std::istream & operator >> (std::istream &inStream, Matrix4 &value);
 
 // stream output
 std::ostream & operator << (std::ostream &outStream, const Matrix4 &value);
+
+// the products are inline, since the vertex stage runs them per vertex
+
+inline Matrix4::Matrix4(const Matrix4 &other)
+    { // copy constructor
+    for (int row = 0; row < 4; row++)
+        SimdMath::store(coordinates[row], other.row(row));
+    } // copy constructor
+
+inline SimdMath::float4 Matrix4::row(int rowIndex) const
+    { // row()
+    return SimdMath::load(coordinates[rowIndex]);
+    } // row()
+
+// vector operations on homogeneous coordinates
+inline Homogeneous4 Matrix4::operator *(const Homogeneous4 &vector) const
+    { // operator *()
+    // transpose the rows into columns, then sum the columns scaled by the vector
+    SimdMath::float4 column0 = row(0), column1 = row(1), column2 = row(2), column3 = row(3);
+    SimdMath::transpose(column0, column1, column2, column3);
+    return Homogeneous4::fromSimd(SimdMath::combine(column0, column1, column2, column3, vector.simd()));
+    } // operator *()
+
+// and on Cartesian coordinates
+inline Cartesian3 Matrix4::operator *(const Cartesian3 &vector) const
+    { // cartesian multiplication
+    // convert to Homogeneous coords and multiply, then divide back through
+    return ((*this) * Homogeneous4(vector)).Point();
+    } // cartesian multiplication
+
+// multiplication operator
+inline Matrix4 Matrix4::operator *(const Matrix4 &other) const
+    { // operator *()
+    Matrix4 productMatrix;
+    multiply(other, productMatrix);
+    return productMatrix;
+    } // operator *()
+
+inline void Matrix4::multiply(const Matrix4 & other,Matrix4 & dst) const noexcept
+    { // multiply()
+    // each row of the product is the rows of other, scaled by the same row of this
+    // dst may be this or other, so all of the rows are read before any are written
+    SimdMath::float4 other0 = other.row(0), other1 = other.row(1), other2 = other.row(2), other3 = other.row(3);
+    SimdMath::float4 product[4];
+    for (int row = 0; row < 4; row++)
+        product[row] = SimdMath::combine(other0, other1, other2, other3, this->row(row));
+    for (int row = 0; row < 4; row++)
+        SimdMath::store(dst.coordinates[row], product[row]);
+    } // multiply()
+
+inline Matrix4& Matrix4::operator*=(const Matrix4 &other) noexcept
+    { // operator *=()
+    multiply(other,*this);
+    return *this;
+    } // operator *=()
+
+inline void Matrix4::multiply(const Matrix4 & other) noexcept
+    { // multiply()
+    multiply(other,*this);
+    } // multiply()
         
 #endif
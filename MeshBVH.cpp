@@ -0,0 +1,419 @@
+#include "MeshBVH.h"
+#include <cmath>
+#include <algorithm>
+#include "SimdMath.h"
+
+namespace
+{
+    //a zero component would give 0 * infinity in the slab test, so nudge it off zero
+    auto safeInverse(float component) -> float
+    {
+        if(std::fabs(component) < 1e-30f)
+            component = std::signbit(component) ? -1e-30f : 1e-30f;
+        return 1.f / component;
+    }
+
+    //a ray ready for the box & triangle tests
+    struct Ray
+    {
+        //xyz in the lanes, for the boxes
+        SimdMath::float4 origin;
+        SimdMath::float4 inverseDirection;
+        //each component in all four lanes, for the triangles
+        SimdMath::float4 originX, originY, originZ;
+        SimdMath::float4 directionX, directionY, directionZ;
+
+        Ray(const Cartesian3 & rayOrigin, const Cartesian3 & rayDirection)
+        {
+            using namespace SimdMath;
+            origin = set(rayOrigin.x, rayOrigin.y, rayOrigin.z, 0.f);
+            inverseDirection = set(safeInverse(rayDirection.x), safeInverse(rayDirection.y), safeInverse(rayDirection.z), 0.f);
+            originX = splat(rayOrigin.x);
+            originY = splat(rayOrigin.y);
+            originZ = splat(rayOrigin.z);
+            directionX = splat(rayDirection.x);
+            directionY = splat(rayDirection.y);
+            directionZ = splat(rayDirection.z);
+        }
+
+        //the slab test: true if the ray meets the box somewhere in [0, tMax], with tEnter where it does
+        auto hitsBox(const MeshBVHNode & node, float tMax, float & tEnter) const -> bool
+        {
+            using namespace SimdMath;
+            float4 t1 = mul(sub(load(node.boundsMin), origin), inverseDirection);
+            float4 t2 = mul(sub(load(node.boundsMax), origin), inverseDirection);
+            float4 tNear = min(t1, t2);
+            float4 tFar = max(t1, t2);
+            //the w lanes are ignored: only x, y & z are gathered into lane 0
+            tEnter = first(max(max(tNear, broadcast<1>(tNear)), max(broadcast<2>(tNear), splat(0.f))));
+            float tExit = first(min(min(tFar, broadcast<1>(tFar)), min(broadcast<2>(tFar), splat(tMax))));
+            return tEnter <= tExit;
+        }
+
+        //Moller-Trumbore on four triangles at once. returns the lanes hit with 0 <= t < tMax as bits
+        auto hitsPacket(const TrianglePacket & packet, float tMax, float * t, float * u, float * v) const -> int
+        {
+            using namespace SimdMath;
+            float4 edge1X = load(packet.edge1[0]), edge1Y = load(packet.edge1[1]), edge1Z = load(packet.edge1[2]);
+            float4 edge2X = load(packet.edge2[0]), edge2Y = load(packet.edge2[1]), edge2Z = load(packet.edge2[2]);
+
+            //p = direction x edge2
+            float4 pX = sub(mul(directionY, edge2Z), mul(directionZ, edge2Y));
+            float4 pY = sub(mul(directionZ, edge2X), mul(directionX, edge2Z));
+            float4 pZ = sub(mul(directionX, edge2Y), mul(directionY, edge2X));
+            float4 determinant = add(add(mul(edge1X, pX), mul(edge1Y, pY)), mul(edge1Z, pZ));
+            float4 inverse = div(splat(1.f), determinant);
+
+            //s = origin - vertex0, q = s x edge1
+            float4 sX = sub(originX, load(packet.vertex0[0]));
+            float4 sY = sub(originY, load(packet.vertex0[1]));
+            float4 sZ = sub(originZ, load(packet.vertex0[2]));
+            float4 qX = sub(mul(sY, edge1Z), mul(sZ, edge1Y));
+            float4 qY = sub(mul(sZ, edge1X), mul(sX, edge1Z));
+            float4 qZ = sub(mul(sX, edge1Y), mul(sY, edge1X));
+
+            float4 laneU = mul(add(add(mul(sX, pX), mul(sY, pY)), mul(sZ, pZ)), inverse);
+            float4 laneV = mul(add(add(mul(directionX, qX), mul(directionY, qY)), mul(directionZ, qZ)), inverse);
+            float4 laneT = mul(add(add(mul(edge2X, qX), mul(edge2Y, qY)), mul(edge2Z, qZ)), inverse);
+
+            //parallel rays & empty lanes have no determinant. NaNs fail every comparison
+            float4 zero = splat(0.f);
+            float4 mask = less(zero, abs(determinant));
+            mask = maskAnd(mask, lessEqual(zero, laneU));
+            mask = maskAnd(mask, lessEqual(zero, laneV));
+            mask = maskAnd(mask, lessEqual(add(laneU, laneV), splat(1.f)));
+            mask = maskAnd(mask, lessEqual(zero, laneT));
+            mask = maskAnd(mask, less(laneT, splat(tMax)));
+            int lanes = moveMask(mask);
+            if(lanes != 0)
+            {
+                store(t, laneT);
+                store(u, laneU);
+                store(v, laneV);
+            }
+            return lanes;
+        }
+    };
+};
+
+auto RayPacket::setup() -> void
+{
+    for(int axis = 0; axis < 3; axis++)
+        for(int lane = 0; lane < 4; lane++)
+            inverseDirection[axis][lane] = safeInverse(direction[axis][lane]);
+}
+
+auto RayPacket::transform(const Matrix4 & matrix, RayPacket & result) const -> void
+{
+    for(int lane = 0; lane < 4; lane++)
+    {
+        Cartesian3 rayOrigin(origin[0][lane], origin[1][lane], origin[2][lane]);
+        Cartesian3 rayDirection(direction[0][lane], direction[1][lane], direction[2][lane]);
+        Cartesian3 newOrigin = matrix * rayOrigin;
+        Cartesian3 newDirection = matrix * (rayOrigin + rayDirection) - newOrigin;
+        for(int axis = 0; axis < 3; axis++)
+        {
+            result.origin[axis][lane] = newOrigin[axis];
+            result.direction[axis][lane] = newDirection[axis];
+        }
+        result.tMax[lane] = tMax[lane];
+    }
+    result.setup();
+}
+
+auto RayPacket::hitsBox(const float * boundsMin, const float * boundsMax, int active) const -> int
+{
+    using namespace SimdMath;
+    float4 tEnter = splat(0.f);
+    float4 tExit = load(tMax);
+    for(int axis = 0; axis < 3; axis++)
+    {
+        float4 rayOrigin = load(origin[axis]);
+        float4 inverse = load(inverseDirection[axis]);
+        float4 t1 = mul(sub(splat(boundsMin[axis]), rayOrigin), inverse);
+        float4 t2 = mul(sub(splat(boundsMax[axis]), rayOrigin), inverse);
+        tEnter = max(tEnter, min(t1, t2));
+        tExit = min(tExit, max(t1, t2));
+    }
+    return moveMask(lessEqual(tEnter, tExit)) & active;
+}
+
+auto MeshBVH::build(const std::vector<Cartesian3> & positions, const std::vector<unsigned int> & indices) -> void
+{
+    nodes.clear();
+    packets.clear();
+    version++;
+    triangleCount = (uint32_t)(indices.size() / 3);
+    if(triangleCount == 0)
+        return;
+
+    order.resize(triangleCount);
+    triangleBoxes.assign(triangleCount, SAHBox());
+    for(uint32_t triangle = 0; triangle < triangleCount; triangle++)
+    {
+        order[triangle] = triangle;
+        for(uint32_t corner = 0; corner < 3; corner++)
+            triangleBoxes[triangle].grow(positions[indices[3 * triangle + corner]]);
+    }
+    nodes.reserve(2 * (triangleCount / MESH_BVH_MAX_LEAF_TRIANGLES) + 1);
+    packets.reserve(triangleCount / MESH_BVH_MAX_LEAF_TRIANGLES + 1);
+    buildNode(positions, indices, 0, triangleCount, 0);
+
+    //the scratch is only wanted again on a rebuild
+    std::vector<uint32_t>().swap(order);
+    std::vector<SAHBox>().swap(triangleBoxes);
+}
+
+auto MeshBVH::assign(std::vector<MeshBVHNode> & newNodes, std::vector<TrianglePacket> & newPackets, uint32_t newTriangleCount) -> bool
+{
+    nodes.clear();
+    packets.clear();
+    version++;
+    triangleCount = 0;
+    if(newNodes.empty() != (newTriangleCount == 0))
+        return false;
+
+    //nodes are laid out depth first, so a node & everything below it take up a run of nodes:
+    //an internal node's left child starts the run just after it & its right child ends it
+    struct Run
+    {
+        uint32_t first;
+        uint32_t end;
+        uint32_t depth;
+    } runs[MESH_BVH_MAX_DEPTH];
+    uint32_t runCount = 0;
+    if(!newNodes.empty())
+        runs[runCount++] = {0, (uint32_t)newNodes.size(), 0};
+    while(runCount > 0)
+    {
+        Run run = runs[--runCount];
+        const MeshBVHNode & node = newNodes[run.first];
+        if(node.packetCount == 0)
+        {
+            if(run.depth + 1 >= MESH_BVH_MAX_DEPTH || node.rightChild <= run.first + 1 || node.rightChild >= run.end)
+                return false;
+            runs[runCount++] = {node.rightChild, run.end, run.depth + 1};
+            runs[runCount++] = {run.first + 1, node.rightChild, run.depth + 1};
+        }
+        else if(run.end != run.first + 1 || node.firstPacket > newPackets.size() || node.packetCount > newPackets.size() - node.firstPacket)
+            return false;
+    }
+    for(const TrianglePacket & packet : newPackets)
+        for(uint32_t lane = 0; lane < 4; lane++)
+            if(packet.triangle[lane] >= newTriangleCount)
+                return false;
+
+    nodes.swap(newNodes);
+    packets.swap(newPackets);
+    triangleCount = newTriangleCount;
+    return true;
+}
+
+auto MeshBVH::buildNode(const std::vector<Cartesian3> & positions, const std::vector<unsigned int> & indices,
+                        uint32_t first, uint32_t count, uint32_t depth) -> uint32_t
+{
+    uint32_t index = (uint32_t)nodes.size();
+    nodes.emplace_back();
+
+    SAHBox bounds, centres;
+    boundSAHBoxes(triangleBoxes.data() + first, count, bounds, centres);
+
+    uint32_t leftCount = 0;
+    if(depth + 1 < MESH_BVH_MAX_DEPTH)
+    {
+        SAHSplit split = findSAHSplit<MESH_BVH_SAH_BINS>(triangleBoxes.data() + first, count, centres);
+
+        //a leaf tests its packets; a split tests two boxes, then its children as often as they are hit.
+        //a packet costs about as much as a box, and a leaf of up to four triangles is one packet
+        float area = bounds.surfaceArea();
+        float splitCost = 2.f + (area > 0.f ? split.cost / area : 0.f) / MESH_BVH_MAX_LEAF_TRIANGLES;
+        float leafCost = (float)((count + MESH_BVH_MAX_LEAF_TRIANGLES - 1) / MESH_BVH_MAX_LEAF_TRIANGLES);
+        if(split.cost < std::numeric_limits<float>::max() && (count > MESH_BVH_MAX_LEAF_TRIANGLES || splitCost < leafCost))
+            leftCount = partitionSAH(triangleBoxes.data() + first, order.data() + first, count, split);
+    }
+
+    MeshBVHNode node;
+    for(int axis = 0; axis < 3; axis++)
+    {
+        node.boundsMin[axis] = bounds.lower[axis];
+        node.boundsMax[axis] = bounds.upper[axis];
+    }
+    node.boundsMin[3] = node.boundsMax[3] = 0.f;
+    node.rightChild = 0;
+    node.firstPacket = 0;
+    node.packetCount = 0;
+
+    if(leftCount == 0 || leftCount == count)
+    {
+        //a leaf: four triangles to a packet, the last one padded with empty lanes
+        node.firstPacket = (uint32_t)packets.size();
+        for(uint32_t packetFirst = first; packetFirst < first + count; packetFirst += 4)
+        {
+            packets.emplace_back();
+            TrianglePacket & packet = packets.back();
+            for(uint32_t lane = 0; lane < 4; lane++)
+            {
+                bool used = packetFirst + lane < first + count;
+                uint32_t triangle = used ? order[packetFirst + lane] : 0;
+                Cartesian3 vertex0, edge1, edge2;
+                if(used)
+                {
+                    vertex0 = positions[indices[3 * triangle]];
+                    edge1 = positions[indices[3 * triangle + 1]] - vertex0;
+                    edge2 = positions[indices[3 * triangle + 2]] - vertex0;
+                }
+                packet.vertex0[0][lane] = vertex0.x;
+                packet.vertex0[1][lane] = vertex0.y;
+                packet.vertex0[2][lane] = vertex0.z;
+                packet.edge1[0][lane] = edge1.x;
+                packet.edge1[1][lane] = edge1.y;
+                packet.edge1[2][lane] = edge1.z;
+                packet.edge2[0][lane] = edge2.x;
+                packet.edge2[1][lane] = edge2.y;
+                packet.edge2[2][lane] = edge2.z;
+                packet.triangle[lane] = triangle;
+            }
+            node.packetCount++;
+        }
+    }
+    else
+    {
+        buildNode(positions, indices, first, leftCount, depth + 1);
+        node.rightChild = buildNode(positions, indices, first + leftCount, count - leftCount, depth + 1);
+    }
+    nodes[index] = node;
+    return index;
+}
+
+auto MeshBVH::intersect(const Cartesian3 & origin, const Cartesian3 & direction, RayHit & hit, float tMax) const -> bool
+{
+    return traverse(origin, direction, hit, tMax, false);
+}
+
+auto MeshBVH::occluded(const Cartesian3 & origin, const Cartesian3 & direction, float tMax) const -> bool
+{
+    RayHit hit;
+    return traverse(origin, direction, hit, tMax, true);
+}
+
+auto MeshBVH::traverse(const Cartesian3 & origin, const Cartesian3 & direction, RayHit & hit, float tMax, bool anyHit) const -> bool
+{
+    if(nodes.empty())
+        return false;
+    Ray ray(origin, direction);
+    float tEnter;
+    if(!ray.hitsBox(nodes[0], tMax, tEnter))
+        return false;
+
+    //the far children still to visit, with where the ray enters them
+    struct Pending
+    {
+        uint32_t node;
+        float tEnter;
+    } stack[MESH_BVH_MAX_DEPTH];
+    uint32_t depth = 0;
+    uint32_t index = 0;
+    bool found = false;
+    alignas(16) float t[4], u[4], v[4];
+    while(true)
+    {
+        const MeshBVHNode & node = nodes[index];
+        if(node.packetCount == 0)
+        {
+            //visit the nearer child first, so that its hits shorten the ray for the other
+            uint32_t left = index + 1, right = node.rightChild;
+            float tLeft, tRight;
+            bool hitsLeft = ray.hitsBox(nodes[left], tMax, tLeft);
+            bool hitsRight = ray.hitsBox(nodes[right], tMax, tRight);
+            if(hitsLeft && hitsRight)
+            {
+                if(tRight < tLeft)
+                {
+                    std::swap(left, right);
+                    std::swap(tLeft, tRight);
+                }
+                stack[depth++] = {right, tRight};
+                index = left;
+                continue;
+            }
+            if(hitsLeft || hitsRight)
+            {
+                index = hitsLeft ? left : right;
+                continue;
+            }
+        }
+        else
+        {
+            for(uint32_t packet = node.firstPacket; packet < node.firstPacket + node.packetCount; packet++)
+            {
+                int lanes = ray.hitsPacket(packets[packet], tMax, t, u, v);
+                if(lanes == 0)
+                    continue;
+                found = true;
+                for(int lane = 0; lane < 4; lane++)
+                    if((lanes & (1 << lane)) && t[lane] < tMax)
+                    {
+                        tMax = t[lane];
+                        hit = {packets[packet].triangle[lane], t[lane], u[lane], v[lane]};
+                    }
+                if(anyHit)
+                    return true;
+            }
+        }
+
+        //pop the next child the ray still enters before its closest hit so far
+        do
+        {
+            if(depth == 0)
+                return found;
+            depth--;
+        } while(stack[depth].tEnter > tMax);
+        index = stack[depth].node;
+    }
+}
+
+auto MeshBVH::occluded(const RayPacket & packet, int active) const -> int
+{
+    if(nodes.empty() || active == 0)
+        return 0;
+
+    //the triangles are tested one ray at a time, four triangles to a test
+    const Ray rays[4] = {
+        Ray(Cartesian3(packet.origin[0][0], packet.origin[1][0], packet.origin[2][0]), Cartesian3(packet.direction[0][0], packet.direction[1][0], packet.direction[2][0])),
+        Ray(Cartesian3(packet.origin[0][1], packet.origin[1][1], packet.origin[2][1]), Cartesian3(packet.direction[0][1], packet.direction[1][1], packet.direction[2][1])),
+        Ray(Cartesian3(packet.origin[0][2], packet.origin[1][2], packet.origin[2][2]), Cartesian3(packet.direction[0][2], packet.direction[1][2], packet.direction[2][2])),
+        Ray(Cartesian3(packet.origin[0][3], packet.origin[1][3], packet.origin[2][3]), Cartesian3(packet.direction[0][3], packet.direction[1][3], packet.direction[2][3]))
+    };
+
+    //the right children still to visit. order doesn't matter when any hit will do
+    uint32_t stack[MESH_BVH_MAX_DEPTH];
+    uint32_t depth = 0;
+    uint32_t index = 0;
+    int done = 0;
+    alignas(16) float t[4], u[4], v[4];
+    while(true)
+    {
+        const MeshBVHNode & node = nodes[index];
+        int lanes = packet.hitsBox(node.boundsMin, node.boundsMax, active & ~done);
+        if(lanes != 0 && node.packetCount == 0)
+        {
+            stack[depth++] = node.rightChild;
+            index = index + 1;
+            continue;
+        }
+        for(int lane = 0; lane < 4; lane++)
+        {
+            if((lanes & (1 << lane)) == 0)
+                continue;
+            for(uint32_t triangles = node.firstPacket; triangles < node.firstPacket + node.packetCount; triangles++)
+                if(rays[lane].hitsPacket(packets[triangles], packet.tMax[lane], t, u, v) != 0)
+                {
+                    done |= 1 << lane;
+                    break;
+                }
+        }
+        if(done == active || depth == 0)
+            return done;
+        index = stack[--depth];
+    }
+}
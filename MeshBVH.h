@@ -0,0 +1,114 @@
+#ifndef MESHBVH_H
+#define MESHBVH_H
+
+#include <cstdint>
+#include <vector>
+#include <limits>
+#include "Cartesian3.h"
+#include "Matrix4.h"
+#include "BinnedSAH.h"
+
+//a bounding volume hierarchy over a mesh's triangles, for ray queries such as picking:
+//a ray visits the boxes it passes through, nearest first, and tests their triangles four at a time
+constexpr uint32_t MESH_BVH_SAH_BINS = 12;
+//one packet of triangles per leaf, unless they can't be told apart
+constexpr uint32_t MESH_BVH_MAX_LEAF_TRIANGLES = 4;
+//no deeper than the traversal stack
+constexpr uint32_t MESH_BVH_MAX_DEPTH = 64;
+
+//the closest hit along a ray. the hit point is (1 - u - v) of the triangle's first vertex,
+//u of its second & v of its third, and lies t directions along from the origin
+struct RayHit
+{
+    uint32_t triangle;
+    float t;
+    float u;
+    float v;
+};
+
+//a node of the hierarchy. the w lanes of the bounds are unused. an internal node's
+//children are the next node & rightChild, a leaf's triangles are in its packets
+struct alignas(16) MeshBVHNode
+{
+    float boundsMin[4];
+    float boundsMax[4];
+    uint32_t rightChild;
+    uint32_t firstPacket;
+    //0 for an internal node
+    uint32_t packetCount;
+};
+
+//four triangles laid out for testing together, as x, y & z rows of four lanes.
+//lanes without a triangle have no edges, so no ray can hit them
+struct alignas(16) TrianglePacket
+{
+    float vertex0[3][4];
+    float edge1[3][4];
+    float edge2[3][4];
+    uint32_t triangle[4];
+};
+
+//four rays traced together, as x, y & z rows of four lanes, each running from t = 0 to tMax.
+//coherent rays, such as shadow rays from neighbouring pixels, mostly visit the same nodes,
+//so a packet pays for one walk of the hierarchy instead of four. call setup() once filled in
+struct alignas(16) RayPacket
+{
+    float origin[3][4];
+    float direction[3][4];
+    float tMax[4];
+    float inverseDirection[3][4];
+
+    //fills in the inverse directions
+    auto setup() -> void;
+
+    //the same rays under an affine map, which keeps their parameters & so tMax. sets the result up
+    auto transform(const Matrix4 & matrix, RayPacket & result) const -> void;
+
+    //the lanes among active (bit i for lane i) whose rays meet the box somewhere in [0, tMax]
+    auto hitsBox(const float * boundsMin, const float * boundsMax, int active) const -> int;
+};
+
+class MeshBVH
+{
+public:
+    //triangle i has the corners indices[3i], indices[3i + 1] & indices[3i + 2]
+    auto build(const std::vector<Cartesian3> & positions, const std::vector<unsigned int> & indices) -> void;
+
+    //takes over nodes & packets that build() made for triangleCount triangles, such as ones read back from a file.
+    //false, leaving the hierarchy empty, unless they form a tree that the traversal can walk safely
+    auto assign(std::vector<MeshBVHNode> & newNodes, std::vector<TrianglePacket> & newPackets, uint32_t newTriangleCount) -> bool;
+
+    //the closest hit with 0 <= t < tMax, from either side of the triangles. false on a miss
+    auto intersect(const Cartesian3 & origin, const Cartesian3 & direction, RayHit & hit,
+                   float tMax = std::numeric_limits<float>::max()) const -> bool;
+
+    //true as soon as any hit with 0 <= t < tMax is found, which is all that a shadow ray needs
+    auto occluded(const Cartesian3 & origin, const Cartesian3 & direction,
+                  float tMax = std::numeric_limits<float>::max()) const -> bool;
+
+    //the lanes among active with a hit at 0 <= t < tMax, walking the hierarchy once for the packet
+    auto occluded(const RayPacket & packet, int active) const -> int;
+
+    inline auto getNodes() const -> const std::vector<MeshBVHNode> & { return nodes; }
+    inline auto getPackets() const -> const std::vector<TrianglePacket> & { return packets; }
+    inline auto getTriangleCount() const -> uint32_t { return triangleCount; }
+    //changes with every build(), so that whatever is derived from the mesh can tell it is out of date
+    inline auto getVersion() const -> uint32_t { return version; }
+
+private:
+    //builds the node over order[first, first + count) & everything below it, returning its index
+    auto buildNode(const std::vector<Cartesian3> & positions, const std::vector<unsigned int> & indices,
+                   uint32_t first, uint32_t count, uint32_t depth) -> uint32_t;
+    //the shared traversal: with anyHit, stops at the first hit rather than the closest
+    auto traverse(const Cartesian3 & origin, const Cartesian3 & direction, RayHit & hit, float tMax, bool anyHit) const -> bool;
+
+    std::vector<MeshBVHNode> nodes;
+    std::vector<TrianglePacket> packets;
+    uint32_t triangleCount = 0;
+    uint32_t version = 0;
+    //scratch for build(): the triangles in the order the nodes take them, & each one's box alongside
+    std::vector<uint32_t> order;
+    std::vector<SAHBox> triangleBoxes;
+};
+
+#endif // MESHBVH_H
@@ -0,0 +1,123 @@
+#include "MeshFile.h"
+#include <cstdio>
+#include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace
+{
+    constexpr uint64_t SECTION_ALIGNMENT = 16;
+
+    inline auto alignUp(uint64_t value) -> uint64_t
+    {
+        return (value + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+    }
+
+    auto getStamp(const char * fileName, uint64_t & size, int64_t & modified) -> bool
+    {
+        struct stat info;
+        if(stat(fileName, &info) != 0)
+            return false;
+        size = static_cast<uint64_t>(info.st_size);
+        //whole seconds would miss a rewrite within the same second, so use the nanoseconds where stat() has them
+#if defined(__APPLE__)
+        modified = static_cast<int64_t>(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+        modified = static_cast<int64_t>(info.st_mtime) * 1000000000;
+#else
+        modified = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+        return true;
+    }
+};
+
+auto MeshFile::open(const char * fileName) -> bool
+{
+    if(!file.open(fileName))
+        return false;
+
+    if(file.size() < sizeof(MeshFileHeader))
+        return false;
+
+    memcpy(&header, file.data(), sizeof(MeshFileHeader));
+    MeshFileHeader expected;
+    if(memcmp(header.magic, expected.magic, sizeof(expected.magic)) != 0 ||
+       header.version != VERSION ||
+       header.byteOrder != expected.byteOrder)
+        return false;
+
+    for(auto & section : header.sections)
+    {
+        if(section.offset < sizeof(MeshFileHeader) || section.offset > file.size() || section.bytes > file.size() - section.offset)
+            return false;
+    }
+    return true;
+}
+
+auto MeshFile::stampSource(const char * sourceFileName, MeshFileHeader & header) -> bool
+{
+    return getStamp(sourceFileName, header.sourceSize, header.sourceModified);
+}
+
+auto MeshFile::matchesSource(const char * sourceFileName, const MeshFileHeader & header) -> bool
+{
+    uint64_t size = 0;
+    int64_t modified = 0;
+    if(!getStamp(sourceFileName, size, modified))
+        return false;
+    return size == header.sourceSize && modified == header.sourceModified;
+}
+
+auto MeshFile::cacheFileName(const char * sourceFileName) -> std::string
+{
+    return std::string(sourceFileName) + ".fglmesh";
+}
+
+auto MeshFile::write(const char * fileName, MeshFileHeader header, const void * const data[MESH_SECTION_COUNT]) -> bool
+{
+    header.version = VERSION;
+
+    uint64_t offset = alignUp(sizeof(MeshFileHeader));
+    for(auto & section : header.sections)
+    {
+        section.offset = offset;
+        offset = alignUp(offset + section.bytes);
+    }
+
+    auto temporaryName = std::string(fileName) + ".tmp";
+    {
+        std::ofstream stream(temporaryName, std::ios::binary | std::ios::trunc);
+        if(!stream.good())
+            return false;
+
+        const char padding[SECTION_ALIGNMENT] = {0};
+        stream.write(reinterpret_cast<const char *>(&header), sizeof(MeshFileHeader));
+        uint64_t written = sizeof(MeshFileHeader);
+        for(uint32_t i = 0; i < MESH_SECTION_COUNT; i++)
+        {
+            stream.write(padding, header.sections[i].offset - written);
+            stream.write(static_cast<const char *>(data[i]), header.sections[i].bytes);
+            written = header.sections[i].offset + header.sections[i].bytes;
+        }
+        stream.write(padding, offset - written);
+
+        if(!stream.good())
+        {
+            stream.close();
+            std::remove(temporaryName.c_str());
+            return false;
+        }
+    }
+
+    //rename replaces atomically on POSIX, elsewhere the old file has to go first
+    if(std::rename(temporaryName.c_str(), fileName) != 0)
+    {
+        std::remove(fileName);
+        if(std::rename(temporaryName.c_str(), fileName) != 0)
+        {
+            std::remove(temporaryName.c_str());
+            return false;
+        }
+    }
+    return true;
+}
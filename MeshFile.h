@@ -0,0 +1,109 @@
+#ifndef MESHFILE_H
+#define MESHFILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <cstring>
+#include "MappedFile.h"
+
+//versioned binary mesh format used to cache parsed .obj files, along with what is derived from them:
+//the levels of detail, welded & reordered, with their meshlets, and the hierarchy for ray queries.
+//the file is a fixed header followed by flat arrays, each aligned to 16 bytes,
+//so that loading is a map plus one copy per array with no parsing & no mesh processing at all.
+
+enum MeshSection : uint32_t
+{
+    MESH_VERTICES = 0,          //Cartesian3
+    MESH_NORMALS,               //Cartesian3
+    MESH_TEXCOORDS,             //Cartesian3
+    MESH_FACE_OFFSETS,          //uint32_t, faces + 1
+    MESH_FACE_VERTICES,         //uint32_t per corner
+    MESH_FACE_NORMALS,          //uint32_t per corner
+    MESH_FACE_TEXCOORDS,        //uint32_t per corner
+    MESH_LEVELS,                //MeshFileLevel per level of detail, full detail first
+    MESH_LEVEL_VERTICES,        //Cartesian3, each level's welded vertices in turn
+    MESH_LEVEL_NORMALS,         //Cartesian3, alongside the vertices
+    MESH_LEVEL_TEXCOORDS,       //Cartesian3, alongside the vertices
+    MESH_LEVEL_INDICES,         //uint32_t, each level's triangles in turn, indexing its own vertices
+    MESH_LEVEL_MESHLETS,        //Meshlet, each level's in turn, indexing its own indices
+    MESH_BVH_NODES,             //MeshBVHNode
+    MESH_BVH_PACKETS,           //TrianglePacket
+    MESH_SECTION_COUNT
+};
+
+//how much of the level sections one level of detail takes up
+struct MeshFileLevel
+{
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    uint32_t meshletCount = 0;
+    float error = 0.f;
+};
+
+struct MeshFileSection
+{
+    uint64_t offset = 0;
+    uint64_t bytes = 0;
+};
+
+struct MeshFileHeader
+{
+    char magic[8] = {'F', 'G', 'L', 'M', 'E', 'S', 'H', '\0'};
+    uint32_t version = 0;
+    //written as 0x01020304, anything else means the file came from another byte order
+    uint32_t byteOrder = 0x01020304;
+    //size & modification time, in nanoseconds, of the source file the mesh was built from
+    uint64_t sourceSize = 0;
+    int64_t sourceModified = 0;
+    //bounds precomputed at write time
+    float centreOfGravity[3] = {0, 0, 0};
+    float objectSize = 0;
+    //vertex cache miss ratios of the full detail mesh before & after it was reordered
+    float originalACMR = 0;
+    float optimisedACMR = 0;
+    MeshFileSection sections[MESH_SECTION_COUNT];
+};
+
+class MeshFile
+{
+public:
+    //bump whenever the layout or the meaning of a section changes
+    static constexpr uint32_t VERSION = 2;
+
+    MeshFile() = default;
+
+    //maps the file and checks magic, version, byte order and section bounds
+    auto open(const char * fileName) -> bool;
+    inline auto getHeader() const -> const MeshFileHeader & { return header; }
+
+    //copies one section into a vector, which is a single memcpy
+    template<typename T>
+    auto read(MeshSection which, std::vector<T> & out) const -> bool
+    {
+        auto & section = header.sections[which];
+        if(section.bytes % sizeof(T) != 0)
+            return false;
+        out.resize(section.bytes / sizeof(T));
+        if(section.bytes != 0)
+            memcpy(static_cast<void *>(out.data()), file.data() + section.offset, section.bytes);
+        return true;
+    }
+
+    //fills in the source stamp of header from the file on disk
+    static auto stampSource(const char * sourceFileName, MeshFileHeader & header) -> bool;
+    //true when the header was built from the source file as it is on disk now
+    static auto matchesSource(const char * sourceFileName, const MeshFileHeader & header) -> bool;
+    //name of the cache file that sits next to a source file
+    static auto cacheFileName(const char * sourceFileName) -> std::string;
+
+    //writes header plus the sections. header.sections[i].bytes must be filled in,
+    //the offsets are computed here. writes to a temporary and renames, so readers never see half a file
+    static auto write(const char * fileName, MeshFileHeader header, const void * const data[MESH_SECTION_COUNT]) -> bool;
+
+private:
+    MappedFile file;
+    MeshFileHeader header;
+};
+
+#endif // MESHFILE_H
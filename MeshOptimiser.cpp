@@ -0,0 +1,290 @@
+#include "MeshOptimiser.h"
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    constexpr uint32_t EMPTY_SLOT = std::numeric_limits<uint32_t>::max();
+
+    inline auto hashTriple(const WeldedVertex & key) -> uint32_t
+    {
+        uint32_t hash = key.vertex * 0x9e3779b1u;
+        hash ^= key.normal * 0x85ebca77u + (hash << 6) + (hash >> 2);
+        hash ^= key.texCoord * 0xc2b2ae3du + (hash << 6) + (hash >> 2);
+        return hash ^ (hash >> 15);
+    }
+
+    //FIFO cache simulation with time stamps : a vertex is resident if it was inserted
+    //within the last cacheSize misses, and flushing is just moving time on
+    class CacheSimulator
+    {
+    public:
+        CacheSimulator(uint32_t vertexCount, uint32_t cacheSize)
+            : insertedAt(vertexCount, 0), cacheSize(cacheSize), time(cacheSize) {}
+
+        //true on a miss
+        inline auto access(uint32_t vertex) -> bool
+        {
+            if(time - insertedAt[vertex] < cacheSize)
+                return false;
+            insertedAt[vertex] = ++time;
+            return true;
+        }
+
+        inline auto flush() -> void { time += cacheSize; }
+
+    private:
+        std::vector<uint64_t> insertedAt;
+        uint64_t cacheSize;
+        uint64_t time;
+    };
+};
+
+auto MeshOptimiser::weld(const std::vector<uint32_t> & cornerVertices, const std::vector<uint32_t> & cornerNormals,
+                         const std::vector<uint32_t> & cornerTexCoords, std::vector<uint32_t> & indices,
+                         std::vector<WeldedVertex> & unique) -> void
+{
+    auto cornerCount = cornerVertices.size();
+    indices.resize(cornerCount);
+    unique.clear();
+
+    //open addressing, at most half full
+    size_t tableSize = 16;
+    while(tableSize < cornerCount * 2)
+        tableSize <<= 1;
+    std::vector<uint32_t> table(tableSize, EMPTY_SLOT);
+    auto mask = tableSize - 1;
+
+    for(size_t corner = 0; corner < cornerCount; corner++)
+    {
+        WeldedVertex key = {cornerVertices[corner], cornerNormals[corner], cornerTexCoords[corner]};
+        auto slot = hashTriple(key) & mask;
+        while(table[slot] != EMPTY_SLOT)
+        {
+            auto & other = unique[table[slot]];
+            if(other.vertex == key.vertex && other.normal == key.normal && other.texCoord == key.texCoord)
+                break;
+            slot = (slot + 1) & mask;
+        }
+        if(table[slot] == EMPTY_SLOT)
+        {
+            table[slot] = static_cast<uint32_t>(unique.size());
+            unique.emplace_back(key);
+        }
+        indices[corner] = table[slot];
+    }
+}
+
+auto MeshOptimiser::optimiseVertexCache(std::vector<uint32_t> & indices, uint32_t vertexCount, uint32_t cacheSize,
+                                        std::vector<uint32_t> & clusters) -> void
+{
+    auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    clusters.assign(1, 0);
+    if(triangleCount == 0)
+    {
+        clusters.push_back(0);
+        return;
+    }
+
+    //vertex -> triangle adjacency, and the number of triangles still to emit per vertex
+    std::vector<uint32_t> live(vertexCount, 0);
+    for(auto index : indices)
+        live[index]++;
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for(uint32_t vertex = 0; vertex < vertexCount; vertex++)
+        offsets[vertex + 1] = offsets[vertex] + live[vertex];
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        auto fill = offsets;
+        for(uint32_t triangle = 0; triangle < triangleCount; triangle++)
+            for(uint32_t corner = 0; corner < 3; corner++)
+                adjacency[fill[indices[triangle * 3 + corner]]++] = triangle;
+    }
+
+    std::vector<uint64_t> cacheTime(vertexCount, 0);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    uint64_t time = cacheSize + 1;
+    uint32_t cursor = 0;
+    int64_t fanning = indices[0];
+
+    while(fanning >= 0)
+    {
+        //emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for(auto t = offsets[fanning]; t < offsets[fanning + 1]; t++)
+        {
+            auto triangle = adjacency[t];
+            if(emitted[triangle])
+                continue;
+            for(uint32_t corner = 0; corner < 3; corner++)
+            {
+                auto vertex = indices[triangle * 3 + corner];
+                output.emplace_back(vertex);
+                deadEnds.emplace_back(vertex);
+                candidates.emplace_back(vertex);
+                live[vertex]--;
+                if(time - cacheTime[vertex] > cacheSize)
+                    cacheTime[vertex] = time++;
+            }
+            emitted[triangle] = 1;
+        }
+
+        //next fanning vertex : the oldest one in the 1-ring that will still be in the cache
+        //after its own triangles have been emitted
+        int64_t next = -1;
+        int64_t bestPriority = -1;
+        for(auto vertex : candidates)
+        {
+            if(live[vertex] == 0)
+                continue;
+            int64_t priority = 0;
+            if(time - cacheTime[vertex] + 2 * live[vertex] <= cacheSize)
+                priority = time - cacheTime[vertex];
+            if(priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = vertex;
+            }
+        }
+
+        if(next == -1)
+        {
+            //dead end : back up through recently used vertices, then fall back to input order
+            while(!deadEnds.empty() && next == -1)
+            {
+                auto vertex = deadEnds.back();
+                deadEnds.pop_back();
+                if(live[vertex] > 0)
+                    next = vertex;
+            }
+            while(next == -1 && cursor < vertexCount)
+            {
+                if(live[cursor] > 0)
+                    next = cursor;
+                cursor++;
+            }
+            //the cache is effectively cold from here on
+            auto boundary = static_cast<uint32_t>(output.size() / 3);
+            if(next != -1 && boundary != clusters.back())
+                clusters.emplace_back(boundary);
+        }
+        fanning = next;
+    }
+
+    clusters.emplace_back(triangleCount);
+    indices.swap(output);
+}
+
+auto MeshOptimiser::optimiseOverdraw(std::vector<uint32_t> & indices, const std::vector<Cartesian3> & positions,
+                                     const std::vector<uint32_t> & clusters, uint32_t cacheSize, float threshold) -> void
+{
+    auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    if(triangleCount == 0 || clusters.size() < 2)
+        return;
+
+    //split the hard clusters wherever the running ACMR is already good enough
+    auto limit = acmr(indices, static_cast<uint32_t>(positions.size()), cacheSize) * threshold;
+    CacheSimulator cache(static_cast<uint32_t>(positions.size()), cacheSize);
+    std::vector<uint32_t> pieces(1, 0);
+    for(size_t cluster = 0; cluster + 1 < clusters.size(); cluster++)
+    {
+        uint32_t misses = 0;
+        uint32_t start = clusters[cluster];
+        cache.flush();
+        for(auto triangle = clusters[cluster]; triangle < clusters[cluster + 1]; triangle++)
+        {
+            for(uint32_t corner = 0; corner < 3; corner++)
+                misses += cache.access(indices[triangle * 3 + corner]);
+            if(triangle + 1 < clusters[cluster + 1] && misses <= limit * (triangle + 1 - start))
+            {
+                pieces.emplace_back(triangle + 1);
+                start = triangle + 1;
+                misses = 0;
+                cache.flush();
+            }
+        }
+        pieces.emplace_back(clusters[cluster + 1]);
+    }
+    pieces.erase(std::unique(pieces.begin(), pieces.end()), pieces.end());
+
+    //area weighted centroid & normal per piece, and for the whole mesh
+    auto pieceCount = pieces.size() - 1;
+    std::vector<Cartesian3> centroids(pieceCount), normals(pieceCount);
+    std::vector<float> areas(pieceCount, 0.f);
+    Cartesian3 meshCentroid(0, 0, 0);
+    float meshArea = 0.f;
+    for(size_t piece = 0; piece < pieceCount; piece++)
+    {
+        Cartesian3 centroid(0, 0, 0), normal(0, 0, 0);
+        float area = 0.f;
+        for(auto triangle = pieces[piece]; triangle < pieces[piece + 1]; triangle++)
+        {
+            auto & a = positions[indices[triangle * 3]];
+            auto & b = positions[indices[triangle * 3 + 1]];
+            auto & c = positions[indices[triangle * 3 + 2]];
+            auto cross = (b - a).cross(c - a);
+            auto twiceArea = cross.length();
+            centroid = centroid + (a + b + c) * (twiceArea / 3.f);
+            normal = normal + cross;
+            area += twiceArea;
+        }
+        meshCentroid = meshCentroid + centroid;
+        meshArea += area;
+        centroids[piece] = area > 0.f ? centroid / area : positions[indices[pieces[piece] * 3]];
+        normals[piece] = normal;
+        areas[piece] = area;
+    }
+    if(meshArea > 0.f)
+        meshCentroid = meshCentroid / meshArea;
+
+    //pieces far out along their own normal are likely to occlude the rest, so they go first
+    std::vector<float> keys(pieceCount);
+    for(size_t piece = 0; piece < pieceCount; piece++)
+    {
+        auto length = normals[piece].length();
+        keys[piece] = length > 0.f ? (centroids[piece] - meshCentroid).dot(normals[piece] / length) : 0.f;
+    }
+    std::vector<uint32_t> order(pieceCount);
+    for(size_t piece = 0; piece < pieceCount; piece++)
+        order[piece] = static_cast<uint32_t>(piece);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for(auto piece : order)
+        output.insert(output.end(), indices.begin() + pieces[piece] * 3, indices.begin() + pieces[piece + 1] * 3);
+    indices.swap(output);
+}
+
+auto MeshOptimiser::optimiseVertexFetch(std::vector<uint32_t> & indices, uint32_t vertexCount, std::vector<uint32_t> & remap) -> uint32_t
+{
+    remap.assign(vertexCount, EMPTY_SLOT);
+    uint32_t next = 0;
+    for(auto & index : indices)
+    {
+        if(remap[index] == EMPTY_SLOT)
+            remap[index] = next++;
+        index = remap[index];
+    }
+    //vertices no triangle uses keep their relative order at the end
+    for(auto & target : remap)
+        if(target == EMPTY_SLOT)
+            target = next++;
+    return next;
+}
+
+auto MeshOptimiser::acmr(const std::vector<uint32_t> & indices, uint32_t vertexCount, uint32_t cacheSize) -> float
+{
+    if(indices.size() < 3)
+        return 0.f;
+    CacheSimulator cache(vertexCount, cacheSize);
+    uint64_t misses = 0;
+    for(auto index : indices)
+        misses += cache.access(index);
+    return static_cast<float>(misses) / (indices.size() / 3);
+}
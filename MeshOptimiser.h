@@ -0,0 +1,47 @@
+#ifndef MESHOPTIMISER_H
+#define MESHOPTIMISER_H
+
+#include <cstdint>
+#include <vector>
+#include "Cartesian3.h"
+
+//one-time preprocessing of static triangle meshes for the indexed draw path.
+//all index lists are plain triangle lists, three entries per triangle.
+
+//the source attributes a welded vertex was built from
+struct WeldedVertex
+{
+    uint32_t vertex;
+    uint32_t normal;
+    uint32_t texCoord;
+};
+
+namespace MeshOptimiser
+{
+    //merges corners with identical (vertex, normal, texCoord) triples.
+    //indices receives one welded index per corner, unique the triple behind each welded vertex
+    auto weld(const std::vector<uint32_t> & cornerVertices, const std::vector<uint32_t> & cornerNormals,
+              const std::vector<uint32_t> & cornerTexCoords, std::vector<uint32_t> & indices,
+              std::vector<WeldedVertex> & unique) -> void;
+
+    //reorders triangles for a FIFO post-transform cache of cacheSize entries (Tipsify, Sander et al. 2007).
+    //clusters receives the first triangle of every run that starts with a cold cache, plus the triangle count
+    auto optimiseVertexCache(std::vector<uint32_t> & indices, uint32_t vertexCount, uint32_t cacheSize,
+                             std::vector<uint32_t> & clusters) -> void;
+
+    //reorders the clusters so that those facing outwards from the centre of the mesh are drawn first
+    //and hide what is behind them. clusters are split further wherever their running ACMR falls
+    //below threshold times the ACMR of the whole mesh, so the cache locality is mostly kept
+    auto optimiseOverdraw(std::vector<uint32_t> & indices, const std::vector<Cartesian3> & positions,
+                          const std::vector<uint32_t> & clusters, uint32_t cacheSize, float threshold = 1.05f) -> void;
+
+    //renumbers the vertices in the order the triangles first use them, so fetches walk memory forwards.
+    //remap receives the new index of every old vertex
+    auto optimiseVertexFetch(std::vector<uint32_t> & indices, uint32_t vertexCount, std::vector<uint32_t> & remap) -> uint32_t;
+
+    //average cache miss ratio : vertices transformed per triangle with a FIFO cache of cacheSize entries.
+    //0.5 is the ideal for a large regular mesh, 3 means no reuse at all
+    auto acmr(const std::vector<uint32_t> & indices, uint32_t vertexCount, uint32_t cacheSize) -> float;
+};
+
+#endif // MESHOPTIMISER_H
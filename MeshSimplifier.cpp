@@ -0,0 +1,490 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <unordered_set>
+
+namespace
+{
+    constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    //border & seam edges weigh this much more than the faces, relative to their squared length
+    constexpr double SEAM_WEIGHT = 10.0;
+
+    //symmetric 4x4 quadric, plus the face area behind it so errors can be averaged
+    struct Quadric
+    {
+        double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+        double b0 = 0, b1 = 0, b2 = 0, c = 0;
+        double area = 0;
+
+        inline auto addPlane(const Cartesian3 & normal, double d, double weight) -> void
+        {
+            double x = normal.x, y = normal.y, z = normal.z;
+            a00 += weight * x * x; a01 += weight * x * y; a02 += weight * x * z;
+            a11 += weight * y * y; a12 += weight * y * z; a22 += weight * z * z;
+            b0 += weight * x * d; b1 += weight * y * d; b2 += weight * z * d;
+            c += weight * d * d;
+        }
+
+        inline auto operator+=(const Quadric & other) -> Quadric &
+        {
+            a00 += other.a00; a01 += other.a01; a02 += other.a02;
+            a11 += other.a11; a12 += other.a12; a22 += other.a22;
+            b0 += other.b0; b1 += other.b1; b2 += other.b2;
+            c += other.c; area += other.area;
+            return *this;
+        }
+
+        inline auto evaluate(const Cartesian3 & v) const -> double
+        {
+            double x = v.x, y = v.y, z = v.z;
+            return a00 * x * x + a11 * y * y + a22 * z * z
+                 + 2 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                 + 2 * (b0 * x + b1 * y + b2 * z) + c;
+        }
+    };
+
+    inline auto edgeKey(uint32_t a, uint32_t b) -> uint64_t
+    {
+        return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+    }
+
+    struct Candidate
+    {
+        double cost;
+        uint32_t vertex;
+        uint32_t version;
+        inline auto operator<(const Candidate & other) const -> bool { return cost > other.cost; }
+    };
+
+    class Simplifier
+    {
+    public:
+        Simplifier(const std::vector<uint32_t> & indices, const std::vector<Cartesian3> & positions,
+                   const std::vector<uint32_t> & positionIds, const std::vector<uint32_t> & seamIds);
+
+        auto run(const std::vector<uint32_t> & targets, float maxError,
+                 std::vector<std::vector<uint32_t>> & levels, std::vector<float> & errors) -> void;
+
+    private:
+        auto canMove(uint32_t p) const -> bool { return !pinned[p] && (seamCount[p] == 0 || seamCount[p] == 2); }
+        auto gatherNeighbours(uint32_t p, std::vector<uint32_t> & out) -> void;
+        auto isValid(uint32_t p, uint32_t q, const std::vector<uint32_t> & neighbours) -> bool;
+        auto collapseCost(uint32_t p, uint32_t q) const -> double;
+        auto updateCandidate(uint32_t p) -> void;
+        auto collapse(uint32_t p, uint32_t q) -> void;
+        auto snapshot(std::vector<uint32_t> & out) const -> void;
+
+        const std::vector<Cartesian3> & positions;
+        std::vector<uint32_t> trianglePositions;
+        std::vector<uint32_t> triangleWedges;
+        std::vector<uint8_t> alive;
+        uint32_t aliveCount = 0;
+
+        std::vector<std::vector<uint32_t>> vertexTriangles;
+        std::vector<Quadric> quadrics;
+        std::vector<uint8_t> pinned;
+        std::vector<uint8_t> seamCount;
+        std::unordered_set<uint64_t> seamEdges;
+
+        std::vector<uint32_t> target;
+        std::vector<uint32_t> version;
+        std::priority_queue<Candidate> heap;
+
+        //scratch
+        std::vector<uint32_t> neighboursP, neighboursQ, candidates, ring;
+        std::vector<std::pair<double, uint32_t>> costs;
+    };
+
+    Simplifier::Simplifier(const std::vector<uint32_t> & indices, const std::vector<Cartesian3> & positions,
+                           const std::vector<uint32_t> & positionIds, const std::vector<uint32_t> & seamIds)
+        : positions(positions)
+    {
+        auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+        auto vertexCount = positions.size();
+        trianglePositions.resize(triangleCount * 3);
+        triangleWedges.assign(indices.begin(), indices.begin() + triangleCount * 3);
+        alive.assign(triangleCount, 1);
+        vertexTriangles.resize(vertexCount);
+        quadrics.resize(vertexCount);
+        pinned.assign(vertexCount, 0);
+        seamCount.assign(vertexCount, 0);
+        target.assign(vertexCount, NONE);
+        version.assign(vertexCount, 0);
+
+        //drop degenerate triangles up front, they carry no area & confuse the topology
+        for(uint32_t t = 0; t < triangleCount; t++)
+        {
+            for(uint32_t k = 0; k < 3; k++)
+                trianglePositions[t * 3 + k] = positionIds[triangleWedges[t * 3 + k]];
+            auto a = trianglePositions[t * 3], b = trianglePositions[t * 3 + 1], c = trianglePositions[t * 3 + 2];
+            if(a == b || b == c || c == a)
+                alive[t] = 0;
+            else
+            {
+                aliveCount++;
+                for(uint32_t k = 0; k < 3; k++)
+                    vertexTriangles[trianglePositions[t * 3 + k]].emplace_back(t);
+            }
+        }
+
+        //classify the edges : border (one triangle), seam (two that disagree on the seam ids),
+        //or non-manifold (more than two)
+        struct HalfEdge
+        {
+            uint64_t key;
+            uint32_t triangle;
+            uint32_t seamA, seamB;
+            inline auto operator<(const HalfEdge & other) const -> bool { return key < other.key; }
+        };
+        struct EdgeUse
+        {
+            uint64_t key;
+            uint32_t count;
+            uint32_t triangle;
+            bool seam;
+        };
+        std::vector<HalfEdge> halfEdges;
+        halfEdges.reserve(aliveCount * 3);
+        for(uint32_t t = 0; t < triangleCount; t++)
+        {
+            if(!alive[t])
+                continue;
+            for(uint32_t k = 0; k < 3; k++)
+            {
+                auto i = t * 3 + k, j = t * 3 + (k + 1) % 3;
+                auto a = trianglePositions[i], b = trianglePositions[j];
+                auto seamA = seamIds[triangleWedges[i]], seamB = seamIds[triangleWedges[j]];
+                if(a > b)
+                    std::swap(seamA, seamB);
+                halfEdges.push_back({edgeKey(a, b), t, seamA, seamB});
+            }
+        }
+        std::sort(halfEdges.begin(), halfEdges.end());
+        std::vector<EdgeUse> edges;
+        for(size_t first = 0, last = 0; first < halfEdges.size(); first = last)
+        {
+            EdgeUse use = {halfEdges[first].key, 0, halfEdges[first].triangle, false};
+            for(last = first; last < halfEdges.size() && halfEdges[last].key == use.key; last++)
+                use.seam |= halfEdges[last].seamA != halfEdges[first].seamA || halfEdges[last].seamB != halfEdges[first].seamB;
+            use.count = static_cast<uint32_t>(last - first);
+            if(use.count != 2 || use.seam)
+                edges.emplace_back(use);
+        }
+
+        //face quadrics, weighted by area
+        for(uint32_t t = 0; t < triangleCount; t++)
+        {
+            if(!alive[t])
+                continue;
+            auto & a = positions[trianglePositions[t * 3]];
+            auto & b = positions[trianglePositions[t * 3 + 1]];
+            auto & c = positions[trianglePositions[t * 3 + 2]];
+            auto normal = (b - a).cross(c - a);
+            auto length = normal.length();
+            if(length <= 0.f)
+                continue;
+            normal = normal / length;
+            Quadric face;
+            face.addPlane(normal, -normal.dot(a), length * 0.5);
+            face.area = length * 0.5;
+            for(uint32_t k = 0; k < 3; k++)
+                quadrics[trianglePositions[t * 3 + k]] += face;
+        }
+
+        //border & seam edges get a plane through the edge at right angles to the face, so that
+        //moving a vertex off the edge line costs a lot more than sliding along it
+        for(auto & use : edges)
+        {
+            auto a = static_cast<uint32_t>(use.key >> 32), b = static_cast<uint32_t>(use.key & 0xffffffffu);
+            if(use.count > 2)
+            {
+                pinned[a] = pinned[b] = 1;
+                continue;
+            }
+            if(use.count == 2 && !use.seam)
+                continue;
+            seamEdges.insert(use.key);
+            seamCount[a] = static_cast<uint8_t>(std::min(255, seamCount[a] + 1));
+            seamCount[b] = static_cast<uint8_t>(std::min(255, seamCount[b] + 1));
+
+            auto t = use.triangle;
+            auto & p0 = positions[trianglePositions[t * 3]];
+            auto faceNormal = (positions[trianglePositions[t * 3 + 1]] - p0).cross(positions[trianglePositions[t * 3 + 2]] - p0);
+            auto edge = positions[b] - positions[a];
+            auto normal = edge.cross(faceNormal);
+            auto length = normal.length();
+            if(length <= 0.f)
+                continue;
+            normal = normal / length;
+            Quadric plane;
+            plane.addPlane(normal, -normal.dot(positions[a]), edge.dot(edge) * SEAM_WEIGHT);
+            quadrics[a] += plane;
+            quadrics[b] += plane;
+        }
+
+        for(uint32_t p = 0; p < vertexCount; p++)
+            if(!vertexTriangles[p].empty())
+                updateCandidate(p);
+    }
+
+    auto Simplifier::gatherNeighbours(uint32_t p, std::vector<uint32_t> & out) -> void
+    {
+        //dead triangles are dropped from the lists lazily, here
+        auto & around = vertexTriangles[p];
+        around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t t) { return !alive[t]; }), around.end());
+        out.clear();
+        for(auto t : around)
+        {
+            for(uint32_t k = 0; k < 3; k++)
+            {
+                auto v = trianglePositions[t * 3 + k];
+                if(v != p && std::find(out.begin(), out.end(), v) == out.end())
+                    out.emplace_back(v);
+            }
+        }
+    }
+
+    auto Simplifier::collapseCost(uint32_t p, uint32_t q) const -> double
+    {
+        Quadric merged = quadrics[p];
+        merged += quadrics[q];
+        auto error = std::max(0.0, merged.evaluate(positions[q]));
+        return merged.area > 0 ? error / merged.area : error;
+    }
+
+    auto Simplifier::isValid(uint32_t p, uint32_t q, const std::vector<uint32_t> & neighbours) -> bool
+    {
+        if(!canMove(p))
+            return false;
+        //a vertex on a seam or border may only slide along it
+        if(seamCount[p] == 2 && seamEdges.count(edgeKey(p, q)) == 0)
+            return false;
+
+        //link condition : p & q may only share the neighbours opposite their shared triangles,
+        //otherwise the collapse pinches the surface
+        uint32_t shared = 0;
+        for(auto t : vertexTriangles[p])
+            if(alive[t] && (trianglePositions[t * 3] == q || trianglePositions[t * 3 + 1] == q || trianglePositions[t * 3 + 2] == q))
+                shared++;
+        if(shared == 0)
+            return false;
+        gatherNeighbours(q, neighboursQ);
+        uint32_t common = 0;
+        for(auto v : neighbours)
+            if(std::find(neighboursQ.begin(), neighboursQ.end(), v) != neighboursQ.end())
+                common++;
+        if(common != shared)
+            return false;
+
+        //no surviving triangle may flip over
+        for(auto t : vertexTriangles[p])
+        {
+            if(!alive[t])
+                continue;
+            Cartesian3 before[3], after[3];
+            bool hasQ = false;
+            for(uint32_t k = 0; k < 3; k++)
+            {
+                auto v = trianglePositions[t * 3 + k];
+                hasQ |= v == q;
+                before[k] = positions[v];
+                after[k] = positions[v == p ? q : v];
+            }
+            if(hasQ)
+                continue;
+            auto normalBefore = (before[1] - before[0]).cross(before[2] - before[0]);
+            auto normalAfter = (after[1] - after[0]).cross(after[2] - after[0]);
+            if(normalBefore.dot(normalAfter) <= 0.f)
+                return false;
+        }
+        return true;
+    }
+
+    auto Simplifier::updateCandidate(uint32_t p) -> void
+    {
+        version[p]++;
+        target[p] = NONE;
+        if(!canMove(p))
+            return;
+        //cost every neighbour, then validate cheapest first : usually the first one passes
+        gatherNeighbours(p, candidates);
+        costs.clear();
+        for(auto q : candidates)
+            costs.emplace_back(collapseCost(p, q), q);
+        std::sort(costs.begin(), costs.end());
+        for(auto & cost : costs)
+            if(isValid(p, cost.second, candidates))
+            {
+                target[p] = cost.second;
+                heap.push({cost.first, p, version[p]});
+                break;
+            }
+    }
+
+    auto Simplifier::collapse(uint32_t p, uint32_t q) -> void
+    {
+        //the triangles around p fall into regions separated by p's seam edges, and each region takes
+        //the attributes q has on that side, from the triangle that disappears there
+        if(seamCount[p] > 0)
+            gatherNeighbours(p, neighboursP);
+        auto & around = vertexTriangles[p];
+        around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t t) { return !alive[t]; }), around.end());
+        std::vector<uint32_t> region(around.size());
+        for(size_t i = 0; i < around.size(); i++)
+            region[i] = static_cast<uint32_t>(i);
+        auto find = [&](uint32_t i) { while(region[i] != i) i = region[i] = region[region[i]]; return i; };
+        if(seamCount[p] > 0)
+        {
+            for(size_t i = 0; i < around.size(); i++)
+                for(size_t j = i + 1; j < around.size(); j++)
+                    for(uint32_t k = 0; k < 3; k++)
+                    {
+                        auto v = trianglePositions[around[i] * 3 + k];
+                        if(v == p || seamEdges.count(edgeKey(p, v)))
+                            continue;
+                        auto & tj = around[j];
+                        if(trianglePositions[tj * 3] == v || trianglePositions[tj * 3 + 1] == v || trianglePositions[tj * 3 + 2] == v)
+                            region[find(static_cast<uint32_t>(j))] = find(static_cast<uint32_t>(i));
+                    }
+        }
+        else
+            std::fill(region.begin(), region.end(), 0);
+
+        std::vector<uint32_t> regionWedge(around.size(), NONE);
+        for(size_t i = 0; i < around.size(); i++)
+        {
+            auto t = around[i];
+            for(uint32_t k = 0; k < 3; k++)
+                if(trianglePositions[t * 3 + k] == q)
+                {
+                    regionWedge[find(static_cast<uint32_t>(i))] = triangleWedges[t * 3 + k];
+                    alive[t] = 0;
+                    aliveCount--;
+                }
+        }
+        for(size_t i = 0; i < around.size(); i++)
+        {
+            auto t = around[i];
+            if(!alive[t])
+                continue;
+            auto wedge = regionWedge[find(static_cast<uint32_t>(i))];
+            for(uint32_t k = 0; k < 3; k++)
+                if(trianglePositions[t * 3 + k] == p)
+                {
+                    trianglePositions[t * 3 + k] = q;
+                    if(wedge != NONE)
+                        triangleWedges[t * 3 + k] = wedge;
+                }
+            vertexTriangles[q].emplace_back(t);
+        }
+        around.clear();
+        around.shrink_to_fit();
+        auto & aroundQ = vertexTriangles[q];
+        aroundQ.erase(std::remove_if(aroundQ.begin(), aroundQ.end(), [&](uint32_t t) { return !alive[t]; }), aroundQ.end());
+
+        //p's seam edges now belong to q
+        if(seamCount[p] > 0)
+        {
+            seamEdges.erase(edgeKey(p, q));
+            for(auto v : neighboursP)
+            {
+                if(v == q || seamEdges.erase(edgeKey(p, v)) == 0)
+                    continue;
+                //an edge q already had merges with the moved one
+                if(!seamEdges.insert(edgeKey(q, v)).second)
+                {
+                    seamCount[q]--;
+                    seamCount[v]--;
+                }
+            }
+            seamCount[p] = 0;
+        }
+
+        quadrics[q] += quadrics[p];
+        target[p] = NONE;
+        version[p]++;
+
+        //the rest of the ring is re-costed lazily when it comes off the heap, except for
+        //vertices that had nowhere to go before & might have now
+        updateCandidate(q);
+        gatherNeighbours(q, ring);
+        for(auto v : ring)
+            if(target[v] == NONE)
+                updateCandidate(v);
+    }
+
+    auto Simplifier::snapshot(std::vector<uint32_t> & out) const -> void
+    {
+        out.clear();
+        out.reserve(aliveCount * 3);
+        for(size_t t = 0; t < alive.size(); t++)
+            if(alive[t])
+                out.insert(out.end(), triangleWedges.begin() + t * 3, triangleWedges.begin() + t * 3 + 3);
+    }
+
+    auto Simplifier::run(const std::vector<uint32_t> & targets, float maxError,
+                         std::vector<std::vector<uint32_t>> & levels, std::vector<float> & errors) -> void
+    {
+        double worst = 0;
+        double limit = double(maxError) * maxError;
+        size_t next = 0;
+        while(next < targets.size())
+        {
+            if(aliveCount <= targets[next])
+            {
+                levels.emplace_back();
+                snapshot(levels.back());
+                errors.emplace_back(static_cast<float>(std::sqrt(worst)));
+                next++;
+                continue;
+            }
+            if(heap.empty())
+                break;
+            auto candidate = heap.top();
+            heap.pop();
+            auto p = candidate.vertex;
+            auto q = target[p];
+            if(candidate.version != version[p] || q == NONE)
+                continue;
+            if(candidate.cost > limit)
+                break;
+
+            //the neighbourhood may have changed since the candidate was costed
+            if(vertexTriangles[q].empty())
+            {
+                updateCandidate(p);
+                continue;
+            }
+            auto cost = collapseCost(p, q);
+            if(cost > candidate.cost)
+            {
+                heap.push({cost, p, version[p]});
+                continue;
+            }
+            gatherNeighbours(p, candidates);
+            if(!isValid(p, q, candidates))
+            {
+                updateCandidate(p);
+                continue;
+            }
+            worst = std::max(worst, candidate.cost);
+            collapse(p, q);
+        }
+    }
+};
+
+auto MeshSimplifier::simplify(const std::vector<uint32_t> & indices, const std::vector<Cartesian3> & positions,
+                              const std::vector<uint32_t> & positionIds, const std::vector<uint32_t> & seamIds,
+                              const std::vector<uint32_t> & targets, float maxError,
+                              std::vector<std::vector<uint32_t>> & levels, std::vector<float> & errors) -> void
+{
+    levels.clear();
+    errors.clear();
+    if(indices.size() < 3 || targets.empty())
+        return;
+    Simplifier simplifier(indices, positions, positionIds, seamIds);
+    simplifier.run(targets, maxError, levels, errors);
+}
@@ -0,0 +1,29 @@
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <cstdint>
+#include <vector>
+#include "Cartesian3.h"
+
+//level of detail generation for welded triangle lists (see MeshOptimiser.h), by half-edge
+//collapses ordered by the quadric error metric (Garland & Heckbert 1997).
+//collapses only ever move a vertex onto a neighbour, so no new attributes are invented.
+
+namespace MeshSimplifier
+{
+    //indices are welded vertices, three per triangle. positionIds maps every welded vertex
+    //to its entry in positions, which is what the topology is built on; seamIds says which
+    //attributes must stay continuous, and edges where the two triangles disagree on them are
+    //kept in place like open borders. vertices where seams meet, and non-manifold ones, never move.
+    //
+    //targets are triangle counts in decreasing order: the first time the mesh gets down to each
+    //one, the surviving triangles are appended to levels & the largest error so far to errors.
+    //errors are RMS distances from the original surface in the units of positions, and
+    //simplification stops early once the next collapse would cost more than maxError
+    auto simplify(const std::vector<uint32_t> & indices, const std::vector<Cartesian3> & positions,
+                  const std::vector<uint32_t> & positionIds, const std::vector<uint32_t> & seamIds,
+                  const std::vector<uint32_t> & targets, float maxError,
+                  std::vector<std::vector<uint32_t>> & levels, std::vector<float> & errors) -> void;
+};
+
+#endif // MESHSIMPLIFIER_H
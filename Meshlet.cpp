@@ -0,0 +1,134 @@
+#include "Meshlet.h"
+#include "Homogeneous4.h"
+#include <algorithm>
+#include <cmath>
+
+auto MeshletBuilder::build(const std::vector<uint32_t> & indices, const std::vector<Cartesian3> & positions,
+                           std::vector<Meshlet> & meshlets, uint32_t maxVertices, uint32_t maxTriangles) -> void
+{
+    meshlets.clear();
+    auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+    //which meshlet last used each vertex, to count the distinct ones
+    std::vector<uint32_t> lastUse(positions.size(), UINT32_MAX);
+    uint32_t first = 0;
+    while(first < triangleCount)
+    {
+        auto id = static_cast<uint32_t>(meshlets.size());
+        uint32_t vertexCount = 0;
+        uint32_t last = first;
+        for(; last < triangleCount && last - first < maxTriangles; last++)
+        {
+            uint32_t added = 0;
+            for(uint32_t k = 0; k < 3; k++)
+                added += lastUse[indices[last * 3 + k]] != id;
+            if(vertexCount + added > maxVertices && last > first)
+                break;
+            for(uint32_t k = 0; k < 3; k++)
+                lastUse[indices[last * 3 + k]] = id;
+            vertexCount += added;
+        }
+
+        Meshlet meshlet;
+        meshlet.firstIndex = first * 3;
+        meshlet.indexCount = (last - first) * 3;
+
+        //sphere around the centre of the bounding box
+        Cartesian3 minimum = positions[indices[first * 3]], maximum = minimum;
+        for(auto i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++)
+        {
+            auto & p = positions[indices[i]];
+            minimum = Cartesian3(std::min(minimum.x, p.x), std::min(minimum.y, p.y), std::min(minimum.z, p.z));
+            maximum = Cartesian3(std::max(maximum.x, p.x), std::max(maximum.y, p.y), std::max(maximum.z, p.z));
+        }
+        meshlet.centre = (minimum + maximum) * 0.5f;
+        meshlet.radius = 0.f;
+        for(auto i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++)
+            meshlet.radius = std::max(meshlet.radius, (positions[indices[i]] - meshlet.centre).length());
+
+        //normal cone from the face normals, following the winding rather than the vertex normals
+        std::vector<Cartesian3> normals;
+        Cartesian3 axis(0, 0, 0);
+        for(auto t = first; t < last; t++)
+        {
+            auto & a = positions[indices[t * 3]];
+            auto normal = (positions[indices[t * 3 + 1]] - a).cross(positions[indices[t * 3 + 2]] - a);
+            auto length = normal.length();
+            if(length <= 0.f)
+                continue;
+            normals.emplace_back(normal / length);
+            axis = axis + normals.back();
+        }
+        meshlet.coneAxis = Cartesian3(0, 0, 1);
+        meshlet.coneCutoff = 2.f;
+        auto axisLength = axis.length();
+        if(axisLength > 0.f)
+        {
+            axis = axis / axisLength;
+            float minimumDot = 1.f;
+            for(auto & normal : normals)
+                minimumDot = std::min(minimumDot, normal.dot(axis));
+            meshlet.coneAxis = axis;
+            if(minimumDot > 0.f)
+                meshlet.coneCutoff = std::sqrt(1.f - minimumDot * minimumDot);
+        }
+        meshlets.emplace_back(meshlet);
+        first = last;
+    }
+}
+
+MeshletCuller::MeshletCuller(const Matrix4 & modelView, const Matrix4 & projection, bool cullBackFaces)
+    : cullBackFaces(cullBackFaces)
+{
+    //the clip planes of the projection, pulled back to object space (Gribb & Hartmann)
+    auto mvp = projection * modelView;
+    for(int plane = 0; plane < 6; plane++)
+    {
+        auto row = plane / 2;
+        float sign = plane % 2 == 0 ? 1.f : -1.f;
+        float length = 0.f;
+        for(int column = 0; column < 4; column++)
+        {
+            planes[plane][column] = mvp[3][column] + sign * mvp[row][column];
+            if(column < 3)
+                length += planes[plane][column] * planes[plane][column];
+        }
+        length = std::sqrt(length);
+        if(length > 0.f)
+            for(int column = 0; column < 4; column++)
+                planes[plane][column] /= length;
+    }
+
+    //an orthographic projection leaves w alone
+    orthographic = projection[3][0] == 0.f && projection[3][1] == 0.f && projection[3][2] == 0.f;
+    auto inverse = modelView.inverse();
+    auto origin = inverse * Homogeneous4(0.f, 0.f, 0.f, 1.f);
+    eye = Cartesian3(origin.x, origin.y, origin.z) / origin.w;
+    auto direction = inverse * Homogeneous4(0.f, 0.f, -1.f, 0.f);
+    viewDirection = Cartesian3(direction.x, direction.y, direction.z).unit();
+}
+
+auto MeshletCuller::isVisible(const Cartesian3 & centre, float radius) const -> bool
+{
+    for(int plane = 0; plane < 6; plane++)
+        if(planes[plane][0] * centre.x + planes[plane][1] * centre.y + planes[plane][2] * centre.z + planes[plane][3] < -radius)
+            return false;
+    return true;
+}
+
+auto MeshletCuller::isVisible(const Meshlet & meshlet) const -> bool
+{
+    auto & c = meshlet.centre;
+    if(!isVisible(c, meshlet.radius))
+        return false;
+
+    //back-facing when every normal in the cone points away from the viewer
+    if(cullBackFaces && meshlet.coneCutoff <= 1.f)
+    {
+        if(orthographic)
+            return viewDirection.dot(meshlet.coneAxis) < meshlet.coneCutoff;
+        auto toCentre = c - eye;
+        return toCentre.dot(meshlet.coneAxis) < meshlet.coneCutoff * toCentre.length() + meshlet.radius;
+    }
+    return true;
+}
@@ -0,0 +1,62 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <cstdint>
+#include <vector>
+#include "Cartesian3.h"
+#include "Matrix4.h"
+
+//a meshlet is a run of consecutive triangles in an index buffer, small enough to be
+//culled as a whole before any of its vertices are shaded
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 128;
+
+struct Meshlet
+{
+    //the triangles are indices [firstIndex, firstIndex + indexCount)
+    uint32_t firstIndex;
+    uint32_t indexCount;
+
+    //bounding sphere
+    Cartesian3 centre;
+    float radius;
+
+    //every face normal lies within the cone around coneAxis; coneCutoff is the sine of its
+    //half angle, and more than 1 when the cone is too wide to ever be back-facing
+    Cartesian3 coneAxis;
+    float coneCutoff;
+};
+
+namespace MeshletBuilder
+{
+    //splits the triangle list into meshlets of consecutive triangles, so it should already be
+    //ordered for locality (see MeshOptimiser::optimiseVertexCache). a meshlet is closed when
+    //another triangle would take it over maxVertices distinct vertices or maxTriangles triangles
+    auto build(const std::vector<uint32_t> & indices, const std::vector<Cartesian3> & positions,
+               std::vector<Meshlet> & meshlets, uint32_t maxVertices = MESHLET_MAX_VERTICES,
+               uint32_t maxTriangles = MESHLET_MAX_TRIANGLES) -> void;
+};
+
+//tests meshlets against the view volume & for facing away from the viewer, in object space
+class MeshletCuller
+{
+public:
+    //counter-clockwise faces are the front, as for FAKEGL_CULL_FACE
+    MeshletCuller(const Matrix4 & modelView, const Matrix4 & projection, bool cullBackFaces);
+
+    auto isVisible(const Meshlet & meshlet) const -> bool;
+
+    //the view volume test alone, for any bounding sphere in the same object space
+    auto isVisible(const Cartesian3 & centre, float radius) const -> bool;
+
+private:
+    //the six clip planes, normalised, with the inside positive
+    float planes[6][4];
+    bool cullBackFaces;
+    bool orthographic;
+    //the viewer : a position for perspective, a direction into the scene for orthographic
+    Cartesian3 eye;
+    Cartesian3 viewDirection;
+};
+
+#endif // MESHLET_H
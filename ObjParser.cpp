@@ -0,0 +1,402 @@
+#include "ObjParser.h"
+#include <cstring>
+#include <thread>
+#include <algorithm>
+
+namespace
+{
+    //which corner array a relative index belongs to
+    enum CornerAttribute : uint8_t
+    {
+        CORNER_VERTEX,
+        CORNER_TEXCOORD,
+        CORNER_NORMAL
+    };
+
+    //negative .obj indices count back from the last element read so far.
+    //a chunk does not know how many elements precede it, so these are fixed up at merge time
+    struct RelativeIndex
+    {
+        uint32_t corner;
+        CornerAttribute attribute;
+        int32_t localIndex;
+    };
+
+    //everything parsed out of one line-aligned piece of the file
+    struct ObjChunk
+    {
+        std::vector<Cartesian3> vertices;
+        std::vector<Cartesian3> normals;
+        std::vector<Cartesian3> textureCoords;
+        std::vector<uint32_t> faceSizes;
+        std::vector<uint32_t> cornerVertices;
+        std::vector<uint32_t> cornerNormals;
+        std::vector<uint32_t> cornerTexCoords;
+        std::vector<RelativeIndex> relativeIndices;
+        bool missingNormals = false;
+        bool missingTexCoords = false;
+    };
+
+    inline auto isDigit(char c) -> bool
+    {
+        return static_cast<unsigned char>(c - '0') < 10;
+    }
+
+    inline auto isBlank(char c) -> bool
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    inline auto skipBlanks(const char * p, const char * end) -> const char *
+    {
+        while(p != end && isBlank(*p))
+            ++p;
+        return p;
+    }
+
+    inline auto nextLine(const char * p, const char * end) -> const char *
+    {
+        auto newLine = static_cast<const char *>(memchr(p, '\n', end - p));
+        return newLine == nullptr ? end : newLine + 1;
+    }
+
+    //powers of ten that are exactly representable as doubles
+    const double exactPowers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    inline auto scaleByPowerOfTen(double value, int32_t exponent) -> double
+    {
+        //one exact multiply/divide keeps the result correctly rounded for typical .obj numbers
+        while(exponent > 22)
+        {
+            value *= 1e22;
+            exponent -= 22;
+        }
+        while(exponent < -22)
+        {
+            value /= 1e22;
+            exponent += 22;
+        }
+        return exponent < 0 ? value / exactPowers[-exponent] : value * exactPowers[exponent];
+    }
+
+    //reads up to three floats, leaving any missing ones at zero
+    inline auto parseTriple(const char * p, const char * end) -> Cartesian3
+    {
+        Cartesian3 result;
+        for(int32_t i = 0; i < 3; i++)
+        {
+            p = skipBlanks(p, end);
+            auto next = ObjParser::parseFloat(p, end, result[i]);
+            if(next == p)
+                break;
+            p = next;
+        }
+        return result;
+    }
+
+    //converts a 1-based (or negative, relative) .obj index into our 0-based form
+    inline auto resolveIndex(ObjChunk & chunk, CornerAttribute attribute, int32_t index, uint32_t localCount) -> uint32_t
+    {
+        if(index > 0)
+            return static_cast<uint32_t>(index - 1);
+        if(index < 0)
+        {
+            chunk.relativeIndices.push_back({static_cast<uint32_t>(chunk.cornerVertices.size()), attribute, static_cast<int32_t>(localCount) + index});
+        }
+        return 0;
+    }
+
+    auto parseFace(const char * p, const char * end, ObjChunk & chunk) -> void
+    {
+        uint32_t corners = 0;
+        while(true)
+        {
+            p = skipBlanks(p, end);
+            if(p == end || *p == '\n')
+                break;
+
+            int32_t vertexID = 0, texCoordID = 0, normalID = 0;
+            auto next = ObjParser::parseInt(p, end, vertexID);
+            if(next == p)
+                break;
+            p = next;
+            if(p != end && *p == '/')
+            {
+                ++p;
+                if(p != end && *p != '/')
+                    p = ObjParser::parseInt(p, end, texCoordID);
+                if(p != end && *p == '/')
+                {
+                    ++p;
+                    p = ObjParser::parseInt(p, end, normalID);
+                }
+            }
+
+            if(texCoordID == 0)
+                chunk.missingTexCoords = true;
+            if(normalID == 0)
+                chunk.missingNormals = true;
+
+            //resolve in this order so that the relative fix-ups see the corner we are about to add
+            auto vertex = resolveIndex(chunk, CORNER_VERTEX, vertexID, chunk.vertices.size());
+            auto texCoord = resolveIndex(chunk, CORNER_TEXCOORD, texCoordID, chunk.textureCoords.size());
+            auto normal = resolveIndex(chunk, CORNER_NORMAL, normalID, chunk.normals.size());
+            chunk.cornerVertices.push_back(vertex);
+            chunk.cornerTexCoords.push_back(texCoord);
+            chunk.cornerNormals.push_back(normal);
+            corners++;
+
+            //skip anything we did not understand in this token
+            while(p != end && !isBlank(*p) && *p != '\n')
+                ++p;
+        }
+
+        //as long as the face has at least three vertices, keep it
+        if(corners > 2)
+        {
+            chunk.faceSizes.push_back(corners);
+        }
+        else
+        {
+            auto kept = chunk.cornerVertices.size() - corners;
+            while(!chunk.relativeIndices.empty() && chunk.relativeIndices.back().corner >= kept)
+                chunk.relativeIndices.pop_back();
+            chunk.cornerVertices.resize(kept);
+            chunk.cornerTexCoords.resize(kept);
+            chunk.cornerNormals.resize(kept);
+        }
+    }
+
+    auto parseChunk(const char * p, const char * end, ObjChunk & chunk) -> void
+    {
+        //rough guess from typical line lengths, saves most of the regrowth
+        auto estimate = static_cast<size_t>(end - p) / 40;
+        chunk.vertices.reserve(estimate / 3);
+        chunk.cornerVertices.reserve(estimate);
+
+        while(p != end)
+        {
+            auto line = skipBlanks(p, end);
+            auto lineEnd = nextLine(line, end);
+            if(line + 1 < end)
+            {
+                switch(line[0])
+                {
+                case 'v':
+                    if(isBlank(line[1]))
+                        chunk.vertices.push_back(parseTriple(line + 2, end));
+                    else if(line[1] == 'n')
+                        chunk.normals.push_back(parseTriple(line + 2, end));
+                    else if(line[1] == 't')
+                        chunk.textureCoords.push_back(parseTriple(line + 2, end));
+                    break;
+                case 'f':
+                    if(isBlank(line[1]))
+                        parseFace(line + 2, end, chunk);
+                    break;
+                default:
+                    break;
+                }
+            }
+            p = lineEnd;
+        }
+    }
+
+    template<typename T>
+    inline auto append(std::vector<T> & dst, const std::vector<T> & src) -> void
+    {
+        dst.insert(dst.end(), src.begin(), src.end());
+    }
+};
+
+auto ObjParser::parseInt(const char * first, const char * last, int32_t & value) -> const char *
+{
+    auto p = first;
+    bool negative = false;
+    if(p != last && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        ++p;
+    }
+    if(p == last || !isDigit(*p))
+        return first;
+
+    int32_t result = 0;
+    while(p != last && isDigit(*p))
+    {
+        result = result * 10 + (*p - '0');
+        ++p;
+    }
+    value = negative ? -result : result;
+    return p;
+}
+
+auto ObjParser::parseFloat(const char * first, const char * last, float & value) -> const char *
+{
+    auto p = first;
+    bool negative = false;
+    if(p != last && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        ++p;
+    }
+
+    //accumulate up to 19 significant digits, the rest only shift the exponent
+    uint64_t mantissa = 0;
+    int32_t significant = 0;
+    int32_t exponent = 0;
+    bool sawDigit = false;
+
+    while(p != last && isDigit(*p))
+    {
+        sawDigit = true;
+        if(significant < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            if(mantissa != 0)
+                significant++;
+        }
+        else
+        {
+            exponent++;
+        }
+        ++p;
+    }
+
+    if(p != last && *p == '.')
+    {
+        ++p;
+        while(p != last && isDigit(*p))
+        {
+            sawDigit = true;
+            if(significant < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                if(mantissa != 0)
+                    significant++;
+                exponent--;
+            }
+            ++p;
+        }
+    }
+
+    if(!sawDigit)
+        return first;
+
+    if(p != last && (*p == 'e' || *p == 'E'))
+    {
+        int32_t power = 0;
+        auto next = parseInt(p + 1, last, power);
+        if(next != p + 1)
+        {
+            exponent += std::max(-400, std::min(power, 400));
+            p = next;
+        }
+    }
+
+    double result = mantissa == 0 ? 0.0 : scaleByPowerOfTen(static_cast<double>(mantissa), exponent);
+    value = static_cast<float>(negative ? -result : result);
+    return p;
+}
+
+auto ObjParser::parse(const char * begin, const char * end, ObjMeshData & mesh, uint32_t threadCount) -> bool
+{
+    if(begin == nullptr || end < begin)
+        return false;
+
+    if(threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    auto bytes = static_cast<size_t>(end - begin);
+    auto chunkCount = std::max<size_t>(1, std::min<size_t>(threadCount, bytes / MIN_CHUNK_BYTES));
+
+    //split at line boundaries so no line straddles two chunks
+    std::vector<const char *> bounds(chunkCount + 1, end);
+    bounds[0] = begin;
+    for(size_t i = 1; i < chunkCount; i++)
+    {
+        auto guess = begin + bytes * i / chunkCount;
+        bounds[i] = std::max(bounds[i - 1], nextLine(guess, end));
+    }
+
+    std::vector<ObjChunk> chunks(chunkCount);
+    std::vector<std::thread> workers;
+    for(size_t i = 1; i < chunkCount; i++)
+        workers.emplace_back(parseChunk, bounds[i], bounds[i + 1], std::ref(chunks[i]));
+    parseChunk(bounds[0], bounds[1], chunks[0]);
+    for(auto & worker : workers)
+        worker.join();
+
+    //merge everything into flat arrays
+    size_t vertexCount = 0, normalCount = 0, texCoordCount = 0, faceCount = 0, cornerCount = 0;
+    for(auto & chunk : chunks)
+    {
+        vertexCount += chunk.vertices.size();
+        normalCount += chunk.normals.size();
+        texCoordCount += chunk.textureCoords.size();
+        faceCount += chunk.faceSizes.size();
+        cornerCount += chunk.cornerVertices.size();
+    }
+
+    mesh = ObjMeshData();
+    mesh.vertices.reserve(vertexCount);
+    mesh.normals.reserve(normalCount);
+    mesh.textureCoords.reserve(texCoordCount);
+    mesh.faceOffsets.reserve(faceCount + 1);
+    mesh.cornerVertices.reserve(cornerCount);
+    mesh.cornerNormals.reserve(cornerCount);
+    mesh.cornerTexCoords.reserve(cornerCount);
+
+    bool missingNormals = false;
+    bool missingTexCoords = false;
+    uint32_t corner = 0;
+    mesh.faceOffsets.push_back(0);
+    for(auto & chunk : chunks)
+    {
+        auto cornerBase = static_cast<uint32_t>(mesh.cornerVertices.size());
+        int32_t bases[3] = {
+            static_cast<int32_t>(mesh.vertices.size()),
+            static_cast<int32_t>(mesh.textureCoords.size()),
+            static_cast<int32_t>(mesh.normals.size())
+        };
+
+        append(mesh.vertices, chunk.vertices);
+        append(mesh.normals, chunk.normals);
+        append(mesh.textureCoords, chunk.textureCoords);
+        append(mesh.cornerVertices, chunk.cornerVertices);
+        append(mesh.cornerNormals, chunk.cornerNormals);
+        append(mesh.cornerTexCoords, chunk.cornerTexCoords);
+        for(auto size : chunk.faceSizes)
+        {
+            corner += size;
+            mesh.faceOffsets.push_back(corner);
+        }
+
+        for(auto & relative : chunk.relativeIndices)
+        {
+            auto index = static_cast<uint32_t>(std::max(0, bases[relative.attribute] + relative.localIndex));
+            auto at = cornerBase + relative.corner;
+            switch(relative.attribute)
+            {
+            case CORNER_VERTEX:   mesh.cornerVertices[at] = index; break;
+            case CORNER_TEXCOORD: mesh.cornerTexCoords[at] = index; break;
+            case CORNER_NORMAL:   mesh.cornerNormals[at] = index; break;
+            }
+        }
+
+        missingNormals |= chunk.missingNormals;
+        missingTexCoords |= chunk.missingTexCoords;
+        chunk = ObjChunk();
+    }
+
+    //faces without normals or texture coordinates point at element 0, so make sure it exists
+    if(missingNormals && mesh.normals.empty())
+        mesh.normals.push_back({});
+    if(missingTexCoords && mesh.textureCoords.empty())
+        mesh.textureCoords.push_back({});
+
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef OBJPARSER_H
+#define OBJPARSER_H
+
+#include <cstdint>
+#include <vector>
+#include "Cartesian3.h"
+
+//flat result of parsing an .obj file.
+//faces are kept in CSR form : face i owns the corners [faceOffsets[i], faceOffsets[i + 1])
+//and every corner has one entry in each of the three corner arrays (0-based).
+
+struct ObjMeshData
+{
+    std::vector<Cartesian3> vertices;
+    std::vector<Cartesian3> normals;
+    std::vector<Cartesian3> textureCoords;
+
+    std::vector<uint32_t> faceOffsets;
+    std::vector<uint32_t> cornerVertices;
+    std::vector<uint32_t> cornerNormals;
+    std::vector<uint32_t> cornerTexCoords;
+};
+
+namespace ObjParser
+{
+    //chunks smaller than this are not worth a thread
+    constexpr size_t MIN_CHUNK_BYTES = 256 * 1024;
+
+    //parses [begin, end) into mesh.
+    //the text is split into line-aligned chunks which are parsed in parallel and then merged.
+    //threadCount == 0 means one thread per hardware thread
+    auto parse(const char * begin, const char * end, ObjMeshData & mesh, uint32_t threadCount = 0) -> bool;
+
+    //from_chars-style parsers : return the position after the number, or first if there was none
+    auto parseFloat(const char * first, const char * last, float & value) -> const char *;
+    auto parseInt(const char * first, const char * last, int32_t & value) -> const char *;
+};
+
+#endif // OBJPARSER_H
@@ -0,0 +1,217 @@
+#include "OcclusionCuller.h"
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    //vertices this close to the eye plane can't be projected safely
+    constexpr float MIN_W = 1e-5f;
+};
+
+OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height)
+    : width(std::max(width, 1u)), height(std::max(height, 1u))
+{
+    //halve each level (rounding up) down to a single cell
+    uint32_t levelWidth = this->width, levelHeight = this->height;
+    while(true)
+    {
+        levelWidths.emplace_back(levelWidth);
+        levelHeights.emplace_back(levelHeight);
+        levels.emplace_back(levelWidth * levelHeight, zFar);
+        if(levelWidth == 1 && levelHeight == 1)
+            break;
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+    }
+}
+
+auto OcclusionCuller::modelViewProjection(const FakeGL & gl) -> Matrix4
+{
+    return gl.stateMechine.projectionMatrixStack.top() * gl.stateMechine.modelViewMatrixStack.top();
+}
+
+auto OcclusionCuller::begin(const FakeGL & gl) -> void
+{
+    zNear = gl.stateMechine.zNear;
+    zFar = gl.stateMechine.zFar;
+    std::fill(levels[0].begin(), levels[0].end(), zFar);
+}
+
+auto OcclusionCuller::toCells(const Homogeneous4 & clip) const -> Cartesian3
+{
+    //the same depth mapping as FakeGL::normalizeToWindow(), but x & y go straight
+    //from normalised device coordinates to cells, since the cells cover the viewport
+    float x = clip.x / clip.w, y = clip.y / clip.w, z = clip.z / clip.w;
+    return Cartesian3((x + 1.f) * 0.5f * width, (y + 1.f) * 0.5f * height,
+                      ((zFar - zNear) * z + (zNear + zFar)) * 0.5f);
+}
+
+auto OcclusionCuller::addOccluder(const Matrix4 & modelViewProjection, const Cartesian3 * positions,
+                                  const uint32_t * indices, size_t indexCount) -> void
+{
+    //coverage is sampled at the cell corners for the occluder as a whole, since a cell on an
+    //edge the triangles share is never entirely inside any one of them. each cell also
+    //gathers the farthest depth of every triangle that might touch it
+    uint32_t cornerWidth = width + 1;
+    cornerCovered.assign(cornerWidth * (height + 1), 0);
+    farthest.assign(width * height, -std::numeric_limits<float>::max());
+    int32_t touchedFirstCol = width, touchedLastCol = -1, touchedFirstRow = height, touchedLastRow = -1;
+
+    //a vertex is shared by about six triangles, so each is projected once up front
+    uint32_t vertexCount = 0;
+    for(size_t index = 0; index < indexCount; index++)
+        vertexCount = std::max(vertexCount, indices[index] + 1);
+    projected.resize(vertexCount);
+    projectedBehind.resize(vertexCount);
+    for(uint32_t vertex = 0; vertex < vertexCount; vertex++)
+    {
+        auto clip = modelViewProjection * Homogeneous4(positions[vertex]);
+        projectedBehind[vertex] = clip.w < MIN_W;
+        projected[vertex] = toCells(clip);
+    }
+
+    for(size_t triangle = 0; triangle + 2 < indexCount; triangle += 3)
+    {
+        const uint32_t * corners = indices + triangle;
+        if(projectedBehind[corners[0]] || projectedBehind[corners[1]] || projectedBehind[corners[2]])
+            continue;
+        const Cartesian3 v[3] = { projected[corners[0]], projected[corners[1]], projected[corners[2]] };
+
+        //twice the signed area, used to make the edge functions positive inside either winding
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+        if(area == 0.f)
+            continue;
+        float sign = area > 0.f ? 1.f : -1.f;
+
+        float minX = std::min({v[0].x, v[1].x, v[2].x}), maxX = std::max({v[0].x, v[1].x, v[2].x});
+        float minY = std::min({v[0].y, v[1].y, v[2].y}), maxY = std::max({v[0].y, v[1].y, v[2].y});
+        int32_t firstCol = std::max(0, (int32_t)std::floor(minX)), lastCol = std::min((int32_t)width - 1, (int32_t)std::floor(maxX));
+        int32_t firstRow = std::max(0, (int32_t)std::floor(minY)), lastRow = std::min((int32_t)height - 1, (int32_t)std::floor(maxY));
+        if(firstCol > lastCol || firstRow > lastRow)
+            continue;
+        touchedFirstCol = std::min(touchedFirstCol, firstCol);
+        touchedLastCol = std::max(touchedLastCol, lastCol);
+        touchedFirstRow = std::min(touchedFirstRow, firstRow);
+        touchedLastRow = std::max(touchedLastRow, lastRow);
+
+        //the depth plane z = zx * x + zy * y + z0
+        float zx = ((v[1].z - v[0].z) * (v[2].y - v[0].y) - (v[2].z - v[0].z) * (v[1].y - v[0].y)) / area;
+        float zy = ((v[2].z - v[0].z) * (v[1].x - v[0].x) - (v[1].z - v[0].z) * (v[2].x - v[0].x)) / area;
+        float z0 = v[0].z - zx * v[0].x - zy * v[0].y;
+        //from a cell's centre, the plane rises at most this much within the cell,
+        //and the triangle never gets farther than its farthest vertex
+        float zSlack = 0.5f * (std::fabs(zx) + std::fabs(zy));
+        float zMax = std::max({v[0].z, v[1].z, v[2].z});
+
+        for(int32_t row = firstRow; row <= lastRow; row++)
+        {
+            for(int32_t col = firstCol; col <= lastCol; col++)
+            {
+                float & cell = farthest[row * width + col];
+                cell = std::max(cell, std::min(zMax, zx * (col + 0.5f) + zy * (row + 0.5f) + z0 + zSlack));
+            }
+        }
+
+        //edge functions, each non-negative inside & on the edge
+        float ex[3], ey[3], ec[3];
+        for(int edge = 0; edge < 3; edge++)
+        {
+            const Cartesian3 & a = v[edge];
+            const Cartesian3 & b = v[(edge + 1) % 3];
+            ex[edge] = -(b.y - a.y) * sign;
+            ey[edge] = (b.x - a.x) * sign;
+            ec[edge] = -(ex[edge] * a.x + ey[edge] * a.y);
+        }
+        int32_t firstX = std::max(0, (int32_t)std::ceil(minX)), lastX = std::min((int32_t)width, (int32_t)std::floor(maxX));
+        int32_t firstY = std::max(0, (int32_t)std::ceil(minY)), lastY = std::min((int32_t)height, (int32_t)std::floor(maxY));
+        for(int32_t y = firstY; y <= lastY; y++)
+            for(int32_t x = firstX; x <= lastX; x++)
+                if(ex[0] * x + ey[0] * y + ec[0] >= 0.f && ex[1] * x + ey[1] * y + ec[1] >= 0.f && ex[2] * x + ey[2] * y + ec[2] >= 0.f)
+                    cornerCovered[y * cornerWidth + x] = 1;
+    }
+
+    //a cell is hidden behind the occluder once all four of its corners are
+    std::vector<float> & depth = levels[0];
+    for(int32_t row = touchedFirstRow; row <= touchedLastRow; row++)
+    {
+        for(int32_t col = touchedFirstCol; col <= touchedLastCol; col++)
+        {
+            const uint8_t * corners = &cornerCovered[row * cornerWidth + col];
+            if(corners[0] && corners[1] && corners[cornerWidth] && corners[cornerWidth + 1])
+            {
+                float & cell = depth[row * width + col];
+                cell = std::min(cell, farthest[row * width + col]);
+            }
+        }
+    }
+}
+
+auto OcclusionCuller::finish() -> void
+{
+    for(size_t level = 1; level < levels.size(); level++)
+    {
+        const std::vector<float> & below = levels[level - 1];
+        uint32_t belowWidth = levelWidths[level - 1], belowHeight = levelHeights[level - 1];
+        std::vector<float> & cells = levels[level];
+        for(uint32_t row = 0; row < levelHeights[level]; row++)
+        {
+            for(uint32_t col = 0; col < levelWidths[level]; col++)
+            {
+                //the odd cell out at the edge of a level has fewer children
+                uint32_t lastRow = std::min(2 * row + 1, belowHeight - 1);
+                uint32_t lastCol = std::min(2 * col + 1, belowWidth - 1);
+                float farthest = below[2 * row * belowWidth + 2 * col];
+                for(uint32_t childRow = 2 * row; childRow <= lastRow; childRow++)
+                    for(uint32_t childCol = 2 * col; childCol <= lastCol; childCol++)
+                        farthest = std::max(farthest, below[childRow * belowWidth + childCol]);
+                cells[row * levelWidths[level] + col] = farthest;
+            }
+        }
+    }
+}
+
+auto OcclusionCuller::isVisible(const Matrix4 & modelViewProjection, const Cartesian3 & boxMin, const Cartesian3 & boxMax) const -> bool
+{
+    float minX = std::numeric_limits<float>::max(), maxX = -minX;
+    float minY = minX, maxY = -minX;
+    float nearest = minX;
+    for(int corner = 0; corner < 8; corner++)
+    {
+        Homogeneous4 position((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y,
+                              (corner & 4) ? boxMax.z : boxMin.z, 1.f);
+        auto clip = modelViewProjection * position;
+        if(clip.w < MIN_W)
+            return true;
+        Cartesian3 cell = toCells(clip);
+        minX = std::min(minX, cell.x);
+        maxX = std::max(maxX, cell.x);
+        minY = std::min(minY, cell.y);
+        maxY = std::max(maxY, cell.y);
+        nearest = std::min(nearest, cell.z);
+    }
+
+    //entirely off screen
+    if(maxX < 0.f || maxY < 0.f || minX >= width || minY >= height)
+        return false;
+    int32_t firstCol = std::max(0, (int32_t)std::floor(minX)), lastCol = std::min((int32_t)width - 1, (int32_t)std::floor(maxX));
+    int32_t firstRow = std::max(0, (int32_t)std::floor(minY)), lastRow = std::min((int32_t)height - 1, (int32_t)std::floor(maxY));
+
+    //climb until the box spans at most 2 x 2 cells, so the test is four reads at most
+    uint32_t level = 0;
+    while(level + 1 < levels.size() && (lastCol - firstCol > 1 || lastRow - firstRow > 1))
+    {
+        firstCol >>= 1;
+        lastCol >>= 1;
+        firstRow >>= 1;
+        lastRow >>= 1;
+        level++;
+    }
+
+    const std::vector<float> & cells = levels[level];
+    for(int32_t row = firstRow; row <= lastRow; row++)
+        for(int32_t col = firstCol; col <= lastCol; col++)
+            if(nearest <= cells[row * levelWidths[level] + col])
+                return true;
+    return false;
+}
@@ -0,0 +1,69 @@
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <cstdint>
+#include <vector>
+#include "Cartesian3.h"
+#include "Matrix4.h"
+#include "FakeGL.h"
+
+//software occlusion culling ahead of FakeGL. a few large occluders are rasterised into a
+//small depth buffer, a pyramid of maximum depths is built over it, and bounding boxes are
+//then tested against the pyramid, so that hidden objects & meshlets are never submitted.
+//a cell only takes an occluder's depth when the occluder covers all four of its corners, and then
+//takes the farthest depth any of the occluder's triangles might have over the cell, so the test
+//errs towards visible. the one exception is a notch in an occluder's outline narrower than a cell.
+//depths are FakeGL window depths (smaller is nearer), using the context's viewport & depth range.
+
+constexpr uint32_t OCCLUSION_DEFAULT_WIDTH = 256;
+constexpr uint32_t OCCLUSION_DEFAULT_HEIGHT = 128;
+
+class OcclusionCuller
+{
+public:
+    OcclusionCuller(uint32_t width = OCCLUSION_DEFAULT_WIDTH, uint32_t height = OCCLUSION_DEFAULT_HEIGHT);
+
+    //the matrix FakeGL would transform vertices by now: the projection times the modelview
+    static auto modelViewProjection(const FakeGL & gl) -> Matrix4;
+
+    //clears the depth buffer & takes the depth range from the context
+    auto begin(const FakeGL & gl) -> void;
+
+    //rasterises one occluder's indexed triangles, in the object space of modelViewProjection.
+    //triangles reaching behind the viewer are skipped rather than clipped
+    auto addOccluder(const Matrix4 & modelViewProjection, const Cartesian3 * positions,
+                     const uint32_t * indices, size_t indexCount) -> void;
+
+    //builds the pyramid; call once all the occluders are in
+    auto finish() -> void;
+
+    //false only if the box is certainly hidden behind the occluders or outside the view.
+    //a box reaching behind the viewer is always visible
+    auto isVisible(const Matrix4 & modelViewProjection, const Cartesian3 & boxMin, const Cartesian3 & boxMax) const -> bool;
+
+    inline auto getWidth() const -> uint32_t { return width; }
+    inline auto getHeight() const -> uint32_t { return height; }
+    //the maximum depth of each cell of each level, level 0 being the full buffer
+    inline auto getLevel(uint32_t level) const -> const std::vector<float> & { return levels[level]; }
+    inline auto getLevelCount() const -> uint32_t { return (uint32_t)levels.size(); }
+
+private:
+    //clip coordinates to (cell x, cell y, window depth); the cells cover the viewport
+    auto toCells(const Homogeneous4 & clip) const -> Cartesian3;
+
+    uint32_t width;
+    uint32_t height;
+    float zNear = 0.f;
+    float zFar = 1.f;
+    std::vector<std::vector<float>> levels;
+    std::vector<uint32_t> levelWidths;
+    std::vector<uint32_t> levelHeights;
+    //scratch for addOccluder(): which cell corners the occluder covers & its farthest depth per cell
+    std::vector<uint8_t> cornerCovered;
+    std::vector<float> farthest;
+    //and the occluder's vertices in cells, & whether each is behind the viewer
+    std::vector<Cartesian3> projected;
+    std::vector<uint8_t> projectedBehind;
+};
+
+#endif // OCCLUSIONCULLER_H
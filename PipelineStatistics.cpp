@@ -0,0 +1,91 @@
+#include "PipelineStatistics.h"
+#include <mutex>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <algorithm>
+
+namespace
+{
+    //the blocks of the live threads & the totals handed over by blocks, for each live context
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<const PipelineStatistics::Block *> blocks;
+        std::unordered_map<uint32_t, std::array<uint64_t, PipelineStatistics::Count>> totals;
+        uint32_t nextContext = 1;
+    };
+
+    //never destroyed, since thread_local blocks can outlive static objects at exit
+    auto registry() -> Registry &
+    {
+        static Registry * instance = new Registry();
+        return *instance;
+    }
+
+    //adds a block's counts to the totals of its context, unless the context has gone; the registry is locked
+    auto retire(Registry & reg, uint32_t context, std::atomic<uint64_t> * counters) -> void
+    {
+        auto found = reg.totals.find(context);
+        for(uint32_t statistic = 0; statistic < PipelineStatistics::Count; statistic++)
+        {
+            if(found != reg.totals.end())
+                found->second[statistic] += counters[statistic].load(std::memory_order_relaxed);
+            counters[statistic].store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+PipelineStatistics::Block::Block()
+{
+    context.store(0, std::memory_order_relaxed);
+    for(auto & counter : counters)
+        counter.store(0, std::memory_order_relaxed);
+    Registry & reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.blocks.push_back(this);
+}
+
+PipelineStatistics::Block::~Block()
+{
+    Registry & reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    retire(reg, context.load(std::memory_order_relaxed), counters);
+    reg.blocks.erase(std::find(reg.blocks.begin(), reg.blocks.end(), this));
+}
+
+auto PipelineStatistics::Block::switchTo(uint32_t newContext) -> void
+{
+    Registry & reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    retire(reg, context.load(std::memory_order_relaxed), counters);
+    context.store(newContext, std::memory_order_relaxed);
+}
+
+auto PipelineStatistics::newContext() -> uint32_t
+{
+    Registry & reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    uint32_t context = reg.nextContext++;
+    reg.totals[context].fill(0);
+    return context;
+}
+
+auto PipelineStatistics::releaseContext(uint32_t context) -> void
+{
+    Registry & reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.totals.erase(context);
+}
+
+auto PipelineStatistics::read(uint32_t context, Statistic statistic) -> uint64_t
+{
+    Registry & reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    auto found = reg.totals.find(context);
+    uint64_t total = found != reg.totals.end() ? found->second[statistic] : 0;
+    for(auto block : reg.blocks)
+        if(block->context.load(std::memory_order_relaxed) == context)
+            total += block->counters[statistic].load(std::memory_order_relaxed);
+    return total;
+}
@@ -0,0 +1,78 @@
+#ifndef PIPELINESTATISTICS_H
+#define PIPELINESTATISTICS_H
+
+#include <cstdint>
+#include <atomic>
+
+//the counters behind FakeGL's pipeline statistics queries.
+//every thread counts into a block of its own, so counting is an unshared increment
+//that is always compiled in. each block is tagged with the context it is counting for:
+//when a thread starts work for another context, the counts so far are handed over to the
+//totals of the context they belong to. reading a context merges its totals with the blocks
+//still counting for it, so each context only sees its own work, on whichever threads it
+//was done. contexts working on behalf of another (e.g. TiledRenderer's tiles) count under its id.
+
+class PipelineStatistics
+{
+public:
+    //the values match the FAKEGL_ query targets
+    enum Statistic : uint32_t
+    {
+        //vertices given to Vertex3f() or DrawElements()
+        VerticesSubmitted = 0,
+        //runs of the vertex shader: DrawElements() only shades its cache misses
+        VertexShaderInvocations = 1,
+        //triangles rejected for lying entirely outside the frame buffer; a tiled render
+        //also counts the tiles a triangle was binned to but doesn't reach
+        PrimitivesClipped = 2,
+        //triangles rejected as back facing
+        PrimitivesCulled = 3,
+        //pixels covered by a primitive, before the depth test
+        FragmentsGenerated = 4,
+        //fragments that failed the depth test
+        FragmentsDepthRejected = 5,
+        //runs of the fragment shader
+        FragmentShaderInvocations = 6,
+        Count = 7
+    };
+
+    //an id to count a new context under, never 0
+    static auto newContext() -> uint32_t;
+    //forgets a context that has gone, along with its counts
+    static auto releaseContext(uint32_t context) -> void;
+
+    inline static auto add(uint32_t context, Statistic statistic, uint64_t amount = 1) -> void
+    {
+        Block & block = local();
+        if(block.context.load(std::memory_order_relaxed) != context)
+            block.switchTo(context);
+        //only this thread writes the counter, so a relaxed load & store is enough
+        std::atomic<uint64_t> & counter = block.counters[statistic];
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    //the count of a context so far, over all threads
+    static auto read(uint32_t context, Statistic statistic) -> uint64_t;
+
+    //one thread's counters & the context they are for
+    struct Block
+    {
+        Block();
+        //hands the counts over to the totals of their context
+        ~Block();
+        //hands the counts over & starts counting for another context
+        auto switchTo(uint32_t newContext) -> void;
+        //only changed by the thread that owns the block, with the registry locked
+        std::atomic<uint32_t> context;
+        std::atomic<uint64_t> counters[Count];
+    };
+
+private:
+    inline static auto local() -> Block &
+    {
+        static thread_local Block block;
+        return block;
+    }
+};
+
+#endif // PIPELINESTATISTICS_H
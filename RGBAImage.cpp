@@ -12,18 +12,24 @@
 //  
 //  A minimal class for an image in single-byte RGBA format
 //  Optimized for simplicity, not speed or memory
-//  With read/write for ASCII RGBA files
+//  With read/write for ASCII (P3) and binary (P6) PPM files
 //  
 ///////////////////////////////////////////////////
 
-#define MAX_IMAGE_DIMENSION 4096
 #define MAX_LINE_LENGTH 1024
+// PPM bodies are read & written in pieces of about this size
+#define PPM_CHUNK_BYTES (1 << 20)
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <utility>
+#include <limits>
 #include "string.h"
 
 #include "RGBAImage.h"
@@ -39,6 +45,10 @@ RGBAImage::RGBAImage()
 
 // copy constructor
 RGBAImage::RGBAImage(const RGBAImage &other)
+    :
+    block(NULL),
+    width(0),
+    height(0)
     { // copy constructor
     // resize to match the other image
     Resize(other.width, other.height);
@@ -50,6 +60,24 @@ RGBAImage::RGBAImage(const RGBAImage &other)
 
     } // copy constructor
 
+// copy assignment: copies the pixels, so that each image owns its own block
+RGBAImage &RGBAImage::operator =(const RGBAImage &other)
+    { // copy assignment
+    // self-assignment would free the block before copying it
+    if (this == &other)
+        return *this;
+
+    // resize to match the other image
+    Resize(other.width, other.height);
+
+    // now copy all of the pixels
+    for (int row = 0; row < height; row++)
+        for (int col = 0; col < width; col++)
+            (*this)[row][col] = other[row][col];
+
+    return *this;
+    } // copy assignment
+
 //  destructor
 RGBAImage::~RGBAImage()
     { // RGBAImage destructor
@@ -57,6 +85,14 @@ RGBAImage::~RGBAImage()
     free(block);
     } // RGBAImage destructor
 
+// exchanges the pixels & dimensions with another image
+void RGBAImage::Swap(RGBAImage &other)
+    { // Swap()
+    std::swap(block, other.block);
+    std::swap(width, other.width);
+    std::swap(height, other.height);
+    } // Swap()
+
 // resizes the image, destroying any contents
 bool RGBAImage::Resize(long Width, long Height) 
     { // Resize()
@@ -100,33 +136,127 @@ const RGBAValue * RGBAImage::operator [](const int rowIndex) const
     return block+(rowIndex*width);
     } // [] row index operator
 
+// the header of a PPM allows comments between any two tokens, so we need a
+// small routine that skips whitespace & comments and reads a decimal number
+static bool ReadPPMHeaderValue(std::istream &inStream, long &value)
+    { // ReadPPMHeaderValue()
+    // skip whitespace & comments
+    while (inStream.good())
+        { // skipping
+        int nextChar = inStream.peek();
+        if (nextChar == '#')
+            { // comment
+            char lineBuffer[MAX_LINE_LENGTH];
+            inStream.getline(lineBuffer, MAX_LINE_LENGTH);
+            // a comment longer than the buffer sets failbit - clear it & discard the rest
+            if (inStream.fail() && !inStream.eof())
+                { // long comment
+                inStream.clear();
+                inStream.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                } // long comment
+            } // comment
+        else if (isspace(nextChar))
+            inStream.get();
+        else
+            break;
+        } // skipping
+
+    // and read the number itself
+    inStream >> value;
+    return !inStream.fail();
+    } // ReadPPMHeaderValue()
+
+// fast reader for the ASCII body of a P3 file: pulls the stream in large
+// chunks and parses integers by hand instead of through operator >>
+// NB: it reads ahead, so the stream is consumed past the end of the image
+class PPMTextReader
+    { // class PPMTextReader
+    public:
+    // constructor
+    PPMTextReader(std::istream &newStream)
+        : stream(newStream), buffer(PPM_CHUNK_BYTES), next(NULL), end(NULL)
+        { // constructor
+        } // constructor
+
+    // reads the next unsigned integer, returning false at end of stream
+    bool NextValue(unsigned int &value)
+        { // NextValue()
+        // skip anything that is not a digit
+        while (true)
+            { // skipping
+            if (next == end && !Refill())
+                return false;
+            if (*next >= '0' && *next <= '9')
+                break;
+            next++;
+            } // skipping
+
+        // accumulate digits, refilling across chunk boundaries as needed
+        value = 0;
+        while (true)
+            { // digits
+            if (next == end && !Refill())
+                return true;
+            if (*next < '0' || *next > '9')
+                return true;
+            value = value * 10 + (*next - '0');
+            next++;
+            } // digits
+        } // NextValue()
+
+    private:
+    // pulls the next chunk of the stream into the buffer
+    bool Refill()
+        { // Refill()
+        stream.read(buffer.data(), buffer.size());
+        next = buffer.data();
+        end = next + stream.gcount();
+        return next != end;
+        } // Refill()
+
+    std::istream &stream;
+    std::vector<char> buffer;
+    char *next, *end;
+    }; // class PPMTextReader
+
+// decimal text for every byte value, used when writing P3
+class PPMDigitTable
+    { // class PPMDigitTable
+    public:
+    char digits[256][4];
+    int nDigits[256];
+
+    // constructor fills in the table
+    PPMDigitTable()
+        { // constructor
+        for (int value = 0; value < 256; value++)
+            nDigits[value] = snprintf(digits[value], sizeof(digits[value]), "%d", value);
+        } // constructor
+    }; // class PPMDigitTable
+
 // file read routine
 bool RGBAImage::ReadPPM(std::istream &inStream)
     { // ReadPPMFile()
-    // buffer for reading in line
-    char lineBuffer[MAX_LINE_LENGTH];
+    // read in the magic number (file code)
+    char magic[3] = { 0, 0, 0 };
+    inStream.read(magic, 2);
 
-    // read in the first line
-    inStream.getline(lineBuffer, MAX_LINE_LENGTH);
-    
-    // check for magic number (file code) in first two characters
-    if (strcmp(lineBuffer,"P3") != 0)
+    // check for either ASCII (P3) or binary (P6)
+    bool binary = (strcmp(magic, "P6") == 0);
+    if (!binary && (strcmp(magic, "P3") != 0))
         { // failed read
-        std::cerr << "RGBA stream did not start with PPM code (P3)" << std::endl;
+        std::cerr << "RGBA stream did not start with PPM code (P3 or P6)" << std::endl;
         return false;
         } // failed read
 
-    while (inStream.good() && inStream.peek() == '#')
-        inStream.getline(lineBuffer, MAX_LINE_LENGTH);
-
-    // read in new width & height
-    long newWidth, newHeight;
-    inStream >> newWidth >> newHeight;
+    // read in new width & height, then the byte max value
+    long newWidth = 0, newHeight = 0, maxValue = 0;
+    if (!ReadPPMHeaderValue(inStream, newWidth) || !ReadPPMHeaderValue(inStream, newHeight) || !ReadPPMHeaderValue(inStream, maxValue))
+        { // failed read
+        std::cerr << "RGBA stream had an incomplete PPM header" << std::endl;
+        return false;
+        } // failed read
 
-    // check the byte max value
-    int maxValue;
-    inStream >> maxValue;
-    
     if (maxValue != 255)
         { // failure
         std::cerr << "RGBA stream did not specify 255 as the maximum colour value." << std::endl;
@@ -142,36 +272,127 @@ bool RGBAImage::ReadPPM(std::istream &inStream)
         } // bad sizes
 
     // resize the image
-    Resize(newWidth, newHeight);
+    if (!Resize(newWidth, newHeight))
+        return false;
 
-    // loop through pixels, reading them:
-    for (int row = 0; row < height; row++)
-        for (int col = 0; col < width; col++)       
-            inStream >> (*this)[row][col];
+    if (binary)
+        { // binary body
+        // exactly one whitespace character separates the header from the data
+        inStream.get();
+
+        // read a band of rows at a time straight into the block: the RGB triples
+        // of a band fit inside the RGBA space of the same band, so we can expand
+        // them in place working backwards without any extra buffer
+        long rowsPerChunk = PPM_CHUNK_BYTES / (3 * width);
+        if (rowsPerChunk < 1)
+            rowsPerChunk = 1;
+        for (long row = 0; row < height; row += rowsPerChunk)
+            { // per band
+            long nRows = (row + rowsPerChunk > height) ? height - row : rowsPerChunk;
+            long nPixels = nRows * width;
+            unsigned char *band = (unsigned char *) (block + row * width);
+            inStream.read((char *) band, 3 * nPixels);
+            if (inStream.gcount() != 3 * nPixels)
+                { // short read
+                std::cerr << "RGBA stream ended before all pixels were read" << std::endl;
+                return false;
+                } // short read
+
+            // expand RGB to RGBA from the back
+            for (long pixel = nPixels - 1; pixel >= 0; pixel--)
+                { // per pixel
+                unsigned char red = band[3 * pixel], green = band[3 * pixel + 1], blue = band[3 * pixel + 2];
+                block[row * width + pixel] = RGBAValue(red, green, blue, 255);
+                } // per pixel
+            } // per band
+        } // binary body
+    else
+        { // ASCII body
+        // the reader skips the whitespace after the header by itself
+        PPMTextReader reader(inStream);
+
+        // loop through pixels, reading them:
+        long nPixels = width * height;
+        for (long pixel = 0; pixel < nPixels; pixel++)
+            { // per pixel
+            unsigned int red, green, blue;
+            if (!reader.NextValue(red) || !reader.NextValue(green) || !reader.NextValue(blue))
+                { // short read
+                std::cerr << "RGBA stream ended before all pixels were read" << std::endl;
+                return false;
+                } // short read
+            block[pixel] = RGBAValue((unsigned char) red, (unsigned char) green, (unsigned char) blue, 255);
+            } // per pixel
+        } // ASCII body
 
     // done
     return true;
     } // ReadPPMFile()
 
 // file write routine
-void RGBAImage::WritePPM(std::ostream &outStream)
+void RGBAImage::WritePPM(std::ostream &outStream, bool binary)
     { // WritePPMFile()
     // print out header information
-    outStream << "P3" << std::endl;
+    outStream << (binary ? "P6" : "P3") << std::endl;
     outStream << "# PPM File" << std::endl;
     outStream << width << " " << height << std::endl;
     outStream << 255 << std::endl;
-        
-    // loop through pixels, reading them:
-    for (int row = 0; row < height; row++)
-        { // row
-        for (int col = 0; col < width; col++)
-            { // col
-            // put a space before each one except the first
-            if (col != 0)
-                outStream << " ";
-            outStream << (*this)[row][col];
-            } // col
-        outStream << std::endl;
-        } // row
+
+    // all output goes through one buffer that is flushed in large writes
+    std::vector<char> buffer;
+    buffer.reserve(PPM_CHUNK_BYTES + 16 * width);
+
+    if (binary)
+        { // binary body
+        // loop through pixels, packing them as RGB triples
+        for (long row = 0; row < height; row++)
+            { // row
+            const RGBAValue *rowPixels = (*this)[row];
+            for (long col = 0; col < width; col++)
+                { // col
+                buffer.push_back(rowPixels[col].red);
+                buffer.push_back(rowPixels[col].green);
+                buffer.push_back(rowPixels[col].blue);
+                } // col
+            if (buffer.size() >= PPM_CHUNK_BYTES)
+                { // flush
+                outStream.write(buffer.data(), buffer.size());
+                buffer.clear();
+                } // flush
+            } // row
+        } // binary body
+    else
+        { // ASCII body
+        // format components by table lookup rather than through iostream
+        static const PPMDigitTable table;
+
+        // loop through pixels, writing them in the same layout as before
+        for (long row = 0; row < height; row++)
+            { // row
+            const RGBAValue *rowPixels = (*this)[row];
+            for (long col = 0; col < width; col++)
+                { // col
+                // put a space before each one except the first
+                if (col != 0)
+                    buffer.push_back(' ');
+                const unsigned char components[3] = { rowPixels[col].red, rowPixels[col].green, rowPixels[col].blue };
+                for (int component = 0; component < 3; component++)
+                    { // component
+                    if (component != 0)
+                        buffer.push_back(' ');
+                    const char *text = table.digits[components[component]];
+                    buffer.insert(buffer.end(), text, text + table.nDigits[components[component]]);
+                    } // component
+                } // col
+            buffer.push_back('\n');
+            if (buffer.size() >= PPM_CHUNK_BYTES)
+                { // flush
+                outStream.write(buffer.data(), buffer.size());
+                buffer.clear();
+                } // flush
+            } // row
+        } // ASCII body
+
+    // and whatever is left over
+    outStream.write(buffer.data(), buffer.size());
     } // WritePPMFile()
@@ -12,7 +12,7 @@
 //  
 //  A minimal class for an image in single-byte RGBA format
 //  Optimized for simplicity, not speed or memory
-//  With read/write for ASCII RGBA files
+//  With read/write for ASCII (P3) and binary (P6) PPM files
 //  
 ///////////////////////////////////////////////////
 
@@ -23,6 +23,10 @@
 
 #include "RGBAValue.h"
 
+// largest width or height that Resize() will accept
+// larger images have to be rendered in tiles (see TiledRenderer)
+#define MAX_IMAGE_DIMENSION 4096
+
 // the class itself
 class RGBAImage
     { // class RGBAImage
@@ -39,8 +43,14 @@ class RGBAImage
     // copy constructor
     RGBAImage(const RGBAImage &other);
 
+    // copy assignment
+    RGBAImage &operator =(const RGBAImage &other);
+
     // destructor
     ~RGBAImage();
+
+    // exchanges the pixels & dimensions with another image, without copying any pixels
+    void Swap(RGBAImage &other);
     
     // resizes the image, destroying any contents
     bool Resize(long Width, long Height);
@@ -53,8 +63,10 @@ class RGBAImage
     const RGBAValue * operator [](const int rowIndex) const;
 
     // routines for stream read & write
+    // reading accepts both ASCII (P3) and binary (P6) files
     bool ReadPPM(std::istream &inStream);
-    void WritePPM(std::ostream &outStream);
+    // writes ASCII (P3) by default, binary (P6) if requested
+    void WritePPM(std::ostream &outStream, bool binary = false);
     
     }; // class RGBAImage
 
@@ -134,6 +134,18 @@ RenderController::RenderController
        QObject::connect(   renderWindow->phongShadingBox,              SIGNAL(stateChanged(int)),
                            this,                                       SLOT(phongShadingCheckChanged(int)));
 
+    // signal for check box for back face culling
+    QObject::connect(   renderWindow->cullBackFacesBox,             SIGNAL(stateChanged(int)),
+                        this,                                       SLOT(cullBackFacesCheckChanged(int)));
+
+    // signals for check boxes for shadows
+    QObject::connect(   renderWindow->shadowsBox,                   SIGNAL(stateChanged(int)),
+                        this,                                       SLOT(shadowsCheckChanged(int)));
+    QObject::connect(   renderWindow->perPixelShadowsBox,           SIGNAL(stateChanged(int)),
+                        this,                                       SLOT(perPixelShadowsCheckChanged(int)));
+    QObject::connect(   renderWindow->shadowMapBox,                 SIGNAL(stateChanged(int)),
+                        this,                                       SLOT(shadowMapCheckChanged(int)));
+
 
 
     // copy the rotation matrix from the widgets to the model
@@ -468,3 +480,43 @@ void RenderController::phongShadingCheckChanged(int state)
     // reset the interface
     renderWindow->ResetInterface();
 } // RenderController::phongShadingCheckChanged()
+
+// slot for toggling back face culling
+void RenderController::cullBackFacesCheckChanged(int state)
+    { // RenderController::cullBackFacesCheckChanged()
+    // reset the model's flag
+    renderParameters->cullBackFaces = (state == Qt::Checked);
+
+    // reset the interface
+    renderWindow->ResetInterface();
+    } // RenderController::cullBackFacesCheckChanged()
+
+// slot for toggling ray-traced shadows
+void RenderController::shadowsCheckChanged(int state)
+    { // RenderController::shadowsCheckChanged()
+    // reset the model's flag
+    renderParameters->shadowsOn = (state == Qt::Checked);
+
+    // reset the interface
+    renderWindow->ResetInterface();
+    } // RenderController::shadowsCheckChanged()
+
+// slot for choosing between per-vertex & per-pixel shadows
+void RenderController::perPixelShadowsCheckChanged(int state)
+    { // RenderController::perPixelShadowsCheckChanged()
+    // reset the model's flag
+    renderParameters->perPixelShadows = (state == Qt::Checked);
+
+    // reset the interface
+    renderWindow->ResetInterface();
+    } // RenderController::perPixelShadowsCheckChanged()
+
+// slot for choosing a shadow map over ray tracing
+void RenderController::shadowMapCheckChanged(int state)
+    { // RenderController::shadowMapCheckChanged()
+    // reset the model's flag
+    renderParameters->shadowMapOn = (state == Qt::Checked);
+
+    // reset the interface
+    renderWindow->ResetInterface();
+    } // RenderController::shadowMapCheckChanged()
@@ -80,6 +80,10 @@ class RenderController : public QObject
     void centreObjectCheckChanged(int state);
     void scaleObjectCheckChanged(int state);
     void phongShadingCheckChanged(int state);
+    void cullBackFacesCheckChanged(int state);
+    void shadowsCheckChanged(int state);
+    void perPixelShadowsCheckChanged(int state);
+    void shadowMapCheckChanged(int state);
     
     // slots for responding to lighting parameter changes
     void emissiveLightChanged(int value);
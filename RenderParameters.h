@@ -34,6 +34,9 @@ class RenderParameters
 
     // and a zoom scale
     float zoomScale;
+
+    // the largest error in pixels we accept when choosing a level of detail (0 always uses the full mesh)
+    float lodPixelError;
     
     // we have the position of the light
     float lightPosition[4];
@@ -62,6 +65,12 @@ class RenderParameters
     bool scaleObject;
     bool mapUVWToRGB;
     bool phongShadingOn;
+    bool cullBackFaces;
+    bool shadowsOn;
+    bool perPixelShadows;
+    bool shadowMapOn;
+    bool impostorsOn;
+    bool occlusionCullingOn;
 
     // constructor
     RenderParameters()
@@ -69,6 +78,7 @@ class RenderParameters
         xTranslate(0.0), 
         yTranslate(0.0),
         zoomScale(1.0),
+        lodPixelError(0.5),
         emissiveLight(0.0),
         ambientLight(0.2),
         diffuseLight(0.6),
@@ -83,7 +93,13 @@ class RenderParameters
         centreObject(false),
         scaleObject(false),
         mapUVWToRGB(false),
-        phongShadingOn(false)
+        phongShadingOn(false),
+        cullBackFaces(false),
+        shadowsOn(false),
+        perPixelShadows(false),
+        shadowMapOn(false),
+        impostorsOn(false),
+        occlusionCullingOn(false)
         { // constructor
         
         // start the lighting at the viewer's direction
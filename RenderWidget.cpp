@@ -116,6 +116,12 @@ void RenderWidget::paintGL()
         glEnable(GL_DEPTH_TEST);
     else
         glDisable(GL_DEPTH_TEST);
+
+    // and back face culling
+    if (renderParameters->cullBackFaces)
+        glEnable(GL_CULL_FACE);
+    else
+        glDisable(GL_CULL_FACE);
         
     // clear the buffer
     glClear(GL_COLOR_BUFFER_BIT | (renderParameters->depthTestOn ? GL_DEPTH_BUFFER_BIT: 0));
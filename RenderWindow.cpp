@@ -72,6 +72,10 @@ RenderWindow::RenderWindow
     texturedRenderingBox        = new QCheckBox                 ("Textures",            this);
     textureModulationBox        = new QCheckBox                 ("Modulation",          this);
     phongShadingBox		        = new QCheckBox                 ("Phong Shading",       this);
+    cullBackFacesBox            = new QCheckBox                 ("Cull Back Faces",     this);
+    shadowsBox                  = new QCheckBox                 ("Shadows",             this);
+    perPixelShadowsBox          = new QCheckBox                 ("Per-Pixel Shadows",   this);
+    shadowMapBox                = new QCheckBox                 ("Shadow Map",          this);
     // modelling options
     showAxesBox                 = new QCheckBox                 ("Axes",                this);  
     showObjectBox               = new QCheckBox                 ("Object",              this);  
@@ -103,7 +107,7 @@ RenderWindow::RenderWindow
     // add all of the widgets to the grid               Row         Column      Row Span    Column Span
     
     // the top two widgets have to fit to the widgets stack between them
-    int nStacked = 13;
+    int nStacked = 18;
     
     windowLayout->addWidget(renderWidget,               0,          1,          nStacked,   1           );
     windowLayout->addWidget(yTranslateSlider,           0,          2,          nStacked,   1           );
@@ -125,6 +129,10 @@ RenderWindow::RenderWindow
     windowLayout->addWidget(texturedRenderingBox,       11,         3,          1,          1           );
     windowLayout->addWidget(textureModulationBox,       12,         3,          1,          1           );
     windowLayout->addWidget(phongShadingBox,	 	    13,         3,          1,          1           );
+    windowLayout->addWidget(cullBackFacesBox,           14,         3,          1,          1           );
+    windowLayout->addWidget(shadowsBox,                 15,         3,          1,          1           );
+    windowLayout->addWidget(perPixelShadowsBox,         16,         3,          1,          1           );
+    windowLayout->addWidget(shadowMapBox,               17,         3,          1,          1           );
 
     // Translate Slider Row
     windowLayout->addWidget(xTranslateSlider,           nStacked,   1,          1,          1           );
@@ -176,6 +184,10 @@ void RenderWindow::ResetInterface()
     centreObjectBox         ->setChecked        (renderParameters   ->  centreObject);
     scaleObjectBox          ->setChecked        (renderParameters   ->  scaleObject);
     phongShadingBox		    ->setChecked        (renderParameters   ->  phongShadingOn);
+    cullBackFacesBox        ->setChecked        (renderParameters   ->  cullBackFaces);
+    shadowsBox              ->setChecked        (renderParameters   ->  shadowsOn);
+    perPixelShadowsBox      ->setChecked        (renderParameters   ->  perPixelShadows);
+    shadowMapBox            ->setChecked        (renderParameters   ->  shadowMapOn);
     // set sliders
     // x & y translate are scaled to notional unit sphere in render widgets
     // but because the slider is defined as integer, we multiply by a 100 for all sliders
@@ -241,4 +253,8 @@ void RenderWindow::ResetInterface()
     showObjectBox           ->update();
     centreObjectBox         ->update();
     scaleObjectBox          ->update();
+    cullBackFacesBox        ->update();
+    shadowsBox              ->update();
+    perPixelShadowsBox      ->update();
+    shadowMapBox            ->update();
     } // RenderWindow::ResetInterface()
@@ -62,6 +62,10 @@ class RenderWindow : public QWidget
     QCheckBox                   *texturedRenderingBox;
     QCheckBox                   *textureModulationBox;
     QCheckBox					*phongShadingBox;
+    QCheckBox                   *cullBackFacesBox;
+    QCheckBox                   *shadowsBox;
+    QCheckBox                   *perPixelShadowsBox;
+    QCheckBox                   *shadowMapBox;
     // check boxes for modelling options
     QCheckBox                   *showAxesBox;
     QCheckBox                   *showObjectBox;
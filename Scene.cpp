@@ -0,0 +1,407 @@
+#include "Scene.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "SimdMath.h"
+#include "ImpostorCache.h"
+#include "TexturedObject.h"
+
+namespace
+{
+    //the slab test: true if the ray meets the box somewhere in [0, tMax]
+    auto rayHitsBox(const Cartesian3 & origin, const Cartesian3 & inverseDirection, const Cartesian3 & boundsMin,
+                    const Cartesian3 & boundsMax, float tMax) -> bool
+    {
+        float tEnter = 0.f, tExit = tMax;
+        for(int axis = 0; axis < 3; axis++)
+        {
+            float t1 = (boundsMin[axis] - origin[axis]) * inverseDirection[axis];
+            float t2 = (boundsMax[axis] - origin[axis]) * inverseDirection[axis];
+            tEnter = std::max(tEnter, std::min(t1, t2));
+            tExit = std::min(tExit, std::max(t1, t2));
+        }
+        return tEnter <= tExit;
+    }
+
+    enum Overlap { Outside, Partial, Inside };
+
+    //the six clip planes in world space (Gribb & Hartmann), inside positive, tested four at a
+    //time: the second four repeat the last two. unnormalised, since only the signs matter
+    struct FrustumPlanes
+    {
+        SimdMath::float4 normalX[2], normalY[2], normalZ[2], offset[2];
+        //the absolute normals, for how far a box reaches towards each plane
+        SimdMath::float4 reachX[2], reachY[2], reachZ[2];
+
+        FrustumPlanes(const Matrix4 & viewProjection)
+        {
+            using namespace SimdMath;
+            alignas(16) float planes[4][8];
+            for(int plane = 0; plane < 8; plane++)
+            {
+                int source = plane < 6 ? plane : plane - 2;
+                float sign = source % 2 == 0 ? 1.f : -1.f;
+                for(int column = 0; column < 4; column++)
+                    planes[column][plane] = viewProjection[3][column] + sign * viewProjection[source / 2][column];
+            }
+            for(int group = 0; group < 2; group++)
+            {
+                normalX[group] = load(planes[0] + 4 * group);
+                normalY[group] = load(planes[1] + 4 * group);
+                normalZ[group] = load(planes[2] + 4 * group);
+                offset[group] = load(planes[3] + 4 * group);
+                reachX[group] = abs(normalX[group]);
+                reachY[group] = abs(normalY[group]);
+                reachZ[group] = abs(normalZ[group]);
+            }
+        }
+
+        //a box is outside if it is wholly behind any plane, and inside if it is wholly in front of all
+        auto classify(const Cartesian3 & boundsMin, const Cartesian3 & boundsMax) const -> Overlap
+        {
+            using namespace SimdMath;
+            float4 centreX = splat(0.5f * (boundsMin.x + boundsMax.x)), extentX = splat(0.5f * (boundsMax.x - boundsMin.x));
+            float4 centreY = splat(0.5f * (boundsMin.y + boundsMax.y)), extentY = splat(0.5f * (boundsMax.y - boundsMin.y));
+            float4 centreZ = splat(0.5f * (boundsMin.z + boundsMax.z)), extentZ = splat(0.5f * (boundsMax.z - boundsMin.z));
+            bool inside = true;
+            for(int group = 0; group < 2; group++)
+            {
+                float4 distance = add(add(mul(normalX[group], centreX), mul(normalY[group], centreY)), add(mul(normalZ[group], centreZ), offset[group]));
+                float4 reach = add(add(mul(reachX[group], extentX), mul(reachY[group], extentY)), mul(reachZ[group], extentZ));
+                if(anyLess(add(distance, reach), splat(0.f)))
+                    return Outside;
+                inside = inside && !anyLess(sub(distance, reach), splat(0.f));
+            }
+            return inside ? Inside : Partial;
+        }
+    };
+};
+
+auto Scene::add(TexturedObject * object, const Matrix4 & transform) -> uint32_t
+{
+    entries.emplace_back();
+    Entry & entry = entries.back();
+    entry.object = object;
+    entry.transform = transform;
+    entry.leaf = 0;
+    computeBounds(entry);
+    return (uint32_t)entries.size() - 1;
+}
+
+auto Scene::setTransform(uint32_t id, const Matrix4 & transform) -> void
+{
+    entries[id].transform = transform;
+    computeBounds(entries[id]);
+    moved.emplace_back(id);
+}
+
+auto Scene::computeBounds(Entry & entry) -> void
+{
+    //the box around the bounding sphere, carried through the transform: the centre moves
+    //with it, and each half extent gathers the absolute contributions of the three axes
+    const Matrix4 & transform = entry.transform;
+    float radius = entry.object->objectSize;
+    Cartesian3 centre = transform * entry.object->centreOfGravity;
+    Cartesian3 extent;
+    for(int row = 0; row < 3; row++)
+        extent[row] = radius * (std::fabs(transform[row][0]) + std::fabs(transform[row][1]) + std::fabs(transform[row][2]));
+    entry.boundsMin = centre - extent;
+    entry.boundsMax = centre + extent;
+    entry.inverse = transform.inverse();
+}
+
+auto Scene::build() -> void
+{
+    nodes.clear();
+    moved.clear();
+    builtCount = (uint32_t)entries.size();
+    if(entries.empty())
+        return;
+
+    order.resize(entries.size());
+    boxes.resize(entries.size());
+    for(uint32_t id = 0; id < entries.size(); id++)
+    {
+        order[id] = id;
+        boxes[id] = SAHBox(entries[id].boundsMin, entries[id].boundsMax);
+    }
+    nodes.reserve(2 * entries.size());
+    buildNode(0, (uint32_t)entries.size(), 0);
+}
+
+auto Scene::buildNode(uint32_t first, uint32_t count, uint32_t parent) -> uint32_t
+{
+    uint32_t index = (uint32_t)nodes.size();
+    nodes.emplace_back();
+    SceneNode node;
+    node.firstObject = first;
+    node.objectCount = count;
+    node.rightChild = 0;
+    node.parent = parent;
+
+    SAHBox bounds, centres;
+    boundSAHBoxes(boxes.data() + first, count, bounds, centres);
+    node.boundsMin = bounds.getMin();
+    node.boundsMax = bounds.getMax();
+
+    uint32_t leftCount = 0;
+    SAHSplit split = findSAHSplit<SCENE_SAH_BINS>(boxes.data() + first, count, centres);
+    //a leaf tests each of its objects; a split tests itself, then its children as often as they are hit
+    float area = bounds.surfaceArea();
+    float splitCost = 1.f + (area > 0.f ? split.cost / area : 0.f);
+    if(split.cost < std::numeric_limits<float>::max() && (count > SCENE_MAX_LEAF_OBJECTS || splitCost < count))
+        leftCount = partitionSAH(boxes.data() + first, order.data() + first, count, split);
+
+    if(leftCount == 0 || leftCount == count)
+    {
+        for(uint32_t object = first; object < first + count; object++)
+            entries[order[object]].leaf = index;
+    }
+    else
+    {
+        buildNode(first, leftCount, index);
+        node.rightChild = buildNode(first + leftCount, count - leftCount, index);
+    }
+    nodes[index] = node;
+    return index;
+}
+
+auto Scene::update() -> void
+{
+    if(builtCount != entries.size())
+    {
+        build();
+        return;
+    }
+    if(moved.empty())
+        return;
+
+    //mark every node above a moved object, stopping where an earlier one already did
+    std::vector<bool> stale(nodes.size(), false);
+    for(uint32_t id : moved)
+    {
+        uint32_t node = entries[id].leaf;
+        while(!stale[node])
+        {
+            stale[node] = true;
+            if(node == 0)
+                break;
+            node = nodes[node].parent;
+        }
+    }
+    moved.clear();
+
+    //children always come after their parents, so a backward pass refits bottom up
+    for(uint32_t index = (uint32_t)nodes.size(); index-- > 0;)
+    {
+        if(!stale[index])
+            continue;
+        SceneNode & node = nodes[index];
+        SAHBox bounds;
+        if(node.rightChild == 0)
+        {
+            for(uint32_t object = node.firstObject; object < node.firstObject + node.objectCount; object++)
+                bounds.grow(SAHBox(entries[order[object]].boundsMin, entries[order[object]].boundsMax));
+        }
+        else
+        {
+            bounds.grow(SAHBox(nodes[index + 1].boundsMin, nodes[index + 1].boundsMax));
+            bounds.grow(SAHBox(nodes[node.rightChild].boundsMin, nodes[node.rightChild].boundsMax));
+        }
+        node.boundsMin = bounds.getMin();
+        node.boundsMax = bounds.getMax();
+    }
+}
+
+auto Scene::cull(const Matrix4 & viewProjection, std::vector<uint32_t> & visible) const -> void
+{
+    if(nodes.empty())
+        return;
+    FrustumPlanes planes(viewProjection);
+
+    uint32_t stack[64];
+    uint32_t depth = 0;
+    uint32_t index = 0;
+    while(true)
+    {
+        const SceneNode & node = nodes[index];
+        Overlap overlap = planes.classify(node.boundsMin, node.boundsMax);
+        if(overlap == Inside)
+            visible.insert(visible.end(), order.begin() + node.firstObject, order.begin() + node.firstObject + node.objectCount);
+        else if(overlap == Partial && node.rightChild == 0)
+        {
+            for(uint32_t object = node.firstObject; object < node.firstObject + node.objectCount; object++)
+                if(planes.classify(entries[order[object]].boundsMin, entries[order[object]].boundsMax) != Outside)
+                    visible.emplace_back(order[object]);
+        }
+        else if(overlap == Partial && depth < 64)
+        {
+            stack[depth++] = node.rightChild;
+            index = index + 1;
+            continue;
+        }
+        else if(overlap == Partial)
+        {
+            //deeper than the stack: keep the whole subtree rather than lose anything
+            visible.insert(visible.end(), order.begin() + node.firstObject, order.begin() + node.firstObject + node.objectCount);
+        }
+        if(depth == 0)
+            break;
+        index = stack[--depth];
+    }
+}
+
+auto Scene::intersect(const Cartesian3 & origin, const Cartesian3 & direction, uint32_t & id, RayHit & hit, float tMax) const -> bool
+{
+    if(nodes.empty())
+        return false;
+    Cartesian3 inverseDirection;
+    for(int axis = 0; axis < 3; axis++)
+        inverseDirection[axis] = 1.f / (std::fabs(direction[axis]) < 1e-30f ? (std::signbit(direction[axis]) ? -1e-30f : 1e-30f) : direction[axis]);
+
+    uint32_t stack[64];
+    uint32_t depth = 0;
+    uint32_t index = 0;
+    bool found = false;
+    while(true)
+    {
+        const SceneNode & node = nodes[index];
+        if(rayHitsBox(origin, inverseDirection, node.boundsMin, node.boundsMax, tMax))
+        {
+            if(node.rightChild != 0 && depth < 64)
+            {
+                stack[depth++] = node.rightChild;
+                index = index + 1;
+                continue;
+            }
+            //a leaf, or deeper than the stack: test the objects one by one
+            for(uint32_t object = node.firstObject; object < node.firstObject + node.objectCount; object++)
+            {
+                const Entry & entry = entries[order[object]];
+                if(!rayHitsBox(origin, inverseDirection, entry.boundsMin, entry.boundsMax, tMax))
+                    continue;
+                //an affine map keeps the ray's parameter, so t means the same in the object
+                Cartesian3 objectOrigin = entry.inverse * origin;
+                Cartesian3 objectDirection = entry.inverse * (origin + direction) - objectOrigin;
+                if(entry.object->bvh.intersect(objectOrigin, objectDirection, hit, tMax))
+                {
+                    tMax = hit.t;
+                    id = order[object];
+                    found = true;
+                }
+            }
+        }
+        if(depth == 0)
+            return found;
+        index = stack[--depth];
+    }
+}
+
+auto Scene::occluded(const RayPacket & packet, int active) const -> int
+{
+    if(nodes.empty() || active == 0)
+        return 0;
+
+    uint32_t stack[64];
+    uint32_t depth = 0;
+    uint32_t index = 0;
+    int done = 0;
+    RayPacket objectPacket;
+    while(true)
+    {
+        const SceneNode & node = nodes[index];
+        int lanes = packet.hitsBox(&node.boundsMin.x, &node.boundsMax.x, active & ~done);
+        if(lanes != 0 && node.rightChild != 0 && depth < 64)
+        {
+            stack[depth++] = node.rightChild;
+            index = index + 1;
+            continue;
+        }
+        //a leaf, or deeper than the stack: test the objects one by one
+        for(uint32_t object = node.firstObject; lanes != 0 && object < node.firstObject + node.objectCount; object++)
+        {
+            const Entry & entry = entries[order[object]];
+            int objectLanes = packet.hitsBox(&entry.boundsMin.x, &entry.boundsMax.x, lanes & ~done);
+            if(objectLanes == 0)
+                continue;
+            packet.transform(entry.inverse, objectPacket);
+            done |= entry.object->bvh.occluded(objectPacket, objectLanes);
+        }
+        if(done == active || depth == 0)
+            return done;
+        index = stack[--depth];
+    }
+}
+
+auto Scene::render(FakeGL & gl, const RenderParameters & renderParameters, ImpostorCache * impostors) -> void
+{
+    update();
+    if(impostors != nullptr)
+        impostors->beginFrame(gl, renderParameters);
+
+    gl.MatrixMode(FAKEGL_MODELVIEW);
+    //PushMatrix() starts from the identity, so the caller's matrix is kept to put back, without the zoom
+    Matrix4 callerModelView = gl.stateMechine.modelViewMatrixStack.top();
+    gl.Scalef(renderParameters.zoomScale, renderParameters.zoomScale, renderParameters.zoomScale);
+    Matrix4 modelView = gl.stateMechine.modelViewMatrixStack.top();
+    Matrix4 viewProjection = gl.stateMechine.projectionMatrixStack.top() * modelView;
+    visible.clear();
+    cull(viewProjection, visible);
+
+    //each object at its own size & position, as its transform places it
+    RenderParameters objectParameters = renderParameters;
+    objectParameters.zoomScale = 1.f;
+    objectParameters.scaleObject = false;
+    objectParameters.centreObject = false;
+
+    //the objects largest on screen hide those behind them, but only while the depth test
+    //is on, since the hidden objects would otherwise show through
+    const OcclusionCuller * occlusion = nullptr;
+    occludedCount = 0;
+    if(renderParameters.occlusionCullingOn && renderParameters.depthTestOn && visible.size() > 1)
+    {
+        //the size across of the sphere around a box, as a fraction of the viewport's height (2 across in
+        //clip terms), is its radius scaled by the projection's y scale over the clip w of its centre
+        float yScale = gl.stateMechine.projectionMatrixStack.top()[1][1];
+        occluders.clear();
+        for(uint32_t id : visible)
+        {
+            const Entry & entry = entries[id];
+            Homogeneous4 centre = viewProjection * Homogeneous4((entry.boundsMin + entry.boundsMax) * 0.5f);
+            float size = (entry.boundsMax - entry.boundsMin).length() * 0.5f * std::fabs(yScale) / centre.w;
+            if(centre.w > 0.f && size >= SCENE_MIN_OCCLUDER_SIZE)
+                occluders.emplace_back(-size, id);
+        }
+        uint32_t occluderCount = std::min<uint32_t>(SCENE_MAX_OCCLUDERS, (uint32_t)occluders.size());
+        std::partial_sort(occluders.begin(), occluders.begin() + occluderCount, occluders.end());
+
+        if(occluderCount > 0)
+        {
+            occlusionCuller.begin(gl);
+            for(uint32_t i = 0; i < occluderCount; i++)
+            {
+                uint32_t id = occluders[i].second;
+                gl.stateMechine.modelViewMatrixStack.top() = modelView * entries[id].transform;
+                entries[id].object->FakeGLRenderOccluder(&objectParameters, &gl, &occlusionCuller);
+            }
+            occlusionCuller.finish();
+            occlusion = &occlusionCuller;
+        }
+    }
+
+    for(uint32_t id : visible)
+    {
+        if(occlusion != nullptr && !occlusion->isVisible(viewProjection, entries[id].boundsMin, entries[id].boundsMax))
+        {
+            occludedCount++;
+            continue;
+        }
+        gl.stateMechine.modelViewMatrixStack.top() = modelView * entries[id].transform;
+        gl.stateMechine.markDirty(DIRTY_MODELVIEW);
+        if(impostors != nullptr && impostors->draw(gl, *entries[id].object, objectParameters))
+            continue;
+        entries[id].object->FakeGLRender(&objectParameters, &gl, occlusion);
+    }
+    gl.stateMechine.modelViewMatrixStack.top() = callerModelView;
+    gl.stateMechine.markDirty(DIRTY_MODELVIEW);
+}
@@ -0,0 +1,120 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <cstdint>
+#include <vector>
+#include "Cartesian3.h"
+#include "Matrix4.h"
+#include "FakeGL.h"
+#include "RenderParameters.h"
+#include "MeshBVH.h"
+#include "BinnedSAH.h"
+#include "OcclusionCuller.h"
+
+class TexturedObject;
+class ImpostorCache;
+
+//many objects, each placed in the world by its own transform, held in a bounding volume
+//hierarchy over their boxes, so that a frame only visits what is inside the view volume.
+//the objects share FakeGL's single texture, so they should share a texture too
+constexpr uint32_t SCENE_SAH_BINS = 12;
+//a leaf holds at most this many objects, unless they can't be told apart
+constexpr uint32_t SCENE_MAX_LEAF_OBJECTS = 4;
+//with occlusion culling on, up to this many of the objects largest on screen are rasterised as occluders,
+//as long as their bounding spheres are at least the given fraction of the viewport's height across:
+//an occluder costs its full detail mesh, which smaller objects would not hide enough to pay back
+constexpr uint32_t SCENE_MAX_OCCLUDERS = 4;
+constexpr float SCENE_MIN_OCCLUDER_SIZE = 0.25f;
+
+//a node of the hierarchy. its objects are order[firstObject, firstObject + objectCount), in
+//leaves and internal nodes alike; an internal node's children are the next node & rightChild
+struct SceneNode
+{
+    Cartesian3 boundsMin;
+    Cartesian3 boundsMax;
+    uint32_t firstObject;
+    uint32_t objectCount;
+    //0 for a leaf, since the root is never anyone's child
+    uint32_t rightChild;
+    uint32_t parent;
+};
+
+class Scene
+{
+public:
+    //the transform maps the object's own coordinates into the world. returns the object's id
+    auto add(TexturedObject * object, const Matrix4 & transform) -> uint32_t;
+
+    //moves an object; the hierarchy is refitted at the next update()
+    auto setTransform(uint32_t id, const Matrix4 & transform) -> void;
+
+    inline auto getTransform(uint32_t id) const -> const Matrix4 & { return entries[id].transform; }
+    inline auto getObject(uint32_t id) const -> TexturedObject * { return entries[id].object; }
+    inline auto size() const -> uint32_t { return (uint32_t)entries.size(); }
+    inline auto getNodes() const -> const std::vector<SceneNode> & { return nodes; }
+
+    //builds the hierarchy from scratch, splitting where a binned surface area heuristic says
+    auto build() -> void;
+
+    //rebuilds if objects were added since the last build, otherwise refits the boxes above the
+    //objects that moved. refitting keeps the tree, so after large moves a build() may pay off
+    auto update() -> void;
+
+    //appends the ids of the objects whose boxes meet the view volume of viewProjection,
+    //which takes world coordinates to clip coordinates. the hierarchy must be up to date
+    auto cull(const Matrix4 & viewProjection, std::vector<uint32_t> & visible) const -> void;
+
+    //the closest hit, with 0 <= t < tMax, of a world ray on the objects' triangles, through each
+    //object's own hierarchy. t is in world terms, the triangle & barycentrics in the object's.
+    //the hierarchy must be up to date. false on a miss
+    auto intersect(const Cartesian3 & origin, const Cartesian3 & direction, uint32_t & id, RayHit & hit,
+                   float tMax = std::numeric_limits<float>::max()) const -> bool;
+
+    //the lanes among active (bit i for lane i) whose world rays hit an object's triangles at
+    //0 <= t < tMax, walking the scene's hierarchy & then each object's own. the hierarchy must be up to date
+    auto occluded(const RayPacket & packet, int active) const -> int;
+
+    //updates, culls against FakeGL's matrices, and draws the visible objects with FakeGLRender().
+    //the zoom scales the whole scene, while each object is drawn at its own size & position.
+    //given an impostor cache, the objects small enough on screen are drawn as impostors instead.
+    //with occlusionCullingOn & the depth test, the objects largest on screen are first rasterised into an
+    //occlusion culler, and the objects & meshlets it says are hidden behind them are not drawn at all
+    auto render(FakeGL & gl, const RenderParameters & renderParameters, ImpostorCache * impostors = nullptr) -> void;
+
+    //how many of the objects inside the view volume the last render() found hidden by occluders
+    inline auto getOccludedCount() const -> uint32_t { return occludedCount; }
+
+private:
+    struct Entry
+    {
+        TexturedObject * object;
+        Matrix4 transform;
+        //takes world rays back to the object
+        Matrix4 inverse;
+        //the world box around the object's bounding sphere
+        Cartesian3 boundsMin;
+        Cartesian3 boundsMax;
+        //the leaf holding it
+        uint32_t leaf;
+    };
+
+    auto computeBounds(Entry & entry) -> void;
+    //builds the node over order[first, first + count) & everything below it, returning its index
+    auto buildNode(uint32_t first, uint32_t count, uint32_t parent) -> uint32_t;
+
+    std::vector<Entry> entries;
+    //object ids, so arranged that every node's objects are contiguous
+    std::vector<uint32_t> order;
+    std::vector<SceneNode> nodes;
+    //the number of objects the hierarchy was built over
+    uint32_t builtCount = 0;
+    std::vector<uint32_t> moved;
+    //scratch for build(), the objects' boxes in the same order as order, & for render()
+    std::vector<SAHBox> boxes;
+    std::vector<uint32_t> visible;
+    std::vector<std::pair<float, uint32_t>> occluders;
+    OcclusionCuller occlusionCuller;
+    uint32_t occludedCount = 0;
+};
+
+#endif // SCENE_H
@@ -2,6 +2,7 @@
 #include <math.h>
 #include <algorithm>
 #include "MathUtils.h"
+#include "ShadowSource.h"
 
 auto Shader::bindTexture(const RGBAImage * img) -> void
 {
@@ -14,18 +15,13 @@ auto Shader::reflect(const Cartesian3 & vec,const Cartesian3 & normal) -> Cartes
     return vec - normal * dn;
 }
 
-GouraudShadingShader::GouraudShadingShader()
-{
-    modelViewInverse.SetIdentity();
-}
-
 auto GouraudShadingShader::vertexShader(const vertexWithAttributes & vertex,const FakeGL & gl) -> screenVertexWithAttributes
 {
+    auto & derived = gl.stateMechine.getDerivedState();
+    auto mdlvCoord = derived.modelView * vertex.position;
+    auto projCoord = derived.modelViewProjection * vertex.position;
 
-    auto mdlvCoord = modelViewMatrix * vertex.position;
-    auto projCoord = projectMatrix * mdlvCoord;
-
-    auto mdlvNormal = modelViewInverse * vertex.normal;
+    auto mdlvNormal = derived.normalMatrix * vertex.normal;
 
     //auto projNormal = projectMatrix * mdlvNormal;
 
@@ -35,7 +31,8 @@ auto GouraudShadingShader::vertexShader(const vertexWithAttributes & vertex,cons
     out.normal = mdlvNormal;
     out.colour = vertex.colour;
     out.texCoord = vertex.texCoord;
-
+    //per pixel shadows need to know where the fragments are
+    out.modelViewCoord = mdlvCoord;
 
     const Cartesian3 eyePos = {0,0,0};
     if(light != nullptr)
@@ -51,13 +48,28 @@ auto GouraudShadingShader::vertexShader(const vertexWithAttributes & vertex,cons
         auto ref = reflect(lightDir,mdlvNormal) ;
         ref.normalize();
 
-        auto diffuse = light->getDiffuse() * gl.stateMechine.material.getDiffuse() * std::max(lightDir.dot(mdlvNormal), 0.0f);
-        auto specular = light->getSpecular() * gl.stateMechine.material.getSpecular() * std::pow(std::max(eyeDir.dot(ref),0.0f),gl.stateMechine.material.getShininess());;
-        auto emission = gl.stateMechine.material.getEmission();
-        auto ambient = light->getAmbient() * gl.stateMechine.material.getAmbient();
+        auto diffuse = derived.diffuseProduct * std::max(lightDir.dot(mdlvNormal), 0.0f);
+        auto specular = derived.specularProduct * std::pow(std::max(eyeDir.dot(ref),0.0f),gl.stateMechine.material.getShininess());;
+
+//a shadow only hides the light's own contribution
+        if(gl.stateMechine.enables[FAKEGL_SHADOWS] && gl.stateMechine.shadowSource != nullptr)
+        {
+            if(gl.stateMechine.shadowMode == FAKEGL_PER_PIXEL)
+            {
+                //the fragments pick between the two colours once they know if they see the light
+                out.shadowColour = out.colour * Color(derived.emissiveAmbient).toRGBAValue();
+                out.shadowColour.alpha = 255;
+            }
+            else
+            {
+                float visibility = gl.stateMechine.shadowSource->visibility(mdlvCoord.Vector(), mdlvNormal, light->getPosition());
+                diffuse = diffuse * visibility;
+                specular = specular * visibility;
+            }
+        }
 
 //it looks like the OpenGL has a min color for object???
-        out.colour =  out.colour * (emission + ambient+ diffuse + specular).toRGBAValue();
+        out.colour =  out.colour * (derived.emissiveAmbient + diffuse + specular).toRGBAValue();
         out.colour.alpha = 255;
     }
 
@@ -73,25 +85,27 @@ auto GouraudShadingShader::fragmentShader(const fragmentWithAttributes & vertex,
 }
 
 
-PhongShadingShader::PhongShadingShader(){
-    modelViewInverse.SetIdentity();
-}
-
 auto PhongShadingShader::vertexShader(const vertexWithAttributes & vertex,const FakeGL & gl) -> screenVertexWithAttributes
 {
 
     screenVertexWithAttributes screen;
-    auto mdlvCoord = modelViewMatrix * vertex.position;
-    auto projCoord = projectMatrix * mdlvCoord;
+    auto & derived = gl.stateMechine.getDerivedState();
+    auto mdlvCoord = derived.modelView * vertex.position;
+    auto projCoord = derived.modelViewProjection * vertex.position;
 
     screen.modelViewCoord = mdlvCoord;
     screen.position = projCoord.Point();
     screen.divZ = 1.0f / projCoord.w;
 
 
-    screen.normal = modelViewInverse * vertex.normal;
+    screen.normal = derived.normalMatrix * vertex.normal;
     screen.colour = vertex.colour;
     screen.texCoord = vertex.texCoord;
+
+    //per vertex shadows are interpolated like the other attributes
+    if(light != nullptr && gl.stateMechine.enables[FAKEGL_SHADOWS] && gl.stateMechine.shadowSource != nullptr
+       && gl.stateMechine.shadowMode == FAKEGL_PER_VERTEX)
+        screen.lightVisibility = gl.stateMechine.shadowSource->visibility(mdlvCoord.Vector(), screen.normal, light->getPosition());
     return screen;
 }
 
@@ -99,16 +113,6 @@ auto Shader::setLight(const Light * light) -> void
 {
     this-> light = light;
 }
-auto Shader::setProjectMatrix(const Matrix4 &project) -> void
-{
-    projectMatrix = project;
-}
-
-auto Shader::setModelViewMatrix(const Matrix4 &modelView) -> void
-{
-    modelViewMatrix = modelView;
-    modelViewInverse = modelViewMatrix.inverse().transpose();
-};
 
 auto PhongShadingShader::fragmentShader(const fragmentWithAttributes & fragment,const FakeGL & gl) -> RGBAValue
 {
@@ -129,8 +133,12 @@ auto PhongShadingShader::fragmentShader(const fragmentWithAttributes & fragment,
         auto lightDir = light->getPosition() - fragPos;
         lightDir.normalize();
 
+        //a shadow only hides the light's own contribution
+        float visibility = gl.stateMechine.enables[FAKEGL_SHADOWS] ? fragment.lightVisibility : 1.0f;
+
         float diff = std::max(normalizedNormal.dot(lightDir), 0.0f);
-        auto diffuse =  (light->getDiffuse()*  gl.stateMechine.material.getDiffuse())* diff;
+        auto & derived = gl.stateMechine.getDerivedState();
+        auto diffuse =  derived.diffuseProduct * (diff * visibility);
 //---------------------
 //specular
 //calculate the eye direction
@@ -139,12 +147,10 @@ auto PhongShadingShader::fragmentShader(const fragmentWithAttributes & fragment,
 
         auto reflectDir = reflect(lightDir, normalizedNormal);
         float spec = std::pow(std::max(viewDir.dot(reflectDir), 0.0f), gl.stateMechine.material.getShininess());
-        auto specular = light->getSpecular() * gl.stateMechine.material.getSpecular() *  spec;
+        auto specular = derived.specularProduct *  (spec * visibility);
 //---------------------
 //ambient is easy
-        auto ambient = light->getAmbient()* gl.stateMechine.material.getAmbient();
-        auto & emission =  gl.stateMechine.material.getEmission();
-        return  (ambient + diffuse + specular + emission).toRGBAValue() * color;;
+        return  (derived.ambientProduct + diffuse + specular + gl.stateMechine.material.getEmission()).toRGBAValue() * color;;
 
     }
     return color;
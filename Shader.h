@@ -16,18 +16,17 @@ public:
     virtual auto vertexShader(const vertexWithAttributes & vertex,const FakeGL & gl) -> screenVertexWithAttributes = 0;
     virtual auto fragmentShader(const fragmentWithAttributes & fragment,const FakeGL & gl) -> RGBAValue = 0;
 
-    auto setModelViewMatrix(const Matrix4 &modelView) -> void;
-    auto setProjectMatrix(const Matrix4 &project) -> void;
+    //the matrices & lighting products come from the state mechine's derived state
     auto bindTexture(const RGBAImage * img) -> void;
     auto setLight(const Light * light) -> void;
 
+    inline auto getLight() const -> const Light * { return light; }
+    inline auto getTexture() const -> const RGBAImage * { return texture2D.getImage(); }
+
     //glsl build-in function
     auto reflect(const Cartesian3 & vec,const Cartesian3 & normal) -> Cartesian3;
 
 protected:
-    Matrix4 modelViewInverse;
-    Matrix4 modelViewMatrix;
-    Matrix4 projectMatrix;
     Texture2D texture2D;
     const Light * light = nullptr;
 };
@@ -37,7 +36,6 @@ protected:
 class GouraudShadingShader : public Shader
 {
 public:
-    GouraudShadingShader();
     auto vertexShader(const vertexWithAttributes & vertex,const FakeGL & gl) -> screenVertexWithAttributes override;
     auto fragmentShader(const fragmentWithAttributes & fragment,const FakeGL & gl) -> RGBAValue override;
 };
@@ -46,7 +44,6 @@ public:
 class PhongShadingShader : public Shader
 {
  public:
-    PhongShadingShader();
     auto vertexShader(const vertexWithAttributes & vertex,const FakeGL & gl) -> screenVertexWithAttributes override;
     auto fragmentShader(const fragmentWithAttributes & fragment,const FakeGL & gl) -> RGBAValue override;
 };
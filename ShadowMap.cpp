@@ -0,0 +1,228 @@
+#include "ShadowMap.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "Scene.h"
+#include "TexturedObject.h"
+
+namespace
+{
+    constexpr float FAR_AWAY = std::numeric_limits<float>::infinity();
+
+    //the affine part of a matrix, written out, since the depth pass transforms every corner
+    inline auto transformPoint(const Matrix4 & matrix, float x, float y, float z) -> Cartesian3
+    {
+        return Cartesian3(matrix[0][0] * x + matrix[0][1] * y + matrix[0][2] * z + matrix[0][3],
+                          matrix[1][0] * x + matrix[1][1] * y + matrix[1][2] * z + matrix[1][3],
+                          matrix[2][0] * x + matrix[2][1] * y + matrix[2][2] * z + matrix[2][3]);
+    }
+}
+
+ShadowMap::ShadowMap(uint32_t size)
+    : size(size), depths((size_t)size * size, FAR_AWAY)
+{
+    lightView.SetIdentity();
+    eyeToLight.SetIdentity();
+}
+
+auto ShadowMap::clear() -> void
+{
+    casters.clear();
+}
+
+auto ShadowMap::add(const MeshBVH & bvh, const Matrix4 & transform) -> void
+{
+    casters.push_back({&bvh, bvh.getVersion(), transform});
+}
+
+auto ShadowMap::add(const Scene & scene) -> void
+{
+    for(uint32_t id = 0; id < scene.size(); id++)
+        add(scene.getObject(id)->bvh, scene.getTransform(id));
+}
+
+auto ShadowMap::update(const Cartesian3 & light, const Matrix4 & view) -> bool
+{
+    Matrix4 eyeToCasters = view.inverse();
+    Cartesian3 casterLight = eyeToCasters * light;
+
+    //moving the view alone, or drawing the same frame again, keeps the map
+    bool stale = !drawn || !(casterLight == drawnLight) || casters != drawnCasters;
+    if(stale)
+    {
+        render(casterLight);
+        drawn = true;
+        drawnLight = casterLight;
+        drawnCasters = casters;
+    }
+    eyeToLight = lightView * eyeToCasters;
+    return stale;
+}
+
+auto ShadowMap::render(const Cartesian3 & light) -> void
+{
+    renderCount++;
+    std::fill(depths.begin(), depths.end(), FAR_AWAY);
+
+    //a sphere around the casters' boxes decides where the light looks & how wide
+    Cartesian3 boundsMin(FAR_AWAY, FAR_AWAY, FAR_AWAY), boundsMax(-FAR_AWAY, -FAR_AWAY, -FAR_AWAY);
+    for(const Caster & caster : casters)
+    {
+        if(caster.bvh->getNodes().empty())
+            continue;
+        const MeshBVHNode & root = caster.bvh->getNodes()[0];
+        for(int corner = 0; corner < 8; corner++)
+        {
+            Cartesian3 point = transformPoint(caster.transform,
+                                              (corner & 1) ? root.boundsMax[0] : root.boundsMin[0],
+                                              (corner & 2) ? root.boundsMax[1] : root.boundsMin[1],
+                                              (corner & 4) ? root.boundsMax[2] : root.boundsMin[2]);
+            for(int axis = 0; axis < 3; axis++)
+            {
+                boundsMin[axis] = std::min(boundsMin[axis], point[axis]);
+                boundsMax[axis] = std::max(boundsMax[axis], point[axis]);
+            }
+        }
+    }
+    if(boundsMin.x > boundsMax.x)
+    {
+        lightView.SetIdentity();
+        return;
+    }
+    Cartesian3 centre = 0.5f * (boundsMin + boundsMax);
+    float radius = 0.5f * (boundsMax - boundsMin).length();
+
+    //the light looks at the centre, with the sphere just inside the map, unless it is in the sphere
+    Cartesian3 forward = centre - light;
+    float distance = forward.length();
+    forward = distance > 0.f ? forward / distance : Cartesian3(0.f, 0.f, -1.f);
+    if(distance > radius)
+    {
+        tanHalfAngle = radius / std::sqrt(distance * distance - radius * radius);
+        nearDepth = distance - radius;
+    }
+    else
+    {
+        //whatever is behind the light or outside the widest view casts no shadow
+        tanHalfAngle = SHADOW_MAP_WIDEST_TAN;
+        nearDepth = radius * 1e-3f;
+    }
+    Cartesian3 helper = std::fabs(forward.y) < 0.9f ? Cartesian3(0.f, 1.f, 0.f) : Cartesian3(1.f, 0.f, 0.f);
+    Cartesian3 right = helper.cross(forward).unit();
+    Cartesian3 up = forward.cross(right);
+    lightView.SetIdentity();
+    const Cartesian3 * axes[3] = {&right, &up, &forward};
+    for(int row = 0; row < 3; row++)
+    {
+        for(int col = 0; col < 3; col++)
+            lightView[row][col] = (*axes[row])[col];
+        lightView[row][3] = -axes[row]->dot(light);
+    }
+
+    //every triangle of every caster, from either side
+    for(const Caster & caster : casters)
+    {
+        Matrix4 toLight = lightView * caster.transform;
+        for(const TrianglePacket & packet : caster.bvh->getPackets())
+            for(int lane = 0; lane < 4; lane++)
+            {
+                float x = packet.vertex0[0][lane], y = packet.vertex0[1][lane], z = packet.vertex0[2][lane];
+                rasterise(transformPoint(toLight, x, y, z),
+                          transformPoint(toLight, x + packet.edge1[0][lane], y + packet.edge1[1][lane], z + packet.edge1[2][lane]),
+                          transformPoint(toLight, x + packet.edge2[0][lane], y + packet.edge2[1][lane], z + packet.edge2[2][lane]));
+            }
+    }
+}
+
+auto ShadowMap::rasterise(const Cartesian3 & vertex0, const Cartesian3 & vertex1, const Cartesian3 & vertex2) -> void
+{
+    //no clipping: a triangle reaching behind the near depth is left out
+    if(vertex0.z < nearDepth || vertex1.z < nearDepth || vertex2.z < nearDepth)
+        return;
+
+    //into texels, keeping 1 / depth, which is linear across the map
+    float scale = 0.5f * size / tanHalfAngle;
+    float halfSize = 0.5f * size;
+    float x0 = vertex0.x / vertex0.z * scale + halfSize, y0 = vertex0.y / vertex0.z * scale + halfSize;
+    float x1 = vertex1.x / vertex1.z * scale + halfSize, y1 = vertex1.y / vertex1.z * scale + halfSize;
+    float x2 = vertex2.x / vertex2.z * scale + halfSize, y2 = vertex2.y / vertex2.z * scale + halfSize;
+    float inverse0 = 1.f / vertex0.z, inverse1 = 1.f / vertex1.z, inverse2 = 1.f / vertex2.z;
+
+    //pixel free triangles, including the empty lanes of a packet, have no area
+    float area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+    if(std::fabs(area) < 1e-12f)
+        return;
+    float inverseArea = 1.f / area;
+
+    //texel centres are at half integers
+    int colMin = std::max(0, (int)std::ceil(std::min({x0, x1, x2}) - 0.5f));
+    int colMax = std::min((int)size - 1, (int)std::floor(std::max({x0, x1, x2}) - 0.5f));
+    int rowMin = std::max(0, (int)std::ceil(std::min({y0, y1, y2}) - 0.5f));
+    int rowMax = std::min((int)size - 1, (int)std::floor(std::max({y0, y1, y2}) - 0.5f));
+    if(colMin > colMax || rowMin > rowMax)
+        return;
+
+    //the weights of vertices 1 & 2 step by a constant per texel
+    float step1 = (y2 - y0) * inverseArea, step2 = -(y1 - y0) * inverseArea;
+    for(int row = rowMin; row <= rowMax; row++)
+    {
+        float x = colMin + 0.5f - x0, y = row + 0.5f - y0;
+        float beta = (x * (y2 - y0) - (x2 - x0) * y) * inverseArea;
+        float gamma = ((x1 - x0) * y - x * (y1 - y0)) * inverseArea;
+        float * depth = &depths[(size_t)row * size];
+        for(int col = colMin; col <= colMax; col++, beta += step1, gamma += step2)
+        {
+            float alpha = 1.f - beta - gamma;
+            if(alpha < 0.f || beta < 0.f || gamma < 0.f)
+                continue;
+            float texelDepth = 1.f / (alpha * inverse0 + beta * inverse1 + gamma * inverse2);
+            depth[col] = std::min(depth[col], texelDepth);
+        }
+    }
+}
+
+auto ShadowMap::lookup(const Cartesian3 & point, float slope) const -> float
+{
+    Cartesian3 light = transformPoint(eyeToLight, point.x, point.y, point.z);
+    //behind the light, or beyond the map, nothing is drawn to cast a shadow
+    if(light.z <= 0.f)
+        return 1.f;
+    float scale = 0.5f * size / tanHalfAngle;
+    int col = (int)std::floor(light.x / light.z * scale + 0.5f * size);
+    int row = (int)std::floor(light.y / light.z * scale + 0.5f * size);
+
+    //a texel spans this much at the point's depth, and neighbouring texels see the surface
+    //nearer or further by up to the slope for each texel they are away
+    float texel = light.z / scale;
+    float receiver = light.z - texel * (SHADOW_MAP_BIAS_TEXELS + (SHADOW_MAP_PCF_RADIUS + 1) * slope);
+
+    int lit = 0;
+    for(int dy = -SHADOW_MAP_PCF_RADIUS; dy <= SHADOW_MAP_PCF_RADIUS; dy++)
+        for(int dx = -SHADOW_MAP_PCF_RADIUS; dx <= SHADOW_MAP_PCF_RADIUS; dx++)
+        {
+            int tapCol = col + dx, tapRow = row + dy;
+            if(tapCol < 0 || tapRow < 0 || tapCol >= (int)size || tapRow >= (int)size
+               || receiver <= depths[(size_t)tapRow * size + tapCol])
+                lit++;
+        }
+    constexpr int taps = (2 * SHADOW_MAP_PCF_RADIUS + 1) * (2 * SHADOW_MAP_PCF_RADIUS + 1);
+    return (float)lit / taps;
+}
+
+auto ShadowMap::visibility(const Cartesian3 * points, const Cartesian3 * normals, uint32_t count,
+                           const Cartesian3 & light, float * visibilities) const -> void
+{
+    for(uint32_t lane = 0; lane < count; lane++)
+    {
+        Cartesian3 toLight = light - points[lane];
+        float normalLength = normals[lane].length(), lightLength = toLight.length();
+        float cosine = normalLength > 0.f && lightLength > 0.f ? normals[lane].dot(toLight) / (normalLength * lightLength) : 1.f;
+        if(cosine <= 0.f)
+        {
+            visibilities[lane] = 0.f;
+            continue;
+        }
+        float slope = std::min(std::sqrt(std::max(1.f - cosine * cosine, 0.f)) / cosine, SHADOW_MAP_MAX_SLOPE);
+        visibilities[lane] = lookup(points[lane], slope);
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef SHADOWMAP_H
+#define SHADOWMAP_H
+
+#include <cstdint>
+#include <vector>
+#include "Cartesian3.h"
+#include "Matrix4.h"
+#include "MeshBVH.h"
+#include "ShadowSource.h"
+
+class Scene;
+
+//texels along each side of the map
+constexpr uint32_t SHADOW_MAP_SIZE = 1024;
+//percentage closer filtering compares this many texels either side of the nearest, so 1 gives 3 x 3
+constexpr int SHADOW_MAP_PCF_RADIUS = 1;
+//the depth bias, in texels at the receiver's depth, before allowing for the surface's slope
+constexpr float SHADOW_MAP_BIAS_TEXELS = 1.5f;
+//steeper slopes than this get no more bias, so that surfaces edge on to the light still shadow
+constexpr float SHADOW_MAP_MAX_SLOPE = 8.f;
+//the tangent of the half angle the map covers when the light is among the casters, about 76 degrees
+constexpr float SHADOW_MAP_WIDEST_TAN = 4.f;
+
+//a depth map of the casters as seen from FakeGL's point light, sampled with percentage closer
+//filtering, so that shadow edges come out soft by a texel or so. the map is drawn by a depth only
+//rasteriser straight from the casters' hierarchies, and kept in the casters' own coordinates:
+//it is only drawn again when the light moves relative to them or they change, not every frame
+class ShadowMap : public ShadowSource
+{
+public:
+    using ShadowSource::visibility;
+
+    explicit ShadowMap(uint32_t size = SHADOW_MAP_SIZE);
+
+    //starts the casters over, which is cheap: the map itself is kept until update() finds it out of date
+    auto clear() -> void;
+
+    //a mesh, which transform places in the casters' coordinates
+    auto add(const MeshBVH & bvh, const Matrix4 & transform) -> void;
+    //each object of a scene, with the world as the casters' coordinates
+    auto add(const Scene & scene) -> void;
+
+    //light is in eye coordinates, and view takes the casters' coordinates to eye coordinates.
+    //redraws the map if the light is somewhere else relative to the casters, or they have changed,
+    //since it was last drawn. returns true if it was
+    auto update(const Cartesian3 & light, const Matrix4 & view) -> bool;
+
+    //the fraction of the filter's texels that see the light
+    auto visibility(const Cartesian3 * points, const Cartesian3 * normals, uint32_t count,
+                    const Cartesian3 & light, float * visibilities) const -> void override;
+
+    inline auto getSize() const -> uint32_t { return size; }
+    //distances along the light's axis, row by row, with infinity where nothing is
+    inline auto getDepths() const -> const std::vector<float> & { return depths; }
+    //how many times the map has been drawn, which shows how well it is cached
+    inline auto getRenderCount() const -> uint32_t { return renderCount; }
+
+private:
+    struct Caster
+    {
+        const MeshBVH * bvh;
+        uint32_t version;
+        Matrix4 transform;
+
+        inline auto operator==(const Caster & other) const -> bool
+        {
+            return bvh == other.bvh && version == other.version && transform == other.transform;
+        }
+    };
+
+    //draws the casters as seen from light, in the casters' coordinates
+    auto render(const Cartesian3 & light) -> void;
+    //the depths of one triangle given in the light's coordinates
+    auto rasterise(const Cartesian3 & vertex0, const Cartesian3 & vertex1, const Cartesian3 & vertex2) -> void;
+    auto lookup(const Cartesian3 & point, float slope) const -> float;
+
+    uint32_t size;
+    std::vector<float> depths;
+    uint32_t renderCount = 0;
+
+    std::vector<Caster> casters;
+    //what the map holds
+    bool drawn = false;
+    std::vector<Caster> drawnCasters;
+    Cartesian3 drawnLight;
+
+    //the light's frame: lightView takes the casters' coordinates to ones with the light at the origin,
+    //looking down z, and x / z & y / z within +-tanHalfAngle fit the map. nothing is nearer than nearDepth
+    Matrix4 lightView;
+    float tanHalfAngle = 1.f;
+    float nearDepth = 0.f;
+    //set by update() for the frame
+    Matrix4 eyeToLight;
+};
+
+#endif // SHADOWMAP_H
@@ -0,0 +1,30 @@
+#ifndef SHADOWSOURCE_H
+#define SHADOWSOURCE_H
+
+#include <cstdint>
+#include "Cartesian3.h"
+
+//where FakeGL's shaders find how much of the light reaches a surface while FAKEGL_SHADOWS is
+//enabled: traced rays (ShadowTracer) or a shadow map (ShadowMap). it is only read while rendering,
+//so the tiles of a TiledRenderer, each on its own thread, can all use the same one
+class ShadowSource
+{
+public:
+    virtual ~ShadowSource() = default;
+
+    //the light reaching up to four eye space points, on surfaces with the given normals: from 1 if
+    //nothing is in the way, down to 0 if something is or the surface faces away from the light.
+    //the points should be close together, e.g. neighbouring pixels
+    virtual auto visibility(const Cartesian3 * points, const Cartesian3 * normals, uint32_t count,
+                            const Cartesian3 & light, float * visibilities) const -> void = 0;
+
+    //one point at a time
+    auto visibility(const Cartesian3 & point, const Cartesian3 & normal, const Cartesian3 & light) const -> float
+    {
+        float result;
+        visibility(&point, &normal, 1, light, &result);
+        return result;
+    }
+};
+
+#endif // SHADOWSOURCE_H
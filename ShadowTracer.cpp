@@ -0,0 +1,74 @@
+#include "ShadowTracer.h"
+#include "Scene.h"
+
+auto ShadowTracer::clear() -> void
+{
+    meshes.clear();
+    scenes.clear();
+}
+
+auto ShadowTracer::add(const MeshBVH & bvh, const Matrix4 & modelView) -> void
+{
+    meshes.push_back({&bvh, modelView.inverse()});
+}
+
+auto ShadowTracer::add(const Scene & scene, const Matrix4 & view) -> void
+{
+    scenes.push_back({&scene, view.inverse()});
+}
+
+auto ShadowTracer::visibility(const Cartesian3 * points, const Cartesian3 * normals, uint32_t count,
+                              const Cartesian3 & light, float * visibilities) const -> void
+{
+    //the rays run from just off each surface to the light, which is at t = 1
+    RayPacket packet;
+    int active = 0;
+    for(uint32_t lane = 0; lane < 4; lane++)
+    {
+        Cartesian3 origin, direction;
+        if(lane < count)
+        {
+            Cartesian3 normal = normals[lane];
+            float length = normal.length();
+            Cartesian3 toLight = light - points[lane];
+            if(length > 0.f && normal.dot(toLight) <= 0.f)
+                visibilities[lane] = 0.f;
+            else
+            {
+                origin = length > 0.f ? points[lane] + normal * (bias / length) : points[lane];
+                direction = light - origin;
+                visibilities[lane] = 1.f;
+                active |= 1 << lane;
+            }
+        }
+        for(int axis = 0; axis < 3; axis++)
+        {
+            packet.origin[axis][lane] = origin[axis];
+            packet.direction[axis][lane] = direction[axis];
+        }
+        packet.tMax[lane] = 1.f;
+    }
+    if(active == 0)
+        return;
+
+    //each caster in its own coordinates, until every ray is blocked
+    int blocked = 0;
+    RayPacket casterPacket;
+    for(const MeshCaster & mesh : meshes)
+    {
+        if(blocked == active)
+            break;
+        packet.transform(mesh.eyeToMesh, casterPacket);
+        blocked |= mesh.bvh->occluded(casterPacket, active & ~blocked);
+    }
+    for(const SceneCaster & scene : scenes)
+    {
+        if(blocked == active)
+            break;
+        packet.transform(scene.eyeToWorld, casterPacket);
+        blocked |= scene.scene->occluded(casterPacket, active & ~blocked);
+    }
+    for(uint32_t lane = 0; lane < count; lane++)
+        if(blocked & (1 << lane))
+            visibilities[lane] = 0.f;
+}
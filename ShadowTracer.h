@@ -0,0 +1,56 @@
+#ifndef SHADOWTRACER_H
+#define SHADOWTRACER_H
+
+#include <cstdint>
+#include <vector>
+#include "Cartesian3.h"
+#include "Matrix4.h"
+#include "MeshBVH.h"
+#include "ShadowSource.h"
+
+class Scene;
+
+//how far a shadow ray starts off its surface, in eye coordinates. FakeGLScene fits the view
+//to the unit sphere, and a level of detail strays from the full mesh by up to a pixel or so
+constexpr float SHADOW_RAY_BIAS = 4e-3f;
+
+//casts hard shadow rays from eye space points to FakeGL's point light, through the hierarchies of
+//the meshes & scenes casting the shadows
+class ShadowTracer : public ShadowSource
+{
+public:
+    using ShadowSource::visibility;
+
+    auto clear() -> void;
+
+    //a mesh, which modelView takes to eye coordinates
+    auto add(const MeshBVH & bvh, const Matrix4 & modelView) -> void;
+    //a scene, which view takes from world to eye coordinates. its hierarchy must be kept up to date
+    auto add(const Scene & scene, const Matrix4 & view) -> void;
+
+    inline auto setBias(float newBias) -> void { bias = newBias; }
+    inline auto getBias() const -> float { return bias; }
+
+    //1 or 0: the points are moved off their surfaces along the normals first, so that they don't
+    //shadow themselves, and traced as one packet
+    auto visibility(const Cartesian3 * points, const Cartesian3 * normals, uint32_t count,
+                    const Cartesian3 & light, float * visibilities) const -> void override;
+
+private:
+    struct MeshCaster
+    {
+        const MeshBVH * bvh;
+        Matrix4 eyeToMesh;
+    };
+    struct SceneCaster
+    {
+        const Scene * scene;
+        Matrix4 eyeToWorld;
+    };
+
+    std::vector<MeshCaster> meshes;
+    std::vector<SceneCaster> scenes;
+    float bias = SHADOW_RAY_BIAS;
+};
+
+#endif // SHADOWTRACER_H
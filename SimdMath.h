@@ -0,0 +1,127 @@
+#ifndef SIMDMATH_H
+#define SIMDMATH_H
+
+//four-wide float operations behind Homogeneous4 & Matrix4.
+//SSE is part of every x86-64 target, so it needs no compiler flags; anywhere else the same
+//operations run on plain arrays, which the compiler is free to vectorise itself.
+//all loads & stores are aligned, so the data must be 16-byte aligned
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FAKEGL_SSE 1
+#include <xmmintrin.h>
+#else
+#define FAKEGL_SSE 0
+#include <utility>
+#endif
+
+namespace SimdMath
+{
+#if FAKEGL_SSE
+    using float4 = __m128;
+
+    inline auto load(const float * values) -> float4 { return _mm_load_ps(values); }
+    inline auto store(float * values, float4 v) -> void { _mm_store_ps(values, v); }
+    inline auto set(float x, float y, float z, float w) -> float4 { return _mm_setr_ps(x, y, z, w); }
+    inline auto splat(float value) -> float4 { return _mm_set1_ps(value); }
+
+    inline auto add(float4 a, float4 b) -> float4 { return _mm_add_ps(a, b); }
+    inline auto sub(float4 a, float4 b) -> float4 { return _mm_sub_ps(a, b); }
+    inline auto mul(float4 a, float4 b) -> float4 { return _mm_mul_ps(a, b); }
+    inline auto div(float4 a, float4 b) -> float4 { return _mm_div_ps(a, b); }
+
+    //copies one lane into all four
+    template<int lane>
+    inline auto broadcast(float4 v) -> float4 { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(lane, lane, lane, lane)); }
+
+    inline auto transpose(float4 & r0, float4 & r1, float4 & r2, float4 & r3) -> void { _MM_TRANSPOSE4_PS(r0, r1, r2, r3); }
+
+    //cross product of the xyz lanes, w comes out as 0
+    inline auto cross(float4 a, float4 b) -> float4
+    {
+        float4 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+        float4 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+        float4 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+        return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+    }
+
+    inline auto first(float4 v) -> float { return _mm_cvtss_f32(v); }
+
+    inline auto abs(float4 v) -> float4 { return _mm_andnot_ps(_mm_set1_ps(-0.f), v); }
+
+    //true if a < b in any lane
+    inline auto anyLess(float4 a, float4 b) -> bool { return _mm_movemask_ps(_mm_cmplt_ps(a, b)) != 0; }
+
+    inline auto min(float4 a, float4 b) -> float4 { return _mm_min_ps(a, b); }
+    inline auto max(float4 a, float4 b) -> float4 { return _mm_max_ps(a, b); }
+
+    //per lane comparisons give masks, which only combine with maskAnd & are read with moveMask
+    inline auto less(float4 a, float4 b) -> float4 { return _mm_cmplt_ps(a, b); }
+    inline auto lessEqual(float4 a, float4 b) -> float4 { return _mm_cmple_ps(a, b); }
+    inline auto maskAnd(float4 a, float4 b) -> float4 { return _mm_and_ps(a, b); }
+    //bit i is set if lane i of the mask is
+    inline auto moveMask(float4 mask) -> int { return _mm_movemask_ps(mask); }
+#else
+    struct alignas(16) float4 { float lanes[4]; };
+
+    inline auto load(const float * values) -> float4 { return {{values[0], values[1], values[2], values[3]}}; }
+    inline auto store(float * values, float4 v) -> void { for(int i = 0; i < 4; i++) values[i] = v.lanes[i]; }
+    inline auto set(float x, float y, float z, float w) -> float4 { return {{x, y, z, w}}; }
+    inline auto splat(float value) -> float4 { return {{value, value, value, value}}; }
+
+    inline auto add(float4 a, float4 b) -> float4 { for(int i = 0; i < 4; i++) a.lanes[i] += b.lanes[i]; return a; }
+    inline auto sub(float4 a, float4 b) -> float4 { for(int i = 0; i < 4; i++) a.lanes[i] -= b.lanes[i]; return a; }
+    inline auto mul(float4 a, float4 b) -> float4 { for(int i = 0; i < 4; i++) a.lanes[i] *= b.lanes[i]; return a; }
+    inline auto div(float4 a, float4 b) -> float4 { for(int i = 0; i < 4; i++) a.lanes[i] /= b.lanes[i]; return a; }
+
+    template<int lane>
+    inline auto broadcast(float4 v) -> float4 { return splat(v.lanes[lane]); }
+
+    inline auto transpose(float4 & r0, float4 & r1, float4 & r2, float4 & r3) -> void
+    {
+        float4 * rows[4] = {&r0, &r1, &r2, &r3};
+        for(int row = 0; row < 4; row++)
+            for(int col = row + 1; col < 4; col++)
+                std::swap(rows[row]->lanes[col], rows[col]->lanes[row]);
+    }
+
+    inline auto cross(float4 a, float4 b) -> float4
+    {
+        return {{a.lanes[1] * b.lanes[2] - a.lanes[2] * b.lanes[1],
+                 a.lanes[2] * b.lanes[0] - a.lanes[0] * b.lanes[2],
+                 a.lanes[0] * b.lanes[1] - a.lanes[1] * b.lanes[0], 0.f}};
+    }
+
+    inline auto first(float4 v) -> float { return v.lanes[0]; }
+
+    inline auto abs(float4 v) -> float4 { for(int i = 0; i < 4; i++) v.lanes[i] = v.lanes[i] < 0.f ? -v.lanes[i] : v.lanes[i]; return v; }
+
+    inline auto anyLess(float4 a, float4 b) -> bool { for(int i = 0; i < 4; i++) if(a.lanes[i] < b.lanes[i]) return true; return false; }
+
+    //the NaN handling follows minps & maxps: the second operand is returned
+    inline auto min(float4 a, float4 b) -> float4 { for(int i = 0; i < 4; i++) a.lanes[i] = a.lanes[i] < b.lanes[i] ? a.lanes[i] : b.lanes[i]; return a; }
+    inline auto max(float4 a, float4 b) -> float4 { for(int i = 0; i < 4; i++) a.lanes[i] = a.lanes[i] > b.lanes[i] ? a.lanes[i] : b.lanes[i]; return a; }
+
+    //masks hold 1 or 0 per lane
+    inline auto less(float4 a, float4 b) -> float4 { for(int i = 0; i < 4; i++) a.lanes[i] = a.lanes[i] < b.lanes[i] ? 1.f : 0.f; return a; }
+    inline auto lessEqual(float4 a, float4 b) -> float4 { for(int i = 0; i < 4; i++) a.lanes[i] = a.lanes[i] <= b.lanes[i] ? 1.f : 0.f; return a; }
+    inline auto maskAnd(float4 a, float4 b) -> float4 { for(int i = 0; i < 4; i++) a.lanes[i] = a.lanes[i] != 0.f && b.lanes[i] != 0.f ? 1.f : 0.f; return a; }
+    inline auto moveMask(float4 mask) -> int { int bits = 0; for(int i = 0; i < 4; i++) bits |= mask.lanes[i] != 0.f ? 1 << i : 0; return bits; }
+#endif
+
+    //c0 * v.x + c1 * v.y + c2 * v.z + c3 * v.w, summed in that order so that it rounds
+    //exactly like the scalar loops it replaces
+    inline auto combine(float4 c0, float4 c1, float4 c2, float4 c3, float4 v) -> float4
+    {
+        float4 sum = add(mul(c0, broadcast<0>(v)), mul(c1, broadcast<1>(v)));
+        sum = add(sum, mul(c2, broadcast<2>(v)));
+        return add(sum, mul(c3, broadcast<3>(v)));
+    }
+
+    //dot product of the xyz lanes
+    inline auto dot3(float4 a, float4 b) -> float
+    {
+        float4 p = mul(a, b);
+        return first(p) + first(broadcast<1>(p)) + first(broadcast<2>(p));
+    }
+};
+
+#endif // SIMDMATH_H
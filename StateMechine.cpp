@@ -1,6 +1,7 @@
 #include "StateMechine.h"
 #include "FakeGL.h"
 #include <cassert>
+#include <cmath>
 
 auto StateMechine::getCurrentSelectedMatrix() -> Matrix4 *
 {
@@ -9,12 +10,48 @@ auto StateMechine::getCurrentSelectedMatrix() -> Matrix4 *
     {
     case FAKEGL_MODELVIEW:
         matrix = &modelViewMatrixStack.top();
+        dirty |= DIRTY_MODELVIEW;
     break;
     case FAKEGL_PROJECTION:
         matrix =  &projectionMatrixStack.top();
+        dirty |= DIRTY_PROJECTION;
     break;
 
     }
     assert(matrix);
     return matrix;
-}
\ No newline at end of file
+}
+auto StateMechine::updateDerivedState() -> const DerivedState &
+{
+    if(dirty == 0)
+        return derived;
+
+    const Matrix4 & modelView = modelViewMatrixStack.top();
+    if(dirty & DIRTY_MODELVIEW)
+    {
+        derived.modelView = modelView;
+        derived.normalMatrix = modelView.inverse().transpose();
+    }
+    if(dirty & (DIRTY_MODELVIEW | DIRTY_PROJECTION))
+        derived.modelViewProjection = projectionMatrixStack.top() * modelView;
+
+    //the inverse transpose shrinks normals by the modelview's (uniform) scale,
+    //so scaling them up by the same amount on the way in keeps their length
+    if(dirty & (DIRTY_MODELVIEW | DIRTY_ENABLES))
+    {
+        derived.normalScale = 1.f;
+        if(enables[FAKEGL_RESCALE_NORMAL])
+            derived.normalScale = std::sqrt(modelView[0][0] * modelView[0][0] + modelView[1][0] * modelView[1][0] + modelView[2][0] * modelView[2][0]);
+    }
+
+    if(dirty & (DIRTY_LIGHT | DIRTY_MATERIAL))
+    {
+        derived.ambientProduct = light.getAmbient() * material.getAmbient();
+        derived.diffuseProduct = light.getDiffuse() * material.getDiffuse();
+        derived.specularProduct = light.getSpecular() * material.getSpecular();
+        derived.emissiveAmbient = material.getEmission() + derived.ambientProduct;
+    }
+
+    dirty = 0;
+    return derived;
+}
@@ -8,11 +8,13 @@
 #include "Matrix4.h"
 #include "Material.h"
 #include "Light.h"
+#include "VertexQuantiser.h"
 
 #include <stack>
 #include <memory>
 
 class Shader;
+class ShadowSource;
 
 struct GLViewport
 {
@@ -33,12 +35,64 @@ struct CurrentSurface
 };
 
 
+//arrays fetched by DrawElements & DrawElementsInstanced
+struct VertexArrays
+{
+    const Cartesian3 * positions = nullptr;
+    const Cartesian3 * normals = nullptr;
+    const Cartesian3 * texCoords = nullptr;
+
+    //quantised alternative to the three arrays above
+    const QuantisedVertex * quantised = nullptr;
+    Cartesian3 quantisedOffset;
+    Cartesian3 quantisedStep;
+
+    //per-instance arrays read by DrawElementsInstanced
+    const Matrix4 * instanceTransforms = nullptr;
+    const RGBAValue * instanceColours = nullptr;
+};
+
+
+//parts of the state that derived values are computed from
+enum StateDirtyFlags : uint32_t
+{
+    DIRTY_MODELVIEW = 1,
+    DIRTY_PROJECTION = 2,
+    DIRTY_LIGHT = 4,
+    DIRTY_MATERIAL = 8,
+    DIRTY_ENABLES = 16,
+    DIRTY_ALL = 31
+};
+
+
+//values the vertex & fragment stages need that only change with the state,
+//so they are computed once rather than per draw, vertex or fragment
+struct DerivedState
+{
+    Matrix4 modelView;
+    Matrix4 modelViewProjection;
+    //inverse transpose of the modelview, for normals
+    Matrix4 normalMatrix;
+
+    //factor applied to incoming normals, the modelview's scale when FAKEGL_RESCALE_NORMAL is on
+    float normalScale = 1.f;
+
+    //light colours times material colours
+    Color ambientProduct;
+    Color diffuseProduct;
+    Color specularProduct;
+    //material emission + ambientProduct
+    Color emissiveAmbient;
+};
+
+
 //current opengl state mechine
 class StateMechine
 {
 public:
     GLViewport viewport;
     CurrentSurface currentSurface;
+    VertexArrays vertexArrays;
 
     //stack for mvp matrix
     std::stack<Matrix4> modelViewMatrixStack;
@@ -50,11 +104,16 @@ public:
     int32_t lineWidth = 1;
     int32_t pointSize = 1;
 
-    //flags for indicating whether it open
-    bool enables[5] = {false};
+    //flags for indicating whether it open, indexed by the Enable() constants
+    bool enables[16] = {false};
 
     Material material;
 
+    //window position of the frame buffer's bottom left pixel.
+    //zero except when a tile of a larger image is being rasterised
+    int32_t rasterOriginX = 0;
+    int32_t rasterOriginY = 0;
+
     //GL Default Z range 
     float zNear = 0;
     float zFar = 1;
@@ -62,17 +121,42 @@ public:
     //param for light
     Light light;
 
+    //where the shadow term comes from while FAKEGL_SHADOWS is enabled,
+    //& whether the shadow term is found per vertex or per pixel
+    const ShadowSource * shadowSource = nullptr;
+    uint32_t shadowMode = 0;
+
+    //how far a depth sprite's texels reach either side of the primitive, in window depth
+    float spriteDepthRange = 0;
 
     //current shader
     //Gouraud or Phong
     std::shared_ptr<Shader> currentShader;
 
     Matrix4 viewportMatrix;
+
+    //the top of the current stack. the caller may change it, so it is marked dirty
     auto getCurrentSelectedMatrix() -> Matrix4 *;
 
+    //anything that changes the matrices, light, material or enables directly must say so
+    inline auto markDirty(uint32_t flags) -> void { dirty |= flags; }
+
+    //recomputes whatever is out of date, then returns the derived values
+    auto updateDerivedState() -> const DerivedState &;
+
+    //the derived values as of the last update
+    inline auto getDerivedState() const -> const DerivedState & { return derived; }
+
     RGBAImage texture;
     RGBAValue clearColor;
 
+    //channels written by fragments, & whether they write depth
+    bool colorMask[4] = {true, true, true, true};
+    bool depthMask = true;
+
+private:
+    uint32_t dirty = DIRTY_ALL;
+    DerivedState derived;
 };
 
 
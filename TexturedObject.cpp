@@ -32,154 +32,465 @@
 #include <iomanip>
 #include <sstream>
 #include <string>
+#include <cmath>
+#include <limits>
 
 // include the Cartesian 3- vector class
 #include "Cartesian3.h"
-
-#define MAXIMUM_LINE_LENGTH 1024
+// and the memory-mapped file used by the fast reader
+#include "MappedFile.h"
+// plus the binary mesh format
+#include "MeshFile.h"
+// and the mesh processing for the indexed meshes
+#include "MeshOptimiser.h"
+#include "MeshSimplifier.h"
 
 // constructor will initialise to safe values
 TexturedObject::TexturedObject()
-    : centreOfGravity(0.0,0.0,0.0)
+    : originalACMR(0.0), optimisedACMR(0.0), centreOfGravity(0.0,0.0,0.0)
     { // TexturedObject()
     // force arrays to size 0
     vertices.resize(0);
     normals.resize(0);
     textureCoords.resize(0);
+    // no faces still needs the leading offset
+    faceOffsets.resize(1, 0);
     } // TexturedObject()
 
 // read routine returns true on success, failure otherwise
 bool TexturedObject::ReadObjectStream(std::istream &geometryStream, std::istream &textureStream)
     { // ReadObjectStream()
-    
-    // create a read buffer
-    char readBuffer[MAXIMUM_LINE_LENGTH];
-    
-    // the rest of this is a loop reading lines & adding them in appropriate places
-    while (true)
-        { // not eof
-        // character to read
-        char firstChar = geometryStream.get();
-        
-        // check for eof() in case we've run out
-        if (geometryStream.eof())
-            break;
-
-        // otherwise, switch on the character we read
-        switch (firstChar)
-            { // switch on first character
-            case '#':       // comment line
-                // read and discard the line
-                geometryStream.getline(readBuffer, MAXIMUM_LINE_LENGTH);
-                break;
-                
-            case 'v':       // vertex data of some type
-                { // some sort of vertex data
-                // retrieve another character
-                char secondChar = geometryStream.get();
-                
-                // bail if we ran out of file
-                if (geometryStream.eof())
-                    break;
-
-                // now use the second character to choose branch
-                switch (secondChar)
-                    { // switch on second character
-                    case ' ':       // space - indicates a vertex
-                        { // vertex read
-                        Cartesian3 vertex;
-                        geometryStream >> vertex;
-                        vertices.push_back(vertex);
-                        break;
-                        } // vertex read
-                    case 'n':       // n indicates normal vector
-                        { // normal read
-                        Cartesian3 normal;
-                        geometryStream >> normal;
-                        normals.push_back(normal);
-                        break;
-                        } // normal read
-                    case 't':       // t indicates texture coords
-                        { // tex coord
-                        Cartesian3 texCoord;
-                        geometryStream >> texCoord;
-                        textureCoords.push_back(texCoord);
-                        break;                  
-                        } // tex coord
-                    default:
-                        break;
-                    } // switch on second character 
-                break;
-                } // some sort of vertex data
-                
-            case 'f':       // face data
-                { // face
-                // a face can have an arbitrary number of vertices, which is a pain
-                // so we will create a separate buffer to read from
-                geometryStream.getline(readBuffer, MAXIMUM_LINE_LENGTH);
-
-                // turn into a C++ string
-                std::string lineString = std::string(readBuffer);
-
-                // create a string stream
-                std::stringstream lineParse(lineString); 
-
-                // create vectors for the IDs (with different names from the master arrays)
-                std::vector<unsigned int> faceVertexSet;
-                std::vector<unsigned int> faceNormalSet;
-                std::vector<unsigned int> faceTexCoordSet;
-                
-                // now loop through the line
-                while (!lineParse.eof())
-                    { // lineParse isn't done
-                    // the triple of vertex, normal, tex coord IDs
-                    unsigned int vertexID;
-                    unsigned int normalID;
-                    unsigned int texCoordID;
-
-                    // try reading them in, breaking if we hit eof
-                    lineParse >> vertexID;
-                    // retrieve & discard a slash
-                    lineParse.get();
-                    // check eof
-                    if (lineParse.eof())
-                        break;
-                    
-                    // and the tex coord
-                    lineParse >> texCoordID;
-                    lineParse.get();
-                    if (lineParse.eof())
-                        break;
-                        
-                    // read normal likewise
-                    lineParse >> normalID;
-                        
-                    // if we got this far, we presumably have three valid numbers, so add them
-                    // but notice that .obj uses 1-based numbering, where our arrays use 0-based
-                    faceVertexSet.push_back(vertexID-1);
-                    faceNormalSet.push_back(normalID-1);
-                    faceTexCoordSet.push_back(texCoordID-1);
-                    } // lineParse isn't done
-
-                // as long as the face has at least three vertices, add to the master list
-                if (faceVertexSet.size() > 2)
-                    { // at least 3
-                    faceVertices.push_back(faceVertexSet);
-                    faceNormals.push_back(faceNormalSet);
-                    faceTexCoords.push_back(faceTexCoordSet);
-                    } // at least 3
-                
-                break;
-                } // face
-                
-            // default processing: do nothing
-            default:
-                break;
-
-            } // switch on first character
-
-        } // not eof
+    // pull the whole stream into memory in one go rather than a character at a time
+    std::string geometryText;
+    {
+    std::ostringstream textBuffer;
+    textBuffer << geometryStream.rdbuf();
+    geometryText = textBuffer.str();
+    }
+
+    // parse it into flat arrays
+    ObjMeshData meshData;
+    if (!ObjParser::parse(geometryText.data(), geometryText.data() + geometryText.size(), meshData))
+        return false;
+
+    // and take over the geometry
+    SetGeometry(meshData);
+    ComputeBounds();
+
+    // now read in the texture file, if there is one: a stream with nothing
+    // in it, such as a file that was never opened, leaves the object untextured
+    if (textureStream.peek() != std::istream::traits_type::eof())
+        texture.ReadPPM(textureStream);
+
+    // return a success code
+    return true;
+    } // ReadObjectStream()
+
+// faster read routine: maps the geometry file and parses it in parallel
+bool TexturedObject::ReadObjectFile(const char *geometryFileName, std::istream &textureStream, bool useCache)
+    { // ReadObjectFile()
+    // the binary cache sits next to the geometry file
+    std::string cacheFileName = MeshFile::cacheFileName(geometryFileName);
+
+    // if the cache is missing or stale, parse the text instead
+    if (!useCache || !ReadMeshFile(cacheFileName.c_str(), geometryFileName))
+        { // parse the .obj
+        // map the file into memory
+        MappedFile geometryFile;
+        if (!geometryFile.open(geometryFileName))
+            return false;
+
+        // parse it straight out of the mapping
+        ObjMeshData meshData;
+        if (!ObjParser::parse(geometryFile.data(), geometryFile.data() + geometryFile.size(), meshData))
+            return false;
+
+        // we no longer need the text
+        geometryFile.close();
+
+        // take over the geometry
+        SetGeometry(meshData);
+        ComputeBounds();
+
+        // and refresh the cache. Failure is not an error: the directory may be read-only
+        if (useCache)
+            WriteMeshFile(cacheFileName.c_str(), geometryFileName);
+        } // parse the .obj
+
+    // now read in the texture file, if there is one: a stream with nothing
+    // in it, such as a file that was never opened, leaves the object untextured
+    if (textureStream.peek() != std::istream::traits_type::eof())
+        texture.ReadPPM(textureStream);
 
+    // return a success code
+    return true;
+    } // ReadObjectFile()
+
+// binary mesh read routine
+bool TexturedObject::ReadMeshFile(const char *meshFileName, const char *sourceFileName)
+    { // ReadMeshFile()
+    // map & validate the file
+    MeshFile meshFile;
+    if (!meshFile.open(meshFileName))
+        return false;
+
+    // check that it was built from the current version of the source
+    const MeshFileHeader &header = meshFile.getHeader();
+    if (sourceFileName != NULL && !MeshFile::matchesSource(sourceFileName, header))
+        return false;
+
+    // copy the arrays out
+    ObjMeshData meshData;
+    std::vector<MeshFileLevel> levels;
+    std::vector<Cartesian3> levelVertices, levelNormals, levelTexCoords;
+    std::vector<unsigned int> levelIndices;
+    std::vector<Meshlet> levelMeshlets;
+    std::vector<MeshBVHNode> bvhNodes;
+    std::vector<TrianglePacket> bvhPackets;
+    if (!meshFile.read(MESH_VERTICES, meshData.vertices) ||
+        !meshFile.read(MESH_NORMALS, meshData.normals) ||
+        !meshFile.read(MESH_TEXCOORDS, meshData.textureCoords) ||
+        !meshFile.read(MESH_FACE_OFFSETS, meshData.faceOffsets) ||
+        !meshFile.read(MESH_FACE_VERTICES, meshData.cornerVertices) ||
+        !meshFile.read(MESH_FACE_NORMALS, meshData.cornerNormals) ||
+        !meshFile.read(MESH_FACE_TEXCOORDS, meshData.cornerTexCoords) ||
+        !meshFile.read(MESH_LEVELS, levels) ||
+        !meshFile.read(MESH_LEVEL_VERTICES, levelVertices) ||
+        !meshFile.read(MESH_LEVEL_NORMALS, levelNormals) ||
+        !meshFile.read(MESH_LEVEL_TEXCOORDS, levelTexCoords) ||
+        !meshFile.read(MESH_LEVEL_INDICES, levelIndices) ||
+        !meshFile.read(MESH_LEVEL_MESHLETS, levelMeshlets) ||
+        !meshFile.read(MESH_BVH_NODES, bvhNodes) ||
+        !meshFile.read(MESH_BVH_PACKETS, bvhPackets))
+        return false;
+
+    // the faces start at the first corner & the corner arrays must agree with the face offsets
+    if (meshData.faceOffsets.empty() || meshData.faceOffsets[0] != 0)
+        return false;
+    size_t nCorners = meshData.faceOffsets.back();
+    if (meshData.cornerVertices.size() != nCorners || meshData.cornerNormals.size() != nCorners || meshData.cornerTexCoords.size() != nCorners)
+        return false;
+
+    // every face needs at least three corners to be triangulated
+    for (size_t face = 0; face + 1 < meshData.faceOffsets.size(); face++)
+        if (meshData.faceOffsets[face + 1] < meshData.faceOffsets[face] + 3)
+            return false;
+
+    // and every corner has to index attributes that are there
+    for (size_t corner = 0; corner < nCorners; corner++)
+        if (meshData.cornerVertices[corner] >= meshData.vertices.size() ||
+            meshData.cornerNormals[corner] >= meshData.normals.size() ||
+            meshData.cornerTexCoords[corner] >= meshData.textureCoords.size())
+            return false;
+
+    // take over the geometry, without rebuilding what the file holds
+    TakeGeometry(meshData);
+
+    // the levels of detail split up the level arrays, each with vertices & indices of its own
+    size_t nLevelVertices = 0, nLevelIndices = 0, nLevelMeshlets = 0;
+    for (unsigned int level = 0; level < levels.size(); level++)
+        { // per level
+        nLevelVertices += levels[level].vertexCount;
+        nLevelIndices += levels[level].indexCount;
+        nLevelMeshlets += levels[level].meshletCount;
+        } // per level
+    if (levels.empty() || levels[0].indexCount != triangleVertices.size() ||
+        levelVertices.size() != nLevelVertices || levelNormals.size() != nLevelVertices || levelTexCoords.size() != nLevelVertices ||
+        levelIndices.size() != nLevelIndices || levelMeshlets.size() != nLevelMeshlets)
+        return false;
+
+    meshLevels.resize(levels.size());
+    size_t firstVertex = 0, firstIndex = 0, firstMeshlet = 0;
+    for (unsigned int level = 0; level < levels.size(); level++)
+        { // per level
+        const MeshFileLevel &counts = levels[level];
+        IndexedMesh &mesh = meshLevels[level];
+        if (counts.indexCount % 3 != 0)
+            return false;
+        mesh.vertices.assign(levelVertices.begin() + firstVertex, levelVertices.begin() + firstVertex + counts.vertexCount);
+        mesh.normals.assign(levelNormals.begin() + firstVertex, levelNormals.begin() + firstVertex + counts.vertexCount);
+        mesh.texCoords.assign(levelTexCoords.begin() + firstVertex, levelTexCoords.begin() + firstVertex + counts.vertexCount);
+        mesh.indices.assign(levelIndices.begin() + firstIndex, levelIndices.begin() + firstIndex + counts.indexCount);
+        mesh.meshlets.assign(levelMeshlets.begin() + firstMeshlet, levelMeshlets.begin() + firstMeshlet + counts.meshletCount);
+        mesh.quantised.clear();
+        mesh.error = counts.error;
+        firstVertex += counts.vertexCount;
+        firstIndex += counts.indexCount;
+        firstMeshlet += counts.meshletCount;
+
+        // the indices have to stay within the level's vertices, & the meshlets within its indices
+        for (unsigned int index = 0; index < mesh.indices.size(); index++)
+            if (mesh.indices[index] >= counts.vertexCount)
+                return false;
+        for (unsigned int meshlet = 0; meshlet < mesh.meshlets.size(); meshlet++)
+            if (mesh.meshlets[meshlet].firstIndex > counts.indexCount ||
+                mesh.meshlets[meshlet].indexCount > counts.indexCount - mesh.meshlets[meshlet].firstIndex)
+                return false;
+        } // per level
+
+    // the hierarchy checks its own nodes & packets against the triangle lists
+    if (!bvh.assign(bvhNodes, bvhPackets, triangleVertices.size() / 3))
+        return false;
+
+    // the bounds & cache statistics were computed when the file was written
+    centreOfGravity = Cartesian3(header.centreOfGravity[0], header.centreOfGravity[1], header.centreOfGravity[2]);
+    objectSize = header.objectSize;
+    originalACMR = header.originalACMR;
+    optimisedACMR = header.optimisedACMR;
+
+    return true;
+    } // ReadMeshFile()
+
+// binary mesh write routine
+bool TexturedObject::WriteMeshFile(const char *meshFileName, const char *sourceFileName)
+    { // WriteMeshFile()
+    MeshFileHeader header;
+
+    // record which source this came from, if any
+    if (sourceFileName != NULL && !MeshFile::stampSource(sourceFileName, header))
+        return false;
+
+    // bounds & cache statistics
+    header.centreOfGravity[0] = centreOfGravity.x;
+    header.centreOfGravity[1] = centreOfGravity.y;
+    header.centreOfGravity[2] = centreOfGravity.z;
+    header.objectSize = objectSize;
+    header.originalACMR = originalACMR;
+    header.optimisedACMR = optimisedACMR;
+
+    // the levels of detail go one after another. The file holds the float vertices,
+    // which a quantised mesh no longer has
+    std::vector<MeshFileLevel> levels(meshLevels.size());
+    std::vector<Cartesian3> levelVertices, levelNormals, levelTexCoords;
+    std::vector<unsigned int> levelIndices;
+    std::vector<Meshlet> levelMeshlets;
+    for (unsigned int level = 0; level < meshLevels.size(); level++)
+        { // per level
+        const IndexedMesh &mesh = meshLevels[level];
+        if (mesh.isQuantised())
+            return false;
+        levels[level].vertexCount = mesh.vertices.size();
+        levels[level].indexCount = mesh.indices.size();
+        levels[level].meshletCount = mesh.meshlets.size();
+        levels[level].error = mesh.error;
+        levelVertices.insert(levelVertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        levelNormals.insert(levelNormals.end(), mesh.normals.begin(), mesh.normals.end());
+        levelTexCoords.insert(levelTexCoords.end(), mesh.texCoords.begin(), mesh.texCoords.end());
+        levelIndices.insert(levelIndices.end(), mesh.indices.begin(), mesh.indices.end());
+        levelMeshlets.insert(levelMeshlets.end(), mesh.meshlets.begin(), mesh.meshlets.end());
+        } // per level
+
+    // and describe the sections
+    const void *data[MESH_SECTION_COUNT] = {
+        vertices.data(), normals.data(), textureCoords.data(),
+        faceOffsets.data(), faceVertices.data(), faceNormals.data(), faceTexCoords.data(),
+        levels.data(), levelVertices.data(), levelNormals.data(), levelTexCoords.data(), levelIndices.data(), levelMeshlets.data(),
+        bvh.getNodes().data(), bvh.getPackets().data()
+        };
+    header.sections[MESH_VERTICES].bytes        = vertices.size() * sizeof(Cartesian3);
+    header.sections[MESH_NORMALS].bytes         = normals.size() * sizeof(Cartesian3);
+    header.sections[MESH_TEXCOORDS].bytes       = textureCoords.size() * sizeof(Cartesian3);
+    header.sections[MESH_FACE_OFFSETS].bytes    = faceOffsets.size() * sizeof(unsigned int);
+    header.sections[MESH_FACE_VERTICES].bytes   = faceVertices.size() * sizeof(unsigned int);
+    header.sections[MESH_FACE_NORMALS].bytes    = faceNormals.size() * sizeof(unsigned int);
+    header.sections[MESH_FACE_TEXCOORDS].bytes  = faceTexCoords.size() * sizeof(unsigned int);
+    header.sections[MESH_LEVELS].bytes          = levels.size() * sizeof(MeshFileLevel);
+    header.sections[MESH_LEVEL_VERTICES].bytes  = levelVertices.size() * sizeof(Cartesian3);
+    header.sections[MESH_LEVEL_NORMALS].bytes   = levelNormals.size() * sizeof(Cartesian3);
+    header.sections[MESH_LEVEL_TEXCOORDS].bytes = levelTexCoords.size() * sizeof(Cartesian3);
+    header.sections[MESH_LEVEL_INDICES].bytes   = levelIndices.size() * sizeof(unsigned int);
+    header.sections[MESH_LEVEL_MESHLETS].bytes  = levelMeshlets.size() * sizeof(Meshlet);
+    header.sections[MESH_BVH_NODES].bytes       = bvh.getNodes().size() * sizeof(MeshBVHNode);
+    header.sections[MESH_BVH_PACKETS].bytes     = bvh.getPackets().size() * sizeof(TrianglePacket);
+
+    return MeshFile::write(meshFileName, header, data);
+    } // WriteMeshFile()
+
+// takes over parsed geometry
+void TexturedObject::SetGeometry(ObjMeshData &meshData)
+    { // SetGeometry()
+    // take the arrays over & triangulate
+    TakeGeometry(meshData);
+
+    // and build the cache friendly version of the triangles
+    BuildIndexedMesh();
+
+    // along with the coarser versions for when the object is small on screen
+    BuildLevelsOfDetail();
+
+    // and the hierarchy for picking, which would otherwise have to test every triangle
+    bvh.build(vertices, triangleVertices);
+    } // SetGeometry()
+
+// takes over parsed geometry & triangulates it, leaving the meshes & hierarchy alone
+void TexturedObject::TakeGeometry(ObjMeshData &meshData)
+    { // TakeGeometry()
+    // the attribute arrays can be taken over directly
+    vertices.swap(meshData.vertices);
+    normals.swap(meshData.normals);
+    textureCoords.swap(meshData.textureCoords);
+
+    // and so can the faces, which are already flat
+    faceOffsets.swap(meshData.faceOffsets);
+    faceVertices.swap(meshData.cornerVertices);
+    faceNormals.swap(meshData.cornerNormals);
+    faceTexCoords.swap(meshData.cornerTexCoords);
+
+    // an empty mesh still has the leading offset
+    if (faceOffsets.empty())
+        faceOffsets.push_back(0);
+
+    // triangulate once, rather than every time we render
+    Triangulate();
+    } // TakeGeometry()
+
+// rebuilds the triangle lists from the faces
+void TexturedObject::Triangulate()
+    { // Triangulate()
+    // a face with n corners becomes n - 2 triangles
+    unsigned int nFaces = faceOffsets.size() - 1;
+    size_t nTriangleCorners = 3 * (faceVertices.size() - 2 * nFaces);
+    triangleVertices.resize(nTriangleCorners);
+    triangleNormals.resize(nTriangleCorners);
+    triangleTexCoords.resize(nTriangleCorners);
+
+    size_t next = 0;
+    for (unsigned int face = 0; face < nFaces; face++)
+        { // per face
+        // each face is a triangle fan around its first corner
+        unsigned int first = faceOffsets[face];
+        for (unsigned int corner = first + 1; corner + 1 < faceOffsets[face + 1]; corner++)
+            { // per triangle
+            const unsigned int triangle[3] = { first, corner, corner + 1 };
+            for (unsigned int vertex = 0; vertex < 3; vertex++, next++)
+                { // per vertex
+                triangleVertices[next] = faceVertices[triangle[vertex]];
+                triangleNormals[next] = faceNormals[triangle[vertex]];
+                triangleTexCoords[next] = faceTexCoords[triangle[vertex]];
+                } // per vertex
+            } // per triangle
+        } // per face
+    } // Triangulate()
+
+// welds & reorders the triangle lists into the full detail single-index mesh
+void TexturedObject::BuildIndexedMesh()
+    { // BuildIndexedMesh()
+    meshLevels.resize(1);
+    meshLevels[0].build(triangleVertices, triangleNormals, triangleTexCoords, vertices, normals, textureCoords,
+                        FAKEGL_VERTEX_CACHE_SIZE, &originalACMR, &optimisedACMR);
+    meshLevels[0].error = 0.0;
+    } // BuildIndexedMesh()
+
+// simplifies the full detail mesh into the coarser levels, keeping normal & texture seams
+void TexturedObject::BuildLevelsOfDetail()
+    { // BuildLevelsOfDetail()
+    // throw away any old levels
+    meshLevels.resize(1);
+    unsigned int nTriangles = triangleVertices.size() / 3;
+
+    // aim to halve the triangles each level
+    std::vector<unsigned int> targets;
+    for (unsigned int target = nTriangles / 2; target >= LOD_MIN_TRIANGLES; target /= 2)
+        targets.push_back(target);
+    if (targets.empty())
+        return;
+
+    // the simplifier works on welded corners, so weld again (it is cheap) to find them
+    std::vector<unsigned int> wedges;
+    std::vector<WeldedVertex> welded;
+    MeshOptimiser::weld(triangleVertices, triangleNormals, triangleTexCoords, wedges, welded);
+
+    // flat shaded objects have one normal per triangle: we recompute those for each level, so
+    // only the texture seams need to be kept.  Otherwise any change in normal is a seam as well
+    bool flatShaded = true;
+    for (unsigned int triangle = 0; triangle < nTriangles && flatShaded; triangle++)
+        flatShaded = (triangleNormals[3*triangle] == triangleNormals[3*triangle+1])
+                  && (triangleNormals[3*triangle] == triangleNormals[3*triangle+2]);
+
+    std::vector<unsigned int> positionIds(welded.size()), seamIds(welded.size());
+    for (unsigned int wedge = 0; wedge < welded.size(); wedge++)
+        { // per wedge
+        positionIds[wedge] = welded[wedge].vertex;
+        seamIds[wedge] = flatShaded ? welded[wedge].texCoord : wedge;
+        } // per wedge
+
+    std::vector<std::vector<unsigned int> > levels;
+    std::vector<float> errors;
+    MeshSimplifier::simplify(wedges, vertices, positionIds, seamIds, targets, std::numeric_limits<float>::max(), levels, errors);
+
+    // now turn each level back into corner lists & build it like the full mesh
+    std::vector<unsigned int> cornerVertices, cornerNormals, cornerTexCoords;
+    std::vector<Cartesian3> faceNormals;
+    for (unsigned int level = 0; level < levels.size(); level++)
+        { // per level
+        // skip levels that barely improve on the one before, when the simplifier got stuck
+        unsigned int nLevelCorners = levels[level].size();
+        if (nLevelCorners == 0 || nLevelCorners > 0.8 * meshLevels.back().indices.size())
+            continue;
+
+        cornerVertices.resize(nLevelCorners);
+        cornerNormals.resize(nLevelCorners);
+        cornerTexCoords.resize(nLevelCorners);
+        faceNormals.clear();
+        for (unsigned int corner = 0; corner < nLevelCorners; corner++)
+            { // per corner
+            const WeldedVertex &wedge = welded[levels[level][corner]];
+            cornerVertices[corner] = wedge.vertex;
+            cornerNormals[corner] = wedge.normal;
+            cornerTexCoords[corner] = wedge.texCoord;
+            } // per corner
+
+        if (flatShaded)
+            for (unsigned int corner = 0; corner < nLevelCorners; corner += 3)
+                { // per triangle
+                // the geometric normal, facing the same way as the original one
+                const Cartesian3 &p0 = vertices[cornerVertices[corner]];
+                Cartesian3 faceNormal = (vertices[cornerVertices[corner+1]] - p0).cross(vertices[cornerVertices[corner+2]] - p0);
+                if (faceNormal.dot(normals[cornerNormals[corner]]) < 0.0)
+                    faceNormal = faceNormal * -1.0;
+                if (faceNormal.length() > 0.0)
+                    faceNormal = faceNormal.unit();
+                else
+                    faceNormal = normals[cornerNormals[corner]];
+                cornerNormals[corner] = cornerNormals[corner+1] = cornerNormals[corner+2] = faceNormals.size();
+                faceNormals.push_back(faceNormal);
+                } // per triangle
+
+        meshLevels.push_back(IndexedMesh());
+        meshLevels.back().build(cornerVertices, cornerNormals, cornerTexCoords, vertices,
+                                flatShaded ? faceNormals : normals, textureCoords, FAKEGL_VERTEX_CACHE_SIZE);
+        meshLevels.back().error = errors[level];
+        } // per level
+    } // BuildLevelsOfDetail()
+
+// picks the coarsest level whose error is below renderParameters->lodPixelError on screen
+unsigned int TexturedObject::SelectLevelOfDetail(RenderParameters *renderParameters, FakeGL *fakeGL, float scale)
+    { // SelectLevelOfDetail()
+    if (renderParameters->lodPixelError <= 0.0)
+        return 0;
+
+    // pixels per object space unit: the vertical scale of the projection takes it to
+    // normalised device coordinates, and the viewport takes those to pixels
+    const Matrix4 &projection = fakeGL->stateMechine.projectionMatrixStack.top();
+    float pixelsPerUnit = scale * std::fabs(projection[1][1]) * fakeGL->stateMechine.viewport.height * 0.5;
+
+    // the errors grow with the level, so walk down until one is too coarse
+    unsigned int level = 0;
+    while ((level + 1 < meshLevels.size()) && (meshLevels[level + 1].error * pixelsPerUnit <= renderParameters->lodPixelError))
+        level++;
+    return level;
+    } // SelectLevelOfDetail()
+
+// replaces the float attributes of the single-index meshes with the compact format
+void TexturedObject::QuantiseMesh()
+    { // QuantiseMesh()
+    for (unsigned int level = 0; level < meshLevels.size(); level++)
+        meshLevels[level].quantise();
+    } // QuantiseMesh()
+
+// computes the centre of gravity & size
+void TexturedObject::ComputeBounds()
+    { // ComputeBounds()
     // compute centre of gravity
     // note that very large files may have numerical problems with this
     centreOfGravity = Cartesian3(0.0, 0.0, 0.0);
@@ -209,13 +520,7 @@ bool TexturedObject::ReadObjectStream(std::istream &geometryStream, std::istream
                 objectSize = distance;
             } // per vertex
         } // non-empty vertex set
-
-    // now read in the texture file
-    texture.ReadPPM(textureStream);
-
-    // return a success code
-    return true;
-    } // ReadObjectStream()
+    } // ComputeBounds()
 
 // write routine
 void TexturedObject::WriteObjectStream(std::ostream &geometryStream, std::ostream &textureStream)
@@ -239,23 +544,25 @@ void TexturedObject::WriteObjectStream(std::ostream &geometryStream, std::ostrea
     geometryStream << std::endl;
 
     // and the faces
-    for (unsigned int face = 0; face < faceVertices.size(); face++)
+    for (unsigned int face = 0; face + 1 < faceOffsets.size(); face++)
         { // per face
         geometryStream << "f ";
         
         // loop through # of vertices
-        for (unsigned int vertex = 0; vertex < faceVertices[face].size(); vertex++)
-            geometryStream << faceVertices[face][vertex]+1 << "/" << faceTexCoords[face][vertex]+1 << "/" << faceNormals[face][vertex]+1 << " " ;
+        for (unsigned int vertex = faceOffsets[face]; vertex < faceOffsets[face + 1]; vertex++)
+            geometryStream << faceVertices[vertex]+1 << "/" << faceTexCoords[vertex]+1 << "/" << faceNormals[vertex]+1 << " " ;
         
         geometryStream << std::endl;
         } // per face
-    geometryStream << "# " << faceVertices.size() << " polygons" << std::endl;
+    geometryStream << "# " << faceOffsets.size() - 1 << " polygons" << std::endl;
     geometryStream << std::endl;
     
     // now output the texture
     texture.WritePPM(textureStream);
     } // WriteObjectStream()
 
+// the OpenGL routines are left out of headless builds, which only have FakeGL
+#ifndef FAKEGL_HEADLESS
 // routine to transfer assets to GPU
 void TexturedObject::TransferAssetsToGPU()
     { // TransferAssetsToGPU()
@@ -283,6 +590,7 @@ void TexturedObject::TransferAssetsToGPU()
         texture.block       // and a pointer to the data
         );
     } // TransferAssetsToGPU()
+#endif
 
 // routine to transfer assets to Fake GL
 void TexturedObject::TransferAssetsToFakeGL(FakeGL *fakeGL)
@@ -291,6 +599,7 @@ void TexturedObject::TransferAssetsToFakeGL(FakeGL *fakeGL)
     fakeGL->TexImage2D(texture);
     } // TransferAssetsToFakeGL()
 
+#ifndef FAKEGL_HEADLESS
 // routine to render
 void TexturedObject::Render(RenderParameters *renderParameters)
     { // Render()
@@ -364,54 +673,31 @@ void TexturedObject::Render(RenderParameters *renderParameters)
     // repeat this for colour - extra call, but saves if statements
     glColor3fv(surfaceColour);
 
-    // loop through the faces: note that they may not be triangles, which complicates life
-    for (unsigned int face = 0; face < faceVertices.size(); face++)
-        { // per face
-        // on each face, treat it as a triangle fan starting with the first vertex on the face
-        for (unsigned int triangle = 0; triangle < faceVertices[face].size() - 2; triangle++)
-            { // per triangle
-            // now do a loop over three vertices
-            for (unsigned int vertex = 0; vertex < 3; vertex++)
-                { // per vertex
-                // we always use the face's vertex 0
-                int faceVertex = 0;
-                // so if it isn't 0, we want to add the triangle base ID
-                if (vertex != 0)
-                    faceVertex = triangle + vertex;
-
-                // now we use that ID to lookup
-                glNormal3f
-                    (
-                    normals         [faceNormals    [face][faceVertex]  ].x * scale,
-                    normals         [faceNormals    [face][faceVertex]  ].y * scale,
-                    normals         [faceNormals    [face][faceVertex]  ].z * scale
-                    );
-                    
-                // if we're using UVW colours, set both colour and material
-                if (renderParameters->mapUVWToRGB)
-                    { // set colour and material
-                    float *colourPointer = (float *) &(textureCoords[faceTexCoords[face][faceVertex]]);
-                    glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, colourPointer);
-                    glMaterialfv(GL_FRONT, GL_SPECULAR, colourPointer);
-                    glColor3fv(colourPointer);
-                    } // set colour and material
-                // set the texture coordinate
-                glTexCoord2f
-                    (
-                    textureCoords   [faceTexCoords  [face][faceVertex]  ].x,
-                    textureCoords   [faceTexCoords  [face][faceVertex]  ].y
-                    );
-                    
-                // and set the vertex position
-                glVertex3f
-                    (
-                    vertices        [faceVertices   [face][faceVertex]].x,
-                    vertices        [faceVertices   [face][faceVertex]].y,
-                    vertices        [faceVertices   [face][faceVertex]].z
-                    );
-                } // per vertex
-            } // per triangle
-        } // per face
+    // the faces were triangulated at load time, so this is one pass over the triangle lists
+    for (unsigned int vertex = 0; vertex < triangleVertices.size(); vertex++)
+        { // per vertex
+        // look the attributes up
+        const Cartesian3 &normal = normals[triangleNormals[vertex]];
+        const Cartesian3 &texCoord = textureCoords[triangleTexCoords[vertex]];
+        const Cartesian3 &position = vertices[triangleVertices[vertex]];
+
+        glNormal3f(normal.x * scale, normal.y * scale, normal.z * scale);
+            
+        // if we're using UVW colours, set both colour and material
+        if (renderParameters->mapUVWToRGB)
+            { // set colour and material
+            float *colourPointer = (float *) &texCoord;
+            glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, colourPointer);
+            glMaterialfv(GL_FRONT, GL_SPECULAR, colourPointer);
+            glColor3fv(colourPointer);
+            } // set colour and material
+
+        // set the texture coordinate
+        glTexCoord2f(texCoord.x, texCoord.y);
+            
+        // and set the vertex position
+        glVertex3f(position.x, position.y, position.z);
+        } // per vertex
 
     // close off the triangles
     glEnd();
@@ -420,21 +706,11 @@ void TexturedObject::Render(RenderParameters *renderParameters)
     if (renderParameters->texturedRendering)
         glDisable(GL_TEXTURE_2D);
     } // Render()
+#endif
 
-// routine for students to use when rendering
-void TexturedObject::FakeGLRender(RenderParameters *renderParameters, FakeGL *fakeGL)
-    { // FakeGLRender()
-    // Ideally, we would apply a global transformation to the object, but sadly that breaks down
-    // when we want to scale things, as unless we normalise the normal vectors, we end up affecting
-    // the illumination.  Known solutions include:
-    // 1.   Normalising the normal vectors
-    // 2.   Explicitly dividing the normal vectors by the scale to balance
-    // 3.   Scaling only the vertex position (slower, but safer)
-    // 4.   Not allowing spatial zoom (note: sniper scopes are a modified projection matrix)
-    //
-    // Inside a game engine, zoom usually doesn't apply. Normalisation of normal vectors is expensive,
-    // so we will choose option 2.  
-
+// sets texturing & the material for the object
+void TexturedObject::FakeGLSetSurface(RenderParameters *renderParameters, FakeGL *fakeGL)
+    { // FakeGLSetSurface()
     // if we have texturing enabled . . . 
     if (renderParameters->texturedRendering)
         { // textures enabled
@@ -452,20 +728,6 @@ void TexturedObject::FakeGLRender(RenderParameters *renderParameters, FakeGL *fa
         fakeGL->Disable(FAKEGL_TEXTURE_2D);
         } // textures disabled
 
-    // Scale defaults to the zoom setting
-    float scale = renderParameters->zoomScale;
-    
-    // if object scaling is requested, apply it as well 
-    if (renderParameters->scaleObject)
-        scale /= objectSize;
-        
-    //  now scale everything
-    fakeGL->Scalef(scale, scale, scale);
-
-    // apply the translation to the centre of the object if requested
-    if (renderParameters->centreObject)
-        fakeGL->Translatef(-centreOfGravity.x, -centreOfGravity.y, -centreOfGravity.z);
-
     // emissive glow from object
     float emissiveColour[4];
     // default ambient / diffuse / specular colour
@@ -475,9 +737,6 @@ void TexturedObject::FakeGLRender(RenderParameters *renderParameters, FakeGL *fa
     emissiveColour[0]   = emissiveColour[1] = emissiveColour[2] = renderParameters->emissiveLight;
     emissiveColour[3]   = 1.0; // don't forget alpha
 
-    // start rendering
-    fakeGL->Begin(FAKEGL_TRIANGLES);
-
     // we assume a single material for the entire object
     fakeGL->Materialfv(FAKEGL_EMISSION, emissiveColour);
     fakeGL->Materialfv(FAKEGL_AMBIENT_AND_DIFFUSE, surfaceColour);
@@ -486,62 +745,278 @@ void TexturedObject::FakeGLRender(RenderParameters *renderParameters, FakeGL *fa
     
     // repeat this for colour - extra call, but saves if statements
     fakeGL->Color3f(surfaceColour[0], surfaceColour[1], surfaceColour[2]);
+    } // FakeGLSetSurface()
 
-    // loop through the faces: note that they may not be triangles, which complicates life
-    for (unsigned int face = 0; face < faceVertices.size(); face++)
-        { // per face
-        // on each face, treat it as a triangle fan starting with the first vertex on the face
-        for (unsigned int triangle = 0; triangle < faceVertices[face].size() - 2; triangle++)
-            { // per triangle
-            // now do a loop over three vertices
-            for (unsigned int vertex = 0; vertex < 3; vertex++)
+// the scale & centring FakeGLRender() applies to the object, as a matrix
+static Matrix4 ObjectPlacement(RenderParameters *renderParameters, const Cartesian3 &centreOfGravity, float scale)
+    { // ObjectPlacement()
+    Matrix4 placement;
+    placement.SetScale(scale, scale, scale);
+    if (renderParameters->centreObject)
+        { // centred
+        Matrix4 translation;
+        translation.SetTranslation(-1.0 * centreOfGravity);
+        placement = placement * translation;
+        } // centred
+    return placement;
+    } // ObjectPlacement()
+
+// the scale & centring FakeGLRender() applies to the object, as a matrix
+Matrix4 TexturedObject::FakeGLPlacement(RenderParameters *renderParameters)
+    { // FakeGLPlacement()
+    float scale = renderParameters->zoomScale;
+    if (renderParameters->scaleObject)
+        scale /= objectSize;
+    return ObjectPlacement(renderParameters, centreOfGravity, scale);
+    } // FakeGLPlacement()
+
+// routine for students to use when rendering
+void TexturedObject::FakeGLRender(RenderParameters *renderParameters, FakeGL *fakeGL, const OcclusionCuller *occlusionCuller)
+    { // FakeGLRender()
+    // Ideally, we would apply a global transformation to the object, but sadly that breaks down
+    // when we want to scale things, as unless we normalise the normal vectors, we end up affecting
+    // the illumination.  Known solutions include:
+    // 1.   Normalising the normal vectors
+    // 2.   Explicitly dividing the normal vectors by the scale to balance
+    // 3.   Scaling only the vertex position (slower, but safer)
+    // 4.   Not allowing spatial zoom (note: sniper scopes are a modified projection matrix)
+    //
+    // Inside a game engine, zoom usually doesn't apply. Normalisation of normal vectors is expensive,
+    // so we will choose option 2.  
+
+    // if an occlusion query has shown the object is hidden, don't even submit it
+    if (fakeGL->ConditionalRenderDiscards())
+        return;
+
+    // Scale defaults to the zoom setting
+    float scale = renderParameters->zoomScale;
+    
+    // if object scaling is requested, apply it as well 
+    if (renderParameters->scaleObject)
+        scale /= objectSize;
+
+    // if the whole object is hidden, leave everything untouched as a discarded render would
+    if (occlusionCuller != NULL)
+        { // whole object test
+        Cartesian3 halfSide(objectSize, objectSize, objectSize);
+        Matrix4 placement = OcclusionCuller::modelViewProjection(*fakeGL) * ObjectPlacement(renderParameters, centreOfGravity, scale);
+        if (!occlusionCuller->isVisible(placement, centreOfGravity - halfSide, centreOfGravity + halfSide))
+            return;
+        } // whole object test
+
+    // texturing & the material
+    FakeGLSetSurface(renderParameters, fakeGL);
+
+    //  now scale everything
+    fakeGL->Scalef(scale, scale, scale);
+
+    // apply the translation to the centre of the object if requested
+    if (renderParameters->centreObject)
+        fakeGL->Translatef(-centreOfGravity.x, -centreOfGravity.y, -centreOfGravity.z);
+
+    // an object that is small on screen can get away with fewer triangles
+    const IndexedMesh &mesh = meshLevels[SelectLevelOfDetail(renderParameters, fakeGL, scale)];
+
+    // meshlets outside the view, or facing away when culling is on, are skipped whole
+    MeshletCuller culler(fakeGL->stateMechine.modelViewMatrixStack.top(), fakeGL->stateMechine.projectionMatrixStack.top(),
+                         fakeGL->stateMechine.enables[FAKEGL_CULL_FACE]);
+    // the occlusion culler tests the box around each meshlet's bounding sphere
+    Matrix4 modelViewProjection = OcclusionCuller::modelViewProjection(*fakeGL);
+    auto isVisible = [&](const Meshlet &meshlet)
+        { // isVisible()
+        if (!culler.isVisible(meshlet))
+            return false;
+        if (occlusionCuller == NULL)
+            return true;
+        Cartesian3 radius(meshlet.radius, meshlet.radius, meshlet.radius);
+        return occlusionCuller->isVisible(modelViewProjection, meshlet.centre - radius, meshlet.centre + radius);
+        }; // isVisible()
+
+    // UVW colours change the material per vertex, which needs immediate mode
+    if (renderParameters->mapUVWToRGB)
+        { // immediate mode
+        // start rendering
+        fakeGL->Begin(FAKEGL_TRIANGLES);
+
+        // the faces were triangulated at load time, so this is one pass over the welded mesh
+        for (const Meshlet &meshlet : mesh.meshlets)
+            { // per meshlet
+            if (!isVisible(meshlet))
+                continue;
+            for (unsigned int element = meshlet.firstIndex; element < meshlet.firstIndex + meshlet.indexCount; element++)
                 { // per vertex
-                // we always use the face's vertex 0
-                int faceVertex = 0;
-                // so if it isn't 0, we want to add the triangle base ID
-                if (vertex != 0)
-                    faceVertex = triangle + vertex;
-
-                // now we use that ID to lookup
-                fakeGL->Normal3f
-                    (
-                    normals         [faceNormals    [face][faceVertex]  ].x * scale,
-                    normals         [faceNormals    [face][faceVertex]  ].y * scale,
-                    normals         [faceNormals    [face][faceVertex]  ].z * scale
-                    );
-                    
-                // if we're using UVW colours, set both colour and material
-                if (renderParameters->mapUVWToRGB)
-                    { // set colour and material
-                    float *colourPointer = (float *) &(textureCoords[faceTexCoords[face][faceVertex]]);
-                    fakeGL->Materialfv(FAKEGL_AMBIENT_AND_DIFFUSE, colourPointer);
-                    fakeGL->Materialfv(FAKEGL_SPECULAR, colourPointer);
-                    fakeGL->Color3f(colourPointer[0], colourPointer[1], colourPointer[2]);
-                    } // set colour and material
+                // look the attributes up
+                Cartesian3 normal, texCoord, position;
+                mesh.getVertex(mesh.indices[element], position, normal, texCoord);
+
+                fakeGL->Normal3f(normal.x * scale, normal.y * scale, normal.z * scale);
+            
+                // set both colour and material from the UVW
+                float *colourPointer = (float *) &texCoord;
+                fakeGL->Materialfv(FAKEGL_AMBIENT_AND_DIFFUSE, colourPointer);
+                fakeGL->Materialfv(FAKEGL_SPECULAR, colourPointer);
+                fakeGL->Color3f(colourPointer[0], colourPointer[1], colourPointer[2]);
 
                 // set the texture coordinate
-                fakeGL->TexCoord2f
-                    (
-                    textureCoords   [faceTexCoords  [face][faceVertex]  ].x,
-                    textureCoords   [faceTexCoords  [face][faceVertex]  ].y
-                    );
-                    
+                fakeGL->TexCoord2f(texCoord.x, texCoord.y);
+            
                 // and set the vertex position
-                fakeGL->Vertex3f
-                    (
-                    vertices        [faceVertices   [face][faceVertex]].x,
-                    vertices        [faceVertices   [face][faceVertex]].y,
-                    vertices        [faceVertices   [face][faceVertex]].z
-                    );
+                fakeGL->Vertex3f(position.x, position.y, position.z);
                 } // per vertex
-            } // per triangle
-        } // per face
+            } // per meshlet
 
-    // close off the triangles
-    fakeGL->End();
+        // close off the triangles
+        fakeGL->End();
+        } // immediate mode
+    else
+        { // indexed
+        // the normals are scaled by FakeGL instead of per vertex here
+        fakeGL->Enable(FAKEGL_RESCALE_NORMAL);
+        if (mesh.isQuantised())
+            // FakeGL decodes these as it fetches them
+            fakeGL->QuantisedVertexPointer(mesh.quantised.data(), mesh.quantisationOffset, mesh.quantisationStep);
+        else
+            { // float arrays
+            fakeGL->VertexPointer(mesh.vertices.data());
+            fakeGL->NormalPointer(mesh.normals.data());
+            fakeGL->TexCoordPointer(mesh.texCoords.data());
+            } // float arrays
+        // neighbouring visible meshlets are drawn as one range, so the vertex cache carries over
+        unsigned int first = 0, count = 0;
+        for (const Meshlet &meshlet : mesh.meshlets)
+            { // per meshlet
+            if (!isVisible(meshlet))
+                continue;
+            if (first + count != meshlet.firstIndex)
+                { // start a new range
+                if (count > 0)
+                    fakeGL->DrawElements(FAKEGL_TRIANGLES, count, mesh.indices.data() + first);
+                first = meshlet.firstIndex;
+                count = 0;
+                } // start a new range
+            count += meshlet.indexCount;
+            } // per meshlet
+        if (count > 0)
+            fakeGL->DrawElements(FAKEGL_TRIANGLES, count, mesh.indices.data() + first);
+        fakeGL->QuantisedVertexPointer(NULL, mesh.quantisationOffset, mesh.quantisationStep);
+        fakeGL->Disable(FAKEGL_RESCALE_NORMAL);
+        } // indexed
 
     // if we have texturing enabled, turn texturing back off 
     if (renderParameters->texturedRendering)
         fakeGL->Disable(FAKEGL_TEXTURE_2D);
     } // FakeGLRender()
 
+
+// renders one copy of the object per instance through FakeGL's instanced draw
+void TexturedObject::FakeGLRenderInstanced(RenderParameters *renderParameters, FakeGL *fakeGL, unsigned int instanceCount,
+                                           const Matrix4 *transforms, const RGBAValue *colours)
+    { // FakeGLRenderInstanced()
+    // if an occlusion query has shown the objects are hidden, don't even submit them
+    if (fakeGL->ConditionalRenderDiscards())
+        return;
+
+    // texturing & the material
+    FakeGLSetSurface(renderParameters, fakeGL);
+
+    // the same scale as FakeGLRender(), but it goes into each instance's transform,
+    // so that the transforms place the scaled & centred object
+    float scale = renderParameters->zoomScale;
+    if (renderParameters->scaleObject)
+        scale /= objectSize;
+    Matrix4 placement = ObjectPlacement(renderParameters, centreOfGravity, scale);
+    std::vector<Matrix4> placedTransforms(instanceCount);
+    for (unsigned int instance = 0; instance < instanceCount; instance++)
+        placedTransforms[instance] = transforms[instance] * placement;
+
+    // one level for every copy, as if each were drawn where the modelview puts the object
+    const IndexedMesh &mesh = meshLevels[SelectLevelOfDetail(renderParameters, fakeGL, scale)];
+
+    // the normals are scaled by FakeGL, per instance
+    fakeGL->Enable(FAKEGL_RESCALE_NORMAL);
+    if (mesh.isQuantised())
+        fakeGL->QuantisedVertexPointer(mesh.quantised.data(), mesh.quantisationOffset, mesh.quantisationStep);
+    else
+        { // float arrays
+        fakeGL->VertexPointer(mesh.vertices.data());
+        fakeGL->NormalPointer(mesh.normals.data());
+        fakeGL->TexCoordPointer(mesh.texCoords.data());
+        } // float arrays
+    fakeGL->InstancePointer(placedTransforms.data(), colours);
+    fakeGL->DrawElementsInstanced(FAKEGL_TRIANGLES, mesh.indices.size(), mesh.indices.data(), instanceCount);
+    fakeGL->InstancePointer(NULL, NULL);
+    fakeGL->QuantisedVertexPointer(NULL, mesh.quantisationOffset, mesh.quantisationStep);
+    fakeGL->Disable(FAKEGL_RESCALE_NORMAL);
+
+    // if we have texturing enabled, turn texturing back off 
+    if (renderParameters->texturedRendering)
+        fakeGL->Disable(FAKEGL_TEXTURE_2D);
+    } // FakeGLRenderInstanced()
+
+
+// draws a box around the object, placed as FakeGLRender() would place the object
+void TexturedObject::FakeGLRenderBounds(RenderParameters *renderParameters, FakeGL *fakeGL)
+    { // FakeGLRenderBounds()
+    // the same scale & centring as FakeGLRender(), but applied to the corners,
+    // since FakeGLRender() applies them to the matrix itself
+    float scale = renderParameters->zoomScale;
+    if (renderParameters->scaleObject)
+        scale /= objectSize;
+    Cartesian3 centre = renderParameters->centreObject ? Cartesian3(0.0, 0.0, 0.0) : centreOfGravity * scale;
+
+    // the cube around the bounding sphere
+    float halfSide = objectSize * scale;
+    Cartesian3 corners[8];
+    for (int corner = 0; corner < 8; corner++)
+        corners[corner] = centre + Cartesian3((corner & 1) ? halfSide : -halfSide,
+                                              (corner & 2) ? halfSide : -halfSide,
+                                              (corner & 4) ? halfSide : -halfSide);
+
+    // two triangles per face
+    static const unsigned int faceCorners[36] =
+        {
+        0, 2, 3,  0, 3, 1,      // -z
+        4, 5, 7,  4, 7, 6,      // +z
+        0, 1, 5,  0, 5, 4,      // -y
+        2, 6, 7,  2, 7, 3,      // +y
+        0, 4, 6,  0, 6, 2,      // -x
+        1, 3, 7,  1, 7, 5       // +x
+        };
+
+    // from inside the box every face is a back face, so culling would hide it
+    bool culling = fakeGL->stateMechine.enables[FAKEGL_CULL_FACE];
+    fakeGL->Disable(FAKEGL_CULL_FACE);
+
+    fakeGL->Begin(FAKEGL_TRIANGLES);
+    for (int vertex = 0; vertex < 36; vertex++)
+        fakeGL->Vertex3f(corners[faceCorners[vertex]].x, corners[faceCorners[vertex]].y, corners[faceCorners[vertex]].z);
+    fakeGL->End();
+
+    if (culling)
+        fakeGL->Enable(FAKEGL_CULL_FACE);
+    } // FakeGLRenderBounds()
+
+
+// rasterises the full detail mesh into an occlusion culler, placed as FakeGLRender() would place it
+void TexturedObject::FakeGLRenderOccluder(RenderParameters *renderParameters, FakeGL *fakeGL, OcclusionCuller *occlusionCuller)
+    { // FakeGLRenderOccluder()
+    float scale = renderParameters->zoomScale;
+    if (renderParameters->scaleObject)
+        scale /= objectSize;
+    Matrix4 placement = OcclusionCuller::modelViewProjection(*fakeGL) * ObjectPlacement(renderParameters, centreOfGravity, scale);
+
+    // coarser levels are not inside the full mesh, so they would not be conservative
+    const IndexedMesh &mesh = meshLevels[0];
+    if (mesh.isQuantised())
+        { // decode positions
+        std::vector<Cartesian3> positions(mesh.vertexCount());
+        for (unsigned int vertex = 0; vertex < positions.size(); vertex++)
+            { // per vertex
+            Cartesian3 normal, texCoord;
+            mesh.getVertex(vertex, positions[vertex], normal, texCoord);
+            } // per vertex
+        occlusionCuller->addOccluder(placement, positions.data(), mesh.indices.data(), mesh.indices.size());
+        } // decode positions
+    else
+        occlusionCuller->addOccluder(placement, mesh.vertices.data(), mesh.indices.data(), mesh.indices.size());
+    } // FakeGLRenderOccluder()
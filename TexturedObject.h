@@ -31,21 +31,35 @@
 // include the C++ standard libraries we need for the header
 #include <vector>
 #include <iostream>
+// headless builds (FAKEGL_HEADLESS) render with FakeGL alone & don't need OpenGL
+#ifndef FAKEGL_HEADLESS
 #ifdef __APPLE__
 #include <OpenGL/gl.h>
 #else
 #include <GL/gl.h>
 #endif
+#endif
 
 // and also include our fake GL library
 #include "FakeGL.h"
 
 // include the unit with Cartesian 3-vectors
 #include "Cartesian3.h"
+// the flat output of the .obj parser
+#include "ObjParser.h"
+// the single-index meshes we draw from
+#include "IndexedMesh.h"
 // the render parameters
 #include "RenderParameters.h"
 // the image class for a texture
 #include "RGBAImage.h" 
+// the software occlusion culler
+#include "OcclusionCuller.h"
+// the hierarchy for ray queries
+#include "MeshBVH.h"
+
+// levels of detail stop before they get this coarse
+#define LOD_MIN_TRIANGLES 256
 
 class TexturedObject
     { // class TexturedObject
@@ -59,20 +73,44 @@ class TexturedObject
     // vector of texture coordinates (stored as triple to simplify code)
     std::vector<Cartesian3> textureCoords;
 
-    // vector of faces
-    std::vector<std::vector<unsigned int> > faceVertices;
+    // faces are stored flat (compressed sparse rows): face f owns
+    // corners faceOffsets[f] up to faceOffsets[f+1], so there are faces + 1 offsets
+    std::vector<unsigned int> faceOffsets;
+
+    // vertex index of each face corner
+    std::vector<unsigned int> faceVertices;
 
-    // corresponding vector of normals
-    std::vector<std::vector<unsigned int> > faceNormals;
+    // corresponding normal index of each corner
+    std::vector<unsigned int> faceNormals;
     
-    // corresponding vector of texture coordinates
-    std::vector<std::vector<unsigned int> > faceTexCoords;
+    // corresponding texture coordinate index of each corner
+    std::vector<unsigned int> faceTexCoords;
+
+    // the faces triangulated as fans at load time, three entries per triangle
+    // these are what the render routines walk, front to back
+    std::vector<unsigned int> triangleVertices;
+    std::vector<unsigned int> triangleNormals;
+    std::vector<unsigned int> triangleTexCoords;
+
+    // the triangles welded into single-index meshes for the indexed draw path
+    // level 0 is the full mesh, each later level roughly halves the triangle count
+    std::vector<IndexedMesh> meshLevels;
+
+    // a bounding volume hierarchy over the triangle lists, for picking & other ray queries
+    // its triangle numbers index the triangle lists, so triangle t has corners 3t to 3t + 2
+    MeshBVH bvh;
+
+    // average cache miss ratio (vertices shaded per triangle) before & after optimising
+    float originalACMR;
+    float optimisedACMR;
 
     // RGBA Image for storing a texture
     RGBAImage texture;
 
+#ifndef FAKEGL_HEADLESS
     // a variable to store the texture's ID on the GPU
     GLuint textureID;
+#endif
 
     // centre of gravity - computed after reading
     Cartesian3 centreOfGravity;
@@ -84,22 +122,83 @@ class TexturedObject
     TexturedObject();
     
     // read routine returns true on success, failure otherwise
+    // an empty texture stream (e.g. an unopened file) means no texture
     bool ReadObjectStream(std::istream &geometryStream, std::istream &textureStream);
 
+    // faster read routine: maps the geometry file and parses it in parallel
+    // if useCache is set, a binary mesh file next to the geometry file is used
+    // when it is up to date, and (re)written when it is not
+    bool ReadObjectFile(const char *geometryFileName, std::istream &textureStream, bool useCache = true);
+
+    // binary mesh read & write: flat arrays plus precomputed bounds, levels of detail & hierarchy
+    // if a source file is given, reading fails unless the mesh was built from that file as it is now
+    // writing fails once the meshes have been quantised
+    bool ReadMeshFile(const char *meshFileName, const char *sourceFileName = NULL);
+    bool WriteMeshFile(const char *meshFileName, const char *sourceFileName = NULL);
+
+    // takes over parsed geometry & builds everything derived from it
+    void SetGeometry(ObjMeshData &meshData);
+
+    // takes over parsed geometry & triangulates it, leaving the meshes & hierarchy alone
+    void TakeGeometry(ObjMeshData &meshData);
+
+    // rebuilds the triangle lists from the faces
+    void Triangulate();
+
+    // welds & reorders the triangle lists into the full detail single-index mesh
+    void BuildIndexedMesh();
+
+    // simplifies the full detail mesh into the coarser levels, keeping normal & texture seams
+    void BuildLevelsOfDetail();
+
+    // picks the coarsest level whose error is below renderParameters->lodPixelError on screen
+    unsigned int SelectLevelOfDetail(RenderParameters *renderParameters, FakeGL *fakeGL, float scale);
+
+    // switches the single-index meshes to the compact vertex format to save memory & bandwidth
+    void QuantiseMesh();
+
+    // computes the centre of gravity & size
+    void ComputeBounds();
+
     // write routine
     void WriteObjectStream(std::ostream &geometryStream, std::ostream &textureStream);
 
+#ifndef FAKEGL_HEADLESS
     // routine to transfer assets to GPU
     void TransferAssetsToGPU();
+#endif
     
     // routine to transfer assets to Fake GL
     void TransferAssetsToFakeGL(FakeGL *fakeGL);
     
+#ifndef FAKEGL_HEADLESS
     // routine to render
     void Render(RenderParameters *renderParameters);
+#endif
+
+    // the scale & centring FakeGLRender() applies to the object, as a matrix
+    Matrix4 FakeGLPlacement(RenderParameters *renderParameters);
+
+    // sets texturing & the material for the FakeGL render routines
+    void FakeGLSetSurface(RenderParameters *renderParameters, FakeGL *fakeGL);
 
     // routine for students to use when rendering
-    void FakeGLRender(RenderParameters *renderParameters, FakeGL *fakeGL);
+    // does nothing while a FakeGL conditional render is discarding
+    // given an occlusion culler, skips the object or meshlets that it says are hidden
+    void FakeGLRender(RenderParameters *renderParameters, FakeGL *fakeGL, const OcclusionCuller *occlusionCuller = NULL);
+
+    // renders one copy of the object per transform, each applied after the modelview to the object
+    // as FakeGLRender() would scale & centre it. colours, if given, replace the surface colour per copy
+    // the level of detail is picked once for all copies, and the UVW colours are not available
+    void FakeGLRenderInstanced(RenderParameters *renderParameters, FakeGL *fakeGL, unsigned int instanceCount,
+                               const Matrix4 *transforms, const RGBAValue *colours = NULL);
+
+    // rasterises the full detail mesh into an occlusion culler, placed as FakeGLRender() would place it
+    void FakeGLRenderOccluder(RenderParameters *renderParameters, FakeGL *fakeGL, OcclusionCuller *occlusionCuller);
+
+    // draws a box around the object, placed as FakeGLRender() would place the object but
+    // leaving the matrices alone: an occlusion query on it says whether the object can be seen
+    void FakeGLRenderBounds(RenderParameters *renderParameters, FakeGL *fakeGL);
     }; // class TexturedObject
 
 // end of include guard for TexturedObject
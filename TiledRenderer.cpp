@@ -0,0 +1,137 @@
+#include "TiledRenderer.h"
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <memory>
+
+TiledRenderer::TiledRenderer(long width, long height, long tileSize, uint32_t threadCount)
+    : width(width), height(height), threadCount(threadCount)
+{
+    this->tileSize = std::max(1L, std::min(tileSize, static_cast<long>(MAX_IMAGE_DIMENSION)));
+    if(this->threadCount == 0)
+        this->threadCount = std::max(1u, std::thread::hardware_concurrency());
+}
+
+auto TiledRenderer::render(FakeGL & gl, const Scene & scene, std::ostream & outStream) -> bool
+{
+    if(width < 1 || height < 1)
+    {
+        std::cerr << "Cannot render an image of size " << width << " x " << height << std::endl;
+        return false;
+    }
+
+    //vertex processing happens exactly once, against the whole image
+    auto savedViewport = gl.stateMechine.viewport;
+    std::vector<RecordedBatch> batches;
+    gl.Viewport(0, 0, width, height);
+    gl.recordTarget = &batches;
+    scene(gl);
+    gl.recordTarget = nullptr;
+    gl.Viewport(savedViewport.x, savedViewport.y, savedViewport.width, savedViewport.height);
+
+    auto header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    outStream.write(header.data(), header.size());
+
+    auto tilesPerStrip = (width + tileSize - 1) / tileSize;
+    auto workers = static_cast<uint32_t>(std::min<long>(threadCount, tilesPerStrip));
+    std::vector<std::unique_ptr<TileContext>> contexts;
+    for(uint32_t i = 0; i < workers; i++)
+    {
+        contexts.emplace_back(new TileContext());
+        //the tiles' pipeline statistics are gl's
+        contexts.back()->gl.statisticsContext = gl.statisticsContext;
+    }
+
+    std::vector<char> strip;
+    std::vector<std::vector<uint32_t>> stripPrimitives(batches.size());
+
+    //the frame buffer is bottom-up and the PPM top-down, so walk the strips from the top
+    for(long stripTop = height; stripTop > 0; stripTop -= tileSize)
+    {
+        long stripBottom = std::max(0L, stripTop - tileSize);
+        long stripHeight = stripTop - stripBottom;
+
+        //bin once per strip, the tiles then only test columns
+        for(size_t b = 0; b < batches.size(); b++)
+        {
+            auto & primitives = stripPrimitives[b];
+            primitives.clear();
+            for(size_t p = 0; p < batches[b].PrimitiveCount(); p++)
+            {
+                float minY, maxY;
+                batches[b].PrimitiveRows(p, minY, maxY);
+                if(maxY >= stripBottom && minY < stripTop)
+                    primitives.emplace_back(static_cast<uint32_t>(p));
+            }
+        }
+
+        strip.resize(static_cast<size_t>(width) * stripHeight * 3);
+        std::atomic<long> nextTile(0);
+        auto work = [&](TileContext & context)
+        {
+            for(long tile = nextTile++; tile < tilesPerStrip; tile = nextTile++)
+            {
+                long x = tile * tileSize;
+                long tileWidth = std::min(tileSize, width - x);
+                renderTile(context, batches, stripPrimitives, gl.stateMechine.clearColor, x, stripBottom, tileWidth, stripHeight);
+
+                //tiles never overlap, so they can be copied into the strip without locking
+                for(long row = 0; row < stripHeight; row++)
+                {
+                    auto source = context.gl.frameBuffer.block + row * tileWidth;
+                    auto target = strip.data() + (static_cast<size_t>(row) * width + x) * 3;
+                    for(long col = 0; col < tileWidth; col++, source++)
+                    {
+                        *target++ = source->red;
+                        *target++ = source->green;
+                        *target++ = source->blue;
+                    }
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for(uint32_t i = 1; i < workers; i++)
+            threads.emplace_back(work, std::ref(*contexts[i]));
+        work(*contexts[0]);
+        for(auto & thread : threads)
+            thread.join();
+
+        for(long row = stripHeight - 1; row >= 0; row--)
+            outStream.write(strip.data() + static_cast<size_t>(row) * width * 3, width * 3);
+        if(!outStream.good())
+            return false;
+    }
+    return true;
+}
+
+auto TiledRenderer::renderTile(TileContext & context, const std::vector<RecordedBatch> & batches,
+                               const std::vector<std::vector<uint32_t>> & stripPrimitives,
+                               const RGBAValue & clearColor, long x, long y, long tileWidth, long tileHeight) -> void
+{
+    auto & gl = context.gl;
+    if(gl.frameBuffer.width != tileWidth || gl.frameBuffer.height != tileHeight)
+    {
+        gl.frameBuffer.Resize(tileWidth, tileHeight);
+        gl.depthBuffer.Resize(tileWidth, tileHeight);
+    }
+    gl.stateMechine.clearColor = clearColor;
+    gl.clearFramebuffer();
+    gl.clearDepth();
+
+    //batches are replayed in the order they were recorded, so depth ties & overdraw resolve as in one pass
+    for(size_t b = 0; b < batches.size(); b++)
+    {
+        context.primitives.clear();
+        for(auto p : stripPrimitives[b])
+        {
+            float minX, maxX;
+            batches[b].PrimitiveColumns(p, minX, maxX);
+            if(maxX >= x && minX < x + tileWidth)
+                context.primitives.emplace_back(p);
+        }
+        if(!context.primitives.empty())
+            gl.ReplayBatch(batches[b], context.primitives, x, y);
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef TILEDRENDERER_H
+#define TILEDRENDERER_H
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include "FakeGL.h"
+
+//renders images larger than MAX_IMAGE_DIMENSION (e.g. 16k posters) with bounded memory.
+//the scene is run once against the full size viewport with the context recording,
+//so vertex processing is shared by every tile. the recorded primitives are then
+//binned per strip of tiles, each tile rasterised into a small frame buffer on its
+//own thread, and the finished strip streamed to disk as binary PPM.
+//only one strip of the image (width * tileSize pixels) is ever held in memory.
+
+class TiledRenderer
+{
+public:
+    //issues the usual FakeGL calls for one frame : projection, lights, Begin()/End()...
+    //the viewport is already set to the full image and must not be changed
+    using Scene = std::function<void(FakeGL &)>;
+
+    //threadCount of 0 uses every hardware thread
+    TiledRenderer(long width, long height, long tileSize = 1024, uint32_t threadCount = 0);
+
+    //runs the scene on gl (which keeps its texture & clear colour) and writes the image as P6
+    auto render(FakeGL & gl, const Scene & scene, std::ostream & outStream) -> bool;
+
+    inline auto getWidth() const -> long { return width; }
+    inline auto getHeight() const -> long { return height; }
+    inline auto getTileSize() const -> long { return tileSize; }
+
+private:
+    //one rendering context per thread, reused for every tile it renders
+    struct TileContext
+    {
+        FakeGL gl;
+        std::vector<uint32_t> primitives;
+    };
+
+    auto renderTile(TileContext & context, const std::vector<RecordedBatch> & batches,
+                    const std::vector<std::vector<uint32_t>> & stripPrimitives,
+                    const RGBAValue & clearColor, long x, long y, long tileWidth, long tileHeight) -> void;
+
+    long width;
+    long height;
+    long tileSize;
+    uint32_t threadCount;
+};
+
+#endif // TILEDRENDERER_H
@@ -0,0 +1,109 @@
+#include "VertexQuantiser.h"
+
+namespace
+{
+    inline auto quantiseAxis(float value, float offset, float step) -> uint16_t
+    {
+        if(step <= 0.f)
+            return 0;
+        auto q = std::lround((value - offset) / step);
+        return static_cast<uint16_t>(std::min(std::max(q, 0L), 65535L));
+    }
+
+    inline auto quantiseSnorm(float value) -> int16_t
+    {
+        return static_cast<int16_t>(std::lround(std::min(std::max(value, -1.f), 1.f) * 32767.f));
+    }
+};
+
+auto VertexQuantiser::encodeHalf(float value) -> uint16_t
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff);
+    uint32_t mantissa = bits & 0x7fffff;
+
+    //infinity & NaN
+    if(exponent == 0xff)
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+
+    exponent = exponent - 127 + 15;
+    if(exponent >= 31)
+        return sign | 0x7c00;
+
+    //round to nearest even, a carry out of the mantissa correctly bumps the exponent
+    if(exponent <= 0)
+    {
+        if(exponent < -10)
+            return sign;
+        mantissa |= 0x800000;
+        uint32_t shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if(remainder > halfway || (remainder == halfway && (half & 1)))
+            half++;
+        return sign | static_cast<uint16_t>(half);
+    }
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    if(remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        half++;
+    return sign | static_cast<uint16_t>(half);
+}
+
+auto VertexQuantiser::encodeOctahedral(const Cartesian3 & normal, int16_t encoded[2]) -> void
+{
+    float norm = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    if(norm <= 0.f)
+    {
+        encoded[0] = encoded[1] = 0;
+        return;
+    }
+    float x = normal.x / norm;
+    float y = normal.y / norm;
+    if(normal.z < 0.f)
+    {
+        float foldedX = (1.f - std::fabs(y)) * (x >= 0.f ? 1.f : -1.f);
+        float foldedY = (1.f - std::fabs(x)) * (y >= 0.f ? 1.f : -1.f);
+        x = foldedX;
+        y = foldedY;
+    }
+    encoded[0] = quantiseSnorm(x);
+    encoded[1] = quantiseSnorm(y);
+}
+
+auto VertexQuantiser::quantise(const std::vector<Cartesian3> & positions, const std::vector<Cartesian3> & normals,
+                               const std::vector<Cartesian3> & texCoords, std::vector<QuantisedVertex> & vertices,
+                               Cartesian3 & offset, Cartesian3 & step) -> void
+{
+    auto count = positions.size();
+    vertices.resize(count);
+    if(count == 0)
+    {
+        offset = step = Cartesian3(0, 0, 0);
+        return;
+    }
+
+    Cartesian3 minimum = positions[0], maximum = positions[0];
+    for(auto & position : positions)
+    {
+        minimum = Cartesian3(std::min(minimum.x, position.x), std::min(minimum.y, position.y), std::min(minimum.z, position.z));
+        maximum = Cartesian3(std::max(maximum.x, position.x), std::max(maximum.y, position.y), std::max(maximum.z, position.z));
+    }
+    offset = minimum;
+    step = (maximum - minimum) / 65535.f;
+
+    for(size_t i = 0; i < count; i++)
+    {
+        auto & vertex = vertices[i];
+        vertex.position[0] = quantiseAxis(positions[i].x, offset.x, step.x);
+        vertex.position[1] = quantiseAxis(positions[i].y, offset.y, step.y);
+        vertex.position[2] = quantiseAxis(positions[i].z, offset.z, step.z);
+        encodeOctahedral(normals[i], vertex.normal);
+        vertex.texCoord[0] = encodeHalf(texCoords[i].x);
+        vertex.texCoord[1] = encodeHalf(texCoords[i].y);
+        vertex.texCoord[2] = encodeHalf(texCoords[i].z);
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef VERTEXQUANTISER_H
+#define VERTEXQUANTISER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include "Cartesian3.h"
+
+//compact vertex : 16 bytes instead of the 36 of three Cartesian3
+//positions are unorm16 against the mesh bounds, normals two snorm16 octahedral coordinates,
+//texture coordinates IEEE half floats. all three texture coordinates are kept since
+//the UVW can be shown as colour
+struct QuantisedVertex
+{
+    uint16_t position[3];
+    int16_t normal[2];
+    uint16_t texCoord[3];
+};
+
+namespace VertexQuantiser
+{
+    auto encodeHalf(float value) -> uint16_t;
+
+    //maps a unit vector onto the octahedron & unfolds it into the unit square
+    auto encodeOctahedral(const Cartesian3 & normal, int16_t encoded[2]) -> void;
+
+    //quantises parallel attribute arrays. a position decodes as offset + position * step
+    auto quantise(const std::vector<Cartesian3> & positions, const std::vector<Cartesian3> & normals,
+                  const std::vector<Cartesian3> & texCoords, std::vector<QuantisedVertex> & vertices,
+                  Cartesian3 & offset, Cartesian3 & step) -> void;
+
+    //decoding happens once per vertex fetch, so it lives here to be inlined
+
+    inline auto decodeHalf(uint16_t half) -> float
+    {
+        uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+        uint32_t exponent = (half >> 10) & 0x1f;
+        uint32_t mantissa = half & 0x3ff;
+        uint32_t bits;
+        if(exponent == 0x1f)
+            bits = sign | 0x7f800000 | (mantissa << 13);
+        else if(exponent != 0)
+            bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        else if(mantissa == 0)
+            bits = sign;
+        else
+        {
+            //denormal : same value as a float, just renormalised
+            float value = std::ldexp(static_cast<float>(mantissa), -24);
+            return sign ? -value : value;
+        }
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    inline auto decodeOctahedral(const int16_t encoded[2]) -> Cartesian3
+    {
+        float x = std::max(encoded[0] / 32767.f, -1.f);
+        float y = std::max(encoded[1] / 32767.f, -1.f);
+        float z = 1.f - std::fabs(x) - std::fabs(y);
+        //the lower hemisphere was folded over the diagonals
+        float t = std::max(-z, 0.f);
+        x += x >= 0.f ? -t : t;
+        y += y >= 0.f ? -t : t;
+        return Cartesian3(x, y, z).unit();
+    }
+
+    inline auto decodePosition(const QuantisedVertex & vertex, const Cartesian3 & offset, const Cartesian3 & step) -> Cartesian3
+    {
+        return Cartesian3(offset.x + vertex.position[0] * step.x,
+                          offset.y + vertex.position[1] * step.y,
+                          offset.z + vertex.position[2] * step.z);
+    }
+
+    inline auto decodeTexCoord(const QuantisedVertex & vertex) -> Cartesian3
+    {
+        return Cartesian3(decodeHalf(vertex.texCoord[0]), decodeHalf(vertex.texCoord[1]), decodeHalf(vertex.texCoord[2]));
+    }
+};
+
+#endif // VERTEXQUANTISER_H
@@ -0,0 +1,83 @@
+######################################################################
+# Headless command-line renderer: FakeGL only, no Qt or OpenGL
+######################################################################
+
+TEMPLATE = app
+TARGET = fakegl_cli
+CONFIG += console thread
+CONFIG -= qt app_bundle
+DEFINES += FAKEGL_HEADLESS
+INCLUDEPATH += .
+
+# Input
+HEADERS += BinnedSAH.h \
+           Cartesian3.h \
+           Color.h \
+           FakeGL.h \
+           FakeGLScene.h \
+           FrameCapture.h \
+           Homogeneous4.h \
+           ImpostorCache.h \
+           IndexedMesh.h \
+           Light.h \
+           MappedFile.h \
+           Material.h \
+           MathUtils.h \
+           MeshBVH.h \
+           MeshFile.h \
+           Meshlet.h \
+           MeshOptimiser.h \
+           MeshSimplifier.h \
+           Matrix4.h \
+           ObjParser.h \
+           OcclusionCuller.h \
+           PipelineStatistics.h \
+           Quaternion.h \
+           RenderParameters.h \
+           RGBAImage.h \
+           RGBAValue.h \
+           Scene.h \
+           Shader.h \
+           ShadowMap.h \
+           ShadowSource.h \
+           ShadowTracer.h \
+           SimdMath.h \
+           StateMechine.h \
+           Texture2D.h \
+           TexturedObject.h \
+           TiledRenderer.h \
+           VertexQuantiser.h
+SOURCES += Cartesian3.cpp \
+           Color.cpp \
+           FakeGL.cpp \
+           FakeGLCli.cpp \
+           FakeGLScene.cpp \
+           FrameCapture.cpp \
+           Homogeneous4.cpp \
+           ImpostorCache.cpp \
+           IndexedMesh.cpp \
+           Light.cpp \
+           MappedFile.cpp \
+           Material.cpp \
+           MathUtils.cpp \
+           MeshBVH.cpp \
+           MeshFile.cpp \
+           Meshlet.cpp \
+           MeshOptimiser.cpp \
+           MeshSimplifier.cpp \
+           Matrix4.cpp \
+           ObjParser.cpp \
+           OcclusionCuller.cpp \
+           PipelineStatistics.cpp \
+           Quaternion.cpp \
+           RGBAImage.cpp \
+           RGBAValue.cpp \
+           Scene.cpp \
+           Shader.cpp \
+           ShadowMap.cpp \
+           ShadowTracer.cpp \
+           StateMechine.cpp \
+           Texture2D.cpp \
+           TexturedObject.cpp \
+           TiledRenderer.cpp \
+           VertexQuantiser.cpp
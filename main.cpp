@@ -18,6 +18,7 @@
 // system libraries
 #include <iostream>
 #include <fstream>
+#include <string>
 
 // QT
 #include <QApplication>
@@ -46,18 +47,40 @@ int main(int argc, char **argv)
     //  use the argument to create a height field &c.
     TexturedObject texturedObject;
 
-    // open the input files for the geometry & texture
-
-    std::ifstream geometryFile(argv[1]);
+    // open the input file for the texture - the geometry file is mapped directly
     std::ifstream textureFile(argv[2]);
 
     // try reading it
-    if (!(geometryFile.good()) || !(textureFile.good()) || (!texturedObject.ReadObjectStream(geometryFile, textureFile)))
+    if (!(textureFile.good()) || (!texturedObject.ReadObjectFile(argv[1], textureFile)))
         { // object read failed 
         std::cout << "Read failed for object " << argv[1] << " or texture " << argv[2] << std::endl;
         return 0;
         } // object read failed
 
+    // optional flags after the texture: -quantise switches to the compact vertex format,
+    // -stats reports how the mesh uses the vertex cache & the levels of detail built for it
+    bool quantise = false, reportStats = false;
+    for (int arg = 3; arg < argc; arg++)
+        { // per flag
+        if (std::string(argv[arg]) == "-quantise")
+            quantise = true;
+        else if (std::string(argv[arg]) == "-stats")
+            reportStats = true;
+        } // per flag
+
+    if (reportStats)
+        { // report stats
+        std::cout << "ACMR " << texturedObject.originalACMR << " -> " << texturedObject.optimisedACMR
+                  << " (" << texturedObject.meshLevels[0].vertexCount() << " vertices, "
+                  << texturedObject.meshLevels[0].triangleCount() << " triangles)" << std::endl;
+        for (unsigned int level = 1; level < texturedObject.meshLevels.size(); level++)
+            std::cout << "LOD " << level << ": " << texturedObject.meshLevels[level].triangleCount()
+                      << " triangles, error " << texturedObject.meshLevels[level].error << std::endl;
+        } // report stats
+
+    if (quantise)
+        texturedObject.QuantiseMesh();
+
     // dump the file to out
 //      texturedObject.WriteObjectStream(std::cout, std::cout);
 